@@ -0,0 +1,231 @@
+// Compares the speed and memory use of the Dictionary backends in
+// ../lib/Dictionary.c, for picking a backend with
+// qsDictionaryCreateBackend().
+//
+// Run: ./Dictionary_bench [MAX_NUM_KEYS]
+//
+// For each set of keys and number of keys it prints the nano seconds per
+// key to insert all the keys, to find all the keys (in a shuffled order),
+// to find keys that are not there, to go through all the keys with
+// qsDictionaryForEach(), and the heap bytes per key.  The "frozen"
+// backend is the trie after qsDictionaryFreeze(), and its insert time
+// includes the freeze.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <inttypes.h>
+
+#include "../lib/Dictionary.h"
+#include "../lib/debug.h"
+
+
+static double Time(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+
+// Large allocations are mmap()ed and not in uordblks.
+static size_t HeapUsed(void) {
+
+    struct mallinfo2 m = mallinfo2();
+    return m.uordblks + m.hblkhd;
+}
+
+
+// A simple LCG so that every run shuffles the same way.
+static uint32_t seed;
+
+static uint32_t Rand(void) {
+
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+
+// Filter names like the stream makes them from the filter module file
+// names.
+static const char *modules[] = {
+    "tests/sequenceGen", "tests/sequenceCheck", "tests/passThrough",
+    "tests/stdin", "stdout", "fileIn", "fileOut", "uhd/rx",
+    "rtlsdr/read", "tests/interleave", 0
+};
+
+static void FilterName(char *key, size_t len, size_t i) {
+
+    size_t n = sizeof(modules)/sizeof(modules[0]) - 1;
+    if(i < n)
+        snprintf(key, len, "%s", modules[i]);
+    else
+        snprintf(key, len, "%s-%zu", modules[i%n], i/n + 1);
+}
+
+
+// Parameter names, with the filter name in front, like in the dictionary
+// of a controller that watches the parameters of all the filters.
+static const char *parameters[] = {
+    "freq", "rate", "gain", "bytesRate", "bytesCount", "antenna",
+    "bandwidth", "sequence", 0
+};
+
+static void ParameterName(char *key, size_t len, size_t i) {
+
+    size_t n = sizeof(parameters)/sizeof(parameters[0]) - 1;
+    char filterName[64];
+    FilterName(filterName, sizeof(filterName), i/n);
+    snprintf(key, len, "%s:%s", filterName, parameters[i%n]);
+}
+
+
+static const struct KeySet {
+    const char *name;
+    void (*make)(char *key, size_t len, size_t i);
+} keySets[] = {
+    { "filter names", FilterName },
+    { "parameter names", ParameterName },
+    { 0, 0 }
+};
+
+
+static const struct Backend {
+    const char *name;
+    enum QsDictionaryBackend backend;
+    bool freeze;
+} backends[] = {
+    { "trie", QsDictionaryTrie, false },
+    { "frozen", QsDictionaryTrie, true },
+    { "hash", QsDictionaryHash, false },
+    { "sorted", QsDictionarySorted, false },
+    { 0, 0, false }
+};
+
+
+static size_t forEachCount;
+
+static int Count(const char *key, void *value, void *userData) {
+    ++forEachCount;
+    return 0;
+}
+
+
+// Find at least this many keys for each result, so the small key sets
+// get timed too.
+#define MIN_FINDS  ((size_t) 2000000)
+
+
+static void Run(const struct Backend *b, char **keys, char **missing,
+        size_t num) {
+
+    size_t heap = HeapUsed();
+    double t = Time();
+
+    struct QsDictionary *d = qsDictionaryCreateBackend(b->backend);
+    for(size_t i = 0; i < num; ++i)
+        ASSERT(qsDictionaryInsert(d, keys[i], keys[i], 0) == 0);
+    if(b->freeze)
+        qsDictionaryFreeze(d);
+
+    double insert = Time() - t;
+    heap = HeapUsed() - heap;
+
+    // Find them in a different order than they were inserted.
+    char **order = malloc(num * sizeof(*order));
+    ASSERT(order);
+    memcpy(order, keys, num * sizeof(*order));
+    seed = 1;
+    for(size_t i = num - 1; i > 0; --i) {
+        size_t j = Rand() % (i + 1);
+        char *k = order[i];
+        order[i] = order[j];
+        order[j] = k;
+    }
+
+    size_t reps = MIN_FINDS/num + 1;
+
+    t = Time();
+    for(size_t r = 0; r < reps; ++r)
+        for(size_t i = 0; i < num; ++i)
+            if(qsDictionaryFind(d, order[i]) != order[i])
+                ASSERT(0, "key \"%s\" not found", order[i]);
+    double find = Time() - t;
+
+    t = Time();
+    for(size_t r = 0; r < reps; ++r)
+        for(size_t i = 0; i < num; ++i)
+            if(qsDictionaryFind(d, missing[i]))
+                ASSERT(0, "key \"%s\" found", missing[i]);
+    double miss = Time() - t;
+
+    forEachCount = 0;
+    reps = reps/8 + 1;
+    t = Time();
+    for(size_t r = 0; r < reps; ++r)
+        qsDictionaryForEach(d, Count, 0);
+    double forEach = Time() - t;
+    ASSERT(forEachCount == reps * num);
+
+    printf("  %-7s %7zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+            b->name, num,
+            1.0e9 * insert/num,
+            1.0e9 * find/(num * (MIN_FINDS/num + 1)),
+            1.0e9 * miss/(num * (MIN_FINDS/num + 1)),
+            1.0e9 * forEach/(num * reps),
+            ((double) heap)/num);
+
+    qsDictionaryDestroy(d);
+    free(order);
+}
+
+
+int main(int argc, char **argv) {
+
+    size_t maxNum = 100000;
+    if(argc > 1)
+        maxNum = strtoul(argv[1], 0, 10);
+    ASSERT(maxNum >= 10);
+
+    char **keys = malloc(maxNum * sizeof(*keys));
+    char **missing = malloc(maxNum * sizeof(*missing));
+    ASSERT(keys && missing);
+
+    for(const struct KeySet *set = keySets; set->name; ++set) {
+
+        char key[128];
+        for(size_t i = 0; i < maxNum; ++i) {
+            set->make(key, sizeof(key) - 1, i);
+            keys[i] = strdup(key);
+            // Keys that are not there, but that start like the ones that
+            // are.
+            strcat(key, "x");
+            missing[i] = strdup(key);
+            ASSERT(keys[i] && missing[i]);
+        }
+
+        printf("\n%s, like \"%s\"\n\n", set->name, keys[maxNum - 1]);
+        printf("  %-7s %7s %10s %10s %10s %10s %10s\n", "backend",
+                "keys", "insert ns", "find ns", "miss ns",
+                "forEach ns", "bytes");
+
+        for(size_t num = 10; num <= maxNum; num *= 10) {
+            for(const struct Backend *b = backends; b->name; ++b)
+                Run(b, keys, missing, num);
+            printf("\n");
+        }
+
+        for(size_t i = 0; i < maxNum; ++i) {
+            free(keys[i]);
+            free(missing[i]);
+        }
+    }
+
+    free(keys);
+    free(missing);
+
+    return 0;
+}
@@ -0,0 +1,644 @@
+// An emulated librtlsdr, so that we can run the librtlsdr based filters,
+// like librtlsdr/iq, without an RTL-SDR dongle.
+//
+// Use it with LD_PRELOAD, like for example:
+//
+//   export LD_PRELOAD=dev_tests/librtlsdrEmulator.so
+//   quickstream -f librtlsdr/iq -f stdout -c -r > iq.bin
+//
+// or link with it in place of -lrtlsdr.
+//
+// It serves rtlsdr_read_sync() and rtlsdr_read_async() with 8 bit
+// unsigned I/Q data, like the dongle, from a file or from a tone
+// generator, at the sample rate that was set or as fast as it can.  It
+// can stall like a USB device that stops responding for a while, and the
+// samples that the device would have made during the stall are lost, like
+// they are in an overrun.  In real-time, a reader that falls more than the
+// USB buffers behind the sample clock loses the oldest samples, like it
+// does with the dongle.  For rtlsdr_read_async() the buffers are buf_num
+// times buf_len bytes, and for rtlsdr_read_sync() we say it is one default
+// buf_len.
+//
+// Since we cannot pass arguments to a LD_PRELOAD library it is set up with
+// these environment variables:
+//
+//   RTLSDR_EMU_FILE=FILE   Replay the uint8 I/Q data in FILE, over and
+//                          over.  Without this we generate a tone.
+//
+//   RTLSDR_EMU_TONE=F      The generated tone is F Hz from the center
+//                          frequency.  The default F is 100000.
+//
+//   RTLSDR_EMU_RATE=MODE   MODE is "real" to make data at the sample rate
+//                          that was set, or "unlimited" to make data as
+//                          fast as it is read.  The default is real.
+//
+//   RTLSDR_EMU_STALL=P:D   Stall for D seconds every P seconds of samples.
+//                          By default there are no stalls.
+//
+//   RTLSDR_EMU_DEVICES=N   Say there are N devices.  The default is 1.
+//
+//   RTLSDR_EMU_VERBOSE=1   Print what is called to stderr.
+//
+// We declare the librtlsdr functions here, and do not include rtl-sdr.h,
+// so we can build this without librtlsdr installed.  The signatures must
+// match those in rtl-sdr.h.
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <time.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+
+#define DEFAULT_RATE       ((uint32_t) 2048000)
+#define DEFAULT_TONE       ((double) 100000.0)
+#define DEFAULT_BUF_NUM    ((uint32_t) 15)
+#define DEFAULT_BUF_LEN    ((uint32_t) (16 * 32 * 512))
+
+
+#define SPEW(fmt, ...)                                              \
+    do {                                                            \
+        if(verbose)                                                 \
+            fprintf(stderr, "rtlsdrEmulator: " fmt "\n",            \
+                    ##__VA_ARGS__);                                 \
+    } while(0)
+
+#define ERR(fmt, ...)                                               \
+    fprintf(stderr, "rtlsdrEmulator: ERROR: " fmt "\n", ##__VA_ARGS__)
+
+
+typedef void (*rtlsdr_read_async_cb_t)(unsigned char *buf, uint32_t len,
+        void *ctx);
+
+
+struct rtlsdr_dev {
+
+    uint32_t index;
+    uint32_t rate;
+    uint32_t freq;
+    int ppm;
+    int gain;
+    int gainMode;
+    int agc;
+    int directSampling;
+    int offsetTuning;
+    int testMode;
+
+    // The file data.
+    uint8_t *data;
+    size_t dataLen, dataIndex;
+
+    // The tone generator phase in cycles.
+    double phase;
+
+    // Samples made since rtlsdr_reset_buffer(), including the lost ones.
+    uint64_t count;
+    // Samples lost in stalls and overruns.
+    uint64_t lost;
+    // How many samples the USB buffers hold for a reader that is behind.
+    uint64_t bufSamples;
+    // The time of sample 0.
+    struct timespec t0;
+    bool started;
+
+    // The next stall is at this sample count.
+    uint64_t nextStall;
+
+    atomic_bool cancel;
+    bool inAsync;
+};
+
+typedef struct rtlsdr_dev rtlsdr_dev_t;
+
+
+static bool verbose = false;
+static bool unlimited = false;
+static double tone = DEFAULT_TONE;
+static double stallPeriod = 0.0, stallDuration = 0.0;
+static const char *file = 0;
+static uint32_t numDevices = 1;
+
+
+static void GetEnv(void) {
+
+    const char *env;
+
+    if((env = getenv("RTLSDR_EMU_VERBOSE")) && *env && *env != '0')
+        verbose = true;
+    if((env = getenv("RTLSDR_EMU_FILE")) && *env)
+        file = env;
+    if((env = getenv("RTLSDR_EMU_TONE")) && *env)
+        tone = strtod(env, 0);
+    if((env = getenv("RTLSDR_EMU_RATE")) && *env) {
+        if(strcmp(env, "unlimited") == 0)
+            unlimited = true;
+        else if(strcmp(env, "real") == 0)
+            unlimited = false;
+        else
+            ERR("Bad RTLSDR_EMU_RATE=\"%s\" using real", env);
+    }
+    if((env = getenv("RTLSDR_EMU_STALL")) && *env) {
+        if(sscanf(env, "%lf:%lf", &stallPeriod, &stallDuration) != 2 ||
+                stallPeriod <= 0.0 || stallDuration < 0.0) {
+            ERR("Bad RTLSDR_EMU_STALL=\"%s\"", env);
+            stallPeriod = stallDuration = 0.0;
+        }
+    }
+    if((env = getenv("RTLSDR_EMU_DEVICES")) && *env)
+        numDevices = strtoul(env, 0, 10);
+}
+
+
+// Returns 0 on success.
+static int LoadFile(struct rtlsdr_dev *d) {
+
+    FILE *f = fopen(file, "r");
+    if(!f) {
+        ERR("fopen(\"%s\", \"r\") failed", file);
+        return -1;
+    }
+
+    size_t alloc = 1 << 16;
+    d->data = malloc(alloc);
+    size_t rd;
+    while(d->data &&
+            (rd = fread(d->data + d->dataLen, 1, alloc - d->dataLen, f))) {
+        d->dataLen += rd;
+        if(d->dataLen == alloc) {
+            alloc *= 2;
+            d->data = realloc(d->data, alloc);
+        }
+    }
+    fclose(f);
+
+    if(!d->data) {
+        ERR("malloc() failed");
+        return -1;
+    }
+
+    // Whole I/Q pairs.
+    d->dataLen &= ~((size_t) 1);
+    if(d->dataLen == 0) {
+        ERR("File \"%s\" has no data", file);
+        free(d->data);
+        d->data = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static inline double Seconds(const struct timespec *t) {
+
+    return t->tv_sec + 1.0e-9 * t->tv_nsec;
+}
+
+
+static void SleepUntil(double t) {
+
+    struct timespec ts;
+    ts.tv_sec = (time_t) t;
+    ts.tv_nsec = (long) ((t - floor(t)) * 1.0e9);
+    if(ts.tv_nsec >= 1000000000) {
+        ts.tv_nsec -= 1000000000;
+        ++ts.tv_sec;
+    }
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR);
+}
+
+
+static void Start(struct rtlsdr_dev *d) {
+
+    clock_gettime(CLOCK_MONOTONIC, &d->t0);
+    d->count = 0;
+    d->lost = 0;
+    d->nextStall = (stallPeriod > 0.0)?(stallPeriod * d->rate):UINT64_MAX;
+    if(d->nextStall == 0)
+        d->nextStall = 1;
+    d->started = true;
+}
+
+
+// Make n samples of I/Q data into buf, 2*n bytes.
+static void Make(struct rtlsdr_dev *d, uint8_t *buf, size_t n) {
+
+    if(d->data) {
+        size_t len = 2*n;
+        while(len) {
+            size_t l = d->dataLen - d->dataIndex;
+            if(l > len) l = len;
+            memcpy(buf, d->data + d->dataIndex, l);
+            buf += l;
+            len -= l;
+            d->dataIndex += l;
+            if(d->dataIndex == d->dataLen)
+                d->dataIndex = 0;
+        }
+        return;
+    }
+
+    // The tone.  Like the dongle, 127.5 is zero.
+    double dph = tone/d->rate;
+    double complex p = 127.0 * cexp(I * 2.0 * M_PI * d->phase);
+    double complex s = cexp(I * 2.0 * M_PI * dph);
+    for(size_t i=0; i<n; ++i) {
+        buf[2*i] = (uint8_t) (creal(p) + 128.0);
+        buf[2*i+1] = (uint8_t) (cimag(p) + 128.0);
+        p *= s;
+    }
+    d->phase += n * dph;
+    d->phase -= floor(d->phase);
+}
+
+
+// Skip n samples, like they were lost in an overrun.
+static void Skip(struct rtlsdr_dev *d, uint64_t n) {
+
+    if(d->data)
+        d->dataIndex = (d->dataIndex + (2*n) % d->dataLen) % d->dataLen;
+    else {
+        d->phase += n * (tone/d->rate);
+        d->phase -= floor(d->phase);
+    }
+}
+
+
+// Wait for and make n samples into buf.
+static void Read(struct rtlsdr_dev *d, uint8_t *buf, size_t n) {
+
+    if(!d->started)
+        Start(d);
+
+    if(!unlimited) {
+        // The device kept making samples while the reader was away.  The
+        // ones that did not fit in the buffers are lost.
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        uint64_t made = (Seconds(&t) - Seconds(&d->t0)) * d->rate;
+        if(made > d->count + d->bufSamples) {
+            uint64_t drop = made - d->count - d->bufSamples;
+            SPEW("overrun lost %" PRIu64 " samples at sample %" PRIu64,
+                    drop, d->count);
+            Skip(d, drop);
+            d->count += drop;
+            d->lost += drop;
+            if(d->nextStall < d->count)
+                d->nextStall = d->count;
+        }
+    }
+
+    if(d->count + n > d->nextStall) {
+        // The USB stalls.
+        uint64_t stall = stallDuration * d->rate;
+        SPEW("stalling for %lg seconds at sample %" PRIu64,
+                stallDuration, d->nextStall);
+        if(unlimited) {
+            struct timespec t;
+            clock_gettime(CLOCK_MONOTONIC, &t);
+            SleepUntil(Seconds(&t) + stallDuration);
+        }
+        // The samples from the stall are lost.  In real-time the clock
+        // went on so we do not sleep for them again below.
+        Skip(d, stall);
+        d->count += stall;
+        d->lost += stall;
+        d->nextStall += (stallPeriod * d->rate) + stall;
+    }
+
+    d->count += n;
+
+    if(!unlimited)
+        // Wait until the last sample is made.
+        SleepUntil(Seconds(&d->t0) + ((double) d->count)/d->rate);
+
+    Make(d, buf, n);
+}
+
+
+uint32_t rtlsdr_get_device_count(void) {
+
+    GetEnv();
+    return numDevices;
+}
+
+
+const char *rtlsdr_get_device_name(uint32_t index) {
+
+    if(index >= rtlsdr_get_device_count())
+        return "";
+    return "Generic RTL2832U OEM (emulated)";
+}
+
+
+int rtlsdr_get_device_usb_strings(uint32_t index, char *manufact,
+        char *product, char *serial) {
+
+    if(index >= rtlsdr_get_device_count())
+        return -1;
+    if(manufact) strcpy(manufact, "Realtek");
+    if(product) strcpy(product, "RTL2838UHIDIR");
+    if(serial) snprintf(serial, 256, "%08" PRIu32, index + 1);
+    return 0;
+}
+
+
+int rtlsdr_get_index_by_serial(const char *serial) {
+
+    if(!serial)
+        return -1;
+    uint32_t n = rtlsdr_get_device_count();
+    if(n == 0)
+        return -2;
+    char *end = 0;
+    unsigned long i = strtoul(serial, &end, 10);
+    if(*end || i < 1 || i > n)
+        return -3;
+    return i - 1;
+}
+
+
+int rtlsdr_open(rtlsdr_dev_t **dev, uint32_t index) {
+
+    GetEnv();
+
+    if(index >= numDevices) {
+        ERR("rtlsdr_open(,%" PRIu32 ") no such device", index);
+        return -1;
+    }
+
+    struct rtlsdr_dev *d = calloc(1, sizeof(*d));
+    if(!d) {
+        ERR("calloc(1,%zu) failed", sizeof(*d));
+        return -1;
+    }
+    d->index = index;
+    d->rate = DEFAULT_RATE;
+    d->bufSamples = DEFAULT_BUF_LEN/2;
+    atomic_init(&d->cancel, false);
+
+    if(file && LoadFile(d)) {
+        free(d);
+        return -1;
+    }
+
+    SPEW("opened device %" PRIu32 " %s %s", index,
+            file?file:"tone", unlimited?"unlimited":"real-time");
+
+    *dev = d;
+    return 0;
+}
+
+
+int rtlsdr_close(rtlsdr_dev_t *d) {
+
+    if(!d)
+        return -1;
+
+    SPEW("closed device %" PRIu32 " after %" PRIu64 " samples, %"
+            PRIu64 " lost", d->index, d->count, d->lost);
+
+    if(d->data)
+        free(d->data);
+    free(d);
+    return 0;
+}
+
+
+int rtlsdr_set_xtal_freq(rtlsdr_dev_t *d, uint32_t rtl_freq,
+        uint32_t tuner_freq) {
+    return d?0:-1;
+}
+
+
+int rtlsdr_get_xtal_freq(rtlsdr_dev_t *d, uint32_t *rtl_freq,
+        uint32_t *tuner_freq) {
+    if(!d) return -1;
+    if(rtl_freq) *rtl_freq = 28800000;
+    if(tuner_freq) *tuner_freq = 28800000;
+    return 0;
+}
+
+
+int rtlsdr_get_usb_strings(rtlsdr_dev_t *d, char *manufact,
+        char *product, char *serial) {
+    if(!d) return -1;
+    return rtlsdr_get_device_usb_strings(d->index, manufact, product,
+            serial);
+}
+
+
+int rtlsdr_set_center_freq(rtlsdr_dev_t *d, uint32_t freq) {
+    if(!d) return -1;
+    SPEW("rtlsdr_set_center_freq(,%" PRIu32 ")", freq);
+    d->freq = freq;
+    return 0;
+}
+
+
+uint32_t rtlsdr_get_center_freq(rtlsdr_dev_t *d) {
+    return d?d->freq:0;
+}
+
+
+int rtlsdr_set_freq_correction(rtlsdr_dev_t *d, int ppm) {
+    if(!d) return -1;
+    if(d->ppm == ppm) return -2; // like librtlsdr
+    d->ppm = ppm;
+    return 0;
+}
+
+
+int rtlsdr_get_freq_correction(rtlsdr_dev_t *d) {
+    return d?d->ppm:0;
+}
+
+
+// RTLSDR_TUNER_R820T
+int rtlsdr_get_tuner_type(rtlsdr_dev_t *d) {
+    return d?5:0;
+}
+
+
+// The R820T gains in tenths of a dB.
+static const int gains[] = {
+    0, 9, 14, 27, 37, 77, 87, 125, 144, 157, 166, 197, 207, 229, 254,
+    280, 297, 328, 338, 364, 372, 386, 402, 421, 434, 439, 445, 480, 496
+};
+
+
+int rtlsdr_get_tuner_gains(rtlsdr_dev_t *d, int *g) {
+    if(!d) return -1;
+    const int n = sizeof(gains)/sizeof(gains[0]);
+    if(g) memcpy(g, gains, sizeof(gains));
+    return n;
+}
+
+
+int rtlsdr_set_tuner_gain(rtlsdr_dev_t *d, int gain) {
+    if(!d) return -1;
+    SPEW("rtlsdr_set_tuner_gain(,%d)", gain);
+    d->gain = gain;
+    return 0;
+}
+
+
+int rtlsdr_set_tuner_bandwidth(rtlsdr_dev_t *d, uint32_t bw) {
+    return d?0:-1;
+}
+
+
+int rtlsdr_get_tuner_gain(rtlsdr_dev_t *d) {
+    return d?d->gain:0;
+}
+
+
+int rtlsdr_set_tuner_if_gain(rtlsdr_dev_t *d, int stage, int gain) {
+    return d?0:-1;
+}
+
+
+int rtlsdr_set_tuner_gain_mode(rtlsdr_dev_t *d, int manual) {
+    if(!d) return -1;
+    d->gainMode = manual;
+    return 0;
+}
+
+
+int rtlsdr_set_sample_rate(rtlsdr_dev_t *d, uint32_t rate) {
+    if(!d) return -1;
+    // The same limits as librtlsdr.
+    if((rate <= 225000) || (rate > 3200000) ||
+            ((rate > 300000) && (rate <= 900000))) {
+        ERR("Invalid sample rate: %" PRIu32 " Hz", rate);
+        return -EINVAL;
+    }
+    SPEW("rtlsdr_set_sample_rate(,%" PRIu32 ")", rate);
+    d->rate = rate;
+    d->started = false;
+    return 0;
+}
+
+
+uint32_t rtlsdr_get_sample_rate(rtlsdr_dev_t *d) {
+    return d?d->rate:0;
+}
+
+
+int rtlsdr_set_testmode(rtlsdr_dev_t *d, int on) {
+    if(!d) return -1;
+    d->testMode = on;
+    return 0;
+}
+
+
+int rtlsdr_set_agc_mode(rtlsdr_dev_t *d, int on) {
+    if(!d) return -1;
+    d->agc = on;
+    return 0;
+}
+
+
+int rtlsdr_set_direct_sampling(rtlsdr_dev_t *d, int on) {
+    if(!d) return -1;
+    d->directSampling = on;
+    return 0;
+}
+
+
+int rtlsdr_get_direct_sampling(rtlsdr_dev_t *d) {
+    return d?d->directSampling:-1;
+}
+
+
+int rtlsdr_set_offset_tuning(rtlsdr_dev_t *d, int on) {
+    if(!d) return -1;
+    d->offsetTuning = on;
+    return 0;
+}
+
+
+int rtlsdr_get_offset_tuning(rtlsdr_dev_t *d) {
+    return d?d->offsetTuning:-1;
+}
+
+
+int rtlsdr_set_bias_tee(rtlsdr_dev_t *d, int on) {
+    return d?0:-1;
+}
+
+
+int rtlsdr_reset_buffer(rtlsdr_dev_t *d) {
+    if(!d) return -1;
+    d->started = false;
+    return 0;
+}
+
+
+int rtlsdr_read_sync(rtlsdr_dev_t *d, void *buf, int len, int *n_read) {
+
+    if(!d || !buf || len < 0)
+        return -1;
+
+    size_t n = len/2;
+    Read(d, buf, n);
+    if(n_read)
+        *n_read = 2*n;
+    return 0;
+}
+
+
+int rtlsdr_read_async(rtlsdr_dev_t *d, rtlsdr_read_async_cb_t cb,
+        void *ctx, uint32_t buf_num, uint32_t buf_len) {
+
+    if(!d || !cb || d->inAsync)
+        return -1;
+
+    if(buf_num == 0)
+        buf_num = DEFAULT_BUF_NUM;
+    if(buf_len == 0 || buf_len % 512)
+        buf_len = DEFAULT_BUF_LEN;
+
+    // Like libusb we cycle through buf_num buffers.
+    uint8_t *bufs = malloc(((size_t) buf_num) * buf_len);
+    if(!bufs) {
+        ERR("malloc(%zu) failed", ((size_t) buf_num) * buf_len);
+        return -1;
+    }
+
+    d->inAsync = true;
+    d->bufSamples = (((uint64_t) buf_num) * buf_len)/2;
+    atomic_store(&d->cancel, false);
+
+    for(uint32_t i=0; !atomic_load(&d->cancel); i = (i + 1) % buf_num) {
+        uint8_t *buf = bufs + ((size_t) i) * buf_len;
+        Read(d, buf, buf_len/2);
+        if(atomic_load(&d->cancel))
+            break;
+        cb(buf, buf_len, ctx);
+    }
+
+    free(bufs);
+    d->bufSamples = DEFAULT_BUF_LEN/2;
+    d->inAsync = false;
+    return 0;
+}
+
+
+int rtlsdr_wait_async(rtlsdr_dev_t *d, rtlsdr_read_async_cb_t cb,
+        void *ctx) {
+    return rtlsdr_read_async(d, cb, ctx, 0, 0);
+}
+
+
+int rtlsdr_cancel_async(rtlsdr_dev_t *d) {
+    if(!d) return -1;
+    atomic_store(&d->cancel, true);
+    return 0;
+}
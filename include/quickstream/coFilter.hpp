@@ -0,0 +1,555 @@
+#ifndef __qscofilter_hpp__
+#define __qscofilter_hpp__
+
+#ifndef __cplusplus
+#  error "This is C++ not C"
+#endif
+
+#if __cplusplus < 202002L
+#  error "This needs C++20 or later"
+#endif
+
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <cstddef>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "filter.h"
+#include "typedFilter.hpp"
+
+/** \file
+ */
+
+/** \page coFilters C++ filter modules that are coroutines
+ *
+ * \headerfile coFilter.hpp "quickstream/coFilter.hpp"
+ *
+ * This is a header only C++20 filter module API, that is like the typed
+ * filter API in typedFilter.hpp (see \ref typedFilters), but in place of
+ * an input() method the filter class has a run() coroutine that is
+ * called once per stream run.  run() waits with \c co_await for input,
+ * output space, or a file descriptor to be ready.  While run() waits the
+ * worker thread that called it is free to run other filters, and the
+ * stream resumes run() when what it waits for is ready.  For example:
+ *
+ * \code
+ * class Frame : public qs::CoFilter<Frame,
+ *         qs::Inputs<float>, qs::Outputs<float>> {
+ *
+ *     public:
+ *
+ *     Frame(int argc, const char **argv) {
+ *         in<0>().maxRead = 64;
+ *     }
+ *
+ *     qs::Task run(void) {
+ *         for(;;) {
+ *             co_await in<0>().read(64);
+ *             co_await out<0>().space(64);
+ *             float *o = out<0>().get(64);
+ *             ...
+ *             in<0>().advance(64);
+ *             out<0>().write(64);
+ *         }
+ *     }
+ * };
+ *
+ * QS_TYPED_FILTER_MODULE(Frame)
+ * \endcode
+ *
+ * run() may wait for:
+ *
+ *   - in<i>().read(n): n elements on input port i, or the input to be
+ *     flushing.  n may not be more than in<i>().maxRead, which the
+ *     filter may set in its constructor.
+ *   - out<i>().space(n): room to write n elements to output port i, in
+ *     this resume of run().
+ *   - qs::readable(fd) and qs::writable(fd): a file descriptor to be
+ *     ready, using qsWaitFd().
+ *
+ * The filter is done for the stream run when run() returns (\c co_return)
+ * or throws an exception, which is an error.
+ *
+ * Ports are refreshed each time the stream resumes run(), so pointers
+ * from data() and get() are only good until the next \c co_await that
+ * suspends run().
+ *
+ * The class may also define a constructor with the arguments (int argc,
+ * const char **argv), int start(void), int stop(void), and static void
+ * help(FILE *file), like with qs::Filter.
+ */
+
+
+namespace qs {
+
+
+/** The return type of a qs::CoFilter run() coroutine */
+class Task {
+
+    public:
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+        struct promise_type {
+
+            // The input() return value when run() is done.
+            int ret = 1;
+
+            // If run() is suspended, poll(awaiter) returns true if what
+            // it waits for is ready.
+            bool (*poll)(const void *awaiter) = nullptr;
+            const void *awaiter = nullptr;
+
+            Task get_return_object(void) {
+                return Task(std::coroutine_handle<promise_type>::
+                        from_promise(*this));
+            };
+
+            // run() is not called until the first filter input() call.
+            std::suspend_always initial_suspend(void) noexcept {
+                return {};
+            };
+
+            std::suspend_always final_suspend(void) noexcept {
+                return {};
+            };
+
+            void return_void(void) { };
+
+            void unhandled_exception(void) {
+                ret = -1;
+                try {
+                    std::rethrow_exception(std::current_exception());
+                } catch(const std::exception &e) {
+                    fprintf(stderr, "filter \"%s\" run() failed: %s\n",
+                            qsGetFilterName(), e.what());
+                } catch(...) {
+                    fprintf(stderr, "filter \"%s\" run() failed\n",
+                            qsGetFilterName());
+                }
+            };
+        };
+
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        Task(void) = default;
+
+        Task(Task &&t): handle_(std::exchange(t.handle_, nullptr)) { };
+
+        Task &operator=(Task &&t) {
+            if(handle_)
+                handle_.destroy();
+            handle_ = std::exchange(t.handle_, nullptr);
+            return *this;
+        };
+
+        ~Task(void) {
+            if(handle_)
+                handle_.destroy();
+        };
+
+        // Resume the coroutine if what it waits for is ready.  Returns
+        // what the filter input() returns.
+        int resume(void) {
+
+            promise_type &p = handle_.promise();
+
+            if(handle_.done())
+                return p.ret;
+
+            if(p.poll && !p.poll(p.awaiter))
+                return 0;
+
+            p.poll = nullptr;
+            handle_.resume();
+
+            if(handle_.done())
+                return p.ret;
+            return 0;
+        };
+
+#endif // #ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+    private:
+
+        explicit Task(Handle h): handle_(h) { };
+
+        Handle handle_ = nullptr;
+};
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+// The common part of what run() can co_await.  W has check(), which
+// returns true if the wait is over, and arm(), which tells the stream
+// when to resume run().
+template<class W>
+struct Awaiter {
+
+    bool await_ready(void) const {
+        return static_cast<const W *>(this)->check();
+    };
+
+    void await_suspend(Task::Handle h) const {
+        static_cast<const W *>(this)->arm();
+        h.promise().poll = Poll;
+        h.promise().awaiter = this;
+    };
+
+    void await_resume(void) const { };
+
+    // Called from Task::resume() in the next filter input() call.  We
+    // arm again if the wait is not over.
+    static bool Poll(const void *awaiter) {
+        const W *w = static_cast<const W *>(
+                static_cast<const Awaiter *>(awaiter));
+        if(w->check())
+            return true;
+        w->arm();
+        return false;
+    };
+};
+
+#endif // #ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+
+/** An input port of a qs::CoFilter with elements of type T */
+template<typename T>
+class CoIn {
+
+    static_assert(std::is_trivially_copyable_v<T>,
+            "Port element types must be trivially copyable");
+
+    public:
+
+        explicit CoIn(uint32_t port): port_(port) { };
+
+        /** The most elements that run() may wait for with read()
+         *
+         * This is the input read promise, in elements.  Change it in the
+         * filter constructor.
+         */
+        size_t maxRead = (QS_DEFAULTMAXREADPROMISE < sizeof(T))?1:
+            (QS_DEFAULTMAXREADPROMISE/sizeof(T));
+
+        /** The number of whole elements that may be read now */
+        size_t size(void) const { return size_; };
+        const T *data(void) const { return data_; };
+        const T *begin(void) const { return data_; };
+        const T *end(void) const { return data_ + size_; };
+        const T &operator[](size_t i) const { return data_[i]; };
+
+        /** Is this the last of the input to this port? */
+        bool isFlushing(void) const { return isFlushing_; };
+
+        uint32_t port(void) const { return port_; };
+
+        /** Mark n elements as read
+         *
+         * This is like qsAdvanceInput(), and the next n elements are then
+         * at data().
+         */
+        void advance(size_t n) {
+            qsAdvanceInput(port_, n * sizeof(T));
+            data_ += n;
+            size_ -= n;
+        };
+
+        /** What run() can co_await for n elements to read */
+        struct Read: Awaiter<Read> {
+            const CoIn *in;
+            size_t n;
+            bool check(void) const {
+                return in->size_ >= n || in->isFlushing_;
+            };
+            // New input will get input() called, so we have nothing to
+            // do.
+            void arm(void) const { };
+        };
+
+        Read read(size_t n) const {
+            if(n > maxRead)
+                throw std::invalid_argument("read() more than maxRead");
+            Read r;
+            r.in = this;
+            r.n = n;
+            return r;
+        };
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+        void _set(void *buffer, size_t len, bool isFlushing) {
+            data_ = (const T *) buffer;
+            size_ = len/sizeof(T);
+            isFlushing_ = isFlushing;
+        };
+#endif
+
+    private:
+
+        uint32_t port_;
+        const T *data_ = nullptr;
+        size_t size_ = 0;
+        bool isFlushing_ = false;
+};
+
+
+/** An output port of a qs::CoFilter with elements of type T */
+template<typename T>
+class CoOut {
+
+    static_assert(std::is_trivially_copyable_v<T>,
+            "Port element types must be trivially copyable");
+
+    public:
+
+        explicit CoOut(uint32_t port): port_(port) { };
+
+        /** The number of elements that may be written before run() must
+         * wait with space() */
+        size_t available(void) const { return max_ - written_; };
+
+        uint32_t port(void) const { return port_; };
+
+        /** Get a buffer to write n elements to
+         *
+         * n may not be more than available().
+         */
+        T *get(size_t n) const {
+            return ((T *) qsGetOutputBuffer(port_,
+                    max_ * sizeof(T), n * sizeof(T))) + written_;
+        };
+
+        /** Write n elements from the get() buffer, like qsOutput() */
+        void write(size_t n) {
+            qsOutput(port_, n * sizeof(T));
+            written_ += n;
+        };
+
+        /** What run() can co_await for room to write n elements */
+        struct Space: Awaiter<Space> {
+            const CoOut *out;
+            size_t n;
+            bool check(void) const {
+                return out->written_ + n <= out->max_;
+            };
+            // We have written all we can in this input() call, so we
+            // have input() called again when the output is not clogged.
+            void arm(void) const { qsInputAgain(); };
+        };
+
+        Space space(size_t n) const {
+            if(n > max_)
+                throw std::invalid_argument("space() more than maxWrite");
+            Space s;
+            s.out = this;
+            s.n = n;
+            return s;
+        };
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+        void _set(size_t max) { max_ = max; written_ = 0; };
+        void _reset(void) { written_ = 0; };
+#endif
+
+    private:
+
+        uint32_t port_;
+        size_t max_ = 0;
+        size_t written_ = 0;
+};
+
+
+/** What run() can co_await for a file descriptor to be ready */
+struct FdWait: Awaiter<FdWait> {
+    int fd;
+    bool forWriting;
+    bool check(void) const {
+        struct pollfd p = {
+            fd, (short) (forWriting?POLLOUT:POLLIN), 0 };
+        // POLLHUP and POLLERR are ready too, so that the next read(2) or
+        // write(2) call does not block.
+        return poll(&p, 1, 0) != 0;
+    };
+    void arm(void) const { qsWaitFd(fd, forWriting); };
+};
+
+/** Wait for fd to be ready to read from */
+inline FdWait readable(int fd) {
+    FdWait w;
+    w.fd = fd;
+    w.forWriting = false;
+    return w;
+}
+
+/** Wait for fd to be ready to write to */
+inline FdWait writable(int fd) {
+    FdWait w;
+    w.fd = fd;
+    w.forWriting = true;
+    return w;
+}
+
+
+template<class Derived, class InputTypes, class OutputTypes>
+class CoFilter;
+
+
+/** The base class of C++ filter modules that are coroutines
+ *
+ * Derived is the class that inherits this, and it must have the method
+ * qs::Task run(void).  See \ref coFilters.
+ */
+template<class Derived, typename... I, typename... O>
+class CoFilter<Derived, Inputs<I...>, Outputs<O...>> {
+
+    public:
+
+        static constexpr uint32_t numInputs = sizeof...(I);
+        static constexpr uint32_t numOutputs = sizeof...(O);
+
+        /** The most elements written to each output port each time run()
+         * is resumed
+         *
+         * Change it in the constructor or start().
+         */
+        size_t maxWrite = QS_DEFAULTMAXWRITE;
+
+        CoFilter(void): CoFilter(std::index_sequence_for<I...>(),
+                std::index_sequence_for<O...>()) { };
+
+        /** Get input port i */
+        template<size_t i>
+        auto &in(void) {
+            static_assert(i < numInputs, "Bad input port number");
+            return std::get<i>(inputs_);
+        };
+
+        /** Get output port i */
+        template<size_t i>
+        auto &out(void) {
+            static_assert(i < numOutputs, "Bad output port number");
+            return std::get<i>(outputs_);
+        };
+
+        int start(void) { return 0; };
+
+        int stop(void) { return 0; };
+
+        static void help(FILE *file) {
+            fprintf(file, "  This filter has no help.\n");
+        };
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+        // These are called from the C functions that
+        // QS_TYPED_FILTER_MODULE() makes.
+
+        static void *_construct(int argc, const char **argv) {
+
+            try {
+                return new Derived(argc, argv);
+            } catch(const std::exception &e) {
+                fprintf(stderr, "filter \"%s\" failed to construct: %s\n",
+                        qsGetFilterName(), e.what());
+            } catch(...) {
+                fprintf(stderr, "filter \"%s\" failed to construct\n",
+                        qsGetFilterName());
+            }
+            return 0; // fail
+        };
+
+        static int _destroy(void *instance) {
+
+            delete static_cast<Derived *>(instance);
+            return 0;
+        };
+
+        static int _start(void *instance,
+                uint32_t numInPorts, uint32_t numOutPorts) {
+
+            Derived *d = static_cast<Derived *>(instance);
+
+            if(numInPorts != numInputs || numOutPorts != numOutputs) {
+                fprintf(stderr, "filter \"%s\" needs %" PRIu32
+                        " inputs and %" PRIu32 " outputs, not %" PRIu32
+                        " and %" PRIu32 "\n", qsGetFilterName(),
+                        numInputs, numOutputs, numInPorts, numOutPorts);
+                return -1; // fail
+            }
+
+            int ret = d->start();
+            if(ret) return ret;
+
+            d->Start(std::index_sequence_for<I...>(),
+                    std::index_sequence_for<O...>());
+
+            // A new coroutine for each stream run.
+            d->task_ = d->run();
+
+            return 0; // success
+        };
+
+        static int _stop(void *instance, uint32_t, uint32_t) {
+
+            Derived *d = static_cast<Derived *>(instance);
+            d->task_ = Task();
+            return d->stop();
+        };
+
+        static int _input(void *instance, void *buffers[],
+                const size_t lens[], const bool isFlushing[],
+                uint32_t, uint32_t) {
+
+            Derived *d = static_cast<Derived *>(instance);
+            d->Input(buffers, lens, isFlushing,
+                    std::index_sequence_for<I...>(),
+                    std::index_sequence_for<O...>());
+            return d->task_.resume();
+        };
+
+#endif // #ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+
+    private:
+
+        template<size_t... i, size_t... o>
+        CoFilter(std::index_sequence<i...>, std::index_sequence<o...>):
+            inputs_(CoIn<I>(i)...), outputs_(CoOut<O>(o)...) { };
+
+        template<size_t... i, size_t... o>
+        void Start(std::index_sequence<i...>, std::index_sequence<o...>) {
+            (qsSetInputReadPromise(i,
+                    std::get<i>(inputs_).maxRead * sizeof(I)), ...);
+            (qsCreateOutputBuffer(o, maxWrite * sizeof(O)), ...);
+            (std::get<o>(outputs_)._set(maxWrite), ...);
+        };
+
+        template<size_t... i, size_t... o>
+        inline void Input(void *buffers[], const size_t lens[],
+                const bool isFlushing[],
+                std::index_sequence<i...>, std::index_sequence<o...>) {
+            (std::get<i>(inputs_)._set(buffers[i], lens[i],
+                    isFlushing[i]), ...);
+            (std::get<o>(outputs_)._reset(), ...);
+        };
+
+        std::tuple<CoIn<I>...> inputs_;
+        std::tuple<CoOut<O>...> outputs_;
+
+        Task task_;
+};
+
+
+} // namespace qs
+
+
+#endif // #ifndef __qscofilter_hpp__
@@ -167,6 +167,97 @@ int qsAddPostFilterInput(struct QsFilter *filter,
             void *userData), void *userData);
 
 
+/** Register a pre-filter-input callback function
+ *
+ * This is like qsAddPostFilterInput(), but \p callback is called just
+ * before each filter input() call, with \p lenIn set to the lengths in
+ * bytes of the input that is passed to the filter input() call.
+ *
+ * Each controller may have only one pre-input filter callback per filter.
+ * If \p callback returns non-zero the callback will be removed.  If
+ * qsAddPreFilterInput() is called with \p callback zero the callback will
+ * be removed.
+ *
+ * The callbacks that are registered when qsStreamReady() returns are the
+ * ones that are called while the stream flows.  The same is true for
+ * qsAddPostFilterInput().  They are called by the thread that calls the
+ * filter input(), without any stream mutex lock, except for post input
+ * callbacks of a controller that called qsControllerRunInThread().
+ *
+ * \param filter is the filter those input() function that is of concern.
+ *
+ * \param callback is the function that is called before each filter
+ * input() call.
+ *
+ * \param userData is passed to the \p callback function each time it is
+ * called.
+ *
+ * \return 0 on success, and non-zero on failure.
+ */
+extern
+int qsAddPreFilterInput(struct QsFilter *filter,
+        int (*callback)(
+            struct QsFilter *filter,
+            const size_t lenIn[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData), void *userData);
+
+
+/** bit flag for qsControllerRunInThread() to use the app's shared
+ * controller threads. */
+#define QS_CONTROLLER_SHARED  (01)
+
+
+/** Run this controller in its own thread, or in the controller threads
+ * that the controllers in the app share
+ *
+ * By default the controller functions are called by whatever thread
+ * triggers them: preStart(), postStart(), preStop(), and postStop() by
+ * the main thread, and input callbacks and parameter get callbacks by
+ * the thread that calls the filter input().  After this is called:
+ *
+ *  - preStart(), postStart(), preStop(), and postStop() are called by the
+ *  controller thread, while the main thread waits for them.
+ *
+ *  - qsAddPostFilterInput() callbacks are queued as events with copies of
+ *  the lengths, and the controller thread calls them later.  A slow
+ *  callback no longer holds up the filter input() calls.  Up to 256 calls
+ *  of each callback wait.  Calls that do not fit are added together into
+ *  one call, with the sums of the lengths, so the lengths that the
+ *  callback gets still add up.  If the callback returns non-zero, the
+ *  filter stops queuing it.
+ *
+ *  - qsParameterGet() callbacks that the controller adds are queued as
+ *  events too, with a copy of the value, if the parameter type is
+ *  QsDouble or QsUint64 or the parameter has a mailbox.  With the
+ *  QS_LATEST_ONLY flag only the latest value is delivered; otherwise up
+ *  to 64 values wait and values that do not fit are dropped.  So are
+ *  qsParameterGetAsync() callbacks that the controller adds, at the
+ *  \p maxRate that they were added with.
+ *
+ * qsAddPreFilterInput() callbacks, construct(), and destroy() are still
+ * called by the thread that triggers them.
+ *
+ * The controller events are called one at a time in the order they were
+ * queued, even in the shared controller threads, so the controller code
+ * does not need to be thread-safe.  All events are called before
+ * qsStreamStop() calls preStop().
+ *
+ * This must be called in the controller construct().  A controller that
+ * runs in a thread cannot unload itself with qsControllerUnload(0).
+ *
+ * \param flags 0 for a thread that is just for this controller, or
+ * QS_CONTROLLER_SHARED to use the app's shared controller threads.  See
+ * qsAppSetControllerPoolThreads().
+ *
+ * \return 0 on success, 1 if the controller runs in a thread already, or
+ * less than 0 on error.
+ */
+extern
+int qsControllerRunInThread(uint32_t flags);
+
+
 
 #ifdef __cplusplus
 }
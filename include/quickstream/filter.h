@@ -106,6 +106,9 @@
 void help(FILE *file);
 
 
+#ifndef QS_FILTER_INSTANCE_API
+
+
 /** required filter input work function
  *
  * input() is how the filters receive input from upstream filters.
@@ -232,6 +235,95 @@ int start(uint32_t numInPorts, uint32_t numOutPorts);
 int stop(uint32_t numInPorts, uint32_t numOutPorts);
 
 
+#else // #ifndef QS_FILTER_INSTANCE_API
+
+/** \page instances filter module instance API
+ *
+ * A filter module that keeps its state in file scope variables can only
+ * be loaded once per DSO (dynamic shared object) file, so when it is
+ * loaded again libquickstream copies the DSO file to a temporary file and
+ * loads that.  A filter module that defines QS_FILTER_INSTANCE_API before
+ * including filter.h, and has QS_FILTER_INSTANCE_MODULE in its source,
+ * keeps its state in an instance object instead.  Its construct()
+ * returns a pointer to the instance which is passed to its start(),
+ * input(), stop(), and destroy().  All the filters loaded from
+ * the same DSO file then share one dlopen() handle.
+ *
+ * The filter API functions, like qsGetOutputBuffer(), work the same in
+ * both APIs.
+ */
+
+// The libquickstream filter loader looks for this symbol to know that
+// this module uses the instance API.  It's defined by
+// QS_FILTER_INSTANCE_MODULE.
+extern const uint32_t qsFilterInstanceAPI;
+
+
+/** C preprocessor macro that makes a filter module use the instance API
+ *
+ * A filter module that defines QS_FILTER_INSTANCE_API must have this once
+ * in its source, after including filter.h.  Without it libquickstream
+ * loads the module as one that does not use the instance API.  We do not
+ * want a semicolon after this macro.
+ */
+#define QS_FILTER_INSTANCE_MODULE \
+    const uint32_t qsFilterInstanceAPI = 1;
+
+
+/** required filter input work function with the instance API
+ *
+ * Like input() without QS_FILTER_INSTANCE_API.
+ *
+ * \param instance is what construct() returned.
+ */
+int input(void *instance, void *inBuffers[], const size_t inLens[],
+        const bool isFlushing[],
+        uint32_t numInPorts, uint32_t numOutPorts);
+
+
+/** optional constructor function with the instance API
+ *
+ * This function, if present, is called only once just after the filter
+ * is loaded.  If it is not present instance will be 0.
+ *
+ * \param argc the number of strings pointed to by argv
+ *
+ * \param argv an array of pointers to the string arguments.
+ *
+ * \return a pointer to the instance object on success, or 0 on
+ * failure.
+ */
+void *construct(int argc, const char **argv);
+
+
+/** optional destructor function with the instance API
+ *
+ * This function, if present, is called only once just before the filter
+ * is unloaded.  It should free the instance.  instance will be 0 if
+ * construct() failed.
+ *
+ * \return 0 on success, and non-zero on failure.
+ */
+int destroy(void *instance);
+
+
+/** optional filter start function with the instance API
+ *
+ * Like start() without QS_FILTER_INSTANCE_API.
+ */
+int start(void *instance, uint32_t numInPorts, uint32_t numOutPorts);
+
+
+/** optional filter stop function with the instance API
+ *
+ * Like stop() without QS_FILTER_INSTANCE_API.
+ */
+int stop(void *instance, uint32_t numInPorts, uint32_t numOutPorts);
+
+
+#endif // #ifndef QS_FILTER_INSTANCE_API #else
+
+
 #endif // ifndef __cplusplus
 
 
@@ -329,6 +421,50 @@ extern
 void qsAdvanceInput(uint32_t inputPortNum, size_t len);
 
 
+/** stop calling input() until a file descriptor is ready
+ *
+ * qsWaitFd() can only be called in a filter input() function.  After
+ * that input() call returns the filter's input() will not be called again
+ * until fd is ready to read from, or ready to write to if forWriting is
+ * true.  When fd is ready input() is called again, even if there is no
+ * new input, so long as the filter's outputs are not clogged.  The worker
+ * thread that called input() is free to run other filters while the
+ * filter waits, so a filter can call this in place of making a read(2)
+ * or write(2) call that would block.
+ *
+ * If the stream stops its sources while the filter waits, the filter
+ * stops waiting, and input() is called again only if there is input for
+ * it.
+ *
+ * The filter does not have to keep its input read promise in the input()
+ * call that calls qsWaitFd().  If fd cannot be waited on, like if it's a
+ * regular file, the filter's input() is called again like it did not
+ * call qsWaitFd().
+ *
+ * \param fd the file descriptor to wait on.
+ *
+ * \param forWriting false to wait for fd to be readable, or true to wait
+ * for fd to be writable.
+ */
+extern
+void qsWaitFd(int fd, bool forWriting);
+
+
+/** have input() called again
+ *
+ * qsInputAgain() can only be called in a filter input() function.  It
+ * makes the stream call the filter's input() again, when the filter's
+ * outputs are not clogged, even if there is no more input.  This is for
+ * filters that have more to write than they can write in one input()
+ * call.
+ *
+ * The filter does not have to keep its input read promise in the input()
+ * call that calls qsInputAgain().
+ */
+extern
+void qsInputAgain(void);
+
+
 /** set the current filters input threshold
  *
  * Set the minimum input needed in order for current filters input()
@@ -2,6 +2,8 @@
 #define __qsparameter_h__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 //////////////////////////// Control/Parameter Stuff /////////////////////
 
@@ -93,7 +95,8 @@
  * Past parameter values are not queued, or stored by quickstream.  They
  * are not time stamped.  They do not have a sample rate.  It's up to the
  * filter or controller module writer to add that kind of thing, if it is
- * needed.
+ * needed.  The exception is qsParameterSetAt() which holds a value until
+ * the filter's input gets to a given byte offset.
  *
  * Parameters cannot be added or removed while the stream is flowing.
  *
@@ -176,7 +179,9 @@ struct QsParameter;
  * called in a different thread than the filter's input() function thread.
  * So steps must be taken by the user to keep data consistent between
  * these different threads.  In the simplest case just atomically copying
- * the data to another variable in the setCallback.
+ * the data to another variable in the setCallback.  Or \p setCallback may
+ * be 0 and the filter can read the values that are set from a mailbox,
+ * see qsParameterAddMailbox().
  *
  * Calling setCallback() should not block.  If there is a blocking call
  * required it should queue up the request, and act later. This
@@ -321,6 +326,9 @@ qsParameterCreateForFilter(struct QsFilter *filter,
 #define QS_KEEP_ONE        (04)
 /** free get callback user data */
 #define QS_FREE_USERDATA   (010)
+/** bit flag to mark that an async get callback, from
+ * qsParameterGetAsync(), only needs the latest value. */
+#define QS_LATEST_ONLY     (020)
 
 /** Register a callback to get a parameter value from outside the filter
  * module
@@ -400,6 +408,54 @@ int qsParameterGet(void *streamOrApp, const char *ownerName,
         uint32_t flags);
 
 
+/** Register a callback to get a parameter value in a different thread
+ * than the one that pushes the value
+ *
+ * This is like qsParameterGet() except that \p getCallback() is not
+ * called by the thread that pushes the value, which is often a filter
+ * input() thread.  The pushing thread copies the value, without a lock,
+ * and a parameter delivery thread calls \p getCallback() later.  A slow
+ * \p getCallback(), like one that calls into python, will not hold up the
+ * stream flow.
+ *
+ * The parameter type must be QsDouble or QsUint64, or the parameter must
+ * have a mailbox from qsParameterAddMailbox(), so that the size of the
+ * value is known.
+ *
+ * There is one delivery thread for all async get callbacks, so \p
+ * getCallback() should still not block for long.  \p getCallback() must
+ * not call qsParameterGetAsync() or remove parameters.  Its return value
+ * is ignored.  If a controller that called qsControllerRunInThread()
+ * adds the callback, the controller thread calls it, in place of the
+ * delivery thread.
+ *
+ * \param flags has the same flags as qsParameterGet(), and also:
+ *
+ *  - QS_LATEST_ONLY: If values are pushed faster than they are delivered
+ *  only the latest value is delivered.  Otherwise up to 64 values wait
+ *  in a queue, and values that are pushed while the queue is full are
+ *  dropped.
+ *
+ * \param maxRate is the most times per second that \p getCallback() will
+ * be called, or 0 for no limit.  With QS_LATEST_ONLY and a \p maxRate a
+ * parameter can be pushed at any rate and the subscriber gets the latest
+ * value at \p maxRate.
+ *
+ * \return the number of parameters found and callback is added, or less
+ * than zero on error.
+ */
+extern
+int qsParameterGetAsync(void *streamOrApp, const char *ownerName,
+        const char *pName, enum QsParameterType type,
+        int (*getCallback)(
+            const void *value, void *streamOrApp,
+            const char *ownerName, const char *pName, 
+            enum QsParameterType type, void *userData),
+        void (*cleanup)(void *userData),
+        void *userData,
+        uint32_t flags, double maxRate);
+
+
 /** Set a parameter by calling the filter's callback, called from outside
  * the owning filter or controller module
  *
@@ -437,6 +493,61 @@ int qsParameterSet(void *streamOrApp, const char *ownerName,
         enum QsParameterType type, void *value);
 
 
+/** Set a filter parameter when the filter input gets to a given byte
+ * offset
+ *
+ * This is like qsParameterSet(), but the setting is delivered just
+ * before the filter input() call that starts at input byte \p
+ * inputOffset on input port \p inputPort.  The stream cuts the input()
+ * call before that short so that it ends at \p inputOffset, so the
+ * change lands at that exact place in the input, and not some place in
+ * the middle of the buffer passed to input().  That lets a filter change
+ * things like gain or frequency without a glitch and without stopping
+ * the stream.
+ *
+ * The setting is delivered by the thread that calls the filter input(),
+ * so the filter's setCallback() or qsParameterMailboxRead() in input()
+ * sees the value before it sees the input at the offset.
+ *
+ * Offsets count the bytes that the filter advanced the input port with
+ * qsAdvanceInput() from the start of the current (or next) stream flow
+ * cycle.  To set at a sample count multiply the count by the size of a
+ * sample in bytes.  If the input is already past \p inputOffset the
+ * setting is delivered before the next input() call.  If the filter does
+ * not advance the shortened input at all, for example if it needs a
+ * whole sample and the offset is not on a sample boundary, the setting
+ * is delivered before the next input() call and the input is not cut
+ * short again for it.  A source filter, with no inputs, has no input
+ * offsets, so use qsParameterSet() for it.  Settings that are not
+ * reached when the stream is stopped are dropped.
+ *
+ * The value is copied, so the parameter type must be QsDouble or QsUint64
+ * or the parameter must have a mailbox from qsParameterAddMailbox() to
+ * tell the size of the value.
+ *
+ * \param stream is the stream that has the filter.
+ *
+ * \param filterName is the filter name.
+ *
+ * \param pName is the parameter name.
+ *
+ * \param type is the parameter type.
+ *
+ * \param value points to the value, which is copied.
+ *
+ * \param inputPort is the filter input port that \p inputOffset is in.
+ * It is an error if the filter does not have this input port.
+ *
+ * \param inputOffset is the byte offset in the input port.
+ *
+ * \return 0 on success and non-zero otherwise.
+ */
+extern
+int qsParameterSetAt(struct QsStream *stream, const char *filterName,
+        const char *pName, enum QsParameterType type, void *value,
+        uint32_t inputPort, uint64_t inputOffset);
+
+
 /** Push the value to the qsParameterGet() callbacks in other modules
  *
  * qsParameterPush() is used when the filter modules that owns the
@@ -477,6 +588,62 @@ int qsParameterPushByPointer(const struct QsParameter *parameter,
         void *value);
 
 
+/** Add a mailbox to a parameter so that the owning filter can read the
+ * latest value set, without a mutex
+ *
+ * With a mailbox, qsParameterSet() copies the value into the mailbox
+ * before it calls the parameter setCallback().  If the parameter has no
+ * setCallback(), qsParameterSet() also pushes the value to the
+ * qsParameterGet() callbacks, as if the owner called qsParameterPush().
+ * The owning filter then gets the value in its input() with
+ * qsParameterMailboxRead().  That way the setCallback() and input() do
+ * not need to share a mutex, and setting a parameter never holds up the
+ * stream flow.
+ *
+ * This should be called before the stream is flowing, like in the filter
+ * construct() just after qsParameterCreate().
+ *
+ * \param parameter is the parameter from qsParameterCreate().
+ *
+ * \param size is the size in bytes of the value.  If \p size is 0 it is
+ * the size of the parameter type, which must be QsDouble or QsUint64.
+ *
+ * \param initValue if not 0, points to the value to start the mailbox
+ * with.
+ *
+ * \return 0 on success and non-zero otherwise.
+ */
+extern
+int qsParameterAddMailbox(struct QsParameter *parameter, size_t size,
+        const void *initValue);
+
+
+/** Read the latest value in a parameter mailbox
+ *
+ * \see qsParameterAddMailbox().
+ *
+ * This does not block and does not take a lock.  If there is no new
+ * value since the last read, this is one atomic load.  It may be called
+ * from any thread, so a filter with more than one thread calling input()
+ * can keep a \p seen value for each thread.
+ *
+ * \param parameter is the parameter with the mailbox.
+ *
+ * \param value points to memory that the value is copied to.  It must
+ * be at least the size of the mailbox.
+ *
+ * \param seen if not 0, points to a counter that the caller keeps, that
+ * starts at 0.  The value is copied only if it has changed since the
+ * read that set \p seen.  If \p seen is 0, the value is always copied.
+ *
+ * \return true if the value was copied to \p value, and false if there
+ * is no new value.
+ */
+extern
+bool qsParameterMailboxRead(struct QsParameter *parameter, void *value,
+        uint32_t *seen);
+
+
 /** Iterate through the parameters via a callback function
  *
  * This function has a butt load of argument parameters but lots of them
@@ -0,0 +1,336 @@
+#ifndef __qstypedfilter_hpp__
+#define __qstypedfilter_hpp__
+
+#ifndef __cplusplus
+#  error "This is C++ not C"
+#endif
+
+#if __cplusplus < 201703L
+#  error "This needs C++17 or later"
+#endif
+
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include "filter.h"
+
+/** \file
+ */
+
+/** \page typedFilters C++ filter modules with typed ports
+ *
+ * \headerfile typedFilter.hpp "quickstream/typedFilter.hpp"
+ *
+ * This is a header only C++17 filter module API that is an alternative
+ * to filter.hpp.  The filter class lists the element types of its input
+ * and output ports as template arguments, and its input() method gets a
+ * qs::In for each input port and a qs::Out for each output port, with
+ * lengths that are counts of elements, not bytes.  For example:
+ *
+ * \code
+ * class Gain : public qs::Filter<Gain,
+ *         qs::Inputs<std::complex<float>>,
+ *         qs::Outputs<std::complex<float>>> {
+ *
+ *     public:
+ *
+ *     Gain(int argc, const char **argv) { ... }
+ *
+ *     int input(qs::In<std::complex<float>> in,
+ *             qs::Out<std::complex<float>> out) { ... }
+ * };
+ *
+ * QS_TYPED_FILTER_MODULE(Gain)
+ * \endcode
+ *
+ * The module uses the filter instance API (see \ref instances), so each
+ * loaded filter is a separate object of the class, and all the filters
+ * loaded from the module share one loaded DSO.  The input() method is
+ * called directly on the class, with no virtual function call, so it can
+ * be inlined into the code that libquickstream calls.
+ *
+ * The number of ports is fixed at compile time.  start() fails if the
+ * stream connects a different number of ports to the filter.
+ *
+ * The class may define these, and they must be public:
+ *
+ *   - A constructor with the arguments (int argc, const char **argv).
+ *     It may throw an exception to fail.
+ *   - int input(qs::In<I>..., qs::Out<O>...), which is required.
+ *   - int start(void) and int stop(void).
+ *   - static void help(FILE *file).
+ *
+ * Elements are passed whole, so the filters that write to a typed input
+ * port should write whole elements.  Bytes at the end of a flushing input
+ * that are not a whole element are dropped.
+ */
+
+
+namespace qs {
+
+
+/** An input port with elements of type T
+ *
+ * This is what a qs::Filter input() method gets for each input port.
+ */
+template<typename T>
+class In {
+
+    static_assert(std::is_trivially_copyable_v<T>,
+            "Port element types must be trivially copyable");
+
+    public:
+
+        In(uint32_t port, void *buffer, size_t len, bool isFlushing):
+            port_(port), data_((const T *) buffer),
+            size_(len/sizeof(T)), isFlushing_(isFlushing) { };
+
+        /** The number of whole elements that may be read */
+        size_t size(void) const { return size_; };
+        const T *data(void) const { return data_; };
+        const T *begin(void) const { return data_; };
+        const T *end(void) const { return data_ + size_; };
+        const T &operator[](size_t i) const { return data_[i]; };
+
+        /** Is this the last of the input to this port? */
+        bool isFlushing(void) const { return isFlushing_; };
+
+        uint32_t port(void) const { return port_; };
+
+        /** Mark n elements as read, like qsAdvanceInput() */
+        void advance(size_t n) const {
+            qsAdvanceInput(port_, n * sizeof(T));
+        };
+
+    private:
+
+        uint32_t port_;
+        const T *data_;
+        size_t size_;
+        bool isFlushing_;
+};
+
+
+/** An output port with elements of type T
+ *
+ * This is what a qs::Filter input() method gets for each output port.
+ */
+template<typename T>
+class Out {
+
+    static_assert(std::is_trivially_copyable_v<T>,
+            "Port element types must be trivially copyable");
+
+    public:
+
+        Out(uint32_t port, size_t maxWrite):
+            port_(port), maxWrite_(maxWrite) { };
+
+        /** The most elements that may be written in one input() call */
+        size_t max(void) const { return maxWrite_; };
+
+        uint32_t port(void) const { return port_; };
+
+        /** Get a buffer to write n elements to, like qsGetOutputBuffer()
+         *
+         * n may not be more than max().
+         */
+        T *get(size_t n) const {
+            return (T *) qsGetOutputBuffer(port_,
+                    n * sizeof(T), n * sizeof(T));
+        };
+
+        /** Write n elements from the get() buffer, like qsOutput() */
+        void write(size_t n) const {
+            qsOutput(port_, n * sizeof(T));
+        };
+
+    private:
+
+        uint32_t port_;
+        size_t maxWrite_;
+};
+
+
+/** The element types of the input ports of a qs::Filter */
+template<typename... T>
+struct Inputs { };
+
+/** The element types of the output ports of a qs::Filter */
+template<typename... T>
+struct Outputs { };
+
+
+template<class Derived, class InputTypes, class OutputTypes>
+class Filter;
+
+
+/** The base class of C++ filter modules with typed ports
+ *
+ * Derived is the class that inherits this, like in the CRTP (curiously
+ * recurring template pattern).  See \ref typedFilters.
+ */
+template<class Derived, typename... I, typename... O>
+class Filter<Derived, Inputs<I...>, Outputs<O...>> {
+
+    public:
+
+        static constexpr uint32_t numInputs = sizeof...(I);
+        static constexpr uint32_t numOutputs = sizeof...(O);
+
+        /** The most elements written to each output port in one input()
+         * call
+         *
+         * Change it in the constructor or start().
+         */
+        size_t maxWrite = QS_DEFAULTMAXWRITE;
+
+        int start(void) { return 0; };
+
+        int stop(void) { return 0; };
+
+        static void help(FILE *file) {
+            fprintf(file, "  This filter has no help.\n");
+        };
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+        // These are called from the C functions that
+        // QS_TYPED_FILTER_MODULE() makes.
+
+        static void *_construct(int argc, const char **argv) {
+
+            try {
+                return new Derived(argc, argv);
+            } catch(const std::exception &e) {
+                fprintf(stderr, "filter \"%s\" failed to construct: %s\n",
+                        qsGetFilterName(), e.what());
+            } catch(...) {
+                fprintf(stderr, "filter \"%s\" failed to construct\n",
+                        qsGetFilterName());
+            }
+            return 0; // fail
+        };
+
+        static int _destroy(void *instance) {
+
+            delete static_cast<Derived *>(instance);
+            return 0;
+        };
+
+        static int _start(void *instance,
+                uint32_t numInPorts, uint32_t numOutPorts) {
+
+            Derived *d = static_cast<Derived *>(instance);
+
+            if(numInPorts != numInputs || numOutPorts != numOutputs) {
+                fprintf(stderr, "filter \"%s\" needs %" PRIu32
+                        " inputs and %" PRIu32 " outputs, not %" PRIu32
+                        " and %" PRIu32 "\n", qsGetFilterName(),
+                        numInputs, numOutputs, numInPorts, numOutPorts);
+                return -1; // fail
+            }
+
+            int ret = d->start();
+            if(ret) return ret;
+
+            // We read whole elements, so we can read as little as one.
+            uint32_t port = 0;
+            (qsSetInputReadPromise(port++, sizeof(I)), ...);
+
+            port = 0;
+            (qsCreateOutputBuffer(port++, d->maxWrite * sizeof(O)), ...);
+
+            return 0; // success
+        };
+
+        static int _stop(void *instance, uint32_t, uint32_t) {
+
+            return static_cast<Derived *>(instance)->stop();
+        };
+
+        static int _input(void *instance, void *buffers[],
+                const size_t lens[], const bool isFlushing[],
+                uint32_t, uint32_t) {
+
+            return Input(static_cast<Derived *>(instance),
+                    buffers, lens, isFlushing,
+                    std::index_sequence_for<I...>(),
+                    std::index_sequence_for<O...>());
+        };
+
+#endif // #ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+
+    private:
+
+        // Drop the end of a flushing input that is less than a whole
+        // element, which the filter cannot read.
+        template<typename T>
+        static size_t WholeLen(uint32_t port, size_t len, bool isFlushing) {
+            if(isFlushing && len && len < sizeof(T)) {
+                qsAdvanceInput(port, len);
+                return 0;
+            }
+            return len;
+        };
+
+        template<size_t... i, size_t... o>
+        static inline int Input(Derived *d, void *buffers[],
+                const size_t lens[], const bool isFlushing[],
+                std::index_sequence<i...>, std::index_sequence<o...>) {
+
+            return d->input(
+                    In<I>(i, buffers[i],
+                        WholeLen<I>(i, lens[i], isFlushing[i]),
+                        isFlushing[i])...,
+                    Out<O>(o, d->maxWrite)...);
+        };
+};
+
+
+} // namespace qs
+
+
+
+/** C++ CPP (C preprocessor) macro that makes a qs::Filter class a
+ * filter module
+ *
+ * This makes the C filter instance API functions that libquickstream
+ * calls.  We do not want a semicolon after this macro.
+ */
+#define QS_TYPED_FILTER_MODULE(ClassName) \
+    extern "C" {\
+    extern const uint32_t qsFilterInstanceAPI = 1;\
+    void *construct(int argc, const char **argv) {\
+        return ClassName::_construct(argc, argv);\
+    }\
+    int destroy(void *instance) {\
+        return ClassName::_destroy(instance);\
+    }\
+    int start(void *instance, uint32_t numInPorts, uint32_t numOutPorts) {\
+        return ClassName::_start(instance, numInPorts, numOutPorts);\
+    }\
+    int stop(void *instance, uint32_t numInPorts, uint32_t numOutPorts) {\
+        return ClassName::_stop(instance, numInPorts, numOutPorts);\
+    }\
+    int input(void *instance, void *buffers[], const size_t lens[],\
+            const bool isFlushing[],\
+            uint32_t numInPorts, uint32_t numOutPorts) {\
+        return ClassName::_input(instance, buffers, lens, isFlushing,\
+                numInPorts, numOutPorts);\
+    }\
+    void help(FILE *file) {\
+        ClassName::help(file);\
+    }\
+    }
+
+
+#endif // #ifndef __qstypedfilter_hpp__
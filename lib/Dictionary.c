@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <inttypes.h>
 
 #include "Dictionary.h"
@@ -19,235 +20,489 @@
 #define END            (126) // ~
 
 
-// A Dictionary via a Trie
+// A Dictionary via a radix tree (a path compressed trie)
 //
-// Faster than a hash table, and just a little more memory usage.
-// This code ROCKS!
+// It's not faster than a hash table.  dev_tests/Dictionary_bench.c
+// measures it against the other backends; see
+// qsDictionaryCreateBackend().  The trie is the default backend because
+// of the sub-dictionaries that qsDictionaryFindDict() gets, and after
+// qsDictionaryFreeze() it finds as fast as the hash backend.
 //
 // References:
-// We use something with less memory than in this:
-// https://www.geeksforgeeks.org/trie-insert-and-search/
 //
-// https://en.wikipedia.org/wiki/Trie
+// https://en.wikipedia.org/wiki/Radix_tree
 //
-// We optimise far more than those references, but they are a nice place
-// to start to try to understand this code.
+// The adaptive radix tree (ART) and the hash array mapped trie (HAMT),
+// from which we get the bitmap with the popcount indexed children.
 //
+// Trie containing keys "filter0:freq", "filter0:gain" and "filter1:freq"
+//
+//     ROOT
+//       |
+//       f + "ilter"
+//       |_______________
+//       |               |
+//       0 + ":"         1 + ":freq"
+//       |_______
+//       |       |
+//       f+"req" g+"ain"
+//
+// Each node has the character that its' parent branches to it with, and
+// then a prefix of characters that all the keys below it have, which is
+// stored in the node, after the fixed size part of the node.  So a
+// Find() compares the prefix characters with one strncmp(), and there is
+// one node per branch point and one per key, and not one node per
+// character.
+//
+// The characters that a node branches with are bits in a 128 bit bitmap
+// (the key characters are all less than 128), and the children are in an
+// array in the order of the characters, so the index of the child for
+// character c is the number of bits set in the bitmap below bit c.  That
+// is one popcount instruction, and the children array is as long as the
+// number of children, so there is no 256 pointer array in nodes with few
+// children.
+//
+// All the memory of a dictionary is from one arena, so destroying a
+// dictionary does not have to free every node, and nodes that are made
+// one after the other are close together in memory.
 //
 struct QsDictionary {
 
     // A Dictionary node.
 
-    // For our use case:
-    //   - We do not need fast insert.
-    //   - We do not need remove at all.
-    //   - Just need fast lookup.
-    //   - This will hold about 1000 elements in extreme cases.
+    // Bit c is set if there is a child that branches with character c.
+    uint64_t bits[2];
 
-    // If there are children than it's an array of length 4.
-    //
-    // There is no benefit to using a constant variable or CPP MACRO that
-    // is 4 because we need to do bit diddling too, that is 3, 2, and 1
-    // are constants that are needed too.  The 4 is like a natural
-    // constant like Pi in our use case.  Hiding the 4 would just obscure
-    // the code.
-    //
-    // We use a reduced alphabet of size 4 to index this children array,
-    // otherwise it's 0.  We add a little complexity by having Null
-    // children to start with.  We reduce the alphabet to needing 2 bits
-    // (2^2=4) as we traverse through the branch points in the tree.  So
-    // for the cost of a little bit diddling we use lots less memory than
-    // a regular Trie Tree data structure.
-    //
-    // Traversing the tree graph example:
-    //
-    // Trie containing keys "hello" and "heat"
-    //
-    //     ROOT
-    //       |
-    //       he____
-    //        |    |
-    //        llo  at
-    //
-    //
-    // "e" is a branch point that is common to the two keys
-    // In ASCII
-    //   'e' = oct 0145 = hex 0x65 = dec 101 = binary 01100101 = 01 10 01 01
-    //   'l' = oct 0154 = hex 0x6C = dec 108 = binary 01101100 = 01 10 11 00
-    //   'a' = oct 0141 = hex 0x61 = dec  97 = binary 01100001 = 01 10 00 01
-    //
-    // "hello" deviates from "heat" at the 'l' and the 'a':
-    // and so the deviation is at the first and second bits being
-    //  00 ('l') and 01 ('a') when we fix the 2 bit left to right ordering,
-    // so the hello traversal reads like 'h' 'e' 00 11 10 01 'l' 'o'
-    // or                                'h' 'e' 0  3  2  1  'l' 'o'
-    // adding 1 to the 2 bit values =>   'h' 'e' 1  4  3  2  'l' 'o'
-    // and since ASCII decimal 1 2 3 and 4 are invalid characters in our
-    // use we can use them is encode the missing 'l' as the 8 bit byte
-    // sequence 1 4 3 2.  We can't use 0 because that would terminate our
-    // string, so we are using 'l' = (c0-1) << 0 + (c1-1) << 2 + (c2-1) << 4
-    // + (c3-1) << 6 where c0 = ASCII byte 1, c1 = ASCII byte 4,
-    // c2 = ASCII byte 3, and c3 = ASCII byte 2.
-    //
-    // Doing the same analysis for "heat" gives
-    //
-    // "heat" traversal is   'h' 'e' 1 0 2 1 't'
-    // adding the 1       => 'h' 'e' 2 1 3 2 't'
-    //
-    // At the cost of converting characters after branch points we can use
-    // a lot less memory.  Each branch point can only have a 1 2 3 or 4
-    // as a starting character.
-    //
-    // The example tree looks like:
-    //
-    //     ROOT
-    //       |
-    //       he_______________
-    //        |               |
-    //       \1\4\3\2lo      \2\1\3\2t
-    //
-    //
-    // where we define \1 as the bit sequence 01 that we convert to 00,
-    // and so on.
-    //
-    //
-    // Adding key = "heep" gives ==> he\2\2\3\2p
-    //
-    //
-    //     ROOT
-    //       |
-    //       he_________________
-    //        |                 |
-    //        |                 |
-    //       \1\4\3\2lo         \2___________________
-    //                           |                    |
-    //                           |                    |
-    //                          \1\3\2t              \2\3\2p
-    //
-    //
-    // where \1 \2 \3 \4 are just one byte characters that are 1 2 3 4.
-    // We will store them as bytes even though they only contain 2 bits
-    // of information, saving computation time at the cost of using a
-    // little more memory at branch points.
-    //
-    // But wait there's more.  The top branch point is from the "he" where
-    // e is shared below.  But we can't use 'e' are a branch point, this
-    // 'e' must be made into a 2 bit group like so:  'e' = \2\2\3\2  so:
-    //
-    //
-    //
-    //     ROOT
-    //       |
-    //       h\2\2\3\2__________________
-    //               |                  |
-    //               |                  |
-    //              \1\4\3\2lo         \2____________________
-    //                                  |                    |
-    //                                  |                    |
-    //                                 \1\3\2t              \2\3\2p
-    //
-    //
-    // But wait there's even move.  The 'h' can't be a branch point from
-    // root so  'h' = ASCII 150 = binary 01101000 = 01 10 10 00
-    // = \2 \3 \3 \1 = \1\3\3\2 in left to right order so:
-    //
-    //     ROOT
-    //       |
-    //      \1\3\3\2\2\2\3\2__________________
-    //                     |                  |
-    //                     |                  |
-    //                    \1\4\3\2lo         \2____________________
-    //                                        |                    |
-    //                                        |                    |
-    //                                       \1\3\2t              \2\3\2p
-    //
-    //
-    //
-    // Clearly with such short keys there is more stuff like \1\2\3\4 than
-    // there would be had they been longer keys.
-    //
-    //
-    //
-    struct QsDictionary *children; // array of 4 when needed and allocated
+    // The children in the order of their characters.  The array length
+    // is numChildren rounded up to a power of 2, so it does not have to
+    // be remade each time a child is added.
+    struct QsDictionary **children;
 
-    // suffix is a string added to the current path traversal generated
-    // string.  It can be 0 if no characters are needed.
-    //
-    // If an insert is done making the suffix become incorrect the node
-    // must be broken, this node will loose as much of the extra
-    // characters as it needs to and add children as it needs to, to make
-    // all the traversals correct.  This helps us use much less memory,
-    // by having more information in a node.  This little addition to the
-    // "standard" Trie data structure adds a little complexity to
-    // Insert(), but not much to Find().  We don't bother making "" empty
-    // strings; we just make them 0 pointers.
+    // value stored if there is one.
+    const void *value;
+
+    // The key of the entry in this node, or 0 if this node is just a
+    // branch point.  This is the key that was passed to
+    // qsDictionaryInsert(), which is not the whole key if it was
+    // inserted into a sub-dictionary.  We need it for
+    // qsDictionaryForEach(), and not for Find().
+    char *key;
+
+    void (*freeValueOnDestroy)(void *);
+
+    // The arena that this node is from.  It's 0 for the entries of the
+    // table backends.
+    struct Arena *arena;
+
+    // These are only set in the top node, the one from
+    // qsDictionaryCreate() or qsDictionaryCreateBackend().
     //
-    char *suffix;
+    // If this dictionary was frozen with qsDictionaryFreeze() this is the
+    // hash table that Find() uses in place of traversing the tree.  If the
+    // dictionary was made with a backend that is not QsDictionaryTrie
+    // this is the table that holds all the entries, and there is no tree.
+    // Both structs start with the backend so we can tell them apart.
+    union {
+        struct Frozen *frozen;
+        struct Table *table;
+        const enum QsDictionaryBackend *backend;
+    };
+
+    uint32_t prefixLen;
+
+    uint8_t numChildren; // There are less than 128 characters.
+
+    // The prefix characters; not '\0' terminated.
+    char prefix[];
+};
 
-    // value stored if there is one.  The key for this value is the string
-    // generated by traversing the graph stringing together the characters
-    // and optional suffix (if present) at each node in the traversal.
-    // Sometimes this node is just a branch point with no value or key.
-    const void *value;
 
-    // We only need the key to make the case for iterating through all the
-    // key/value pairs.  This is not needed for the Find() function.  You
-    // could remove this if you're not iterating through all the key/value
-    // pairs; example qsDictionaryForEach().
+// The arena is at the start of the first block of memory.  More blocks,
+// each twice as large as the last, are added as they are needed.
+//
+// Freed memory goes in a list that is searched for a piece of the same
+// size.  Removing entries is not common, so the list is not long, and
+// it's empty in dictionaries that nothing was removed from.  Children
+// arrays that are outgrown go in the list too.
+//
+struct Arena {
+
+    // The blocks after the first, last one first.
+    struct Block {
+        struct Block *next;
+    } *blocks;
+
+    // The unused memory in the newest block.
+    char *mem, *end;
+
+    size_t blockSize; // of the newest block
+
+    struct FreeMem {
+        struct FreeMem *next;
+        size_t size;
+    } *free;
+
+    // When qsDictionaryForEach() is running, removed nodes are not freed
+    // until it's done, because the callback may remove its' entry.
+    uint32_t forEachDepth;
+    bool needPrune;
+};
+
+
+// The size of the first block, with the arena and the top node in it.  It
+// fits a few keys, which is all most of the dictionaries in
+// libquickstream have.
+#define FIRST_BLOCK_SIZE  ((size_t) 1024)
+#define MAX_BLOCK_SIZE    ((size_t) 1024*1024)
+
+
+static inline
+size_t AllocSize(size_t size) {
+
+    if(size < sizeof(struct FreeMem))
+        return sizeof(struct FreeMem);
+    return (size + 7) & ~((size_t) 7);
+}
+
+
+static
+void *Alloc(struct Arena *a, size_t size) {
+
+    size = AllocSize(size);
+
+    for(struct FreeMem **f = &a->free; *f; f = &(*f)->next)
+        if((*f)->size == size) {
+            void *ret = *f;
+            *f = (*f)->next;
+            return ret;
+        }
+
+    if(a->mem + size > a->end) {
+
+        if(a->blockSize < MAX_BLOCK_SIZE)
+            a->blockSize *= 2;
+
+        size_t blockSize = a->blockSize;
+        if(blockSize < size + sizeof(struct Block))
+            blockSize = size + sizeof(struct Block);
+
+        // The end of the last block is lost.
+        struct Block *b = malloc(blockSize);
+        ASSERT(b, "malloc(%zu) failed", blockSize);
+        b->next = a->blocks;
+        a->blocks = b;
+        a->mem = (char *) (b + 1);
+        a->end = ((char *) b) + blockSize;
+    }
+
+    void *ret = a->mem;
+    a->mem += size;
+    return ret;
+}
+
+
+static inline
+void Free(struct Arena *a, void *ptr, size_t size) {
+
+    struct FreeMem *f = ptr;
+    f->size = AllocSize(size);
+    f->next = a->free;
+    a->free = f;
+}
+
+
+static inline
+char *ArenaStrdup(struct Arena *a, const char *str) {
+
+    size_t len = strlen(str) + 1;
+    char *s = Alloc(a, len);
+    memcpy(s, str, len);
+    return s;
+}
+
+
+static inline
+size_t NodeSize(uint32_t prefixLen) {
+    return offsetof(struct QsDictionary, prefix) + prefixLen;
+}
+
+
+// The top node, the one from qsDictionaryCreate(), is in the first block
+// of the arena just after the arena.
+static inline
+struct QsDictionary *TopNode(const struct Arena *a) {
+    return (struct QsDictionary *) ((char *) a + AllocSize(sizeof(*a)));
+}
+
+
+// Make a node with no children and no entry.
+static inline
+struct QsDictionary *NewNode(struct Arena *a, const char *prefix,
+        uint32_t prefixLen) {
+
+    struct QsDictionary *node = Alloc(a, NodeSize(prefixLen));
+    memset(node, 0, sizeof(*node));
+    node->arena = a;
+    node->prefixLen = prefixLen;
+    memcpy(node->prefix, prefix, prefixLen);
+    return node;
+}
+
+
+// The length of the children array for n children.
+static inline
+uint32_t ChildrenSize(uint32_t n) {
+
+    uint32_t size = 1;
+    while(size < n)
+        size *= 2;
+    return size;
+}
+
+
+static inline
+bool HasChild(const struct QsDictionary *node, unsigned char c) {
+
+    if(c < 64)
+        return node->bits[0] & (((uint64_t) 1) << c);
+    if(c < 128)
+        return node->bits[1] & (((uint64_t) 1) << (c - 64));
+    return false;
+}
+
+
+// The index into the children array of the child for character c.
+static inline
+uint32_t ChildIndex(const struct QsDictionary *node, unsigned char c) {
+
+    if(c < 64)
+        return __builtin_popcountll(node->bits[0] &
+                ((((uint64_t) 1) << c) - 1));
+    return __builtin_popcountll(node->bits[0]) +
+        __builtin_popcountll(node->bits[1] &
+                ((((uint64_t) 1) << (c - 64)) - 1));
+}
+
+
+static inline
+struct QsDictionary *Child(const struct QsDictionary *node,
+        unsigned char c) {
+
+    if(!HasChild(node, c))
+        return 0;
+    return node->children[ChildIndex(node, c)];
+}
+
+
+static
+void AddChild(struct QsDictionary *node, unsigned char c,
+        struct QsDictionary *child) {
+
+    DASSERT(!HasChild(node, c));
+    DASSERT(node->numChildren < 128);
+
+    uint32_t n = node->numChildren;
+    uint32_t i = ChildIndex(node, c);
+
+    if(n == 0 || n == ChildrenSize(n)) {
+        // The children array is full.
+        struct QsDictionary **children = Alloc(node->arena,
+                2 * n * sizeof(*children) + (n?0:sizeof(*children)));
+        if(n) {
+            memcpy(children, node->children, n * sizeof(*children));
+            Free(node->arena, node->children, n * sizeof(*children));
+        }
+        node->children = children;
+    }
+
+    memmove(node->children + i + 1, node->children + i,
+            (n - i) * sizeof(*node->children));
+    node->children[i] = child;
+    node->numChildren = n + 1;
+
+    if(c < 64)
+        node->bits[0] |= (((uint64_t) 1) << c);
+    else
+        node->bits[1] |= (((uint64_t) 1) << (c - 64));
+}
+
+
+static
+void RemoveChild(struct QsDictionary *node, unsigned char c) {
+
+    DASSERT(HasChild(node, c));
+
+    uint32_t n = node->numChildren;
+    uint32_t i = ChildIndex(node, c);
+
+    memmove(node->children + i, node->children + i + 1,
+            (n - i - 1) * sizeof(*node->children));
+    --n;
+    node->numChildren = n;
+
+    if(c < 64)
+        node->bits[0] &= ~(((uint64_t) 1) << c);
+    else
+        node->bits[1] &= ~(((uint64_t) 1) << (c - 64));
+
+    if(n == 0) {
+        Free(node->arena, node->children, sizeof(*node->children));
+        node->children = 0;
+    } else if(n == ChildrenSize(n) && n > 1) {
+        // Use the smaller array, so that the array size is always
+        // ChildrenSize(numChildren).
+        struct QsDictionary **children = Alloc(node->arena,
+                n * sizeof(*children));
+        memcpy(children, node->children, n * sizeof(*children));
+        Free(node->arena, node->children, 2 * n * sizeof(*children));
+        node->children = children;
+    }
+}
+// The frozen dictionary is a hash table with open addressing, in one
+// allocation, with the keys copied after the table slots.  The slots
+// point to the tree nodes, and not to the values, so that
+// qsDictionarySetValue() does not make the table out of date.
+//
+// For a Find() we hash the key, and then we usually touch just one
+// slot, one key string, and one tree node; in place of a node and a
+// children array for each branch point in the tree.
+//
+struct Frozen {
+
+    // This is QsDictionaryTrie.
+    enum QsDictionaryBackend backend;
+
+    // mask = (number of slots) - 1, and the number of slots is a power
+    // of 2 that is at least twice the number of keys.
+    uint32_t mask;
+
+    struct FrozenSlot {
+        uint32_t hash;
+        uint32_t keyOffset; // from the start of keys below
+        struct QsDictionary *node; // 0 if the slot is empty
+    } *slots; // points into this allocation
+
+    char *keys; // points into this allocation after slots
+};
+
+
+// The entries of dictionaries with the QsDictionaryHash or
+// QsDictionarySorted backends.  Each entry is a struct QsDictionary that
+// is allocated by itself, with just the key, value, and
+// freeValueOnDestroy set, so qsDictionarySetValue() and the like work
+// the same for all backends.
+//
+struct Table {
+
+    enum QsDictionaryBackend backend;
+
+    uint32_t numKeys;
+
+    // QsDictionaryHash
     //
-    // Key is the only this need to be non-zero for this element to be in
-    // use.
+    // mask = (number of slots) - 1, like in struct Frozen.  numUsed is
+    // the number of slots that are not empty, counting the slots of
+    // removed entries, which we keep so that the probing for the keys
+    // after them does not stop.  The table is remade when it gets half
+    // full.
+    uint32_t mask, numUsed;
+    struct HashSlot {
+        uint32_t hash;
+        struct QsDictionary *entry; // 0 if empty or &removed if removed
+    } *slots;
+
+    // QsDictionarySorted
     //
-    char *key; // strdup() the key.
-
-    void (*freeValueOnDestroy)(void *);
+    // The entries in strcmp() order of their keys, and the length of the
+    // allocated array.
+    struct QsDictionary **entries;
+    uint32_t size;
 };
 
 
+// Hash slots with a removed entry point to this.
+static struct QsDictionary removed;
+
+
+static inline
+bool IsTable(const struct QsDictionary *dict) {
+    return dict->backend && *dict->backend != QsDictionaryTrie;
+}
+
+
+// From MurmurHash1.c
+extern
+uint32_t MurmurHash1(const void *key, int len, uint32_t seed);
+
+#define HASH_SEED  ((uint32_t) 0x9747b28c)
+
+static inline
+uint32_t Hash(const char *key, size_t len) {
+    return MurmurHash1(key, (int) len, HASH_SEED);
+}
+
+
+
 struct QsDictionary *qsDictionaryCreate(void) {
 
+    struct Arena *a = malloc(FIRST_BLOCK_SIZE);
+    ASSERT(a, "malloc(%zu) failed", FIRST_BLOCK_SIZE);
+    memset(a, 0, sizeof(*a));
+    a->mem = (char *) a + AllocSize(sizeof(*a));
+    a->end = (char *) a + FIRST_BLOCK_SIZE;
+    a->blockSize = FIRST_BLOCK_SIZE;
+
+    // The top node is in the first block, right after the arena.
+    return NewNode(a, "", 0);
+}
+
+
+struct QsDictionary *qsDictionaryCreateBackend(
+        enum QsDictionaryBackend backend) {
+
+    if(backend == QsDictionaryTrie)
+        return qsDictionaryCreate();
+
+    DASSERT(backend == QsDictionaryHash || backend == QsDictionarySorted);
+
     struct QsDictionary *d = calloc(1, sizeof(*d));
     ASSERT(d, "calloc(1,%zu) failed", sizeof(*d));
 
-    struct QsDictionary *children = calloc(4, sizeof(*children));
-    ASSERT(children, "calloc(%d,%zu) failed", 4, sizeof(*children));
-    d->children = children;
+    struct Table *t = calloc(1, sizeof(*t));
+    ASSERT(t, "calloc(1,%zu) failed", sizeof(*t));
+    t->backend = backend;
+
+    if(backend == QsDictionaryHash) {
+        t->mask = 8 - 1;
+        t->slots = calloc(t->mask + 1, sizeof(*t->slots));
+        ASSERT(t->slots, "calloc(%" PRIu32 ",%zu) failed",
+                t->mask + 1, sizeof(*t->slots));
+    } else {
+        t->size = 8;
+        t->entries = malloc(t->size * sizeof(*t->entries));
+        ASSERT(t->entries, "malloc(%zu) failed",
+                t->size * sizeof(*t->entries));
+    }
+
+    d->table = t;
 
     return d;
 }
 
 
+// Calls the freeValueOnDestroy() functions of all the entries in the tree
+// at node.  The memory is freed with the arena.
 static
-void FreeChildren(struct QsDictionary *children) {
+void FreeValues(struct QsDictionary *node) {
 
-    for(struct QsDictionary *child = children + 4 - 1;
-            child >= children; --child) {
-        if(child->children)
-            // Recurse
-            FreeChildren(child->children);
-
-        // Clean up this child's struct QsDictionary
-        //
-        if(child->key) {
-            if(child->freeValueOnDestroy) {
-                child->freeValueOnDestroy((void *) child->value);
-                child->freeValueOnDestroy = 0;
-            }
-            DASSERT(child->key);
-            free(child->key);
-            child->key = 0;
-        }
-        //
-        if(child->suffix)
-            free(child->suffix);
+    if(node->key && node->freeValueOnDestroy) {
+        node->freeValueOnDestroy((void *) node->value);
+        node->freeValueOnDestroy = 0;
     }
 
-    // Cleanup the children array.
-
-#if DEBUG
-    memset(children, 0, 4*sizeof(*children));
-#endif
-    free(children);
+    for(uint32_t i = 0; i < node->numChildren; ++i)
+        // Recurse
+        FreeValues(node->children[i]);
 }
 
 
@@ -260,649 +515,499 @@ void qsDictionarySetFreeValueOnDestroy(struct QsDictionary *dict,
 }
 
 
+static inline
+void Unfreeze(struct QsDictionary *dict) {
+
+    DASSERT(!IsTable(dict));
+
+    if(dict->frozen) {
+        free(dict->frozen);
+        dict->frozen = 0;
+    }
+}
+
+
+static void DestroyTable(struct Table *t);
+
+
 void qsDictionaryDestroy(struct QsDictionary *dict) {
 
     DASSERT(dict);
 
-    if(dict->children) {
-        FreeChildren(dict->children);
-        dict->children = 0;
+    if(IsTable(dict)) {
+        DestroyTable(dict->table);
+#if DEBUG
+        memset(dict, 0, sizeof(*dict));
+#endif
+        free(dict);
+        return;
     }
 
-    if(dict->suffix) {
-        free(dict->suffix);
-        dict->suffix = 0;
-    }
+    // This must be a top node, which is in the first block of the arena.
+    struct Arena *a = dict->arena;
+    DASSERT(a);
+    DASSERT(dict == TopNode(a));
 
-    if(dict->key) {
-        if(dict->freeValueOnDestroy) {
-            dict->freeValueOnDestroy((void *) dict->value);
-            dict->freeValueOnDestroy = 0;
-        }
-        DASSERT(dict->key);
-        free(dict->key);
-        dict->key = 0;
+    Unfreeze(dict);
+    FreeValues(dict);
+
+    while(a->blocks) {
+        struct Block *b = a->blocks;
+        a->blocks = b->next;
+        free(b);
     }
 
 #if DEBUG
-    memset(dict, 0, sizeof(*dict));
+    memset(a, 0, FIRST_BLOCK_SIZE);
 #endif
-    free(dict);
+    free(a);
 }
 
 
-// TODO: Remove this debugging print thing.
-static inline char *
-STRING(const char *s) {
+static inline
+char *Strdup(const char *str) {
 
-    if(s == 0 || *s == 0)
-        return 0;
+    char *s = strdup(str);
+    ASSERT(s, "strdup(%p) failed", str);
+    return s;
+}
+
+
+// All the backends take the same keys, so that a use can change backends
+// without changing what keys it can have.
+static inline
+bool KeyIsValid(const char *key) {
+
+    for(const char *c = key; *c; ++c)
+        if(*c < START || *c > END) {
+            ERROR("Invalid character in key: \"%s\"", key);
+            return false;
+        }
+    return true;
+}
 
-    static char *str = 0;
 
-    str = realloc(str, strlen(s) * 4 + 2);
-    ASSERT(str, "realloc() failed");
+static int TableInsert(struct Table *t, const char *key,
+        const void *value, struct QsDictionary **idict);
 
-    char *ss = str;
 
-    for(; *s; ++s) {
-        if(*s >= START)
-            *ss++ = *s;
-        else {
-            *ss++ = '\\';
-            *ss++ = *s + '0';
+// Speed of Insert is not much of a concern.  It's Find that needs to be
+// fast.
+//
+// Returns 0 on success or 1 if already present and -1 if it is not added
+// and have an invalid character.
+int qsDictionaryInsert(struct QsDictionary *node,
+        const char *key_in, const void *value,
+        struct QsDictionary **idict) {
+
+    DASSERT(node);
+    DASSERT(key_in);
+    DASSERT(*key_in);
+
+    if(IsTable(node))
+        return TableInsert(node->table, key_in, value, idict);
+
+    struct Arena *a = node->arena;
+    DASSERT(a);
+    if(node != TopNode(a) && TopNode(a)->frozen) {
+        // The frozen table of the top node would not see the change.
+        ERROR("Inserting \"%s\" with a sub-dictionary of a frozen"
+                " dictionary", key_in);
+        return -1;
+    }
+
+    // The nodes may change, so the frozen table goes away.  It can be
+    // made again with qsDictionaryFreeze().
+    Unfreeze(node);
+
+    if(!KeyIsValid(key_in))
+        return -1;
+
+    const char *c = key_in;
+
+    // We start at the end of the prefix of node.
+    while(*c) {
+
+        struct QsDictionary *child = Child(node, *c);
+
+        if(!child) {
+            // Add a child with all the rest of the key as its' prefix.
+            child = NewNode(a, c + 1, strlen(c + 1));
+            AddChild(node, *c, child);
+            node = child;
+            break;
         }
+
+        ++c;
+
+        // Find the point where key and prefix do not match.
+        uint32_t i = 0;
+        while(i < child->prefixLen && c[i] == child->prefix[i])
+            ++i;
+
+        if(i < child->prefixLen) {
+            // SPLIT
+            //
+            // The key ends or goes another way part way through the
+            // prefix.  We put a new node between node and child with the
+            // part of the prefix that matched, and child keeps the rest.
+            // child does not move, because the user may have a pointer
+            // to it from qsDictionaryInsert() or qsDictionaryFindDict().
+            //
+            struct QsDictionary *mid = NewNode(a, child->prefix, i);
+            node->children[ChildIndex(node, *(c - 1))] = mid;
+            char midChar = child->prefix[i];
+            child->prefixLen -= i + 1;
+            memmove(child->prefix, child->prefix + i + 1, child->prefixLen);
+            AddChild(mid, midChar, child);
+            child = mid;
+        }
+
+        c += i;
+        node = child;
+    }
+
+    if(idict) *idict = node;
+
+    if(node->key) {
+        DSPEW("Entry with key=\"%s\" exists", key_in);
+        return 1;
     }
-    *ss = '\0';
 
-    return str;
+    node->value = value;
+    node->key = ArenaStrdup(a, key_in);
+
+    return 0; // success
 }
 
 
-// Example:
-//
-// Input: "key"
-//             k        e       y
-// Output: \4\3\3\2 \2\2\3\2 \2\3\4\2
-//
-// It's a 4 x 2 bit encoding of each character.  0 is not used to encode
-// because we still need a 0 (Null) terminator to be 0 and not part of the
-// encoding.   So the 2 bits are 00 01 10 11 and than we add one giving 01
-// 10 11 100 = 1 2 3 4 = \1 \2 \3 \4  so we can tell them from apart from
-// the regular characters '1' '2' '3' and '4'.  See above.
+// Find the node with key, starting at the end of the prefix of node.
 //
-// Returns malloc() allocated string.
+// Returns 0 if it's not found.
 static inline
-char *Expand(const char *key) {
-
-    size_t l = 1;
-    for(const char *c = key; *c; ++c) {
-        if(*c > 4)
-            l += 4;
-        else
-            ++l;
-    }
+struct QsDictionary
+*_qsDictionaryFindDict(const struct QsDictionary *node, const char *key) {
 
-    char *s = malloc(l);
-    ASSERT(s, "malloc(%zu) failed", l);
-    char *str = s;
+    while(*key) {
 
-    for(const char *c = key; *c; ++c) {
+        node = Child(node, *key);
 
-        uint32_t code = *c;
+        if(!node) {
+            DSPEW("No key=\"%s\" found", key);
+            return 0;
+        }
 
-        if(code > 4) {
-            uint32_t *val = (uint32_t *) str;
+        ++key;
 
-            *val =     (((0x00000003) & code)        + 0x00000001)
-                    | ((((0x0000000C) & code) << 6 ) + 0x00000100)
-                    | ((((0x00000030) & code) << 12) + 0x00010000)
-                    | ((((0x000000C0) & code) << 18) + 0x01000000);
-            str += 4;
-        } else
-            *(str++) = code;
+        if(node->prefixLen) {
+            // strncmp() stops at the end of key, and the prefix has no
+            // '\0' in it.
+            if(strncmp(node->prefix, key, node->prefixLen)) {
+                DSPEW("No key=\"%s\" found", key);
+                return 0;
+            }
+            key += node->prefixLen;
+        }
     }
 
-    *str = '\0';
+    if(!node->key) {
+        // The key is a prefix of other keys, and it ends at a branch
+        // point with no entry.
+        DSPEW("No key=\"%s\" found", key);
+        return 0;
+    }
 
-    return s;
+    // Hooray!  We got it.
+    return (struct QsDictionary *) node;
 }
 
 
 static inline
-bool
-IsCharacter(const char *s, uint32_t count) {
-
-    if(*s == 0 || *(s+1) == 0 || *(s+2) == 0 || *(s+3) == 0)
-        return false;
-
-    //return false;
-
-    if(
-            count%4 == 0 &&
-            *s < 5 &&
-            *(s+1) < 5 &&
-            *(s+2) < 5 &&
-            *(s+3) < 5
-            )
-        return true;
-    return false;
+struct QsDictionary *FrozenFind(const struct Frozen *frozen,
+        const char *key) {
+
+    size_t len = strlen(key);
+    uint32_t hash = Hash(key, len);
+
+    for(uint32_t i = hash & frozen->mask; ;
+            i = (i + 1) & frozen->mask) {
+
+        const struct FrozenSlot *slot = frozen->slots + i;
+
+        if(!slot->node)
+            // We hit an empty slot, so it's not here.
+            return 0;
+
+        if(slot->hash == hash &&
+                strcmp(frozen->keys + slot->keyOffset, key) == 0)
+            return slot->node;
+    }
 }
 
 
-// Returns malloc() allocated string.
-//
-// Converts in parts of 4 characters from the end.
-//
-// Examples:
-//
-// Input: \3\2 \2\2\3\2 \2\3\4\2
-//
-// Output: \3\2ey
-//
+// Returns the hash slot with key, or if it's not there, the first empty
+// or removed slot where it could be added.
 static inline
-char *Compress(const char *suffix, size_t count_in) {
-
-    DASSERT(suffix);
-    DASSERT(*suffix);
-
-    const char *s = suffix;
-    size_t len = 0;
-    size_t count = count_in;
-
-    while(*s) {
- 
-        if(IsCharacter(s, count)) {
-            count += 4;
-            s += 4;
-        } else {
-            ++s;
-            ++count;
+struct HashSlot *HashLookup(const struct Table *t, const char *key,
+        uint32_t hash) {
+
+    struct HashSlot *avail = 0;
+
+    for(uint32_t i = hash & t->mask; ; i = (i + 1) & t->mask) {
+
+        struct HashSlot *slot = t->slots + i;
+
+        if(!slot->entry)
+            // We hit an empty slot, so it's not here.
+            return avail?avail:slot;
+
+        if(slot->entry == &removed) {
+            if(!avail) avail = slot;
+            continue;
         }
 
-        ++len;
+        if(slot->hash == hash && strcmp(slot->entry->key, key) == 0)
+            return slot;
     }
+}
 
-    char *str = malloc(len+1);
-    ASSERT(str, "malloc(%zu) failed", len+1);
-    char *mem = str;
-    // Reset count for another run at the input string.
-    count = count_in;
-    s = suffix;
-
-    while(*s) {
-
-        if(IsCharacter(s, count)) {
-            char val = (*(s++) - 1);
-            val     |= (*(s++) - 1) << 2;
-            val     |= (*(s++) - 1) << 4;
-            val     |= (*(s++) - 1) << 6;
-            *(str++) = val;
-            count += 4;
-        } else {
-            *(str++) = *(s++);
-            ++count;
+
+// Binary search.  Returns the entry with key, or 0 if it's not there and
+// then *index is set to where it would be inserted.
+static inline
+struct QsDictionary *SortedLookup(const struct Table *t, const char *key,
+        uint32_t *index) {
+
+    uint32_t lo = 0, hi = t->numKeys;
+
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        int cmp = strcmp(key, t->entries[mid]->key);
+        if(cmp == 0) {
+            if(index) *index = mid;
+            return t->entries[mid];
         }
+        if(cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
     }
 
-    *str = '\0';
-
-    return mem;
+    if(index) *index = lo;
+    return 0;
 }
 
 
 static inline
-char *Strdup(const char *str) {
+struct QsDictionary *TableFind(const struct Table *t, const char *key) {
 
-    char *s = strdup(str);
-    ASSERT(s, "strdup(%p) failed", str);
-    return s;
+    if(t->backend == QsDictionaryHash) {
+        struct QsDictionary *entry = HashLookup(t, key,
+                Hash(key, strlen(key)))->entry;
+        return (entry == &removed)?0:entry;
+    }
+
+    return SortedLookup(t, key, 0);
 }
 
-#if 0
+
+// Remake the hash slots with room for at least numKeys keys, and without
+// the removed slots.
 static
-void
-DictionaryCheckChildren(struct QsDictionary *node) {
+void HashResize(struct Table *t, uint32_t numKeys) {
 
-    DASSERT(node);
+    uint32_t numSlots = 8;
+    while(numSlots < 4*numKeys)
+        numSlots *= 2;
 
-    if(node->children) {
-        const char *childKey = 0;
-        struct QsDictionary *aChild = 0;
-        struct QsDictionary *lastChild = node->children + 3;
-        for(struct QsDictionary *child = node->children;
-                child <= lastChild; ++child) {
-            if(child->children) {
-                DictionaryCheckChildren(child);
-                aChild = child;
-            } else if(child->key)
-                childKey = child->key;
-        }
-        ASSERT(aChild || childKey);
+    struct HashSlot *slots = calloc(numSlots, sizeof(*slots));
+    ASSERT(slots, "calloc(%" PRIu32 ",%zu) failed",
+            numSlots, sizeof(*slots));
+
+    for(uint32_t i = 0; i <= t->mask; ++i) {
+        struct HashSlot *slot = t->slots + i;
+        if(!slot->entry || slot->entry == &removed)
+            continue;
+        uint32_t j = slot->hash & (numSlots - 1);
+        while(slots[j].entry)
+            j = (j + 1) & (numSlots - 1);
+        slots[j] = *slot;
     }
-}
-#endif
 
+    free(t->slots);
+    t->slots = slots;
+    t->mask = numSlots - 1;
+    t->numUsed = t->numKeys;
+}
 
-// Speed of Insert is not much of a concern.  It's Find that needs to be
-// fast.
-//
-// Returns 0 on success or 1 if already present and -1 if it is not added
-// and have an invalid character.
-int qsDictionaryInsert(struct QsDictionary *node,
-        const char *key_in, const void *value,
-        struct QsDictionary **idict) {
 
-    DASSERT(node);
-    DASSERT(key_in);
-    DASSERT(*key_in);
+static int TableInsert(struct Table *t, const char *key,
+        const void *value, struct QsDictionary **idict) {
 
-    // Since we have no need for speed in Insert and the code is simpler
-    // this way, we check all the characters in the key at the start of
-    // this function.  It would have be faster (but more complex) to do
-    // this as we traverse the characters in the key in the next for loop.
-    //
-    for(const char *c = key_in; *c; ++c)
-        if(*c < START || *c > END) {
-            ERROR("Invalid character in key: \"%s\"",
-                    key_in);
-            return -1;
-        }
+    if(!KeyIsValid(key))
+        return -1;
 
-    // We put the key input the form like: "he" = \1\3\3\2 \2\2\3\2
-    char *key = Expand(key_in);
+    struct QsDictionary *entry;
 
+    if(t->backend == QsDictionaryHash) {
 
-#if 0 // Testing encoding.
-    for(char *str = key; *str; ++str) {
-        fprintf(stderr, "\\%d", *str);
-    }
-    fprintf(stderr, "\n");
+        uint32_t hash = Hash(key, strlen(key));
+        struct HashSlot *slot = HashLookup(t, key, hash);
 
-    return 0;
-#endif
+        if(slot->entry && slot->entry != &removed) {
+            if(idict) *idict = slot->entry;
+            DSPEW("Entry with key=\"%s\" exists", key);
+            return 1;
+        }
 
+        if(!slot->entry && 2*(t->numUsed + 1) > t->mask + 1) {
+            HashResize(t, t->numKeys + 1);
+            slot = HashLookup(t, key, hash);
+        }
 
-    // It turns out we also need an index character counter in order to
-    // tell when we can compress the likes of \2\2\3\2 to 'h'.  That can
-    // only happen at every 4 characters starting at the top of the tree.
-    // If it compresses across a 4 character "boundary" we get trouble
-    // decoding it.  We could compress across a 4 character boundaries,
-    // but then we'd add quite a bit more complexity to the code.
+        if(!slot->entry)
+            ++t->numUsed;
 
-    size_t count = 0;
+        entry = calloc(1, sizeof(*entry));
+        ASSERT(entry, "calloc(1,%zu) failed", sizeof(*entry));
+        slot->hash = hash;
+        slot->entry = entry;
 
-    for(char *c = key; *c;) {
+    } else {
 
-        if(node->children) {
-            // We will go to next child in the traversal.
-            //
-            // Go to the next child in the traversal.
+        uint32_t i;
+        entry = SortedLookup(t, key, &i);
 
-            node = node->children + *c - 1;
-            ++c;
-            ++count;
+        if(entry) {
+            if(idict) *idict = entry;
+            DSPEW("Entry with key=\"%s\" exists", key);
+            return 1;
+        }
 
-            if(node->suffix) {
-
-                char *eSuffix = Expand(node->suffix); // gets freed.
-                char *e = eSuffix;
-
-                for(;*e && *c && *e == *c; ++c, ++e, ++count);
-                // e and c are at:
-                //
-                // CASES:
-                //
-                //
-                if(*e == 0 && *c == 0) {
-                    // Prefect match.
-                    //
-                    if(idict) *idict = node;
-
-                    if(node->key) {
-                        DSPEW("Entry with key=\"%s\" exists", key_in);
-                        free(eSuffix);
-                        free(key);
-                        return 1;
-                    }
-                    node->value = value;
-                    node->key = Strdup(key_in);
-                    free(eSuffix);
-                    free(key);
-                    return 0;
-                }
-                if(*e == 0) {
-                    // CONTINUE
-                    //
-                    // Suffix matched and ran out.  Still have key
-                    // characters.  Go to the next child if there is one.
-                    free(eSuffix);
-                    continue;
-                }
-                if(*c == 0) {
-                    // SPLIT
-                    //
-                    // The key ran out and the suffix still have
-                    // characters.  We matched part way through the
-                    // suffix.
-                    //
-                    // So: split the node in two and the first one has the
-                    // new inserted value and the second (n2) has the old
-                    // value and the old children.
-                    //
-                    // New node children:
-                    struct QsDictionary *children = calloc(4,
-                            sizeof(*children));
-                    ASSERT(children, "calloc(%d,%zu) failed",
-                            4, sizeof(*children));
-
-                    // The first node keeps the same child memory as node.
-                    struct QsDictionary *n2 = children + (*e) - 1;
-                    n2->children = node->children;
-                    n2->value = node->value;
-                    n2->freeValueOnDestroy = node->freeValueOnDestroy;
-                    node->freeValueOnDestroy = 0;
-                    n2->key = node->key;
-
-                    if(*(e+1))
-                        // Copy the remains of the old suffix starting at
-                        // the next character.
-                        n2->suffix = Compress(e+1, count+1);
-
-                    char *oldSuffix = node->suffix;
-                    node->value = value;
-                    if(idict) *idict = node;
-                    node->key = Strdup(key_in);
-                    if(e == eSuffix) {
-                        // There where no matching chars in suffix and the
-                        // char pointers never advanced.
-                        node->suffix = 0;
-                    } else {
-                        // At least one char matched in suffix.  Null
-                        // terminate the suffix after the last matching
-                        // char and then dup it.
-                        *(char *) e = '\0'; // It's okay we copied it
-                        // above.  We have less characters for this node.
-                        node->suffix = Compress(eSuffix,
-                                count - (e - eSuffix));
-                    }
-                    node->children = children;
-                    free(oldSuffix);
-                    free(eSuffix);
-                    free(key);
-                    return 0; // success
-                }
-
-                // BIFURCATE
-                //
-                // We match up to "ee" but there is more to go and we
-                // don't match after that.  Result is we need to add 2
-                // nodes.
-
-                // New node children:
-                //
-                // 2 of these children will be used in this bifurcation.
-                struct QsDictionary *children =
-                        calloc(4, sizeof(*children));
-                ASSERT(children, "calloc(%d,%zu) failed",
-                        4, sizeof(*children));
-
-                char *oldSuffix = node->suffix;
-                struct QsDictionary *n1 = children + (*e) - 1;
-                struct QsDictionary *n2 = children + (*c) - 1;
-                n1->value = node->value;
-                n1->freeValueOnDestroy = node->freeValueOnDestroy;
-                node->freeValueOnDestroy = 0;
-                n1->key = node->key;
-                n1->children = node->children;
-                n2->value = value;
-                if(idict) *idict = n2;
-                n2->key = Strdup(key_in);
-                node->children = children;
-                node->value = 0;
-                node->key = 0;
-
-                if(*(e+1))
-                    n1->suffix = Compress(e+1, count+1);
-
-                ++c;
-                if(*c)
-                    n2->suffix = Compress(c, count+1);
-
-                if(e == eSuffix)
-                    node->suffix = 0;
-                else {
-                    // No need to worry, we copied this above, so now we
-                    // came hack it up.
-                    *((char *)(e)) = '\0';
-                    node->suffix = Compress(eSuffix, count - (e - eSuffix));
-                }
-
-                free(oldSuffix);
-                free(eSuffix);
-                free(key);
-                return 0; // success
-
-            } // if(node->suffix)
-
-            // The simple case.  We matched, to get to this node.
-            // We'll act after we break out of this 
-            continue; // See if there are more children.
-
-        } // if(node->children) { // node = next child
-
-
-        DASSERT(node->children == 0);
-        DASSERT(*c);
-
-        if(node->key == 0) {
-            DASSERT(node->suffix == 0);
-            node->suffix = Compress(c, count);
-            if(idict) *idict = node;
-            node->value = value;
-            DASSERT(node->key == 0);
-            node->key = Strdup(key_in);
-
-            free(key);
-            return 0; // success
+        if(t->numKeys == t->size) {
+            t->size *= 2;
+            t->entries = realloc(t->entries,
+                    t->size * sizeof(*t->entries));
+            ASSERT(t->entries, "realloc(,%zu) failed",
+                    t->size * sizeof(*t->entries));
         }
 
-        struct QsDictionary *children = calloc(4, sizeof(*children));
-        ASSERT(children, "calloc(%d,%zu) failed", 4, sizeof(*children));
-        node->children = children;
+        memmove(t->entries + i + 1, t->entries + i,
+                (t->numKeys - i) * sizeof(*t->entries));
 
-        // go to this character (*c) node.
-        node = children + (*c) - 1;
-        if(idict) *idict = node;
-        node->value = value;
-        node->key = Strdup(key_in);
-        // add any suffix characters if needed.
-        if(*(c+1))
-            node->suffix = Compress(c+1, count+1);
+        entry = calloc(1, sizeof(*entry));
+        ASSERT(entry, "calloc(1,%zu) failed", sizeof(*entry));
+        t->entries[i] = entry;
+    }
 
-        free(key);
-        return 0; // success
+    ++t->numKeys;
+    entry->key = Strdup(key);
+    entry->value = value;
+    if(idict) *idict = entry;
 
+    return 0; // success
+}
 
-    } // for(char *c = key; *c; ++c) {
 
-    if(node->key) {
-        if(idict) *idict = node;
-        DSPEW("Entry with key=\"%s\" exists", key_in);
-        free(key);
-        return 1;
-    }
+static inline
+void FreeEntry(struct QsDictionary *entry) {
 
-    // node->value == 0
-    node->value = value;
-    if(idict) *idict = node;
-    DASSERT(node->key == 0);
-    node->key = Strdup(key_in);
-    free(key);
-    return 0; // success done
+    if(entry->freeValueOnDestroy)
+        entry->freeValueOnDestroy((void *) entry->value);
+    free(entry->key);
+#if DEBUG
+    memset(entry, 0, sizeof(*entry));
+#endif
+    free(entry);
 }
 
 
+static int TableRemove(struct Table *t, const char *key) {
 
-// Returns the next character
-// This returns the next character after we run out of the 2 bit encoded
-// characters.
-static inline
-char GetChar(char **bits, const char **c) {
-
-    char ret;
-
-    if(**bits) {
-        // For this use case we encode the 0 as 1 and the 1 as 2
-        // and the 2 as 3 and the 3 as 4; because we need 0 to terminate
-        // the string.
-        DASSERT((**bits) <= 4);
-        ret = (**bits);
-        *bits += 1;
-        if(**bits == 0)
-            // We hit the 0 terminator.
-            // Advance to the next character for next time.
-            *c += 1;
-        // Return a 2 bits of a byte + 1.
-        return ret;
-    }
-
-    // *bits is at the null terminator.
-    ret = **c;
+    struct QsDictionary *entry;
 
-    *c += 1;
+    if(t->backend == QsDictionaryHash) {
 
-    return ret;
-}
+        struct HashSlot *slot = HashLookup(t, key,
+                Hash(key, strlen(key)));
+        entry = slot->entry;
+        if(!entry || entry == &removed)
+            return 1; // not found
+        slot->entry = &removed;
 
+    } else {
 
-// I wish C had pass by reference.
-//
-// This is only used to index into a child node, so the 1 offset is not
-// added.
-static inline
-char GetBits(char **bits, const char **c) {
-
-    // We cannot call this function if there are no more characters left
-    // in the string.
-    DASSERT(**c);
-
-    char ret;
-
-    if(**bits) {
-        // For this use case we encode the 0 as 1 and the 1 as 2
-        // and the 2 as 3 and the 3 as 4; because we need 0 to terminate
-        // the string.
-        DASSERT((**bits) <= 4);
-        ret = (**bits);
-        *bits += 1;
-        if(**bits == 0)
-            // We hit the 0 terminator.
-            // Advance to the next character for next time.
-            *c += 1;
-        // Return a 2 bits of a byte + 1.
-        return ret;
+        uint32_t i;
+        entry = SortedLookup(t, key, &i);
+        if(!entry)
+            return 1; // not found
+        memmove(t->entries + i, t->entries + i + 1,
+                (t->numKeys - i - 1) * sizeof(*t->entries));
     }
 
-    // *bits is at the null terminator.
+    --t->numKeys;
+    FreeEntry(entry);
 
-    // The current character we analyze is:
-    ret = **c;
+    return 0; // found and removed
+}
 
-    // Bit diddle with next character, i.e. decompose it into 4 2 bit
-    // pieces in bits[].  We store 2 bits in each char in bits[4].  The
-    // value of any one of bits[] is 0, 1, 2, or 3, all plus 1.  We encode
-    // 1 8 bit char as 4 8 byte chars with values only 1, 2, 3, or 4.  We
-    // need to use the 0 value as a terminator.
 
-    // Go to the second array element in this null terminate array of 4 +
-    // 1 null = *bits[5].
-    //
-    *bits -= 3;
+static
+size_t TableForEach(const struct Table *t,
+        int (*callback) (const char *key, void *value,
+            void *userData), void *userData) {
 
-    // We can use a pointer to a 32 bit = 4 byte x 8 bit/byte thing to set
-    // all the *bits[] array at one shot.
-    uint32_t *val32 = (uint32_t *) (*bits - 1);
+    size_t count = 0;
 
-    // We must keep this order when decoding in the Find() function.
+    if(t->backend == QsDictionaryHash) {
+        // Removing an entry just marks its slot, so the callback removing
+        // its entry does not move the other entries.
+        for(uint32_t i = 0; i <= t->mask; ++i) {
+            struct QsDictionary *entry = t->slots[i].entry;
+            if(!entry || entry == &removed)
+                continue;
+            ++count;
+            if(callback(entry->key, (void *) entry->value, userData))
+                break;
+        }
+        return count;
+    }
 
-    //                                        plus 1 in this byte
-    //                                            |
-    //                                            V
-    *val32 =   (((0x00000003) & ret)        + 0x00000001)
-            | ((((0x0000000C) & ret) << 6)  + 0x00000100)
-            | ((((0x00000030) & ret) << 12) + 0x00010000)
-            | ((((0x000000C0) & ret) << 18) + 0x01000000);
-    //
-    // The next bits[] to be returned after this call will be **bits =
-    // *bits[0], not *bits[-1].
-    //
-    return *(*bits -1); // Return the first set of 2 bits.
+    for(uint32_t i = 0; i < t->numKeys;) {
+        struct QsDictionary *entry = t->entries[i];
+        ++count;
+        if(callback(entry->key, (void *) entry->value, userData))
+            break;
+        // If the callback removed the entry, the next one is at i now.
+        if(i < t->numKeys && t->entries[i] == entry)
+            ++i;
+    }
+    return count;
 }
 
-static inline
-struct QsDictionary
-*_qsDictionaryFindDict(struct QsDictionary *node, const char *key) {
-
-    // Setup pointers to an array of chars that null terminates.
-    char b[5];
-    char *bits = b + 4;
-    b[0] = 1;
-    b[1] = 1;
-    b[2] = 1;
-    b[3] = 1;
-    b[4] = 0; // null terminate.
-    // We'll use bits to swim through this "bit" character array.
-
-    for(const char *c = key; *c; ) {
-
-        if(node->children) {
-
-            node = node->children + GetBits(&bits, &c)  - 1;
-
-            if(node->suffix) {
-
-                const char *e = node->suffix;
-
-                // Find the point where key and suffix do not match.
-                for(;*e && *c;) {
-                    // Consider iterating over 2 bit chars
-                    if(*e < START) {
-                        if((*e) != GetBits(&bits, &c))
-                            break;
-                    } else
-                    // Else iterate over regular characters.
-                    if(*e != GetChar(&bits, &c))
-                        break;
-                    ++e;
-                }
-
-                if(*e == 0)
-                    // Matched so far
-                    continue;
-                else {
-                    // The suffix has more characters that we did not
-                    // match.
-                    DSPEW("No key=\"%s\" found", key);
-                    return 0;
-                }
-            }
-            continue;
-        }
 
-        // No more children, but we have unmatched key characters.
-        DSPEW("No key=\"%s\" found", key);
-        return 0;
+static void DestroyTable(struct Table *t) {
+
+    if(t->backend == QsDictionaryHash) {
+        for(uint32_t i = 0; i <= t->mask; ++i) {
+            struct QsDictionary *entry = t->slots[i].entry;
+            if(entry && entry != &removed)
+                FreeEntry(entry);
+        }
+        free(t->slots);
+    } else {
+        for(uint32_t i = 0; i < t->numKeys; ++i)
+            FreeEntry(t->entries[i]);
+        free(t->entries);
     }
 
-    DASSERT(node->key);
+#if DEBUG
+    memset(t, 0, sizeof(*t));
+#endif
+    free(t);
+}
 
-    // This DASSERT() will not be true for *qsDictionaryFindDict():
-    //DASSERT(strcmp(key, node->key) == 0);
 
-    // Hooray!  We got it.
-    return (struct QsDictionary *) node;
-}
 
 
 struct QsDictionary
@@ -912,7 +1017,12 @@ struct QsDictionary
     DASSERT(key);
     DASSERT(key[0]);
 
-    dict = _qsDictionaryFindDict((struct QsDictionary *)dict, key);
+    if(IsTable(dict))
+        dict = TableFind(dict->table, key);
+    else if(dict->frozen)
+        dict = FrozenFind(dict->frozen, key);
+    else
+        dict = _qsDictionaryFindDict(dict, key);
 
     if(value && dict) *value = (void *) dict->value;
 
@@ -926,7 +1036,12 @@ void *qsDictionaryFind(const struct QsDictionary *dict, const char *key) {
     DASSERT(key);
     DASSERT(key[0]);
 
-    dict = _qsDictionaryFindDict((struct QsDictionary *) dict, key);
+    if(IsTable(dict))
+        dict = TableFind(dict->table, key);
+    else if(dict->frozen)
+        dict = FrozenFind(dict->frozen, key);
+    else
+        dict = _qsDictionaryFindDict(dict, key);
 
     if(dict) return (void *) dict->value;
 
@@ -934,6 +1049,37 @@ void *qsDictionaryFind(const struct QsDictionary *dict, const char *key) {
 }
 
 
+// Frees the nodes below node that have no entry and no children, that
+// are left from removing entries.
+static
+void Prune(struct QsDictionary *node) {
+
+    for(uint32_t i = 0; i < node->numChildren;) {
+
+        struct QsDictionary *child = node->children[i];
+
+        Prune(child);
+
+        if(child->key || child->numChildren) {
+            ++i;
+            continue;
+        }
+
+        // Find the character for the child at index i.
+        unsigned char c = 0;
+        for(uint32_t n = 0; ; ++c)
+            if(HasChild(node, c) && n++ == i)
+                break;
+
+        RemoveChild(node, c);
+        Free(node->arena, child, NodeSize(child->prefixLen));
+    }
+}
+
+
+// The children are in the order of their characters, and the prefix of a
+// node is before its' children, so this goes through the keys in
+// strcmp() order.
 static
 bool ForEach(const struct QsDictionary *node,
         int (*callback) (const char *key, void *value,
@@ -951,14 +1097,9 @@ bool ForEach(const struct QsDictionary *node,
             return true; // We are done.
     }
 
-    if(node->children) {
-        struct QsDictionary *end = node->children + 3;
-        for(struct QsDictionary *child = node->children;
-                child <= end; ++child)
-            if(ForEach(child, callback, count, userData))
-                return true; // We are done.
-    }
-
+    for(uint32_t i = 0; i < node->numChildren; ++i)
+        if(ForEach(node->children[i], callback, count, userData))
+            return true; // We are done.
 
     return false; // keep going.
 }
@@ -971,472 +1112,347 @@ qsDictionaryForEach(const struct QsDictionary *node,
 
     DASSERT(node);
     DASSERT(callback);
+
+    if(IsTable(node))
+        return TableForEach(node->table, callback, userData);
+
     size_t ret_count = 0;
+    struct Arena *a = node->arena;
+    DASSERT(a);
 
+    // The callback may remove its' entry, and then the nodes are not
+    // freed until we are done going through them.
+    ++a->forEachDepth;
     ForEach(node, callback, &ret_count, userData);
+    --a->forEachDepth;
+
+    if(a->forEachDepth == 0 && a->needPrune) {
+        Prune((struct QsDictionary *) node);
+        a->needPrune = false;
+    }
+
     return ret_count;
 }
 
 
-static void
-PrintEscChar(char c, FILE *f) {
+// Count the keys, and the bytes needed to copy them, in the tree at node.
+// The node->key strings are relative to the node that they were inserted
+// with, which may be a sub-dictionary, so we use the keys that the path
+// through the tree spells.  len is the length of the key at node, and
+// maxLen is the length of the longest path.
+static
+void FreezeCount(const struct QsDictionary *node, size_t len,
+        uint32_t *numKeys, size_t *keysLen, size_t *maxLen) {
 
-    DASSERT((1 <= c && c <= 4) ||
-            (START <= c && c <= END), "c=\\%d", c);
+    if(node->key) {
+        ++(*numKeys);
+        *keysLen += len + 1;
+    }
+    if(len > *maxLen)
+        *maxLen = len;
 
-    if(c < '0' || ('9' < c && c < 'A') ||
-            ('Z' < c && c < 'a') || 'z' < c)
-        fprintf(f, "\\(%d\\)", c); // like \\2
-    else
-        // Print like a regular character like 'a' or '5'.
-        putc(c, f);
+    for(uint32_t i = 0; i < node->numChildren; ++i)
+        FreezeCount(node->children[i],
+                len + 1 + node->children[i]->prefixLen,
+                numKeys, keysLen, maxLen);
 }
 
 
-static inline void
-PrintEscStr(const char *s, FILE *f) {
+// Add the keys in the tree at node to the frozen table.  key[0:len] is
+// the key at node.
+static
+void FreezeAdd(struct QsDictionary *node, struct Frozen *frozen,
+        char *key, size_t len, size_t *keysLen) {
 
-    while(*s)
-        PrintEscChar(*s++, f);
-}
+    if(node->key) {
 
+        uint32_t hash = Hash(key, len);
+        uint32_t i = hash & frozen->mask;
 
-static void
-Print_Char(char c, FILE *f) {
+        while(frozen->slots[i].node)
+            i = (i + 1) & frozen->mask;
 
-    DASSERT((1 <= c && c <= 4) ||
-            (START <= c && c <= END), "c=\\%d", c);
+        memcpy(frozen->keys + *keysLen, key, len);
+        frozen->keys[*keysLen + len] = '\0';
+        frozen->slots[i].hash = hash;
+        frozen->slots[i].keyOffset = *keysLen;
+        frozen->slots[i].node = node;
+        *keysLen += len + 1;
+    }
 
-    if(c < '0' || ('9' < c && c < 'A') ||
-            ('Z' < c && c < 'a') || 'z' < c)
-        fprintf(f, "_%d", c); // like \\2
-    else
-        // Print like a regular character like 'a' or '5'.
-        putc(c, f);
-}
+    unsigned char c = 0;
 
+    for(uint32_t i = 0; i < node->numChildren; ++i, ++c) {
 
-static inline void
-Print_Str(const char *s, FILE *f) {
+        while(!HasChild(node, c)) ++c;
 
-    while(*s)
-        Print_Char(*s++, f);
+        struct QsDictionary *child = node->children[i];
+        key[len] = c;
+        memcpy(key + len + 1, child->prefix, child->prefixLen);
+        FreezeAdd(child, frozen, key, len + 1 + child->prefixLen, keysLen);
+    }
 }
 
 
-#if 1
-static void
-PrintStr(const char *s, FILE *f) {
+void qsDictionaryFreeze(struct QsDictionary *dict) {
 
-    while(*s) {
+    DASSERT(dict);
 
-        if(*s < 5) {
+    if(IsTable(dict))
+        // There's no tree to make faster.
+        return;
 
-            DASSERT(*(s+1) && *(s+2) && *(s+3));
-            DASSERT(*(s+1) < 5, "*(s+1)=%d", *(s+1));
-            DASSERT(*(s+2) < 5, "*(s+2)=%d", *(s+2));
-            DASSERT(*(s+3) < 5, "*(s+3)=%d", *(s+3));
+    // Only the top node has a frozen table; see struct QsDictionary.
+    DASSERT(dict == TopNode(dict->arena),
+            "Freezing a sub-dictionary");
 
-            char val = (*s - 1);
-            ++s;
-            val |= (*s - 1) << 2;
-            ++s;
-            val |= (*s - 1) << 4;
-            ++s;
-            val |= (*s - 1) << 6;
+    Unfreeze(dict);
 
-            PrintEscChar(val, f);
-        } else
+    uint32_t numKeys = 0;
+    size_t keysLen = 0, maxLen = 0;
+    // The top node has no key and no prefix.
+    FreezeCount(dict, 0, &numKeys, &keysLen, &maxLen);
 
-            PrintEscChar(*s, f);
-        ++s;
-    }
-}
-#else
-static void
-PrintStr(const char *s, FILE *f) {
-    PrintEscStr(s,f);
-}
-#endif
+    if(numKeys == 0)
+        // There's nothing to find, and Find() is fast enough at that.
+        return;
 
+    uint32_t numSlots = 4;
+    while(numSlots < 2*numKeys)
+        numSlots *= 2;
 
-// This function is called recursively adding to parentPrefix at each
-// level in the call stack.
-static void
-PrintChildren(const struct QsDictionary *node, char *parentPrefix,
-        char *parentSum, FILE *f) {
-
-    if(node->children) {
-        char c = 1;
-        for(struct QsDictionary *child = node->children;
-                c <= 4; ++c, child = node->children + c - 1) {
-
-            if(child->key == 0 && child->children == 0) continue;
-
-            const char *suffix = child->suffix;
-
-            // Make a new longer prefix
-            size_t l1 = strlen(parentPrefix);
-            char *prefix = malloc(l1 + 2);
-            ASSERT(prefix, "malloc() failed");
-            strcpy(prefix, parentPrefix);
-            *(prefix + l1) = c;
-            *(prefix + l1 + 1) = '\0';
-
-            // Make a longer sum
-            l1 = strlen(parentSum);
-            size_t l2 = strlen(suffix?suffix:"");
-            size_t len = l1 + 1 + l2 + 1;
-            char *sum = malloc(len);
-            ASSERT(sum, "malloc() failed");
-            strcpy(sum, parentSum);
-            *(sum + l1) = c;
-            strcpy(sum + l1 + 1, suffix?suffix:"");
-            *(sum + l1 + 1 + l2) = '\0';
-
-            // parent -> child
-            fprintf(f, "  \"");
-            Print_Str(parentPrefix, f);
-            fprintf(f, "\" -> \"");
-            Print_Str(prefix, f);
-            fprintf(f, "\";\n");
-
-            // child label
-            fprintf(f, "  \"");
-            Print_Str(prefix, f);
-            fprintf(f, "\" [label=\"");
-            PrintEscChar(c, f);
-            if(suffix) {
-                fprintf(f, "\\nsuffix=");
-                PrintEscStr(suffix, f);
-            }
-            fprintf(f, "\\ntotal=");
-            PrintEscStr(sum, f);
-            fprintf(f, "");
+    size_t size = sizeof(struct Frozen) +
+            numSlots * sizeof(struct FrozenSlot) + keysLen;
+    struct Frozen *frozen = calloc(1, size);
+    ASSERT(frozen, "calloc(1,%zu) failed", size);
 
-            if(child->key) {
+    frozen->backend = QsDictionaryTrie;
+    frozen->mask = numSlots - 1;
+    frozen->slots = (struct FrozenSlot *) (frozen + 1);
+    frozen->keys = (char *) (frozen->slots + numSlots);
 
-                fprintf(f, "\\nkey=");
-                PrintStr(sum, f);
-                fprintf(f, "\\nvalue=%p", child->value);
-            }
+    char *key = malloc(maxLen + 1);
+    ASSERT(key, "malloc(%zu) failed", maxLen + 1);
 
-            fprintf(f, "\"];\n");
+    keysLen = 0;
+    FreezeAdd(dict, frozen, key, 0, &keysLen);
 
-            PrintChildren(child, prefix, sum, f);
-            
-            free(prefix);
-            free(sum);
-        }
-    }
+    free(key);
+
+    dict->frozen = frozen;
 }
 
 
-void qsDictionaryPrintDot(const struct QsDictionary *node, FILE *f) {
+static void
+PrintEscChar(char c, FILE *f) {
 
-    fprintf(f, "digraph {\n  label=\"Trie Dictionary\";\n\n");
+    DASSERT(START <= c && c <= END, "c=\\%d", c);
 
-    fprintf(f, "  \"\" [label=\"ROOT\"];\n");
+    if(c < '0' || ('9' < c && c < 'A') ||
+            ('Z' < c && c < 'a') || 'z' < c)
+        fprintf(f, "\\(%d\\)", c); // like \(58\) for ':'
+    else
+        // Print like a regular character like 'a' or '5'.
+        putc(c, f);
+}
 
 
-    PrintChildren(node, "", "", f);
+static inline void
+PrintEscStr(const char *s, size_t len, FILE *f) {
 
-    fprintf(f, "}\n");
+    while(len--)
+        PrintEscChar(*s++, f);
 }
 
 
-void qsDictionarySetValue(struct QsDictionary *dict, void *value) {
+static void
+Print_Char(char c, FILE *f) {
 
-    DASSERT(dict);
-    dict->value = value;
+    DASSERT(START <= c && c <= END, "c=\\%d", c);
+
+    if(c < '0' || ('9' < c && c < 'A') ||
+            ('Z' < c && c < 'a') || 'z' < c)
+        fprintf(f, "_%d", c); // like _58 for ':'
+    else
+        // Print like a regular character like 'a' or '5'.
+        putc(c, f);
 }
 
 
-void *qsDictionaryGetValue(const struct QsDictionary *dict) {
+static inline void
+Print_Str(const char *s, FILE *f) {
 
-    DASSERT(dict);
-    return (void *) dict->value;
+    while(*s)
+        Print_Char(*s++, f);
 }
 
 
+// This function is called recursively.  The nodes are named by their
+// addresses.
 static void
-AbsorbChild(struct QsDictionary *parent, struct QsDictionary *child,
-        int childIndex) {
-
-    DASSERT(parent->key == 0);
-    // Absorb this one child up to this parent.
-    struct QsDictionary *nodeChildren = parent->children;
-
-    parent->value = child->value;
-    parent->children = child->children;
-    parent->freeValueOnDestroy = child->freeValueOnDestroy;
-    parent->key = child->key;
+PrintChildren(const struct QsDictionary *node, FILE *f) {
 
-    size_t len = ((parent->suffix)?strlen(parent->suffix):0) +
-        ((child->suffix)?strlen(child->suffix):0) + 2;
+    unsigned char c = 0;
 
-    char *suffix = malloc(len);
-    ASSERT(suffix, "malloc(%zu) failed", len);
-    sprintf(suffix, "%s%c%s",
-            (parent->suffix)?(parent->suffix):"",
-            childIndex+1,
-            (child->suffix)?(child->suffix):"");
+    for(uint32_t i = 0; i < node->numChildren; ++i, ++c) {
 
-    //DSPEW("--- suffix=\"%s\"", STRING(suffix));
+        while(!HasChild(node, c)) ++c;
 
+        const struct QsDictionary *child = node->children[i];
 
-    if(parent->suffix)
-        free(parent->suffix);
-    if(child->suffix)
-        free(child->suffix);
+        // parent -> child
+        fprintf(f, "  \"%p\" -> \"%p\";\n", node, child);
 
-    // The only thing left to do is compress the suffix, but we must first
-    // figure out where suffix boundaries of that divide the regular
-    // characters and the 1-4 encoded characters.  Since we were not
-    // passed a counter that tells us where the boundaries are we need to
-    // figure it out (if we can) by looking at the characters.
-    //
-    char *esuffix = 0; // for expanded 1-4 char encoded suffix
-    size_t l = 0;
-    const char *s = suffix;
-    for(;*s; ++s) {
-        if(*s >= START) {
-            l = 4 - (s - suffix)%4;
-            break;
+        // child label
+        fprintf(f, "  \"%p\" [label=\"", child);
+        PrintEscChar(c, f);
+        if(child->prefixLen) {
+            fprintf(f, "\\nprefix=");
+            PrintEscStr(child->prefix, child->prefixLen, f);
         }
-    }
+        if(child->key) {
+            fprintf(f, "\\nkey=");
+            PrintEscStr(child->key, strlen(child->key), f);
+            fprintf(f, "\\nvalue=%p", child->value);
+        }
+        fprintf(f, "\"];\n");
 
-    if(*s == '\0' && parent->key) {
-        // We did not find a START char but this node will have an entry,
-        // so there must be what will be an un-encoded character at the
-        // last character.
-        esuffix = Expand(suffix);
-        l = 4 - strlen(esuffix)%4;
-
-    } else if(*s == '\0') {
-        // This is the case where we can't determine the 1-4 encoded
-        // characters boundary, so we just leave the suffix in an expanded
-        // form with just 1-4 encoded characters.
-        //
-        // TODO: recompress this suffix.  That's hard given we do not know
-        // at what point the character decoding begins in this version of
-        // the suffix.  It's all just in the 4 (encoding) characters \001
-        // \002 \003 and \004 with a group of 4 being an encoding of a
-        // character that is between START (7) bell and END (126) '~'.  We
-        // don't know when a group of 4 starts without traversing the
-        // dictionary tree, or passing a counter parameter to this
-        // function.
-        //
-        parent->suffix = suffix;
-        free(nodeChildren);
-        return;
+        PrintChildren(child, f);
     }
-
-    if(!esuffix)
-        esuffix = Expand(suffix);
-
-    parent->suffix = Compress(esuffix, l);
-    free(esuffix);
-    free(suffix);
-    free(nodeChildren);
-    //DSPEW("l=%zu parent suffix=\"%s\"", l, STRING(parent->suffix));
 }
 
 
-// Because we can remove a node from between upper and lower generations;
-// anywhere in the tree.
-//
-// This is freeing the node entry, and if there is one child it will be
-// absorbed by this node, but if there is 2 or more children than this
-// just frees the node key/value, keeping the 2 or more children
-// unchanged.
-//
-// This node may get removed from its' parent later.
-//
-// Pruning up useless parent nodes happens later too.
-//
+// The table backends have no tree, so the graph is the root with all the
+// entries as its' children.
 static
-void PruneNodeDown(struct QsDictionary *node) {
+int PrintEntry(const char *key, void *value, FILE *f) {
+
+    fprintf(f, "  \"\" -> \"");
+    Print_Str(key, f);
+    fprintf(f, "\";\n  \"");
+    Print_Str(key, f);
+    fprintf(f, "\" [label=\"key=");
+    PrintEscStr(key, strlen(key), f);
+    fprintf(f, "\\nvalue=%p\"];\n", value);
+    return 0;
+}
 
-    // First empty the node, but leave its' children.
-    DASSERT(node->key);
 
-    if(node->freeValueOnDestroy) {
-        DASSERT(node->value);
+void qsDictionaryPrintDot(const struct QsDictionary *node, FILE *f) {
 
-        node->freeValueOnDestroy((void *) node->value);
-        node->freeValueOnDestroy = 0;
+    if(IsTable(node)) {
+        fprintf(f, "digraph {\n  label=\"%s Dictionary\";\n\n",
+                (*node->backend == QsDictionaryHash)?"Hash":"Sorted");
+        fprintf(f, "  \"\" [label=\"ROOT\"];\n");
+        TableForEach(node->table,
+                (int (*)(const char *, void *, void *)) PrintEntry, f);
+        fprintf(f, "}\n");
+        return;
     }
 
-    free(node->key);
-    node->key = 0;
-    node->value = 0;
+    fprintf(f, "digraph {\n  label=\"Radix Tree Dictionary\";\n\n");
 
-    if(!node->children) {
-        free(node->suffix);
-        node->suffix = 0;
-        return; // stop pruning down, we may prune up later.
-    }
+    fprintf(f, "  \"%p\" [label=\"ROOT\"];\n", node);
 
+    PrintChildren(node, f);
 
-    // If this node has children then there must be a key/value pair
-    // in at least one child.
+    fprintf(f, "}\n");
+}
 
-    int numChildren = 0;
 
-    struct QsDictionary *oneChild = 0;
-    int childIndex = 0;
+void qsDictionarySetValue(struct QsDictionary *dict, void *value) {
 
-    for(int i=0;i<4;++i) {
-        struct QsDictionary *child = node->children + i;
-        if(child->key || child->children) {
-            oneChild = child;
-            ++numChildren;
-            childIndex = i;
-        }
-    }
+    DASSERT(dict);
+    dict->value = value;
+}
 
-    if(numChildren >= 2)
-        // The node will keep its' children.
-        // We keep the suffix.
-        return; // stop pruning down, we may prune up.
 
-    DASSERT(numChildren == 1, "numChildren=%d", numChildren);
+void *qsDictionaryGetValue(const struct QsDictionary *dict) {
 
-    AbsorbChild(node, oneChild, childIndex);
+    DASSERT(dict);
+    return (void *) dict->value;
 }
 
 
+// Returns 0 if it was found and removed, 1 if not found.
 //
-static void
-PruneUp(struct QsDictionary *parent) {
-
-
-    DASSERT(parent->children);
-
-    int numChildren = 0;
-    int childIndex = 0;
-    struct QsDictionary *oneChild = 0;
-
-    for(int i=0;i<4;++i) {
-        struct QsDictionary *child = parent->children + i;
-        if(child->key || child->children) {
-            oneChild = child;
-            ++numChildren;
-            childIndex = i;
-        }
-    }
-
-    //ERROR("======== prumeUP key=%s has %d children", parent->key, numChildren);
-
-    //DSPEW("parent->suffix=\"%s\"", STRING(parent->suffix));
-
-    if(numChildren == 1 && parent->key == 0)
-        // Absorb this one child up to this parent.
-        AbsorbChild(parent, oneChild, childIndex);
-    else if(numChildren == 0) {
-        free(parent->children);
-        parent->children = 0;
-    }
-}
+// If prune is set the nodes that are left with no entry and no children
+// are freed on the way back up.  We never free the node we started at,
+// because that's the top node or a sub-dictionary that the user has.
+//
+static
+int Remove(struct QsDictionary *node, const char *key, bool prune) {
 
+    if(*key == '\0') {
 
-// Return true if found,
-// or return false if not found,
-// or recurse.
-//
-bool TraverseChildrenAndPrumeBack(struct QsDictionary *node,
-        const char *key,
-        char **bits, const char **c, bool *done) {
-
-    if(node->suffix) {
-
-        const char *e = node->suffix;
-
-        // Find the point where key and suffix do not match.
-        for(;*e && **c;) {
-            // Consider iterating over 2 bit chars
-            if(*e < START) {
-                if((*e) != GetBits(bits, c))
-                    break;
-            } else
-            // Else iterate over regular characters.
-            if(*e != GetChar(bits, c))
-                break;
-            ++e;
-        }
+        if(!node->key)
+            return 1; // not found
 
-        if(*e != 0) {
-            // The suffix has more characters that we did not
-            // match.
-            DSPEW("No key=\"%s\" found", key);
-            return false;
+        if(node->freeValueOnDestroy) {
+            node->freeValueOnDestroy((void *) node->value);
+            node->freeValueOnDestroy = 0;
         }
+        Free(node->arena, node->key, strlen(node->key) + 1);
+        node->key = 0;
+        node->value = 0;
+        return 0; // found and removed
     }
 
-    // Okay we made it through the last suffix
-    //
-    // Go to the next node if we can.
-
-    if(**c && node->children) {
+    unsigned char c = *key;
+    struct QsDictionary *child = Child(node, c);
 
-        struct QsDictionary *n = node->children + GetBits(bits, c)  - 1;
+    if(!child)
+        return 1; // not found
 
-        if(!TraverseChildrenAndPrumeBack(n, key, bits, c, done))
-            return false; // not found.
+    ++key;
 
-        if(*done) return true; // found and done pruning.
+    if(strncmp(child->prefix, key, child->prefixLen))
+        return 1; // not found
 
-        PruneUp(node);
-        *done = true; // stop pruning.
-        return true;
-    }
-
-    if(**c) {
-        // No more children, but we have unmatched key characters.
-        //
-        // Therefore we failed to find the key.
-        DSPEW("No key=\"%s\" found", key);
-        return false; // not found.
-    }
+    if(Remove(child, key + child->prefixLen, prune))
+        return 1; // not found
 
-    if(!node->key) {
-        DSPEW("No key=\"%s\" found", key);
-        return false;
+    if(prune && !child->key && !child->numChildren) {
+        RemoveChild(node, c);
+        Free(node->arena, child, NodeSize(child->prefixLen));
     }
 
-    PruneNodeDown(node);
+    // Nodes that are left with one child are not joined with the child,
+    // because that would move the child, and the user may have a pointer
+    // to it.
 
-    // We went through all the characters so:
-    return true; // It's found.
+    return 0; // found and removed
 }
 
 
-
 int qsDictionaryRemove(struct QsDictionary *dict, const char *key) {
 
     DASSERT(dict);
     DASSERT(key);
     DASSERT(key[0]);
 
-    if(!dict->children) return 1; // not found
-
-    // Setup pointers to an array of chars that null terminates.
-    char b[5];
-    char *bits = b + 4;
-    b[0] = 1;
-    b[1] = 1;
-    b[2] = 1;
-    b[3] = 1;
-    b[4] = 0; // null terminate.
+    if(IsTable(dict))
+        return TableRemove(dict->table, key);
 
-    const char *c = key;
-    bool done = false;
+    struct Arena *a = dict->arena;
+    DASSERT(a);
+    if(dict != TopNode(a) && TopNode(a)->frozen) {
+        // The frozen table of the top node would not see the change.
+        ERROR("Removing \"%s\" with a sub-dictionary of a frozen"
+                " dictionary", key);
+        return -1;
+    }
 
-    dict = dict->children + GetBits(&bits, &c)  - 1;
+    // The nodes may change, so the frozen table goes away.
+    Unfreeze(dict);
 
-    if(*c && TraverseChildrenAndPrumeBack(dict, key, &bits, &c, &done))
-        return 0; // found and removed
+    if(a->forEachDepth) {
+        // We are in a qsDictionaryForEach() callback.
+        int ret = Remove(dict, key, false);
+        if(ret == 0)
+            a->needPrune = true;
+        return ret;
+    }
 
-    return 1; // not found
+    return Remove(dict, key, true);
 }
@@ -9,6 +9,38 @@ extern
 struct QsDictionary *qsDictionaryCreate(void);
 
 
+// The data structures that a dictionary may keep its key/value pairs in.
+// See dev_tests/Dictionary_bench.c for how they compare.
+enum QsDictionaryBackend {
+
+    // What qsDictionaryCreate() makes.  A trie, which is the only backend
+    // with sub-dictionaries for qsDictionaryFindDict(), and that gets
+    // faster with qsDictionaryFreeze().
+    QsDictionaryTrie = 0,
+
+    // A MurmurHash1 hash table with open addressing.  The fastest to
+    // insert, and to find when there are many keys.
+    QsDictionaryHash,
+
+    // A flat array of entries sorted by key, with a binary search to find.
+    // It uses the least memory, and qsDictionaryForEach() goes through
+    // the keys in strcmp() order.
+    QsDictionarySorted
+};
+
+
+// Make a dictionary that uses "backend".
+//
+// With a backend that is not QsDictionaryTrie, the entries that
+// qsDictionaryInsert() and qsDictionaryFindDict() get may be used with
+// qsDictionarySetValue(), qsDictionaryGetValue(), and
+// qsDictionarySetFreeValueOnDestroy(), but not as sub-dictionaries; and
+// qsDictionaryFreeze() does nothing.
+extern
+struct QsDictionary *qsDictionaryCreateBackend(
+        enum QsDictionaryBackend backend);
+
+
 extern
 void qsDictionaryDestroy(struct QsDictionary *dict);
 
@@ -23,7 +55,8 @@ void qsDictionaryDestroy(struct QsDictionary *dict);
 // sub-dictionary to insert and find with.
 //
 // Returns 0 on success or 1 if already present and -1 if it is not added
-// and have an invalid character.
+// and have an invalid character, or "dict" is a sub-dictionary of a
+// frozen dictionary.
 extern
 int qsDictionaryInsert(struct QsDictionary *dict,
         const char *key, const void *value,
@@ -32,7 +65,8 @@ int qsDictionaryInsert(struct QsDictionary *dict,
 
 // If found, cleans up the value calling freeValueOnDestroy if it was set.
 //
-// Returns 0 if it was found and removed, 1 if not found.
+// Returns 0 if it was found and removed, 1 if not found, and -1 if "dict"
+// is a sub-dictionary of a frozen dictionary.
 extern
 int qsDictionaryRemove(struct QsDictionary *dict, const char *key);
 
@@ -98,7 +132,8 @@ void qsDictionaryPrintDot(const struct QsDictionary *dict, FILE *file);
 // call to qsDictionaryForEach() returns.
 //
 // Searches the entire data structure starting at dict.  Calls callback
-// with key and value.
+// with key and value.  The QsDictionaryTrie and QsDictionarySorted
+// backends go through the keys in strcmp() order.
 //
 // Returns the number of keys and callbacks called.
 //
@@ -110,6 +145,23 @@ qsDictionaryForEach(const struct QsDictionary *dict,
 
 
 
+// Make a hash table of all the keys in "dict" that qsDictionaryFind()
+// and qsDictionaryFindDict(), with "dict", then use in place of
+// traversing the tree.  It's for dictionaries that do not change while
+// the stream is flowing, and it's faster because there are far fewer
+// cache misses.
+//
+// Calling qsDictionaryInsert() or qsDictionaryRemove() with "dict"
+// unfreezes it, and it may be frozen again.  Inserting or removing with a
+// sub-dictionary of a frozen dictionary, from qsDictionaryFindDict() or
+// qsDictionaryInsert(), fails and returns -1, and freezing a
+// sub-dictionary is not allowed.
+//
+// Calling this again remakes the table.
+extern
+void qsDictionaryFreeze(struct QsDictionary *dict);
+
+
 // Set the value for the node at "dict".
 extern
 void qsDictionarySetValue(struct QsDictionary *dict, void *value);
@@ -13,8 +13,143 @@
 
 
 #include "debug.h"
+#include "Dictionary.h"
 #include "qs.h"
 
+
+// The name of the optional module index file in a plugin directory.  It
+// is made by lib/quickstream/plugins/qsModulesIndex.bash at install time,
+// in the installed plugins directory and in its filters, controllers, and
+// run directories, so that QS_FILTER_PATH and the like may point to them.
+//
+// Each line is the path to a module file, relative to the directory that
+// the index file is in, optionally followed by a tab and the symbols that
+// the module exports.  We just use the path.  Lines starting with '#' are
+// comments.
+//
+// The index saves us looking in the directories that do not have the
+// module: a module that is not in the index is taken to not be in the
+// directory.  A module that is in the index may have been removed or
+// renamed since the index was made, so we still check it with access().
+//
+#define INDEX_FILE  "qsModules.index"
+
+
+// This mutex protects the caches below.  GetPluginPath() is usually
+// called from the main thread, but it need not be.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Dictionary of directory path to the dictionary of the paths in the
+// index file in that directory, or &noIndex if there is no index file.
+// We never free this; it's per process.
+static struct QsDictionary *indexes = 0;
+static char noIndex;
+
+// Dictionary of category + name + suffix to the full path that
+// GetPluginPath() found for it.  Paths that were not found are not put in
+// it, so a module that is added later will be found.  We never free this;
+// it's per process.
+static struct QsDictionary *paths = 0;
+
+// The plugin path environment variables that paths was made with.  If
+// they change we start a new paths cache.
+static char *pathsEnv = 0;
+
+
+
+static void FreeIndex(struct QsDictionary *index) {
+
+    if((void *) index != (void *) &noIndex)
+        qsDictionaryDestroy(index);
+}
+
+
+// Returns the dictionary of the paths in the index file in directory dir,
+// or 0 if there is not one.  Reads the index file the first time only.
+//
+// The mutex must be locked to call this.
+static struct QsDictionary *GetIndex(const char *dir) {
+
+    // These dictionaries are only used to find whole keys, and they are
+    // never frozen, so the hash backend is the fastest.  An index file
+    // may list all the modules that are installed.
+    if(!indexes) {
+        indexes = qsDictionaryCreateBackend(QsDictionaryHash);
+        ASSERT(indexes);
+    }
+
+    struct QsDictionary *index = qsDictionaryFind(indexes, dir);
+
+    if(index)
+        return ((void *) index == (void *) &noIndex)?0:index;
+
+    size_t len = strlen(dir) + strlen(INDEX_FILE) + 2;
+    char *path = malloc(len);
+    ASSERT(path, "malloc(%zu) failed", len);
+    snprintf(path, len, "%s/%s", dir, INDEX_FILE);
+
+    FILE *file = fopen(path, "r");
+    if(file) {
+        index = qsDictionaryCreateBackend(QsDictionaryHash);
+        ASSERT(index);
+        char *line = 0;
+        size_t n = 0;
+        ssize_t rd;
+        while((rd = getline(&line, &n, file)) > 0) {
+            if(line[0] == '#') continue;
+            // The path ends at a tab or the end of the line.
+            line[strcspn(line, "\t\n")] = '\0';
+            if(line[0] && qsDictionaryInsert(index, line,
+                        (void *) &noIndex, 0) < 0) {
+                // The path has characters that the dictionary does not
+                // take.  The index would not list all the modules, so we
+                // do not use it.
+                WARN("Module index file %s has path \"%s\" that we can't"
+                        " use; not using the index", path, line);
+                qsDictionaryDestroy(index);
+                index = 0;
+                break;
+            }
+        }
+        free(line);
+        fclose(file);
+        if(index)
+            DSPEW("Read module index file: %s", path);
+    } else
+        errno = 0;
+
+    free(path);
+
+    struct QsDictionary *d;
+    if(qsDictionaryInsert(indexes, dir,
+                index?((void *) index):((void *) &noIndex), &d)) {
+        // We cannot cache it.
+        if(index)
+            qsDictionaryDestroy(index);
+        return 0;
+    }
+    qsDictionarySetFreeValueOnDestroy(d, (void (*)(void *)) FreeIndex);
+
+    return index;
+}
+
+// Returns true if the module file at path is there.  relPath is path
+// relative to the directory with the index, or index is 0 if there is no
+// index file.
+static inline bool HaveModule(struct QsDictionary *index,
+        const char *relPath, const char *path) {
+
+    if(index && !qsDictionaryFind(index, relPath))
+        return false;
+
+    if(access(path, R_OK) == 0)
+        return true;
+
+    errno = 0;
+    return false;
+}
+
+
 //
 // Returned malloc() memory must be free()ed.
 // or 0 if it's not found.
@@ -101,14 +236,16 @@ static char *GetPluginPathFromEnv(const char *envs,
     for(char **path = envPaths; *path; ++path) {
         snprintf(buf, len, "%s/%s%s%s", *path, category, name, suffix);
 
-        if(access(buf, R_OK) == 0) {
+        // If there is an index file in this directory and it does not
+        // have this module we go on to the next directory without
+        // looking at the file system.
+        if(HaveModule(GetIndex(*path), buf + strlen(*path) + 1, buf)) {
             // No memory leaks here:
             free(envPaths);
             free(env);
             // The user of this function must free buf.
             return buf; // success, we can access this file.
-        } else
-            errno = 0;
+        }
     }
 
     // No memory leaks here:
@@ -126,13 +263,18 @@ static char *GetPluginPathFromEnv(const char *envs,
 //
 // example: category = "filters/"
 //
-// The returned pointer must be free()ed.
+// The returned pointer must be free()ed.  *found is set if we know the
+// file is there, and not set if the returned path is just a guess.
+//
+// The mutex must be locked to call this.
 static inline
 char *_GetPluginPath(const char *prefix, const char *category,
-        const char *name, const char *suffix)
+        const char *name, const char *suffix, bool *found)
 {
     DASSERT(name && strlen(name) >= 1);
 
+    *found = false;
+
     size_t suffixLen = strlen(suffix);
     DASSERT(suffix && suffixLen);
 
@@ -148,7 +290,8 @@ char *_GetPluginPath(const char *prefix, const char *category,
             path = malloc(len + suffixLen + 1);
             snprintf(path, len + suffixLen + 1, "%s%s", name, suffix);
         }
-        // This is the full path.
+        // This is the full path.  There's no looking to save by caching
+        // it, so we leave *found unset.
         return path;
     }
 
@@ -157,30 +300,33 @@ char *_GetPluginPath(const char *prefix, const char *category,
     char *buf;
 
     if(strcmp(category, "filters/") == 0) {
-        if((buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
-                        name, suffix)))
-            return buf;
-        if((buf = GetPluginPathFromEnv("QS_FILTER_PATH", "",
+        if(!(buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
                         name, suffix)))
-            return buf;
+            buf = GetPluginPathFromEnv("QS_FILTER_PATH", "",
+                        name, suffix);
     } else if(strcmp(category, "controllers/") == 0) {
-        if((buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
+        if(!(buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
                         name, suffix)))
-            return buf;
-        if((buf = GetPluginPathFromEnv("QS_CONTROLLER_PATH", "",
-                        name, suffix)))
-            return buf;
+            buf = GetPluginPathFromEnv("QS_CONTROLLER_PATH", "",
+                        name, suffix);
     } else if(strcmp(category, "run/") == 0) {
-        if((buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
-                        name, suffix)))
-            return buf;
-        if((buf = GetPluginPathFromEnv("QS_RUN_PATH", "",
+        if(!(buf = GetPluginPathFromEnv("QS_MODULE_PATH", category,
                         name, suffix)))
-            return buf;
+            buf = GetPluginPathFromEnv("QS_RUN_PATH", "",
+                        name, suffix);
     } else
         ASSERT(0, "category != \"filters/\" or \"controllers/\" Need "
                 "to add category \"%s\"", category);
 
+    if(buf) {
+        *found = true;
+        return buf;
+    }
+
+
+    // The prefix is a directory, like "/lib/quickstream/plugins/".
+    const size_t prefixLen = strlen(prefix);
+    DASSERT(prefixLen > 1 && prefix[prefixLen-1] == '/');
 
     // postLen = strlen("/lib/quickstream/plugins/" + category + name)
     const ssize_t postLen =
@@ -245,18 +391,102 @@ char *_GetPluginPath(const char *prefix, const char *category,
     if(strcmp(&buf[bufLen-suffixLen], suffix))
         strcat(buf, suffix);
 
+    // buf is our best guess.  If we can access it, and the index file in
+    // the installed plugins directory, if there is one, lists it, it's
+    // found.
+    const size_t dirLen = rl + prefixLen - 1;
+    char *dir = strndup(buf, dirLen);
+    ASSERT(dir, "strndup() failed");
+    *found = HaveModule(GetIndex(dir), buf + dirLen + 1, buf);
+    free(dir);
+
     return buf;
 }
 
 
+// Returns a malloc() allocated string of the values of the environment
+// variables that _GetPluginPath() uses.
+static char *GetEnvs(void) {
+
+    const char *envs[] = { "QS_MODULE_PATH", "QS_FILTER_PATH",
+        "QS_CONTROLLER_PATH", "QS_RUN_PATH", 0 };
+    size_t len = 1;
+    for(const char **e = envs; *e; ++e) {
+        const char *val = getenv(*e);
+        len += (val?strlen(val):0) + 1;
+    }
+    char *ret = malloc(len);
+    ASSERT(ret, "malloc(%zu) failed", len);
+    char *s = ret;
+    for(const char **e = envs; *e; ++e) {
+        const char *val = getenv(*e);
+        if(val) {
+            strcpy(s, val);
+            s += strlen(val);
+        }
+        *s++ = '\n';
+    }
+    *s = '\0';
+    return ret;
+}
+
+
 // This is the only exposed interface in this file.
 //
+// We cache the paths that we find, so that loading the same module many
+// times does not look through the file system each time.
+//
 char *GetPluginPath(const char *prefix, const char *category,
         const char *name, const char *suffix) {
 
-    char *ret = _GetPluginPath(prefix, category, name, suffix);
+    size_t len = strlen(category) + strlen(name) + strlen(suffix) + 1;
+    char *key = alloca(len);
+    snprintf(key, len, "%s%s%s", category, name, suffix);
+
+    char *env = GetEnvs();
+
+    CHECK(pthread_mutex_lock(&mutex));
+
+    if(!pathsEnv || strcmp(env, pathsEnv)) {
+        // The environment changed, or this is the first call.
+        if(paths)
+            qsDictionaryDestroy(paths);
+        paths = qsDictionaryCreateBackend(QsDictionaryHash);
+        ASSERT(paths);
+        if(pathsEnv)
+            free(pathsEnv);
+        pathsEnv = env;
+        env = 0;
+    }
+
+    char *ret = qsDictionaryFind(paths, key);
+
+    if(ret) {
+        ret = strdup(ret);
+        ASSERT(ret, "strdup() failed");
+    } else {
+        bool found;
+        ret = _GetPluginPath(prefix, category, name, suffix, &found);
+        DASSERT(ret);
+        if(!found)
+            // Do not cache a guess.
+            goto unlock;
+        char *val = strdup(ret);
+        ASSERT(val, "strdup() failed");
+        struct QsDictionary *d;
+        if(qsDictionaryInsert(paths, key, val, &d))
+            // We could not add it.
+            free(val);
+        else
+            qsDictionarySetFreeValueOnDestroy(d, free);
+    }
+
+unlock:
+
+    CHECK(pthread_mutex_unlock(&mutex));
 
-    DASSERT(ret);
+    if(env)
+        free(env);
 
     // ret should be a malloc() allocated string a full path to a file, or
     // a best guess of that, but at this point we are not sure the file
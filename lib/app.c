@@ -23,7 +23,9 @@
 #include "./debug.h"
 #include "Dictionary.h"
 #include "./qs.h"
+#include "./parameter.h"
 #include "./filterList.h"
+#include "./controllerThread.h"
 
 
 uint32_t _qsAppCount = 0;
@@ -85,6 +87,9 @@ int qsAppDestroy(struct QsApp *app) {
     // all the controllers.
     qsDictionaryDestroy(app->controllers);
 
+    // The controllers that used the shared controller threads are gone.
+    _qsControllerPoolDestroy(app);
+
     // The SetFreeValueOnDestroy callbacks will cleanup
     // all the scriptControllerLoaders.
     qsDictionaryDestroy(app->scriptControllerLoaders);
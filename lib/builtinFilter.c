@@ -0,0 +1,65 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// The public installed user interfaces:
+#include "../include/quickstream/app.h"
+
+
+#include "debug.h"
+#include "Dictionary.h"
+#include "qs.h"
+
+
+// The table of filter modules that are compiled into the program, in
+// place of being plugin DSO files.  See qsBuiltinFiltersAdd() in app.h.
+//
+// We never free this; it's per process.  The list is short, and it's
+// only searched when filters are loaded, so a list is fine.
+//
+static struct QsBuiltin *builtins = 0;
+
+
+
+void qsBuiltinFiltersAdd(const struct QsBuiltinFilter *filters) {
+
+    ASSERT(filters);
+
+    for(; filters->name; ++filters) {
+
+        ASSERT(filters->input, "Built-in filter \"%s\" has no input()",
+                filters->name);
+
+        struct QsBuiltin *b = calloc(1, sizeof(*b));
+        ASSERT(b, "calloc(1,%zu) failed", sizeof(*b));
+        b->filter = filters;
+        // Added last is found first.
+        b->next = builtins;
+        builtins = b;
+    }
+}
+
+
+struct QsBuiltin *FindBuiltinFilter(const char *fileName) {
+
+    DASSERT(fileName);
+
+    if(!builtins ||
+            // This is a path to a file, and not a filter name.
+            fileName[0] == DIR_CHAR || fileName[0] == '.')
+        return 0;
+
+    // fileName may or may not have a ".so" suffix.
+    size_t len = strlen(fileName);
+    if(len > 3 && strcmp(fileName + len - 3, ".so") == 0)
+        len -= 3;
+
+    for(struct QsBuiltin *b = builtins; b; b = b->next)
+        if(strncmp(b->filter->name, fileName, len) == 0 &&
+                b->filter->name[len] == '\0')
+            return b; // found
+
+    return 0; // not found
+}
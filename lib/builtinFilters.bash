@@ -0,0 +1,217 @@
+#!/bin/bash
+
+# Usage: builtinFilters.bash [ -d FILTERS_DIR ] [ -a APP_H ] NAME ...
+#
+# Make the C source files that compile the filter modules NAME ... into a
+# library or program, so that qsStreamFilterLoad() finds them by name
+# without looking in the file system or calling dlopen().  NAME is the
+# name of the filter, like stdin or tests/sequenceGen.
+#
+# For each NAME this makes the file qsBuiltin_ID.c, where ID is NAME with
+# '/' replaced with '_', that compiles FILTERS_DIR/NAME.c with the filter
+# module functions given the linker names qsBuiltin_ID_input and so on,
+# so that they do not clash with the other built-in filters.  That's done
+# with "#pragma redefine_extname", which only changes the names that the
+# functions are linked with, not what the names mean in the C code.  And
+# it makes qsBuiltinTable.c that adds them all with qsBuiltinFiltersAdd()
+# (see app.h) before main() is called.  The files are made in the current
+# directory.
+#
+# A filter module source that has "#define QS_FILTER_INSTANCE_API" (see
+# filter.h) is added as an instance API filter.
+#
+# A built-in filter that does not use the instance API keeps its file
+# scope variables when it is unloaded, unlike a plugin DSO that is
+# dlclose()ed and loaded again.  So such a filter must set all of its
+# file scope variables in its construct() or start(), and not just
+# initialize them where they are declared.
+#
+# FILTERS_DIR is the directory with the filter module source files,
+# relative to the current directory.  The default FILTERS_DIR is
+# quickstream/plugins/filters, which is what we use in lib/.
+#
+# APP_H is the path to quickstream/app.h to #include in qsBuiltinTable.c.
+# The default APP_H is ../include/quickstream/app.h.
+
+set -eo pipefail
+
+filtersDir=quickstream/plugins/filters
+appH=../include/quickstream/app.h
+
+function usage() {
+    echo "Usage: $0 [ -d FILTERS_DIR ] [ -a APP_H ] NAME ..."
+    exit 1
+}
+
+while [ -n "$1" ] ; do
+    case "$1" in
+        -d)
+            [ -n "$2" ] || usage
+            filtersDir="$2"
+            shift 2
+            ;;
+        -a)
+            [ -n "$2" ] || usage
+            appH="$2"
+            shift 2
+            ;;
+        -*)
+            usage
+            ;;
+        *)
+            break
+            ;;
+    esac
+done
+
+[ -n "$1" ] || usage
+
+ids=()
+names=()
+instance=()
+
+for name in "$@" ; do
+    name="${name%.so}"
+    id="${name//\//_}"
+    if [[ ! "$id" =~ ^[A-Za-z_][A-Za-z0-9_]*$ ]] ; then
+        echo "$0: filter name \"$name\" does not make a C identifier"
+        exit 1
+    fi
+    if [ ! -f "$filtersDir/$name.c" ] ; then
+        echo "$0: filter module source \"$filtersDir/$name.c\" not found"
+        exit 1
+    fi
+
+    exec 3> qsBuiltin_$id.c
+
+    cat >&3 << EOF
+// This file was generated by $(basename $0)
+//
+// The filter module functions are linked with names like
+// qsBuiltin_${id}_input in place of input.
+
+EOF
+    for sym in help construct destroy start stop input\
+            qsFilterInstanceAPI ; do
+        echo "#pragma redefine_extname $sym qsBuiltin_${id}_$sym" >&3
+    done
+    cat >&3 << EOF
+
+#include "$filtersDir/$name.c"
+EOF
+    exec 3>&-
+
+    if grep -Eq '^[[:space:]]*#[[:space:]]*define[[:space:]]+QS_FILTER_INSTANCE_API([[:space:]]|$)'\
+            "$filtersDir/$name.c" ; then
+        instance+=(yes)
+    else
+        instance+=('')
+    fi
+    ids+=("$id")
+    names+=("$name")
+done
+
+
+exec 3> qsBuiltinTable.c.tmp
+
+cat >&3 << EOF
+// This file was generated by $(basename $0)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "$appH"
+
+// Filter modules may not have all these functions, so all but input() are
+// weak symbols, which are 0 if they are not there.
+
+EOF
+
+for i in "${!ids[@]}" ; do
+    p=qsBuiltin_${ids[$i]}
+    if [ -n "${instance[$i]}" ] ; then
+        cat >&3 << EOF
+extern const uint32_t ${p}_qsFilterInstanceAPI;
+extern void *${p}_construct(int argc, const char **argv)
+    __attribute__((weak));
+extern int ${p}_destroy(void *instance) __attribute__((weak));
+extern int ${p}_start(void *instance,
+        uint32_t numInPorts, uint32_t numOutPorts) __attribute__((weak));
+extern int ${p}_stop(void *instance,
+        uint32_t numInPorts, uint32_t numOutPorts) __attribute__((weak));
+extern int ${p}_input(void *instance,
+        void *inBuffers[], const size_t inLens[],
+        const bool isFlushing[], uint32_t numInPorts, uint32_t numOutPorts);
+extern void ${p}_help(FILE *file) __attribute__((weak));
+
+EOF
+    else
+        cat >&3 << EOF
+extern int ${p}_construct(int argc, const char **argv) __attribute__((weak));
+extern int ${p}_destroy(void) __attribute__((weak));
+extern int ${p}_start(uint32_t numInPorts, uint32_t numOutPorts)
+    __attribute__((weak));
+extern int ${p}_stop(uint32_t numInPorts, uint32_t numOutPorts)
+    __attribute__((weak));
+extern int ${p}_input(void *inBuffers[], const size_t inLens[],
+        const bool isFlushing[], uint32_t numInPorts, uint32_t numOutPorts);
+extern void ${p}_help(FILE *file) __attribute__((weak));
+
+EOF
+    fi
+done
+
+cat >&3 << EOF
+
+static const struct QsBuiltinFilter filters[] = {
+EOF
+
+for i in "${!ids[@]}" ; do
+    p=qsBuiltin_${ids[$i]}
+    if [ -n "${instance[$i]}" ] ; then
+        # The instance API functions are cast to the types in struct
+        # QsBuiltinFilter.  See app.h.
+        cat >&3 << EOF
+    {
+        "${names[$i]}",
+        &${p}_qsFilterInstanceAPI,
+        (int (*)(int, const char **)) ${p}_construct,
+        (int (*)(void)) ${p}_destroy,
+        (int (*)(uint32_t, uint32_t)) ${p}_start,
+        (int (*)(uint32_t, uint32_t)) ${p}_stop,
+        (int (*)(void *[], const size_t [], const bool [],
+                uint32_t, uint32_t)) ${p}_input,
+        ${p}_help
+    },
+EOF
+    else
+        cat >&3 << EOF
+    {
+        "${names[$i]}",
+        0,
+        ${p}_construct,
+        ${p}_destroy,
+        ${p}_start,
+        ${p}_stop,
+        ${p}_input,
+        ${p}_help
+    },
+EOF
+    fi
+done
+
+cat >&3 << EOF
+    { 0 }
+};
+
+
+static void __attribute__((constructor)) AddBuiltinFilters(void) {
+
+    qsBuiltinFiltersAdd(filters);
+}
+EOF
+
+exec 3>&-
+
+mv qsBuiltinTable.c.tmp qsBuiltinTable.c
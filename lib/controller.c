@@ -18,6 +18,7 @@
 #include "qs.h"
 #include "LoadDSOFromTmpFile.h"
 #include "controller.h"
+#include "controllerThread.h"
 
 
 // Used to pass the current controller that is being constructed or having
@@ -146,6 +147,10 @@ DictionaryDestroyController(struct QsController *c) {
     DASSERT(c->app);
     DASSERT(c->name);
     DASSERT(c->parameters);
+
+    // Call the events that are waiting and stop the controller thread,
+    // if there is one, before the controller goes away.
+    _qsControllerQueueClose(c);
  
     qsDictionaryDestroy(c->parameters);
 
@@ -611,10 +616,22 @@ int qsControllerUnload(struct QsController *c) {
                 c->mark == _QS_IN_POSTSTART ||
                 c->mark == _QS_IN_PRESTOP ||
                 c->mark == _QS_IN_POSTSTOP);
+
+        if(c->queue && c->mark != _QS_IN_CCONSTRUCT) {
+            // We are in the controller thread, and it cannot join
+            // itself.
+            ERROR("Controller \"%s\" runs in a thread and cannot"
+                    " unload itself", c->name);
+            return 1;
+        }
     }
 
     DASSERT(c->app);
 
+    // The queued post input callbacks use the callbacks that we remove
+    // next.
+    _qsControllerQueueWait(c);
+
     for(struct QsStream *s=c->app->streams; s; s = s->next)
         for(struct QsFilter *f=s->filters; f; f = f->next) {
             if(f->preInputCallbacks)
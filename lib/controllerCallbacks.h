@@ -1,9 +1,10 @@
 
-// Controllers may setup post filter input() callbacks.
+// Controllers may setup pre and post filter input() callbacks.
 // The filters keep a list of these:
 //
 struct ControllerCallback {
 
+    // From qsAddPostFilterInput(), or 0.
     int (*callback)(
             struct QsFilter *filter,
             const size_t lenIn[],
@@ -11,6 +12,13 @@ struct ControllerCallback {
             const bool isFlushing[],
             uint32_t numInputs, uint32_t numOutputs,
             void *userData);
+    // From qsAddPreFilterInput(), or 0.
+    int (*preCallback)(
+            struct QsFilter *filter,
+            const size_t lenIn[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData);
     void *userData;
 
     // This is used to mark that a non-zero value was returned from the
@@ -32,4 +40,12 @@ struct ControllerCallback {
     // We need the stink'n key in order to remove the callback.  It hurts
     // so much to have to add another 64 bit pointer.
     const char *key;
+
+    // The controller that added this callback.
+    struct QsController *controller;
+
+    // If the controller runs in a thread, the post input callback calls
+    // wait here for the controller thread.  See prePostInputCallbacks.c.
+    struct PostInputQueue *postQueue;
 };
+
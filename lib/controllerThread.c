@@ -0,0 +1,474 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// The public installed user interfaces:
+#include "../include/quickstream/app.h"
+#include "../include/quickstream/controller.h"
+
+// Private interfaces.
+#include "debug.h"
+#include "Dictionary.h"
+#include "qs.h"
+#include "controllerThread.h"
+
+
+// The number of threads in the app's shared controller pool if
+// qsAppSetControllerPoolThreads() is not called.
+#define DEFAULT_POOL_THREADS  ((uint32_t) 2)
+
+
+// One or more threads that call the events of the controller queues in
+// it.  A controller that has its own thread has a pool with one thread.
+struct QsControllerPool {
+
+    // This mutex protects the pool and all the queues in it.
+    pthread_mutex_t mutex;
+    // The pool threads wait on cond for a queue with events.
+    pthread_cond_t cond;
+    // Signaled after each event is called.
+    pthread_cond_t idle;
+
+    // List of queues that have events to call and are not being called
+    // by a pool thread.
+    struct QsEventQueue *first, *last;
+
+    bool quit;
+
+    uint32_t numThreads;
+    pthread_t *threads;
+};
+
+
+// The events for one controller.
+struct QsEventQueue {
+
+    struct QsControllerPool *pool;
+    // Set if the pool is just for this queue.
+    bool ownPool;
+
+    // 0 after the queue is closed.
+    struct QsController *controller;
+
+    // The events waiting to be called.
+    struct QsControllerEvent *first, *last;
+
+    // For the pool list of queues.
+    struct QsEventQueue *next;
+
+    // Set if the queue is in the pool list or a pool thread is calling
+    // one of its events, so at most one thread calls the events of a
+    // controller.
+    bool scheduled;
+    bool closed;
+
+    // The event being called and the thread calling it.
+    struct QsControllerEvent *running;
+    pthread_t runner;
+
+    // The controller and the parameter get callbacks that deliver to this
+    // queue have references.
+    atomic_uint refs;
+};
+
+
+// The number of open queues, so that _qsControllerQueueCurrent() does
+// not need to look at the thread specific data when there are none.
+static atomic_uint numQueues = 0;
+
+
+
+// Add q to the pool list of queues.  The pool mutex must be locked.
+static inline
+void ScheduleQueue(struct QsControllerPool *pool, struct QsEventQueue *q) {
+
+    q->next = 0;
+    if(pool->last)
+        pool->last->next = q;
+    else
+        pool->first = q;
+    pool->last = q;
+
+    CHECK(pthread_cond_signal(&pool->cond));
+}
+
+
+static void *PoolThread(struct QsControllerPool *pool) {
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+
+    while(true) {
+
+        struct QsEventQueue *q = pool->first;
+
+        if(!q) {
+            if(pool->quit)
+                break;
+            CHECK(pthread_cond_wait(&pool->cond, &pool->mutex));
+            continue;
+        }
+
+        pool->first = q->next;
+        if(!pool->first)
+            pool->last = 0;
+
+        struct QsControllerEvent *e = q->first;
+        if(!e) {
+            // The events were canceled.
+            q->scheduled = false;
+            CHECK(pthread_cond_broadcast(&pool->idle));
+            continue;
+        }
+        q->first = e->next;
+        if(!q->first)
+            q->last = 0;
+        q->running = e;
+        q->runner = pthread_self();
+
+        CHECK(pthread_mutex_unlock(&pool->mutex));
+
+        // So the controller API knows what controller this is.
+        CHECK(pthread_setspecific(_qsControllerKey, q->controller));
+
+        e->run(e);
+
+        CHECK(pthread_setspecific(_qsControllerKey, 0));
+
+        CHECK(pthread_mutex_lock(&pool->mutex));
+
+        q->running = 0;
+        if(q->first)
+            // Go to the back of the line, so the other controllers in the
+            // pool get a turn.
+            ScheduleQueue(pool, q);
+        else
+            q->scheduled = false;
+
+        CHECK(pthread_cond_broadcast(&pool->idle));
+    }
+
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+
+    return 0;
+}
+
+
+static struct QsControllerPool *CreatePool(uint32_t numThreads) {
+
+    DASSERT(numThreads);
+
+    struct QsControllerPool *pool = calloc(1, sizeof(*pool));
+    ASSERT(pool, "calloc(1,%zu) failed", sizeof(*pool));
+    pool->threads = calloc(numThreads, sizeof(*pool->threads));
+    ASSERT(pool->threads, "calloc(%" PRIu32 ",%zu) failed",
+            numThreads, sizeof(*pool->threads));
+
+    CHECK(pthread_mutex_init(&pool->mutex, 0));
+    CHECK(pthread_cond_init(&pool->cond, 0));
+    CHECK(pthread_cond_init(&pool->idle, 0));
+
+    for(pool->numThreads = 0; pool->numThreads < numThreads;
+            ++pool->numThreads)
+        CHECK(pthread_create(pool->threads + pool->numThreads, 0,
+                    (void *(*)(void *)) PoolThread, pool));
+
+    DSPEW("Started %" PRIu32 " controller thread(s)", numThreads);
+
+    return pool;
+}
+
+
+// Join the pool threads.  The pool memory stays so queues that are still
+// referenced can lock the pool mutex.
+static void StopPool(struct QsControllerPool *pool) {
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+    pool->quit = true;
+    CHECK(pthread_cond_broadcast(&pool->cond));
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+
+    for(uint32_t i=0; i<pool->numThreads; ++i)
+        CHECK(pthread_join(pool->threads[i], 0));
+    pool->numThreads = 0;
+}
+
+
+static void FreePool(struct QsControllerPool *pool) {
+
+    DASSERT(pool->numThreads == 0);
+
+    CHECK(pthread_mutex_destroy(&pool->mutex));
+    CHECK(pthread_cond_destroy(&pool->cond));
+    CHECK(pthread_cond_destroy(&pool->idle));
+    free(pool->threads);
+#ifdef DEBUG
+    memset(pool, 0, sizeof(*pool));
+#endif
+    free(pool);
+}
+
+
+int _qsControllerQueueCreate(struct QsController *c, bool shared) {
+
+    DASSERT(c);
+    DASSERT(c->app);
+    DASSERT(!c->queue);
+
+    struct QsEventQueue *q = calloc(1, sizeof(*q));
+    ASSERT(q, "calloc(1,%zu) failed", sizeof(*q));
+
+    if(shared) {
+        if(!c->app->controllerPool)
+            c->app->controllerPool = CreatePool(
+                    c->app->numControllerPoolThreads?
+                    c->app->numControllerPoolThreads:
+                    DEFAULT_POOL_THREADS);
+        q->pool = c->app->controllerPool;
+    } else {
+        q->pool = CreatePool(1);
+        q->ownPool = true;
+    }
+
+    q->controller = c;
+    atomic_init(&q->refs, 1);
+    c->queue = q;
+    atomic_fetch_add(&numQueues, 1);
+
+    return 0; // success
+}
+
+
+void _qsControllerQueueRef(struct QsEventQueue *q) {
+
+    DASSERT(q);
+    atomic_fetch_add(&q->refs, 1);
+}
+
+
+void _qsControllerQueueUnref(struct QsEventQueue *q) {
+
+    DASSERT(q);
+
+    if(atomic_fetch_sub(&q->refs, 1) != 1)
+        return;
+
+    DASSERT(q->closed);
+    if(q->ownPool)
+        FreePool(q->pool);
+#ifdef DEBUG
+    memset(q, 0, sizeof(*q));
+#endif
+    free(q);
+}
+
+
+void _qsControllerQueueClose(struct QsController *c) {
+
+    struct QsEventQueue *q = c->queue;
+    if(!q) return;
+
+    struct QsControllerPool *pool = q->pool;
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+    // A controller thread cannot close its own queue.
+    DASSERT(!q->running || !pthread_equal(q->runner, pthread_self()));
+    while(q->scheduled)
+        CHECK(pthread_cond_wait(&pool->idle, &pool->mutex));
+    q->closed = true;
+    q->controller = 0;
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+
+    if(q->ownPool)
+        StopPool(pool);
+
+    atomic_fetch_sub(&numQueues, 1);
+    c->queue = 0;
+    _qsControllerQueueUnref(q);
+}
+
+
+struct QsEventQueue *_qsControllerQueueCurrent(void) {
+
+    if(!atomic_load(&numQueues))
+        return 0;
+
+    struct QsController *c = pthread_getspecific(_qsControllerKey);
+    if(!c || !c->queue)
+        return 0;
+
+    atomic_fetch_add(&c->queue->refs, 1);
+    return c->queue;
+}
+
+
+bool _qsControllerQueueEvent(struct QsEventQueue *q,
+        struct QsControllerEvent *e) {
+
+    DASSERT(q);
+    DASSERT(e);
+    DASSERT(e->run);
+
+    struct QsControllerPool *pool = q->pool;
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+
+    if(q->closed) {
+        CHECK(pthread_mutex_unlock(&pool->mutex));
+        return false;
+    }
+
+    e->next = 0;
+    if(q->last)
+        q->last->next = e;
+    else
+        q->first = e;
+    q->last = e;
+
+    if(!q->scheduled) {
+        q->scheduled = true;
+        ScheduleQueue(pool, q);
+    }
+
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+
+    return true;
+}
+
+
+void _qsControllerQueueCancel(struct QsEventQueue *q,
+        struct QsControllerEvent *e) {
+
+    DASSERT(q);
+    DASSERT(e);
+
+    struct QsControllerPool *pool = q->pool;
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+
+    struct QsControllerEvent *prev = 0;
+    for(struct QsControllerEvent *i = q->first; i; i = i->next) {
+        if(i == e) {
+            if(prev)
+                prev->next = e->next;
+            else
+                q->first = e->next;
+            if(q->last == e)
+                q->last = prev;
+            break;
+        }
+        prev = i;
+    }
+
+    while(q->running == e && !pthread_equal(q->runner, pthread_self()))
+        CHECK(pthread_cond_wait(&pool->idle, &pool->mutex));
+
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+}
+
+
+void _qsControllerQueueWait(struct QsController *c) {
+
+    struct QsEventQueue *q = c->queue;
+    if(!q) return;
+
+    struct QsControllerPool *pool = q->pool;
+
+    CHECK(pthread_mutex_lock(&pool->mutex));
+    DASSERT(!q->running || !pthread_equal(q->runner, pthread_self()));
+    while(q->scheduled)
+        CHECK(pthread_cond_wait(&pool->idle, &pool->mutex));
+    CHECK(pthread_mutex_unlock(&pool->mutex));
+}
+
+
+struct RunEvent {
+
+    struct QsControllerEvent event; // first in struct
+
+    void (*func)(void *arg);
+    void *arg;
+    // Set in the controller thread after func() returns.
+    atomic_bool done;
+};
+
+
+static void RunFunc(struct RunEvent *r) {
+
+    r->func(r->arg);
+    atomic_store(&r->done, true);
+}
+
+
+void _qsControllerRun(struct QsController *c,
+        void (*func)(void *arg), void *arg) {
+
+    struct QsEventQueue *q = c->queue;
+
+    if(!q) {
+        func(arg);
+        return;
+    }
+
+    struct RunEvent r;
+    r.event.run = (void (*)(struct QsControllerEvent *)) RunFunc;
+    r.func = func;
+    r.arg = arg;
+    atomic_init(&r.done, false);
+
+    ASSERT(_qsControllerQueueEvent(q, &r.event));
+
+    CHECK(pthread_mutex_lock(&q->pool->mutex));
+    while(!atomic_load(&r.done))
+        CHECK(pthread_cond_wait(&q->pool->idle, &q->pool->mutex));
+    CHECK(pthread_mutex_unlock(&q->pool->mutex));
+}
+
+
+void _qsControllerPoolDestroy(struct QsApp *app) {
+
+    if(!app->controllerPool) return;
+
+    StopPool(app->controllerPool);
+    FreePool(app->controllerPool);
+    app->controllerPool = 0;
+}
+
+
+int qsControllerRunInThread(uint32_t flags) {
+
+    struct QsController *c = pthread_getspecific(_qsControllerKey);
+    ASSERT(c, "Not called from a controller");
+
+    if(c->mark != _QS_IN_CCONSTRUCT) {
+        ERROR("Controller \"%s\" must call qsControllerRunInThread()"
+                " in construct()", c->name);
+        return -1; // error
+    }
+
+    if(c->queue) {
+        WARN("Controller \"%s\" runs in a thread already", c->name);
+        return 1;
+    }
+
+    INFO("Controller \"%s\" will run in %s", c->name,
+            (flags & QS_CONTROLLER_SHARED)?
+            "the shared controller threads":"its own thread");
+
+    return _qsControllerQueueCreate(c, flags & QS_CONTROLLER_SHARED);
+}
+
+
+int qsAppSetControllerPoolThreads(struct QsApp *app, uint32_t num) {
+
+    DASSERT(app);
+
+    if(app->controllerPool) {
+        ERROR("The controller thread pool is running already");
+        return -1; // error
+    }
+
+    app->numControllerPoolThreads = num;
+    return 0; // success
+}
@@ -0,0 +1,81 @@
+// Controllers may run in their own thread, or in a pool of threads that
+// they share with other controllers, by calling qsControllerRunInThread()
+// in their construct().  Work for the controller, like post filter input
+// callbacks and parameter get callbacks, is then queued as events, in the
+// order they happen, and the controller thread calls them.  The events of
+// a controller are called one at a time, so the controller code does not
+// need to be thread-safe, even in a shared pool.
+//
+// The code is in controllerThread.c.
+
+
+struct QsApp;
+struct QsController;
+struct QsEventQueue;
+
+
+// An event is usually the first thing in a bigger struct that has the
+// data run() needs.
+struct QsControllerEvent {
+
+    // For the queue list.  Requires the pool mutex lock.
+    struct QsControllerEvent *next;
+
+    // Called in the controller thread with the controller thread specific
+    // data set.  run() may free the event.  The queue code does not
+    // touch the event after calling run().
+    void (*run)(struct QsControllerEvent *e);
+};
+
+
+// Make a queue for the controller in c->queue.  The queue has its own
+// thread, or if shared is set it uses the app's controller thread pool.
+// Returns 0 on success.
+extern
+int _qsControllerQueueCreate(struct QsController *c, bool shared);
+
+// Waits for the queued events to be called and then stops the queue from
+// taking more events.  The controller's own thread is joined, but the
+// queue memory is kept until the last reference to it is gone.  Called
+// when the controller is destroyed.
+extern
+void _qsControllerQueueClose(struct QsController *c);
+
+// The queue of the controller that the calling thread is working for, with
+// a reference added for the caller, or 0 if there is none.
+extern
+struct QsEventQueue *_qsControllerQueueCurrent(void);
+
+extern
+void _qsControllerQueueRef(struct QsEventQueue *q);
+
+extern
+void _qsControllerQueueUnref(struct QsEventQueue *q);
+
+// Add an event to the end of the queue.  Does not block for long.
+// Returns false if the queue is closed.
+extern
+bool _qsControllerQueueEvent(struct QsEventQueue *q,
+        struct QsControllerEvent *e);
+
+// Remove the event from the queue if it is queued, and wait for it if it
+// is being called by another thread.
+extern
+void _qsControllerQueueCancel(struct QsEventQueue *q,
+        struct QsControllerEvent *e);
+
+// Wait until all the events that are queued for controller c are called.
+// Does nothing for a controller that does not run in a thread.
+extern
+void _qsControllerQueueWait(struct QsController *c);
+
+// Call func(arg) in the controller's thread and wait for it to return,
+// or just call it if the controller does not run in a thread.
+extern
+void _qsControllerRun(struct QsController *c,
+        void (*func)(void *arg), void *arg);
+
+// Join the app's shared controller pool threads and free the pool.  Called
+// after all the controllers are destroyed.
+extern
+void _qsControllerPoolDestroy(struct QsApp *app);
@@ -0,0 +1,214 @@
+#ifndef _GNU_SOURCE
+// for pipe2()
+#  define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+
+#include "debug.h"
+#include "qs.h"
+
+
+// The fd thread.
+//
+// Filters that call qsWaitFd() in input() are not called again until the
+// file descriptor they passed is ready.  In place of a worker thread
+// blocking in a read(2) or write(2) call in the filter input(), the
+// worker thread goes on to run other filters, and this one thread waits
+// on all the file descriptors with epoll_wait(2).  When a file
+// descriptor is ready we queue a job for the filter that is waiting on
+// it.
+//
+// There is at most one fd thread per stream, and it's only started if a
+// filter calls qsWaitFd() in the stream run.
+
+
+// The most events we get from one epoll_wait() call.
+#define MAX_EVENTS  (16)
+
+// How long we wait in epoll_wait() before we check if the stream stopped
+// sourcing.  qsStreamStopSources() may be called from a signal handler,
+// so it can't tell us directly.
+#define TIMEOUT_MS  (100)
+
+
+
+// Stop filter f from waiting and queue a job for it if it can have one.
+//
+// We need a stream mutex lock to call this.
+static inline
+void Release(struct QsStream *s, struct QsFilter *f, bool isReady) {
+
+    DASSERT(f->waitEvents);
+    DASSERT(s->numFdWaiting);
+
+    if(epoll_ctl(s->epollFd, EPOLL_CTL_DEL, f->waitFd, 0))
+        // The filter may have closed the file descriptor, which removes
+        // it from the epoll set, so this is not an error.
+        DSPEW("epoll_ctl(,EPOLL_CTL_DEL, fd=%d,) failed for filter \"%s\"",
+                f->waitFd, f->name);
+
+    f->waitEvents = 0;
+    --s->numFdWaiting;
+
+    // If the file descriptor is not ready the stream stopped sourcing,
+    // and the filter will only be called if there's input for it.
+    f->inputAgain = isReady;
+
+    QueueFilterJob(s, f);
+}
+
+
+static
+void *FdThread(struct QsStream *s) {
+
+    DSPEW("Starting fd thread");
+
+    struct epoll_event events[MAX_EVENTS];
+    bool running = true;
+
+    while(running) {
+
+        int n = epoll_wait(s->epollFd, events, MAX_EVENTS, TIMEOUT_MS);
+
+        if(n < 0) {
+            ASSERT(errno == EINTR, "epoll_wait() failed");
+            continue;
+        }
+
+        // STREAM LOCK
+        CHECK(pthread_mutex_lock(&s->mutex));
+
+        for(int i=0; i<n; ++i) {
+            struct QsFilter *f = events[i].data.ptr;
+            if(!f)
+                // FdWaitJoin() wrote to the pipe.  We finish this pass
+                // and then return.
+                running = false;
+            else if(f->waitEvents)
+                Release(s, f, true);
+        }
+
+        if(s->isSourcing <= 0 && s->numFdWaiting)
+            // The stream is not sourcing any more, so we do not make
+            // filters wait for file descriptors that may never be ready.
+            for(struct QsFilter *f = s->filters; f; f = f->next)
+                if(f->waitEvents)
+                    Release(s, f, false);
+
+        if(s->numFdWaiting == 0 && s->numThreads &&
+                s->numIdleThreads == s->numThreads)
+            // All the worker threads are idle and they may have been
+            // waiting just for the filters we released; so wake them up
+            // so they can get jobs or return.  See GetWork() in flow.c.
+            CHECK(pthread_cond_broadcast(&s->cond));
+
+        // STREAM UNLOCK
+        CHECK(pthread_mutex_unlock(&s->mutex));
+    }
+
+    DSPEW("fd thread returning");
+
+    return 0;
+}
+
+
+// We need a stream mutex lock to call this.
+static
+bool StartFdThread(struct QsStream *s) {
+
+    DASSERT(!s->haveFdThread);
+
+    s->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(s->epollFd < 0) {
+        ERROR("epoll_create1() failed");
+        return false; // fail
+    }
+
+    if(pipe2(s->fdPipe, O_CLOEXEC)) {
+        ERROR("pipe2() failed");
+        close(s->epollFd);
+        return false; // fail
+    }
+
+    // data.ptr = 0 marks the pipe.
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = 0 };
+    CHECK(epoll_ctl(s->epollFd, EPOLL_CTL_ADD, s->fdPipe[0], &ev));
+
+    CHECK(pthread_create(&s->fdThread, 0/*attr*/,
+            (void *(*) (void *)) FdThread, s));
+    s->haveFdThread = true;
+
+    return true; // success
+}
+
+
+bool FdWaitAdd(struct QsStream *s, struct QsFilter *f, int fd,
+        uint32_t events) {
+
+    DASSERT(events == EPOLLIN || events == EPOLLOUT);
+    DASSERT(f->waitEvents == 0);
+
+    if(!s->haveFdThread && !StartFdThread(s))
+        return false; // fail
+
+    struct epoll_event ev = {
+        .events = events | EPOLLONESHOT,
+        .data.ptr = f
+    };
+
+    if(epoll_ctl(s->epollFd, EPOLL_CTL_ADD, fd, &ev)) {
+        // EPERM is from regular files and directories, which are always
+        // ready anyway.
+        if(errno != EPERM)
+            WARN("filter \"%s\" cannot wait on fd=%d", f->name, fd);
+        return false; // fail
+    }
+
+    f->waitFd = fd;
+    f->waitEvents = events;
+    ++s->numFdWaiting;
+
+    return true; // success
+}
+
+
+void FdWaitJoin(struct QsStream *s) {
+
+    DASSERT(_qsMainThread == pthread_self(), "Not main thread");
+
+    // STREAM LOCK
+    CHECK(pthread_mutex_lock(&s->mutex));
+    bool haveFdThread = s->haveFdThread;
+    // STREAM UNLOCK
+    CHECK(pthread_mutex_unlock(&s->mutex));
+
+    if(haveFdThread) {
+
+        // Tell the fd thread to return.
+        char c = 0;
+        ASSERT(write(s->fdPipe[1], &c, 1) == 1, "write() to pipe failed");
+        CHECK(pthread_join(s->fdThread, 0));
+
+        close(s->fdPipe[0]);
+        close(s->fdPipe[1]);
+        close(s->epollFd);
+        s->haveFdThread = false;
+    }
+
+    // Reset the filters for the next stream run.
+    for(struct QsFilter *f = s->filters; f; f = f->next) {
+        f->waitEvents = 0;
+        f->inputAgain = false;
+    }
+    s->numFdWaiting = 0;
+}
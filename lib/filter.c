@@ -18,6 +18,7 @@
 #include "debug.h"
 #include "Dictionary.h"
 #include "qs.h"
+#include "parameter.h"
 #include "filterList.h"
 #include "filterAPI.h"
 #include "LoadDSOFromTmpFile.h"
@@ -27,6 +28,17 @@ int qsFilterPrintHelp(const char *filterName, FILE *f) {
 
     if(f == 0) f = stderr;
 
+    struct QsBuiltin *b = FindBuiltinFilter(filterName);
+    if(b) {
+        if(!b->filter->help) {
+            ERROR("Built-in filter \"%s\" has no help()", b->filter->name);
+            return 1; // error
+        }
+        fprintf(f, "\nfilter built-in=%s\n\n", b->filter->name);
+        b->filter->help(f);
+        return 0; // success
+    }
+
     char *path = GetPluginPath(MOD_PREFIX, "filters/", filterName, ".so");
 
     void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
@@ -58,6 +70,147 @@ int qsFilterPrintHelp(const char *filterName, FILE *f) {
 }
 
 
+// Finish setting up a newly loaded filter, and call its construct() if
+// it has one.  Returns f, or QS_UNLOADED or 0 if construct() did not
+// succeed and the filter is unloaded.
+//
+// construct() is void *(*)(int argc, const char **argv) for the instance
+// API.
+//
+static struct QsFilter *Construct(struct QsStream *s, struct QsFilter *f,
+        int (* construct)(int argc, const char **argv), bool isInstance,
+        int argc, const char **argv) {
+
+    f->app = s->app;
+    f->stream = s;
+    f->maxThreads = 1;
+
+    // Create a parameters dictionary:
+    f->parameters = qsDictionaryCreate();
+    ASSERT(f->parameters);
+
+    // For qsParameterSetAt()
+    CHECK(pthread_mutex_init(&f->scheduleMutex, 0));
+
+    DASSERT(f->stream->dict);
+
+    ASSERT(0 == qsDictionaryInsert(f->stream->dict, f->name, f, 0));
+
+
+    if(construct) {
+
+        struct QsFilter *oldFilter = pthread_getspecific(_qsKey);
+        // Check if the user is using more than one QsApp in a single
+        // thread and calling qsApp or qsStream functions from within
+        // other qsApp or qsStream functions.
+        //
+        // You may be able to create more than one QsApp but:
+        //
+        ASSERT(!oldFilter || f->app == oldFilter->app,
+                "You cannot mix QsApp objects in "
+                "other QsApp function calls");
+
+        DASSERT(f->mark == 0);
+
+        CHECK(pthread_setspecific(_qsKey, f));
+
+        // This code is only run in one thread, so this is not necessarily
+        // required to be thread safe, but it is and MUST BE re-entrant.
+        // There's a big difference between re-entrant and thread safe.
+        //
+        // A filter cannot load itself.
+        DASSERT(oldFilter != f);
+        // We use this otherwise 0 flag as a marker that we are in the
+        // construct() phase.
+        f->mark = _QS_IN_CONSTRUCT;
+
+        // In this construct() call this function, qsStreamFilterLoad(),
+        // may be called, so this function must be re-entrant.
+
+        // When this construct() is called this filter struct is "all
+        // setup" and in the stream object.  Therefore if this filter module
+        // is a super-module that loads other filters and adds
+        // connections, it will work.
+        int ret;
+
+        if(isInstance) {
+            f->instance = ((void *(*)(int, const char **)) construct)(
+                    argc, argv);
+            ret = f->instance?0:-1;
+        } else
+            ret = construct(argc, argv);
+
+        // Filter f is not in construct() phase anymore.
+        f->mark = 0;
+
+        // This will set the thread specific data to 0 for the case when
+        // it was 0 before this.
+        CHECK(pthread_setspecific(_qsKey, oldFilter));
+
+        if(ret) {
+            if(ret > 0)
+                NOTICE("filter \"%s\" construct() returned > 0", f->name);
+            else
+                ERROR("filter \"%s\" construct() failed", f->name);
+            qsFilterUnload(f);
+            return (ret>0)?QS_UNLOADED/*not error*/:0/*error*/;
+        }
+        //else Success.
+    }
+
+
+    return f; // success
+}
+
+
+// Load a filter that is compiled into the program.
+//
+static struct QsFilter *LoadBuiltinFilter(struct QsStream *s,
+        struct QsBuiltin *b, const char *loadName,
+        int argc, const char **argv) {
+
+    const struct QsBuiltinFilter *bf = b->filter;
+    bool isInstance = bf->instanceAPI?true:false;
+
+    if(!bf->help) {
+#ifdef QS_FILTER_REQUIRE_HELP
+        ERROR("Built-in filter \"%s\" does not provide a help() function",
+                bf->name);
+        return 0;
+#else
+        WARN("Built-in filter \"%s\" does not provide a help() function",
+                bf->name);
+#endif
+    }
+
+    struct QsFilter *f = AllocAndAddToFilterList(s, loadName);
+
+    f->builtin = b;
+    ++b->useCount;
+
+    if(isInstance) {
+        f->iStart = (int (*)(void *, uint32_t, uint32_t)) bf->start;
+        f->iStop = (int (*)(void *, uint32_t, uint32_t)) bf->stop;
+        f->iInput = (int (*)(void *, void *[], const size_t [],
+                    const bool [], uint32_t, uint32_t)) bf->input;
+    } else {
+        f->start = bf->start;
+        f->stop = bf->stop;
+        f->input = bf->input;
+    }
+
+    struct QsFilter *ret = Construct(s, f, bf->construct, isInstance,
+            argc, argv);
+
+    if(ret == f)
+        INFO("Successfully loaded built-in Filter %s with name \"%s\"",
+                bf->name, f->name);
+
+    return ret;
+}
+
+
+
 struct QsFilter *qsStreamFilterLoad(struct QsStream *s,
         const char *fileName, const char *_loadName,
         int argc, const char **argv) {
@@ -124,6 +277,22 @@ struct QsFilter *qsStreamFilterLoad(struct QsStream *s,
         return 0;
     }
 
+    // Filters that are compiled into the program are found without
+    // looking in the file system.
+    struct QsBuiltin *builtin = FindBuiltinFilter(fileName);
+
+    if(builtin && !builtin->filter->instanceAPI && builtin->useCount) {
+        // This built-in filter keeps its state in file scope variables
+        // which are in use by the filter that loaded it already, so we
+        // look for a plugin DSO file to load in its place.
+        INFO("Built-in filter \"%s\" is in use; looking for a plugin file",
+                builtin->filter->name);
+        builtin = 0;
+    }
+
+    if(builtin)
+        return LoadBuiltinFilter(s, builtin, loadName, argc, argv);
+
     // fileName may or may not have a suffix already.
     //
     char *path = GetPluginPath(MOD_PREFIX, "filters/", fileName, ".so");
@@ -136,7 +305,12 @@ struct QsFilter *qsStreamFilterLoad(struct QsStream *s,
         return 0;
     }
 
-    if(FindFilter_viaHandle(s, handle)) {
+    // Modules that use the instance API keep their state in the
+    // instance that construct() returns and not in the DSO, so they can
+    // share one loaded DSO.
+    bool isInstance = dlsym(handle, "qsFilterInstanceAPI")?true:false;
+
+    if(!isInstance && FindFilter_viaHandle(s, handle)) {
         //
         // This DSO (dynamic shared object) file is already loaded.  So we
         // must copy the DSO file to a temp file and load that.  Otherwise
@@ -162,15 +336,29 @@ struct QsFilter *qsStreamFilterLoad(struct QsStream *s,
 
     // If "construct", "destroy", "start", or "stop"
     // are not present, that's okay, they are optional.
+    //
+    // construct() is void *(*)(int argc, const char **argv) for the
+    // instance API.
     int (* construct)(int argc, const char **argv) =
         dlsym(handle, "construct");
-    f->start = dlsym(handle, "start");
-    f->stop = dlsym(handle, "stop");
 
     dlerror(); // clear error
-    // "input()" is not optional.
-    f->input = dlsym(handle, "input");
-    char *err = dlerror();
+    char *err;
+
+    if(isInstance) {
+        f->iStart = dlsym(handle, "start");
+        f->iStop = dlsym(handle, "stop");
+        // "input()" is not optional.
+        f->iInput = dlsym(handle, "input");
+        err = dlerror();
+    } else {
+        f->start = dlsym(handle, "start");
+        f->stop = dlsym(handle, "stop");
+        // "input()" is not optional.
+        f->input = dlsym(handle, "input");
+        err = dlerror();
+    }
+
     if(err) {
         // We must have a input() function.
         ERROR("no input() provided: dlsym(\"input\") error: %s", err);
@@ -196,81 +384,17 @@ struct QsFilter *qsStreamFilterLoad(struct QsStream *s,
     }
 
 
-    f->app = s->app;
-    f->stream = s;
-    f->maxThreads = 1;
     f->dlhandle = handle;
 
-    // Create a parameters dictionary:
-    f->parameters = qsDictionaryCreate();
-    ASSERT(f->parameters);
-
-    DASSERT(f->stream->dict);
-
-    ASSERT(0 == qsDictionaryInsert(f->stream->dict, f->name, f, 0));
-
-
-    if(construct) {
-
-        struct QsFilter *oldFilter = pthread_getspecific(_qsKey);
-        // Check if the user is using more than one QsApp in a single
-        // thread and calling qsApp or qsStream functions from within
-        // other qsApp or qsStream functions.
-        //
-        // You may be able to create more than one QsApp but:
-        //
-        ASSERT(!oldFilter || f->app == oldFilter->app,
-                "You cannot mix QsApp objects in "
-                "other QsApp function calls");
-
-        DASSERT(f->mark == 0);
-
-        CHECK(pthread_setspecific(_qsKey, f));
-
-        // This code is only run in one thread, so this is not necessarily
-        // required to be thread safe, but it is and MUST BE re-entrant.
-        // There's a big difference between re-entrant and thread safe.
-        //
-        // A filter cannot load itself.
-        DASSERT(oldFilter != f);
-        // We use this otherwise 0 flag as a marker that we are in the
-        // construct() phase.
-        f->mark = _QS_IN_CONSTRUCT;
-
-        // In this construct() call this function, qsStreamFilterLoad(),
-        // may be called, so this function must be re-entrant.
-
-        // When this construct() is called this filter struct is "all
-        // setup" and in the stream object.  Therefore if this filter module
-        // is a super-module that loads other filters and adds
-        // connections, it will work.
-        int ret = construct(argc, argv);
+    struct QsFilter *ret = Construct(s, f, construct, isInstance,
+            argc, argv);
 
-        // Filter f is not in construct() phase anymore.
-        f->mark = 0;
-
-        // This will set the thread specific data to 0 for the case when
-        // it was 0 before this.
-        CHECK(pthread_setspecific(_qsKey, oldFilter));
-
-        if(ret) {
-            free(path);
-            if(ret > 0)
-                NOTICE("filter \"%s\" construct() returned > 0", f->name);
-            else
-                ERROR("filter \"%s\" construct() failed", f->name);
-            qsFilterUnload(f);
-            return (ret>0)?QS_UNLOADED/*not error*/:0/*error*/;
-        }
-        //else Success.
-    }
-
-
-    INFO("Successfully loaded module Filter %s with name \"%s\"",
-            path, f->name);
+    if(ret == f)
+        INFO("Successfully loaded module Filter %s with name \"%s\"",
+                path, f->name);
     free(path);
 
-    return f; // success
+    return ret;
 
 cleanup:
 
@@ -7,6 +7,7 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <sys/epoll.h>
 
 #include "./debug.h"
 #include "./qs.h"
@@ -132,6 +133,27 @@ void qsAdvanceInput(uint32_t inputPortNum, size_t len) {
 }
 
 
+void qsWaitFd(int fd, bool forWriting) {
+
+    struct QsJob *j = GetJob();
+
+    // This would be a user error.
+    ASSERT(fd >= 0, "Filter \"%s\" bad file descriptor %d",
+            j->filter->name, fd);
+
+    // The stream looks at this after input() returns.  See RunInput() in
+    // flow.c.
+    j->waitFd = fd;
+    j->waitEvents = forWriting?EPOLLOUT:EPOLLIN;
+}
+
+
+void qsInputAgain(void) {
+
+    GetJob()->inputAgain = true;
+}
+
+
 void qsSetInputThreshold(uint32_t inputPortNum, size_t len) {
 
     // We only call this in the main thread in start().
@@ -43,59 +43,73 @@ void FreeFilter(struct QsFilter *f) {
     DASSERT(f->stream);
 
 
-    if(f->dlhandle) {
-        int (* destroy)(void) = dlsym(f->dlhandle, "destroy");
-        if(destroy) {
-
-            struct QsFilter *oldFilter = pthread_getspecific(_qsKey);
-            // Check if the user is using more than one QsApp in a single
-            // thread and calling qsApp or qsStream functions from within
-            // other qsApp or qsStream functions.
-            //
-            // You may be able to create more than one QsApp but:
-            //
-            ASSERT(!oldFilter || oldFilter->app == f->app,
-                    "You cannot mix QsApp objects in "
-                    "other QsApp function calls");
+    // destroy() is int (*)(void *instance) for the instance API.
+    int (* destroy)(void) = 0;
+    if(f->dlhandle)
+        destroy = dlsym(f->dlhandle, "destroy");
+    else if(f->builtin)
+        destroy = f->builtin->filter->destroy;
+
+    if(destroy) {
+
+        struct QsFilter *oldFilter = pthread_getspecific(_qsKey);
+        // Check if the user is using more than one QsApp in a single
+        // thread and calling qsApp or qsStream functions from within
+        // other qsApp or qsStream functions.
+        //
+        // You may be able to create more than one QsApp but:
+        //
+        ASSERT(!oldFilter || oldFilter->app == f->app,
+                "You cannot mix QsApp objects in "
+                "other QsApp function calls");
 
-            DASSERT(f->mark == 0);
+        DASSERT(f->mark == 0);
 
-            CHECK(pthread_setspecific(_qsKey, f));
+        CHECK(pthread_setspecific(_qsKey, f));
 
-            // This FreeFilter() function must be re-entrant.  It may be
-            // called from a qsFilterUnload() call in a filter->destroy()
-            // call; for filters that are super-modules.  Super-modules
-            // are filters that can load and unload other filters.
-            //
-            // However, filters cannot unload themselves.
-            //
-            // A filter cannot unload itself.
-            DASSERT(oldFilter != f);
-            // Use the mark variable at a state marker.
-            f->mark = _QS_IN_DESTROY;
+        // This FreeFilter() function must be re-entrant.  It may be
+        // called from a qsFilterUnload() call in a filter->destroy()
+        // call; for filters that are super-modules.  Super-modules
+        // are filters that can load and unload other filters.
+        //
+        // However, filters cannot unload themselves.
+        //
+        // A filter cannot unload itself.
+        DASSERT(oldFilter != f);
+        // Use the mark variable at a state marker.
+        f->mark = _QS_IN_DESTROY;
 
-            int ret = destroy();
+        int ret;
+        if(f->iInput)
+            ret = ((int (*)(void *)) destroy)(f->instance);
+        else
+            ret = destroy();
 
-            // Filter f is not in destroy() phase anymore.
-            f->mark = 0;
+        // Filter f is not in destroy() phase anymore.
+        f->mark = 0;
 
-            CHECK(pthread_setspecific(_qsKey, oldFilter));
+        CHECK(pthread_setspecific(_qsKey, oldFilter));
 
 
-            if(ret) {
-                // TODO: what do we use this return value for??
-                //
-                // Maybe just to print this warning.
-                WARN("filter \"%s\" destroy() returned %d", f->name, ret);
-            }
+        if(ret) {
+            // TODO: what do we use this return value for??
+            //
+            // Maybe just to print this warning.
+            WARN("filter \"%s\" destroy() returned %d", f->name, ret);
         }
+    }
 
+    if(f->dlhandle) {
         dlerror(); // clear error
         if(dlclose(f->dlhandle))
             WARN("dlclose(%p): %s", f->dlhandle, dlerror());
             // TODO: So what can I do.
+    } else if(f->builtin) {
+        DASSERT(f->builtin->useCount);
+        --f->builtin->useCount;
     }
 
+    FreeInputCallbacks(f);
     if(f->preInputCallbacks)
         qsDictionaryDestroy(f->preInputCallbacks);
     if(f->postInputCallbacks)
@@ -140,10 +154,13 @@ void DestroyFilter(struct QsStream *s, struct QsFilter *f) {
 
     DSPEW("Freeing: %s", f->name);
     
-    if(f->parameters)
+    if(f->parameters) {
+        _qsParameterFreeScheduled(f);
+        CHECK(pthread_mutex_destroy(&f->scheduleMutex));
         // This will cleanup all the parameter data using the qsDictionary
         // SetFreeValueOnDestroy thingy.
         qsDictionaryDestroy(f->parameters);
+    }
 
     ASSERT(0 == qsDictionaryRemove(s->dict, f->name),
             "Can't remove filter \"%s\" from source dict", f->name);
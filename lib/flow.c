@@ -15,6 +15,7 @@
 #include "../include/quickstream/filter.h"
 #include "controllerCallbacks.h"
 #include "Dictionary.h"
+#include "parameter.h"
 
 
 // Stop running input() for this filter, f.
@@ -110,9 +111,10 @@ void StopRunningInput(struct QsStream *s, struct QsFilter *f,
 static inline
 bool CheckFilterInputCallable(struct QsFilter *f) {
 
-    if(f->unused == 0 || f->mark) 
+    if(f->unused == 0 || f->mark || f->waitEvents)
         // This filter has a full amount of working threads already,
-        // or f->mark has marked it as finished.
+        // or f->mark has marked it as finished, or it's waiting for the
+        // fd thread to see a file descriptor be ready.
         return false;
 
     // If any outputs are clogged than we cannot call input() for filter,
@@ -138,6 +140,11 @@ bool CheckFilterInputCallable(struct QsFilter *f) {
         }
     }
 
+    if(f->inputAgain)
+        // The filter asked for another input() call with qsInputAgain(),
+        // or it's file descriptor from qsWaitFd() is ready.
+        return true;
+
     // If any input meets the threshold we can call input() for this
     // filter, f, we return true.  If this filter, f, decides that this
     // one simple threshold condition is not enough then that filter's
@@ -156,21 +163,115 @@ bool CheckFilterInputCallable(struct QsFilter *f) {
 }
 
 
-static void
-PostInputCallback(const char *key, struct  ControllerCallback *cb,
-        struct QsJob *j) {
+// Move the qsParameterSetAt() changes that are due to the job, j, and cut
+// the job input lengths short so that the input() call ends at the next
+// scheduled change.  This is called with the stream mutex lock after the
+// job input lengths are set up for the next input() call.
+static inline
+void ScheduleInput(struct QsFilter *f, struct QsJob *j) {
+
+    j->scheduleClamped = false;
+
+    if(atomic_load(&f->numScheduled) == 0)
+        // This is the common case.  No scheduled parameter changes.
+        return;
+
+    CHECK(pthread_mutex_lock(&f->scheduleMutex));
+
+    struct QsScheduledSet **next = &f->scheduled;
+    struct QsScheduledSet **due = &j->dueSets;
+    while(*due) due = &(*due)->next;
+
+    while(*next) {
+        struct QsScheduledSet *set = *next;
+        uint32_t port = set->inputPort;
+
+        if(port >= f->numInputs ||
+                set->offset <= f->readers[port]->readCount ||
+                (f->scheduleStalled && set->offset <=
+                 f->readers[port]->readCount + j->inputLens[port])) {
+            // It's due.  Move it to the end of the job due list.
+            *next = set->next;
+            set->next = 0;
+            *due = set;
+            due = &set->next;
+            atomic_fetch_sub(&f->numScheduled, 1);
+            continue;
+        }
+
+        // Not due yet, so the input() call must end at it.
+        uint64_t len = set->offset - f->readers[port]->readCount;
+        if(j->inputLens[port] > len) {
+            j->inputLens[port] = len;
+            j->scheduleClamped = true;
+            // The input after the cut is still there, so this is not the
+            // last of the input.
+            j->isFlushing[port] = false;
+        }
+        next = &set->next;
+    }
+
+    f->scheduleStalled = false;
+
+    CHECK(pthread_mutex_unlock(&f->scheduleMutex));
+}
+
+
+// Mark the callback so it is not called again, after it returned ret.
+// The arrays do not change while the stream flows, because more than one
+// thread may be going through them for a filter with maxThreads > 1.
+// qsStreamStop() removes the marked callbacks from the filter's
+// dictionary.
+static inline
+void MarkInputCallback(struct QsInputCallback *cb, int ret) {
+
+    int zero = 0;
+    // Only the first non-zero return value is kept.
+    atomic_compare_exchange_strong(&cb->cb->returnValue, &zero, ret);
+}
 
-    struct QsFilter *f = j->filter;
 
-    // Note: we can't edit the list of callbacks while the stream is
-    // running.  We just made it simple that way.
+// Call all controller preInput callbacks for this filter.
+static inline
+void PreInputCallbacks(struct QsFilter *f, struct QsJob *j) {
+
+    for(uint32_t i=0; i<f->numPreInput; ++i) {
+        struct QsInputCallback *cb = f->preInput + i;
+        if(atomic_load(&cb->cb->returnValue))
+            continue;
+        int ret = cb->pre(f,
+                j->inputLens, // input lengths
+                j->isFlushing, f->numInputs, f->numOutputs,
+                cb->userData);
+        if(ret)
+            MarkInputCallback(cb, ret);
+    }
+}
+
 
-    if(!cb->returnValue)
-        cb->returnValue = cb->callback(f,
+// Call all controller postInput callbacks for this filter.
+static inline
+void PostInputCallbacks(struct QsFilter *f, struct QsJob *j) {
+
+    for(uint32_t i=0; i<f->numPostInput; ++i) {
+        struct QsInputCallback *cb = f->postInput + i;
+        // The controller thread marks a queued callback that returned
+        // non-zero.
+        if(atomic_load(&cb->cb->returnValue))
+            continue;
+        if(cb->queue) {
+            QueuePostInput(f, cb, j->advanceLens, j->outputLens,
+                    j->isFlushing);
+            continue;
+        }
+        int ret = cb->post(f,
                 j->advanceLens, // input lengths
                 j->outputLens,  // output lengths
-            j->isFlushing, f->numInputs, f->numOutputs,
-            cb->userData);
+                j->isFlushing, f->numInputs, f->numOutputs,
+                cb->userData);
+        if(ret)
+            MarkInputCallback(cb, ret);
+    }
 }
 
 
@@ -220,8 +321,41 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
     //
     int inputRet;
 
-    inputRet = f->input(j->inputBuffers, j->inputLens,
-            j->isFlushing, f->numInputs, f->numOutputs);
+    if(j->dueSets) {
+        // Scheduled qsParameterSetAt() changes land just before this
+        // input() call.
+        _qsParameterSetScheduled(f, j->dueSets);
+        j->dueSets = 0;
+    }
+
+    if(f->numPreInput) {
+        // A filter with maxThreads > 1 may have its input() called by
+        // more than one thread at a time, but the controller callbacks
+        // are called one at a time, like they were before they got out
+        // of the stream lock.
+        if(f->maxThreads > 1) {
+            CHECK(pthread_mutex_lock(&s->mutex));
+            PreInputCallbacks(f, j);
+            CHECK(pthread_mutex_unlock(&s->mutex));
+        } else
+            PreInputCallbacks(f, j);
+    }
+
+    if(f->iInput)
+        inputRet = f->iInput(f->instance, j->inputBuffers, j->inputLens,
+                j->isFlushing, f->numInputs, f->numOutputs);
+    else
+        inputRet = f->input(j->inputBuffers, j->inputLens,
+                j->isFlushing, f->numInputs, f->numOutputs);
+
+    if(f->numPostInput) {
+        if(f->maxThreads > 1) {
+            CHECK(pthread_mutex_lock(&s->mutex));
+            PostInputCallbacks(f, j);
+            CHECK(pthread_mutex_unlock(&s->mutex));
+        } else
+            PostInputCallbacks(f, j);
+    }
 
 
     // Note: all these "for" loop iteration are through just the number of
@@ -275,6 +409,13 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
 
     CheckLockFilter(f);
 
+    // If the filter called qsWaitFd() or qsInputAgain() it's input() will
+    // be called again without more input, so it did not have to keep
+    // it's read promise in this call.
+    bool isDeferred = (j->waitEvents || j->inputAgain);
+    f->inputAgain = j->inputAgain;
+    j->inputAgain = false;
+
     // Advance the output write pointers and see if we can write more.
     //
     // To be able to write more we must be able to write maxLength to all
@@ -371,13 +512,15 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
  
         //j->inputLens[i] = f->readers[i]->readLength;
 
-        if(j->inputLens[i] >= r->maxRead)
+        if(j->inputLens[i] >= r->maxRead && !isDeferred)
             // This filter module is not written correctly.
             ASSERT(j->advanceLens[i],
                     "The filter \"%s\" did not keep it's read promise"
                     " for input port %" PRIu32,
                     f->name, i);
 
+        r->readCount += j->advanceLens[i];
+
         // Advance read pointer 
         r->readPtr += j->advanceLens[i];
         // Record the length that we have left to read up to the write
@@ -393,6 +536,24 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
     }
 
 
+    if(j->scheduleClamped) {
+        // The input was cut short for a scheduled parameter change.  If
+        // the filter did not take any of it, it will not get to the
+        // change, so we apply it late in the next call.
+        bool advanced = false;
+        for(uint32_t i=f->numInputs-1; i!=-1; --i)
+            if(j->advanceLens[i]) {
+                advanced = true;
+                break;
+            }
+        if(!advanced) {
+            NOTICE("filter \"%s\" did not advance input cut short for "
+                    "a scheduled parameter change", f->name);
+            f->scheduleStalled = true;
+        }
+    }
+
+
     if(f->numInputs == 0) {
         // We pretend we got the needed input if there are no inputs (a
         // source).
@@ -423,12 +584,10 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
         }
     }
 
-
-    if(f->postInputCallbacks)
-        // Call all controller postInput callbacks for this filter.
-        qsDictionaryForEach(f->postInputCallbacks,
-            (int (*) (const char *key, void *value,
-                void *userData)) PostInputCallback, j);
+    if(f->inputAgain)
+        // The filter wants input() called again even if there is no new
+        // input, so long as the outputs are not clogged.
+        inputsFeeding = inputAdvanced = true;
 
 
     bool ret = true;
@@ -438,6 +597,15 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
         StopRunningInput(s, f, j, inputRet);
     }
 
+    if(j->waitEvents) {
+        // The filter called qsWaitFd().  If the fd thread can wait on the
+        // file descriptor we stop calling input() until it's ready,
+        // otherwise we go on like qsWaitFd() was not called.
+        if(ret && FdWaitAdd(s, f, j->waitFd, j->waitEvents))
+            ret = false;
+        j->waitEvents = 0;
+    }
+
 
     if(ret && outputsHungry && inputsFeeding && inputAdvanced) {
         // We will be calling input() again.
@@ -454,6 +622,8 @@ bool RunInput(struct QsStream *s, struct QsFilter *f, struct QsJob *j) {
         for(uint32_t i=f->numOutputs-1; i!=-1; --i)
             j->outputLens[i] = 0;
 
+        ScheduleInput(f, j);
+
     } else if(ret)
         // We will not be calling input() again.
         ret = false;
@@ -620,8 +790,10 @@ struct QsJob *GetWork(struct QsStream *s) {
 
         if(j) return j;
 
-        if(s->numIdleThreads == s->numThreads - 1)
-            // All other threads are idle so we are done working/living.
+        if(s->numIdleThreads == s->numThreads - 1 &&
+                s->numFdWaiting == 0)
+            // All other threads are idle and no filters are waiting on
+            // file descriptors so we are done working/living.
             return 0;
 
         // We count ourselves in the ranks of the sleeping unemployed.
@@ -640,18 +812,29 @@ struct QsJob *GetWork(struct QsStream *s) {
         // Remove ourselves from the numIdleThreads.
         --s->numIdleThreads;
 
-        if(s->numIdleThreads == s->numThreads - 1) {
-            // All other threads are idle so we are done working/living.
-            //
-            // In order for this to happen there should be no jobs in the
-            // stream job queue.
-            DASSERT(StreamQToFilterWorker(s) == 0);
-            return 0;
-        }
+        // We may have been woken by the fd thread, which can queue a job
+        // when all the worker threads are idle; so we look for a job
+        // before we see if we are done working/living.
     }
 }
 
 
+void QueueFilterJob(struct QsStream *s, struct QsFilter *f) {
+
+    if(!CheckFilterInputCallable(f))
+        return;
+
+    FilterUnusedToStreamQ(s, f);
+
+    if(s->numIdleThreads)
+        // Wake up an idle worker to do the job.
+        CHECK(pthread_cond_signal(&s->cond));
+    else if(s->numThreads < s->maxThreads)
+        LaunchWorkerThread(s);
+    // else a working thread will get to it.
+}
+
+
 
 // This is the first function called by worker threads.
 //
@@ -715,6 +898,8 @@ void *RunningWorkerThread(struct QsWorkPermit *p) {
             j->inputLens[i] = f->readers[i]->readLength;
         }
 
+        ScheduleInput(f, j);
+
         // Ya, undo that lock.
         CheckUnlockFilter(f);
 
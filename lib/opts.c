@@ -51,7 +51,11 @@ const char *FindOptString(int argc, const char **argv, const char *opt) {
             if(argLen > optLen+2 && arg[optLen+2] == '=')
                 // got: --option=val
                 return &arg[optLen+3];
-            else if(argLen == optLen+2 && i < argc - 1)
+            else if(argLen > optLen+2)
+                // got: --optionMore, which is another option, like
+                // --freq2 when we look for --freq.
+                continue;
+            else if(i < argc - 1)
                 // got: --option val
                 return argv[i + 1];
             // else got: --option
@@ -5,13 +5,18 @@
 #include <stdatomic.h>
 #include <errno.h>
 #include <regex.h>
+#include <semaphore.h>
+#include <time.h>
+#include <stddef.h>
 
 #include "../include/quickstream/filter.h"
 #include "../include/quickstream/parameter.h"
 #include "debug.h"
 #include "Dictionary.h"
 #include "qs.h"
+#include "parameter.h"
 #include "filterAPI.h" // struct QsJob *GetJob(void){}
+#include "controllerThread.h"
 
 
 
@@ -61,6 +66,20 @@ const char *GetTypeString(enum QsParameterType type) {
 }
 
 
+// The mailbox that qsParameterSet() writes to and the owning filter
+// reads from, without either one taking a lock.  It's a sequence lock:
+// seq is odd while a value is being written, and it goes up by 2 with
+// each value written.  The value is kept in atomic words so that a reader
+// that races with a writer reads junk that it throws away, and not
+// undefined behavior.
+struct Mailbox {
+
+    _Atomic uint32_t seq;
+    size_t size; // in bytes
+    _Atomic uint64_t words[];
+};
+
+
 // Get callbacks are called when qsParameterPush() is called.
 struct GetCallback {
 
@@ -72,9 +91,15 @@ struct GetCallback {
     void (*cleanup)(void *);
     void *userData;
     uint32_t flags;
+    // From qsParameterGetAsync(), or 0.
+    struct AsyncGet *async;
 };
 
 
+struct AsyncGet;
+static void FreeAsync(struct AsyncGet *a);
+
+
 struct QsParameter {
 
     enum QsParameterType type;
@@ -86,6 +111,9 @@ struct QsParameter {
 
     void (*cleanup)(const char *pName, void *userData);
 
+    // From qsParameterAddMailbox(), or 0.
+    struct Mailbox *mailbox;
+
     // realloc()ed array.
     size_t numGetCallbacks;
     struct GetCallback *getCallbacks;
@@ -114,6 +142,8 @@ static void FreeParameter(struct QsParameter *p) {
         DASSERT(p->numGetCallbacks);
 
         for(size_t i=0; i<p->numGetCallbacks; ++i) {
+            if(p->getCallbacks[i].async)
+                FreeAsync(p->getCallbacks[i].async);
             if(p->getCallbacks[i].flags & QS_FREE_USERDATA && p->userData)
                 free(p->getCallbacks[i].userData);
             if(p->getCallbacks[i].cleanup)
@@ -125,6 +155,8 @@ static void FreeParameter(struct QsParameter *p) {
 #endif
         free(p->getCallbacks);
     }
+    if(p->mailbox)
+        free(p->mailbox);
     free(p->pName);
 
 #ifdef DEBUG
@@ -261,7 +293,13 @@ int RemoveCallbacksForRestart(const char *key,
     for(size_t j=0; j<p->numGetCallbacks;) {
         // Keep going until we find one to keep:
         while(j<p->numGetCallbacks &&
-                !(p->getCallbacks[j].flags & QS_KEEP_AT_RESTART)) ++j;
+                !(p->getCallbacks[j].flags & QS_KEEP_AT_RESTART)) {
+            if(p->getCallbacks[j].async) {
+                FreeAsync(p->getCallbacks[j].async);
+                p->getCallbacks[j].async = 0;
+            }
+            ++j;
+        }
         if(j==p->numGetCallbacks) break;
         // We keep j-th one in the newNum position.
         if(newNum != j)
@@ -406,6 +444,558 @@ qsParameterCreate(const char *pName, enum QsParameterType type,
 }
 
 
+static void MailboxWrite(struct Mailbox *m, const void *value) {
+
+    // Writers take turns by making seq odd.  Writers are rare, so
+    // spinning here is okay.
+    uint32_t seq = atomic_load_explicit(&m->seq, memory_order_relaxed);
+    while(seq & 01 || !atomic_compare_exchange_weak_explicit(&m->seq,
+                &seq, seq + 1, memory_order_acquire,
+                memory_order_relaxed))
+        seq = atomic_load_explicit(&m->seq, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_release);
+
+    const char *v = value;
+    size_t num = (m->size + 7)/8;
+    for(size_t i=0; i<num; ++i) {
+        uint64_t word = 0;
+        memcpy(&word, v + 8*i, (i < num - 1 || m->size%8 == 0)?8:
+                m->size%8);
+        atomic_store_explicit(m->words + i, word, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&m->seq, seq + 2, memory_order_release);
+}
+
+
+int qsParameterAddMailbox(struct QsParameter *p, size_t size,
+        const void *initValue) {
+
+    DASSERT(p);
+
+    if(p->mailbox) {
+        ERROR("Parameter \"%s:%s\" already has a mailbox",
+                p->filterName, p->pName);
+        return -1; // fail
+    }
+
+    if(size == 0) {
+        switch(p->type) {
+            case QsDouble:
+                size = sizeof(double);
+                break;
+            case QsUint64:
+                size = sizeof(uint64_t);
+                break;
+            default:
+                ERROR("Parameter \"%s:%s\" mailbox needs a size",
+                        p->filterName, p->pName);
+                return -1; // fail
+        }
+    }
+
+    size_t num = (size + 7)/8;
+    p->mailbox = calloc(1, sizeof(*p->mailbox) +
+            num*sizeof(*p->mailbox->words));
+    ASSERT(p->mailbox, "calloc(1,%zu) failed",
+            sizeof(*p->mailbox) + num*sizeof(*p->mailbox->words));
+    p->mailbox->size = size;
+    atomic_init(&p->mailbox->seq, 0);
+
+    if(initValue)
+        MailboxWrite(p->mailbox, initValue);
+
+    return 0; // success
+}
+
+
+static bool MailboxRead(struct Mailbox *m, void *value, uint32_t *seen) {
+
+    uint32_t seq = atomic_load_explicit(&m->seq, memory_order_acquire);
+
+    // This is the common case in a filter input(), with no new value.
+    if(seen && *seen == seq)
+        return false;
+
+    size_t num = (m->size + 7)/8;
+    char *v = value;
+
+    while(true) {
+        if(seq & 01) {
+            // A writer is writing.
+            seq = atomic_load_explicit(&m->seq, memory_order_acquire);
+            continue;
+        }
+        for(size_t i=0; i<num; ++i) {
+            uint64_t word = atomic_load_explicit(m->words + i,
+                    memory_order_relaxed);
+            memcpy(v + 8*i, &word, (i < num - 1 || m->size%8 == 0)?8:
+                    m->size%8);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t seq2 = atomic_load_explicit(&m->seq,
+                memory_order_relaxed);
+        if(seq2 == seq)
+            break;
+        // We raced a writer, so we read it again.
+        seq = seq2;
+    }
+
+    if(seen)
+        *seen = seq;
+
+    return true;
+}
+
+bool qsParameterMailboxRead(struct QsParameter *p, void *value,
+        uint32_t *seen) {
+
+    DASSERT(p);
+    DASSERT(p->mailbox, "Parameter \"%s:%s\" has no mailbox",
+            p->filterName, p->pName);
+
+    return MailboxRead(p->mailbox, value, seen);
+}
+
+
+// The number of values that an async get callback, without
+// QS_LATEST_ONLY, can have waiting to be delivered.  It must be a power
+// of 2.
+#define ASYNC_QUEUE_LENGTH  ((size_t) 64)
+
+
+// An async get callback, from qsParameterGetAsync(), is called by the
+// parameter delivery thread and not by the thread that pushes the value.
+// The pushing thread does not take a lock.  It writes the value to a
+// mailbox for QS_LATEST_ONLY, or else to a queue, and it wakes the
+// delivery thread if the value is the first one waiting.
+//
+// A get callback that a controller that runs in a thread adds, with
+// qsParameterGet() or qsParameterGetAsync(), is the same, except that the
+// controller thread delivers it in place of the delivery thread.  If it
+// has a rate limit the delivery thread still keeps the time, and queues
+// the event when the rate limit lets it.
+struct AsyncGet {
+
+    // In the delivery thread list.  Requires the delivery mutex lock.
+    struct AsyncGet *next, *prev;
+
+    // The controller queue, or 0 for the delivery thread.
+    struct QsEventQueue *queue;
+    // The event that is queued when a value is waiting.
+    struct QsControllerEvent event;
+    // Set while the event is queued or being called, if the delivery
+    // thread queues it.
+    atomic_bool queued;
+
+    // A copy of what is in the parameter get callback, because the
+    // parameter getCallbacks array can be realloc()ed.
+    const struct QsParameter *parameter;
+    int (*getCallback)(
+            const void *value,
+            void *streamOrApp,
+            const char *filterName, const char *pName,
+            enum QsParameterType type, void *userData);
+    void *userData;
+
+    // The least time between calls to getCallback(), in seconds, or 0.
+    double minPeriod;
+    // When getCallback() may be called next.  Only the thread that calls
+    // Deliver() writes it, and with a queue the delivery thread reads it
+    // only when queued is not set.
+    double nextTime;
+
+    // Set when there is a value waiting to be delivered.
+    atomic_bool pending;
+    // Pushed values that did not fit in the queue.
+    atomic_uint numDropped;
+
+    size_t size; // of the value in bytes
+
+    // For QS_LATEST_ONLY
+    struct Mailbox *mailbox;
+    uint32_t seen;
+
+    // Or else a bounded queue with many pushing threads and one reading
+    // thread.  Each slot has a sequence number that tells the pushing
+    // threads and the reading thread whose turn it is with the slot.
+    _Atomic size_t tail;
+    size_t head; // Only the delivery thread uses it.
+    size_t slotSize;
+    char *slots;
+
+    // The delivery thread copies the value here to call getCallback().
+    char value[];
+};
+
+
+struct Slot {
+    _Atomic size_t seq;
+    char value[];
+};
+
+
+static inline
+struct Slot *GetSlot(struct AsyncGet *a, size_t pos) {
+    return (struct Slot *)
+        (a->slots + (pos & (ASYNC_QUEUE_LENGTH - 1)) * a->slotSize);
+}
+
+
+// Returns false if the queue is full.
+static bool Enqueue(struct AsyncGet *a, const void *value) {
+
+    size_t pos = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    struct Slot *slot;
+
+    while(true) {
+        slot = GetSlot(a, pos);
+        size_t seq = atomic_load_explicit(&slot->seq,
+                memory_order_acquire);
+        if(seq == pos) {
+            if(atomic_compare_exchange_weak_explicit(&a->tail, &pos,
+                        pos + 1, memory_order_relaxed,
+                        memory_order_relaxed))
+                break;
+            // pos was changed to the current tail.
+        } else if(seq < pos)
+            // The delivery thread has not read this slot yet.
+            return false;
+        else
+            pos = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    }
+
+    memcpy(slot->value, value, a->size);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+
+// Returns false if the queue is empty.
+static bool Dequeue(struct AsyncGet *a) {
+
+    struct Slot *slot = GetSlot(a, a->head);
+    if(atomic_load_explicit(&slot->seq, memory_order_acquire) !=
+            a->head + 1)
+        return false;
+
+    memcpy(a->value, slot->value, a->size);
+    atomic_store_explicit(&slot->seq, a->head + ASYNC_QUEUE_LENGTH,
+            memory_order_release);
+    ++a->head;
+    return true;
+}
+
+
+// There is one parameter delivery thread for all the async get
+// callbacks in the process.  It runs while there are any.
+static struct Delivery {
+
+    pthread_mutex_t mutex;
+    // Pushing threads sem_post() to wake the delivery thread, and
+    // sem_post() does not block.
+    sem_t sem;
+    pthread_t thread;
+    bool haveThread;
+    bool quit;
+    struct AsyncGet *list;
+} delivery = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static pthread_once_t deliveryOnce = PTHREAD_ONCE_INIT;
+
+static void InitDelivery(void) {
+    ASSERT(sem_init(&delivery.sem, 0, 0) == 0);
+}
+
+
+static inline
+double GetTime(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+
+// Call the getCallback() with the waiting values.  Called by the
+// delivery thread with the delivery mutex locked, or by the controller
+// thread.
+static void Deliver(struct AsyncGet *a, double now) {
+
+    const struct QsParameter *p = a->parameter;
+
+    atomic_store(&a->pending, false);
+
+    if(a->mailbox) {
+        if(MailboxRead(a->mailbox, a->value, &a->seen))
+            a->getCallback(a->value, p->streamOrApp, p->filterName,
+                    p->pName, p->type, a->userData);
+    } else
+        while(Dequeue(a)) {
+            a->getCallback(a->value, p->streamOrApp, p->filterName,
+                    p->pName, p->type, a->userData);
+            if(a->minPeriod) {
+                // One at a time.  If there are more we come back.
+                struct Slot *slot = GetSlot(a, a->head);
+                if(atomic_load(&slot->seq) == a->head + 1)
+                    atomic_store(&a->pending, true);
+                break;
+            }
+        }
+
+    a->nextTime = now + a->minPeriod;
+}
+
+
+static void *DeliveryThread(void *arg) {
+
+    CHECK(pthread_mutex_lock(&delivery.mutex));
+
+    while(!delivery.quit) {
+
+        double now = GetTime();
+        // When we need to wake up to deliver a value that is waiting
+        // for its rate limit, or 0.
+        double wake = 0;
+
+        for(struct AsyncGet *a = delivery.list; a; a = a->next) {
+
+            if(!atomic_load(&a->pending))
+                continue;
+            if(a->queue) {
+                // The controller thread delivers it.  We just keep the
+                // time.  DeliverEvent() wakes us if there are more values
+                // waiting after it is done.
+                if(atomic_load(&a->queued))
+                    continue;
+                if(now >= a->nextTime) {
+                    atomic_store(&a->queued, true);
+                    _qsControllerQueueEvent(a->queue, &a->event);
+                    continue;
+                }
+            } else if(now >= a->nextTime)
+                Deliver(a, now);
+            if(atomic_load(&a->pending) && (!wake || a->nextTime < wake))
+                wake = a->nextTime;
+        }
+
+        CHECK(pthread_mutex_unlock(&delivery.mutex));
+
+        if(wake) {
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            double dt = wake - now;
+            t.tv_sec += (time_t) dt;
+            t.tv_nsec += (long) ((dt - (time_t) dt) * 1.0e9);
+            if(t.tv_nsec >= 1000000000) {
+                ++t.tv_sec;
+                t.tv_nsec -= 1000000000;
+            }
+            while(sem_timedwait(&delivery.sem, &t) && errno == EINTR);
+        } else
+            while(sem_wait(&delivery.sem) && errno == EINTR);
+
+        CHECK(pthread_mutex_lock(&delivery.mutex));
+    }
+
+    CHECK(pthread_mutex_unlock(&delivery.mutex));
+
+    return 0;
+}
+
+
+// Called in the controller thread.
+static void DeliverEvent(struct QsControllerEvent *e) {
+
+    struct AsyncGet *a = (struct AsyncGet *)
+            ((char *) e - offsetof(struct AsyncGet, event));
+
+    if(!a->minPeriod) {
+        // A value pushed after Deliver() clears pending queues the
+        // event again.
+        Deliver(a, 0);
+        return;
+    }
+
+    Deliver(a, GetTime());
+    atomic_store(&a->queued, false);
+
+    if(atomic_load(&a->pending))
+        // There are more values waiting.  The pushing thread may not have
+        // woken the delivery thread for them, so we do.
+        ASSERT(sem_post(&delivery.sem) == 0);
+}
+
+
+// Returns the size of the parameter value, or 0 if we do not know it.
+static inline
+size_t AsyncValueSize(const struct QsParameter *p) {
+
+    if(p->mailbox)
+        return p->mailbox->size;
+    else if(p->type == QsDouble)
+        return sizeof(double);
+    else if(p->type == QsUint64)
+        return sizeof(uint64_t);
+    return 0;
+}
+
+
+// If queue is set the controller thread delivers the values, and the
+// AsyncGet has the queue reference that the caller got.
+static struct AsyncGet *CreateAsync(const struct QsParameter *p,
+        int (*getCallback)(
+            const void *value,
+            void *streamOrApp,
+            const char *filterName, const char *pName,
+            enum QsParameterType type, void *userData),
+        void *userData, uint32_t flags, double maxRate,
+        struct QsEventQueue *queue) {
+
+    size_t size = AsyncValueSize(p);
+    if(!size) {
+        ERROR("Parameter \"%s:%s\" needs a mailbox to get it "
+                "asynchronously", p->filterName, p->pName);
+        return 0;
+    }
+
+    struct AsyncGet *a = calloc(1, sizeof(*a) + size);
+    ASSERT(a, "calloc(1,%zu) failed", sizeof(*a) + size);
+    a->parameter = p;
+    a->getCallback = getCallback;
+    a->userData = userData;
+    if(maxRate > 0)
+        a->minPeriod = 1.0/maxRate;
+    a->size = size;
+    atomic_init(&a->pending, false);
+    atomic_init(&a->numDropped, 0);
+
+    if(flags & QS_LATEST_ONLY) {
+        size_t num = (size + 7)/8;
+        a->mailbox = calloc(1, sizeof(*a->mailbox) +
+                num*sizeof(*a->mailbox->words));
+        ASSERT(a->mailbox, "calloc(1,%zu) failed",
+                sizeof(*a->mailbox) + num*sizeof(*a->mailbox->words));
+        a->mailbox->size = size;
+        atomic_init(&a->mailbox->seq, 0);
+    } else {
+        // Keep the values in the slots 8 byte aligned.
+        a->slotSize = sizeof(struct Slot) + (size + 7)/8*8;
+        a->slots = calloc(ASYNC_QUEUE_LENGTH, a->slotSize);
+        ASSERT(a->slots, "calloc(%zu,%zu) failed",
+                ASYNC_QUEUE_LENGTH, a->slotSize);
+        for(size_t i=0; i<ASYNC_QUEUE_LENGTH; ++i)
+            atomic_init(&GetSlot(a, i)->seq, i);
+        atomic_init(&a->tail, 0);
+    }
+
+    if(queue) {
+        a->queue = queue;
+        a->event.run = DeliverEvent;
+        atomic_init(&a->queued, false);
+        if(!a->minPeriod)
+            // The pushing threads queue the event.
+            return a;
+        // The delivery thread queues the event at the rate limit.
+    }
+
+    CHECK(pthread_once(&deliveryOnce, InitDelivery));
+
+    CHECK(pthread_mutex_lock(&delivery.mutex));
+
+    a->next = delivery.list;
+    if(delivery.list)
+        delivery.list->prev = a;
+    delivery.list = a;
+
+    if(!delivery.haveThread) {
+        delivery.quit = false;
+        CHECK(pthread_create(&delivery.thread, 0, DeliveryThread, 0));
+        delivery.haveThread = true;
+    }
+
+    CHECK(pthread_mutex_unlock(&delivery.mutex));
+
+    return a;
+}
+
+
+static void FreeAsync(struct AsyncGet *a) {
+
+    bool join = false;
+
+    if(a->queue && !a->minPeriod)
+        goto cancel;
+
+    CHECK(pthread_mutex_lock(&delivery.mutex));
+
+    if(a->prev)
+        a->prev->next = a->next;
+    else
+        delivery.list = a->next;
+    if(a->next)
+        a->next->prev = a->prev;
+
+    if(!delivery.list && delivery.haveThread) {
+        // That was the last one, so the delivery thread can go.
+        delivery.quit = true;
+        delivery.haveThread = false;
+        ASSERT(sem_post(&delivery.sem) == 0);
+        join = true;
+    }
+
+    CHECK(pthread_mutex_unlock(&delivery.mutex));
+
+    if(join)
+        CHECK(pthread_join(delivery.thread, 0));
+
+cancel:
+
+    if(a->queue) {
+        _qsControllerQueueCancel(a->queue, &a->event);
+        _qsControllerQueueUnref(a->queue);
+    }
+
+    if(atomic_load(&a->numDropped))
+        NOTICE("Parameter \"%s:%s\" async get callback dropped %u values",
+                a->parameter->filterName, a->parameter->pName,
+                atomic_load(&a->numDropped));
+
+    if(a->mailbox)
+        free(a->mailbox);
+    if(a->slots)
+        free(a->slots);
+#ifdef DEBUG
+    memset(a, 0, sizeof(*a));
+#endif
+    free(a);
+}
+
+
+// Called in the thread that pushes the value.
+static inline
+void AsyncPush(struct AsyncGet *a, const void *value) {
+
+    if(a->mailbox)
+        MailboxWrite(a->mailbox, value);
+    else if(!Enqueue(a, value)) {
+        atomic_fetch_add(&a->numDropped, 1);
+        return;
+    }
+
+    if(!atomic_exchange(&a->pending, true)) {
+        // This is the first value waiting, so we wake the delivery
+        // thread, or queue the event for the controller thread.
+        if(a->queue && !a->minPeriod)
+            _qsControllerQueueEvent(a->queue, &a->event);
+        else
+            ASSERT(sem_post(&delivery.sem) == 0);
+    }
+}
+
+
+
 static int
 AddGetCallback(struct QsParameter *p, const char *filterName,
         const char *pName, enum QsParameterType type,
@@ -415,7 +1005,7 @@ AddGetCallback(struct QsParameter *p, const char *filterName,
             const char *filterName, const char *pName, 
             enum QsParameterType type, void *userData),
         void (*cleanup)(void *),
-        void *userData, uint32_t flags) {
+        void *userData, uint32_t flags, bool async, double maxRate) {
     
     DASSERT(p);
     // p->setCallback is not necessary.  A filter or controller can just
@@ -438,6 +1028,27 @@ AddGetCallback(struct QsParameter *p, const char *filterName,
                 return 0;
 
 
+    // A controller that runs in a thread gets the values in its thread,
+    // so that its events are still called one at a time.
+    struct QsEventQueue *queue = _qsControllerQueueCurrent();
+    if(queue && !async && !AsyncValueSize(p)) {
+        NOTICE("Parameter \"%s:%s\" has no mailbox, so the pushing"
+                " thread will call the controller get callback",
+                filterName, pName);
+        _qsControllerQueueUnref(queue);
+        queue = 0;
+    }
+
+    struct AsyncGet *a = 0;
+    if(async || queue) {
+        a = CreateAsync(p, getCallback, userData, flags, maxRate, queue);
+        if(!a) {
+            if(queue)
+                _qsControllerQueueUnref(queue);
+            return -4; // error
+        }
+    }
+
     size_t num = p->numGetCallbacks;
 
     p->getCallbacks = realloc(p->getCallbacks,
@@ -449,6 +1060,7 @@ AddGetCallback(struct QsParameter *p, const char *filterName,
     gc->cleanup = cleanup;
     gc->userData = userData;
     gc->flags = flags;
+    gc->async = a;
     ++p->numGetCallbacks;
 
     return 1; // success
@@ -469,6 +1081,8 @@ struct Check_AddGetCallback_args {
     void (*cleanup)(void *);
     void *userData;
     uint32_t flags;
+    bool async;
+    double maxRate;
 };
 
 
@@ -485,7 +1099,7 @@ int Check_AddGetCallback(const char *pName, struct QsParameter *p,
         // This parameter name matches the regular expression.
         AddGetCallback(p, args->filterName, pName, p->type,
                 args->getCallback, args->cleanup,
-                args->userData, args->flags);
+                args->userData, args->flags, args->async, args->maxRate);
         ++args->numParameters;
     }
     return 0; // keep going.
@@ -493,7 +1107,8 @@ int Check_AddGetCallback(const char *pName, struct QsParameter *p,
 
 
 
-int qsParameterGet(void *as, const char *filterName,
+static int
+ParameterGet(void *as, const char *filterName,
         const char *pName, enum QsParameterType type,
         int (*getCallback)(
             const void *value,
@@ -501,7 +1116,7 @@ int qsParameterGet(void *as, const char *filterName,
             const char *filterName, const char *pName, 
             enum QsParameterType type, void *userData),
         void (*cleanup)(void *userData),
-        void *userData, uint32_t flags) {
+        void *userData, uint32_t flags, bool async, double maxRate) {
 
     DASSERT(as);
     DASSERT(filterName);
@@ -526,7 +1141,7 @@ int qsParameterGet(void *as, const char *filterName,
         }
 
         return AddGetCallback(p, filterName, pName, type, getCallback,
-                cleanup, userData, flags);
+                cleanup, userData, flags, async, maxRate);
     }
 
     // This could be getting many parameters via a parameter name regular
@@ -542,6 +1157,8 @@ int qsParameterGet(void *as, const char *filterName,
     args.cleanup = cleanup;
     args.userData = userData;
     args.flags = flags;
+    args.async = async;
+    args.maxRate = maxRate;
 
     int ret = regcomp(&args.regex, pName, REG_EXTENDED);
     if(ret == REG_ESPACE)
@@ -562,6 +1179,36 @@ int qsParameterGet(void *as, const char *filterName,
 }
 
 
+int qsParameterGet(void *as, const char *filterName,
+        const char *pName, enum QsParameterType type,
+        int (*getCallback)(
+            const void *value,
+            void *streamOrApp,
+            const char *filterName, const char *pName, 
+            enum QsParameterType type, void *userData),
+        void (*cleanup)(void *userData),
+        void *userData, uint32_t flags) {
+
+    return ParameterGet(as, filterName, pName, type, getCallback,
+            cleanup, userData, flags, false, 0);
+}
+
+
+int qsParameterGetAsync(void *as, const char *filterName,
+        const char *pName, enum QsParameterType type,
+        int (*getCallback)(
+            const void *value,
+            void *streamOrApp,
+            const char *filterName, const char *pName, 
+            enum QsParameterType type, void *userData),
+        void (*cleanup)(void *userData),
+        void *userData, uint32_t flags, double maxRate) {
+
+    return ParameterGet(as, filterName, pName, type, getCallback,
+            cleanup, userData, flags, true, maxRate);
+}
+
+
 static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
 // We put a pointer to the filter or the controller in thread specific
 // data with this key.  You see: only filters or controller modules manage
@@ -574,6 +1221,44 @@ static void MakeKey(void) {
 
 
 
+// Set the value of parameter p, that is owned by filter or controller
+// owner, now; after the parameter is found and the type is checked.
+static int SetParameter(struct QsParameter *p, void *owner, void *value) {
+
+    if(p->mailbox) {
+        // The owner reads this with qsParameterMailboxRead() when it
+        // gets to it.
+        MailboxWrite(p->mailbox, value);
+        if(!p->setCallback)
+            // The value is the parameter value now.  There's no owner
+            // code to call qsParameterPush() for us.
+            return qsParameterPushByPointer(p, value);
+    }
+
+    // We need thread specific data to tell what filter this is when
+    // setCallback() is called below.  
+    CHECK(pthread_once(&keyOnce, MakeKey));
+
+    void *oldOwner = pthread_getspecific(parameterKey);
+
+    // Set the thread specific
+    CHECK(pthread_setspecific(parameterKey, owner));
+
+    // This may call qsParameterPush() or it may not, or qsParameterPush()
+    // may be called later, after this call.  It's up to the filter module
+    // when and if to call qsParameterPush().  It may not call it if the
+    // parameter does not change due to this call.
+    p->setCallback(p, value, p->pName, p->userData);
+
+    CHECK(pthread_setspecific(parameterKey, oldOwner));
+
+    // Now we wait for this to have an effect.  The effect does not have
+    // to be soon.
+
+    return 0; // success
+}
+
+
 int qsParameterSet(void *sa,
         const char *filterName, const char *pName,
         enum QsParameterType type, void *value) {
@@ -626,7 +1311,10 @@ int qsParameterSet(void *sa,
         }
     }
 
-    DASSERT(p->setCallback);
+    if(!p->setCallback && !p->mailbox) {
+        WARN("Parameter \"%s:%s\" cannot be set", filterName, pName);
+        return 5; // error
+    }
 
     if(p->type != type) {
         ERROR("Filter parameter \"%s:%s\" type \"%s\" "
@@ -636,30 +1324,151 @@ int qsParameterSet(void *sa,
         return 3; // error
     }
 
-    // We need thread specific data to tell what filter this is when
-    // setCallback() is called below.  
-    CHECK(pthread_once(&keyOnce, MakeKey));
+    return SetParameter(p, (f)?((void *)f):((void *)c), value);
+}
 
-    void *oldOwner = pthread_getspecific(parameterKey);
 
-    // Set the thread specific
-    CHECK(pthread_setspecific(parameterKey, (f)?((void *)f):((void*)c)));
+// Returns the number of input ports that filter f has in stream s.  It
+// works before qsStreamReady() sets f->numInputs, because each input port
+// has just one connection that feeds it.
+static inline
+uint32_t NumInputs(const struct QsStream *s, const struct QsFilter *f) {
 
-    // This may call qsParameterPush() or it may not, or qsParameterPush()
-    // may be called later, after this call.  It's up to the filter module
-    // when and if to call qsParameterPush().  It may not call it if the
-    // parameter does not change due to this call.
-    p->setCallback(p, value, pName, p->userData);
+    uint32_t n = 0;
+    for(uint32_t i=0; i<s->numConnections; ++i)
+        if(s->connections[i].to == f)
+            ++n;
+    return n;
+}
 
-    CHECK(pthread_setspecific(parameterKey, oldOwner));
 
-    // Now we wait for this to have an effect.  The effect does not have
-    // to be soon.
+int qsParameterSetAt(struct QsStream *s,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *value,
+        uint32_t inputPort, uint64_t inputOffset) {
+
+    DASSERT(s);
+    DASSERT(s->type == _QS_STREAM_TYPE);
+    DASSERT(filterName);
+    DASSERT(filterName[0]);
+    DASSERT(pName);
+    DASSERT(pName[0]);
+
+    struct QsFilter *f = qsFilterFromName(s, filterName);
+    if(!f) {
+        WARN("Filter named \"%s\" not found", filterName);
+        return 1; // error
+    }
+    DASSERT(f->parameters);
+
+    struct QsParameter *p = qsDictionaryFind(f->parameters, pName);
+    if(!p) {
+        WARN("Parameter \"%s:%s\" not found", filterName, pName);
+        return 2; // error
+    }
+
+    if(!p->setCallback && !p->mailbox) {
+        WARN("Parameter \"%s:%s\" cannot be set", filterName, pName);
+        return 5; // error
+    }
+
+    if(p->type != type) {
+        ERROR("Filter parameter \"%s:%s\" type \"%s\" "
+                "is not requested type \"%s\"",
+                filterName, pName, GetTypeString(p->type),
+                GetTypeString(type));
+        return 3; // error
+    }
+
+    uint32_t numInputs = NumInputs(s, f);
+    if(inputPort >= numInputs) {
+        // There is no input offset to set it at.  A source filter, with
+        // no inputs, should use qsParameterSet().
+        ERROR("Filter \"%s\" has %" PRIu32 " input ports, so it has no"
+                " input port %" PRIu32 " to set parameter \"%s\" at",
+                filterName, numInputs, inputPort, pName);
+        return 7; // error
+    }
+
+    // We must copy the value, so we need to know how big it is.
+    size_t size;
+    if(p->mailbox)
+        size = p->mailbox->size;
+    else if(type == QsDouble)
+        size = sizeof(double);
+    else if(type == QsUint64)
+        size = sizeof(uint64_t);
+    else {
+        ERROR("Filter parameter \"%s:%s\" needs a mailbox to "
+                "schedule setting it", filterName, pName);
+        return 6; // error
+    }
+
+    struct QsScheduledSet *set = malloc(sizeof(*set) + size);
+    ASSERT(set, "malloc(%zu) failed", sizeof(*set) + size);
+    set->pName = strdup(pName);
+    ASSERT(set->pName, "strdup() failed");
+    set->offset = inputOffset;
+    set->inputPort = inputPort;
+    memcpy(set->value, value, size);
+
+    CHECK(pthread_mutex_lock(&f->scheduleMutex));
+
+    // Keep the list in offset order, and in the order that they are set
+    // for the same offset.
+    struct QsScheduledSet **next = &f->scheduled;
+    while(*next && (*next)->offset <= inputOffset)
+        next = &(*next)->next;
+    set->next = *next;
+    *next = set;
+    atomic_fetch_add(&f->numScheduled, 1);
+
+    CHECK(pthread_mutex_unlock(&f->scheduleMutex));
 
     return 0; // success
 }
 
 
+void _qsParameterSetScheduled(struct QsFilter *f,
+        struct QsScheduledSet *sets) {
+
+    struct QsScheduledSet *next;
+
+    for(struct QsScheduledSet *set = sets; set; set = next) {
+        next = set->next;
+        struct QsParameter *p = qsDictionaryFind(f->parameters,
+                set->pName);
+        if(p)
+            SetParameter(p, f, set->value);
+        else
+            WARN("Scheduled parameter \"%s:%s\" was removed",
+                    f->name, set->pName);
+        free(set->pName);
+        free(set);
+    }
+}
+
+
+void _qsParameterFreeScheduled(struct QsFilter *f) {
+
+    CHECK(pthread_mutex_lock(&f->scheduleMutex));
+
+    struct QsScheduledSet *next;
+    for(struct QsScheduledSet *set = f->scheduled; set; set = next) {
+        next = set->next;
+        NOTICE("Scheduled setting of parameter \"%s:%s\" at input "
+                "port %" PRIu32 " offset %" PRIu64 " was not reached",
+                f->name, set->pName, set->inputPort, set->offset);
+        free(set->pName);
+        free(set);
+    }
+    f->scheduled = 0;
+    atomic_store(&f->numScheduled, 0);
+
+    CHECK(pthread_mutex_unlock(&f->scheduleMutex));
+}
+
+
 int qsParameterPushByPointer(const struct QsParameter *p,
         void *value) {
 
@@ -672,8 +1481,12 @@ int qsParameterPushByPointer(const struct QsParameter *p,
     struct GetCallback *gcs = p->getCallbacks;
     size_t num = p->numGetCallbacks;
     for(size_t i=0; i<num; ++i)
-        gcs[i].getCallback(value, p->streamOrApp,
-                p->filterName, p->pName, p->type, gcs[i].userData);
+        if(gcs[i].async)
+            // The delivery thread calls this one.
+            AsyncPush(gcs[i].async, value);
+        else
+            gcs[i].getCallback(value, p->streamOrApp,
+                    p->filterName, p->pName, p->type, gcs[i].userData);
 
     return 0;
 }
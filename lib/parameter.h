@@ -5,3 +5,17 @@
 // not.
 extern void
 _qsParameterRemoveCallbacksForRestart(struct QsFilter *filter);
+
+
+// called by the thread that calls the filter input(), just before the
+// input() call, to apply the scheduled qsParameterSetAt() changes that
+// are due.  It frees the list.
+extern void
+_qsParameterSetScheduled(struct QsFilter *filter,
+        struct QsScheduledSet *sets);
+
+
+// called at stream stop, and when the filter is destroyed, to free the
+// scheduled qsParameterSetAt() changes that where not reached.
+extern void
+_qsParameterFreeScheduled(struct QsFilter *filter);
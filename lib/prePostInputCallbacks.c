@@ -19,10 +19,17 @@
 #include "Dictionary.h"
 #include "qs.h"
 #include "controllerCallbacks.h"
+#include "controllerThread.h"
+
+
+static void FreePostInputQueue(struct PostInputQueue *q);
 
 
 static void CleanUpCB(void *ptr) {
     DASSERT(ptr);
+    struct ControllerCallback *cb = ptr;
+    if(cb->postQueue)
+        FreePostInputQueue(cb->postQueue);
 #ifdef DEBUG
     memset(ptr, 0, sizeof(struct ControllerCallback));
 #endif
@@ -31,14 +38,25 @@ static void CleanUpCB(void *ptr) {
 
 
 
-int qsAddPostFilterInput(struct QsFilter *f,
+// Add, replace, or remove (if both callbacks are 0) the callback for
+// the current controller in the dictionary *dict.
+static
+int AddCallback(struct QsFilter *f, struct QsDictionary **dict,
+        const char *what,
         int (*callback)(
             struct QsFilter *filter,
             const size_t lenIn[],
             const size_t lenOut[],
             const bool isFlushing[],
             uint32_t numInputs, uint32_t numOutputs,
-            void *userData), void *userData) {
+            void *userData),
+        int (*preCallback)(
+            struct QsFilter *filter,
+            const size_t lenIn[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData),
+        void *userData) {
 
     DASSERT(f);
     struct QsController *c = pthread_getspecific(_qsControllerKey);
@@ -57,32 +75,417 @@ int qsAddPostFilterInput(struct QsFilter *f,
             " different app than controller \"%s\"",
             f->name, c->name);
 
-    if(!f->postInputCallbacks)
-        f->postInputCallbacks = qsDictionaryCreate();
+    if(!callback && !preCallback) {
+        if(*dict && qsDictionaryRemove(*dict, c->name) == 0)
+            DSPEW("Removed %s Callback for filter:controller="
+                "\"%s:%s\"", what, f->name, c->name);
+        return 0; // success
+    }
+
+    if(!*dict)
+        *dict = qsDictionaryCreate();
 
     struct ControllerCallback *cb = malloc(sizeof(*cb));
     ASSERT(cb, "malloc(%zu) failed", sizeof(*cb));
 
     struct QsDictionary *d = 0;
-    int ret = qsDictionaryInsert(f->postInputCallbacks, c->name, cb, &d);
+    int ret = qsDictionaryInsert(*dict, c->name, cb, &d);
     ASSERT(ret >= 0, "Bad controller name \"%s\"", c->name);
     DASSERT(d);
 
     if(ret) {
         free(cb);
         cb = qsDictionaryGetValue(d);
-        INFO("Replaced PostInput Callback for filter:controller="
-                "\"%s:%s\"", f->name, c->name);
+        INFO("Replaced %s Callback for filter:controller="
+                "\"%s:%s\"", what, f->name, c->name);
     } else {
         DASSERT(ret == 0);
+        cb->postQueue = 0;
         qsDictionarySetFreeValueOnDestroy(d, CleanUpCB);
-        DSPEW("Added PostInput Callback for filter:controller="
-                "\"%s:%s\"", f->name, c->name);
+        DSPEW("Added %s Callback for filter:controller="
+                "\"%s:%s\"", what, f->name, c->name);
     }
 
     cb->callback = callback;
+    cb->preCallback = preCallback;
     cb->userData = userData;
     cb->returnValue = 0;
+    cb->controller = c;
 
     return 0; // success
 }
+
+
+int qsAddPostFilterInput(struct QsFilter *f,
+        int (*callback)(
+            struct QsFilter *filter,
+            const size_t lenIn[],
+            const size_t lenOut[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData), void *userData) {
+
+    return AddCallback(f, &f->postInputCallbacks, "PostInput",
+            callback, 0, userData);
+}
+
+
+int qsAddPreFilterInput(struct QsFilter *f,
+        int (*callback)(
+            struct QsFilter *filter,
+            const size_t lenIn[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData), void *userData) {
+
+    return AddCallback(f, &f->preInputCallbacks, "PreInput",
+            0, callback, userData);
+}
+
+
+// The number of post input callback calls that can wait for a controller
+// that runs in a thread, for each callback.  It must be a power of 2.
+#define POST_INPUT_QUEUE_LENGTH  ((size_t) 256)
+
+
+// The post input callback calls for a controller that runs in a thread
+// wait in a bounded queue, one for each callback, so that the thread that
+// called the filter input() does not malloc() or take a lock for each
+// call.  Only the call that finds the queue not scheduled queues the
+// controller event, and the event calls all the waiting calls.
+//
+// Calls that do not fit are not dropped.  They are added up in the
+// overflow slot, with a lock, until the controller thread empties the
+// queue and calls the callback once with the sums.  So the callback
+// still gets all the lengths, just in fewer calls.
+//
+// The queue is like the async parameter get queue in parameter.c.  Each
+// slot has a sequence number that tells the pushing threads and the
+// controller thread whose turn it is with the slot.
+struct PostInputQueue {
+
+    struct QsControllerEvent event; // first in struct
+
+    struct QsEventQueue *queue;
+    struct QsFilter *filter;
+    struct ControllerCallback *cb;
+    uint32_t numInputs, numOutputs;
+
+    // Set while the event is queued, and cleared when it starts to run.
+    atomic_bool scheduled;
+
+    _Atomic size_t tail;
+    size_t head; // Only the controller thread uses it.
+    size_t slotSize;
+    char *slots;
+
+    // The calls that did not fit in the queue are added to overflow.
+    // While overflowed is set the calls go to overflow, so that they are
+    // not called before the calls that came before them.
+    pthread_mutex_t overflowMutex;
+    atomic_bool overflowed;
+    struct PostInputSlot *overflow;
+    // The controller thread copies overflow to this, to call the
+    // callback without holding the lock.
+    struct PostInputSlot *overflowCopy;
+};
+
+
+struct PostInputSlot {
+    _Atomic size_t seq;
+    // lenIn[numInputs], then lenOut[numOutputs], then
+    // isFlushing[numInputs].
+    size_t lens[];
+};
+
+
+static inline
+struct PostInputSlot *GetSlot(struct PostInputQueue *q, size_t pos) {
+    return (struct PostInputSlot *)
+        (q->slots + (pos & (POST_INPUT_QUEUE_LENGTH - 1)) * q->slotSize);
+}
+
+
+static inline
+void CallPostInput(struct PostInputQueue *q, struct PostInputSlot *slot) {
+
+    // The callback may have returned non-zero in an earlier call.
+    if(atomic_load(&q->cb->returnValue))
+        return;
+
+    size_t *lenOut = slot->lens + q->numInputs;
+    int ret = q->cb->callback(q->filter, slot->lens, lenOut,
+            (const bool *) (lenOut + q->numOutputs),
+            q->numInputs, q->numOutputs, q->cb->userData);
+    if(ret)
+        // The filter will stop queuing it.
+        atomic_store(&q->cb->returnValue, ret);
+}
+
+
+// Called in the controller thread.
+static void RunPostInput(struct PostInputQueue *q) {
+
+    // A call that is pushed after this queues the event again.
+    atomic_store(&q->scheduled, false);
+
+    while(true) {
+        struct PostInputSlot *slot = GetSlot(q, q->head);
+        if(atomic_load_explicit(&slot->seq, memory_order_acquire) ==
+                q->head + 1) {
+            CallPostInput(q, slot);
+            atomic_store_explicit(&slot->seq,
+                    q->head + POST_INPUT_QUEUE_LENGTH,
+                    memory_order_release);
+            ++q->head;
+            continue;
+        }
+
+        // The queue is empty.  The calls in overflow came after all the
+        // calls that were in the queue.
+        if(!atomic_load(&q->overflowed))
+            break;
+
+        CHECK(pthread_mutex_lock(&q->overflowMutex));
+        memcpy(q->overflowCopy, q->overflow, q->slotSize);
+        memset(q->overflow, 0, q->slotSize);
+        atomic_store(&q->overflowed, false);
+        CHECK(pthread_mutex_unlock(&q->overflowMutex));
+
+        CallPostInput(q, q->overflowCopy);
+        // And there may be more calls in the queue now.
+    }
+}
+
+
+static void FreePostInputQueue(struct PostInputQueue *q) {
+
+    _qsControllerQueueCancel(q->queue, &q->event);
+    _qsControllerQueueUnref(q->queue);
+    CHECK(pthread_mutex_destroy(&q->overflowMutex));
+    free(q->overflowCopy);
+    free(q->overflow);
+    free(q->slots);
+#ifdef DEBUG
+    memset(q, 0, sizeof(*q));
+#endif
+    free(q);
+}
+
+
+// Make the post input queue for cb, if it does not have one that fits.
+// Called when the stream is not flowing.
+static void MakePostInputQueue(struct QsFilter *f,
+        struct ControllerCallback *cb) {
+
+    struct QsEventQueue *queue = cb->controller->queue;
+    DASSERT(queue);
+
+    struct PostInputQueue *q = cb->postQueue;
+    if(q && q->queue == queue && q->filter == f &&
+            q->numInputs == f->numInputs && q->numOutputs == f->numOutputs)
+        return;
+
+    if(q)
+        FreePostInputQueue(q);
+
+    q = calloc(1, sizeof(*q));
+    ASSERT(q, "calloc(1,%zu) failed", sizeof(*q));
+    q->event.run = (void (*)(struct QsControllerEvent *)) RunPostInput;
+    _qsControllerQueueRef(queue);
+    q->queue = queue;
+    q->filter = f;
+    q->cb = cb;
+    q->numInputs = f->numInputs;
+    q->numOutputs = f->numOutputs;
+    atomic_init(&q->scheduled, false);
+    atomic_init(&q->overflowed, false);
+    CHECK(pthread_mutex_init(&q->overflowMutex, 0));
+
+    // Keep the slots 8 byte aligned.
+    q->slotSize = (sizeof(struct PostInputSlot) +
+            (f->numInputs + f->numOutputs)*sizeof(size_t) +
+            f->numInputs*sizeof(bool) + 7)/8*8;
+    q->slots = calloc(POST_INPUT_QUEUE_LENGTH, q->slotSize);
+    ASSERT(q->slots, "calloc(%zu,%zu) failed",
+            POST_INPUT_QUEUE_LENGTH, q->slotSize);
+    for(size_t i=0; i<POST_INPUT_QUEUE_LENGTH; ++i)
+        atomic_init(&GetSlot(q, i)->seq, i);
+    atomic_init(&q->tail, 0);
+
+    q->overflow = calloc(1, q->slotSize);
+    ASSERT(q->overflow, "calloc(1,%zu) failed", q->slotSize);
+    q->overflowCopy = calloc(1, q->slotSize);
+    ASSERT(q->overflowCopy, "calloc(1,%zu) failed", q->slotSize);
+
+    cb->postQueue = q;
+}
+
+
+struct AddToArrayArgs {
+    struct QsFilter *filter;
+    struct QsInputCallback *entry;
+};
+
+
+static int
+AddToArray(const char *key, struct ControllerCallback *cb,
+        struct AddToArrayArgs *args) {
+
+    struct QsInputCallback **entry = &args->entry;
+
+    if(cb->returnValue)
+        // It returned non-zero in the last stream run, and qsStreamStop()
+        // will remove it.
+        return 0;
+
+    if(cb->preCallback)
+        (*entry)->pre = cb->preCallback;
+    else
+        (*entry)->post = cb->callback;
+    (*entry)->userData = cb->userData;
+    (*entry)->cb = cb;
+    // Only post input callbacks are queued.  A pre input callback is
+    // about the input() call that is next, so it is called right away.
+    (*entry)->queue = cb->preCallback?0:cb->controller->queue;
+    if((*entry)->queue)
+        MakePostInputQueue(args->filter, cb);
+    ++(*entry);
+
+    return 0;
+}
+
+
+static int
+CountCallback(const char *key, void *value, void *userData) {
+    return 0;
+}
+
+
+// Returns a malloc() allocated array of the callbacks in dict and sets
+// *num to the length of the array, or returns 0 if there are none.
+static
+struct QsInputCallback *MakeArray(struct QsFilter *f,
+        const struct QsDictionary *dict, uint32_t *num) {
+
+    *num = 0;
+
+    if(!dict)
+        return 0;
+
+    // The number of callbacks is the number of controllers, which is
+    // not many, so we just count them.
+    size_t count = qsDictionaryForEach(dict, CountCallback, 0);
+
+    if(count == 0)
+        return 0;
+
+    struct QsInputCallback *array = malloc(count*sizeof(*array));
+    ASSERT(array, "malloc(%zu) failed", count*sizeof(*array));
+
+    struct AddToArrayArgs args = { .filter = f, .entry = array };
+    qsDictionaryForEach(dict,
+            (int (*) (const char *, void *, void *)) AddToArray,
+            &args);
+
+    *num = args.entry - array;
+
+    if(*num == 0) {
+        free(array);
+        return 0;
+    }
+
+    return array;
+}
+
+
+void CompileInputCallbacks(struct QsFilter *f) {
+
+    FreeInputCallbacks(f);
+
+    f->preInput = MakeArray(f, f->preInputCallbacks, &f->numPreInput);
+    f->postInput = MakeArray(f, f->postInputCallbacks, &f->numPostInput);
+}
+
+
+// Add the lengths of a call that did not fit in the queue to overflow.
+static void AddToOverflow(struct PostInputQueue *q,
+        const size_t lenIn[], const size_t lenOut[],
+        const bool isFlushing[]) {
+
+    size_t *lens = q->overflow->lens;
+    bool *flushing = (bool *) (lens + q->numInputs + q->numOutputs);
+
+    CHECK(pthread_mutex_lock(&q->overflowMutex));
+    for(uint32_t i=0; i<q->numInputs; ++i) {
+        lens[i] += lenIn[i];
+        // Once an input is flushing it stays flushing.
+        flushing[i] |= isFlushing[i];
+    }
+    lens += q->numInputs;
+    for(uint32_t i=0; i<q->numOutputs; ++i)
+        lens[i] += lenOut[i];
+    atomic_store(&q->overflowed, true);
+    CHECK(pthread_mutex_unlock(&q->overflowMutex));
+}
+
+
+void QueuePostInput(struct QsFilter *f, const struct QsInputCallback *cb,
+        const size_t lenIn[], const size_t lenOut[],
+        const bool isFlushing[]) {
+
+    DASSERT(cb->queue);
+    struct PostInputQueue *q = cb->cb->postQueue;
+    DASSERT(q);
+    DASSERT(q->filter == f);
+
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    struct PostInputSlot *slot = 0;
+
+    while(!slot && !atomic_load(&q->overflowed)) {
+        struct PostInputSlot *s = GetSlot(q, pos);
+        size_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if(seq == pos) {
+            if(atomic_compare_exchange_weak_explicit(&q->tail, &pos,
+                        pos + 1, memory_order_relaxed,
+                        memory_order_relaxed))
+                slot = s;
+            // else pos was changed to the current tail.
+        } else if(seq < pos)
+            // The controller thread is behind, and the queue is full.
+            break;
+        else
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+
+    if(slot) {
+        if(f->numInputs) {
+            memcpy(slot->lens, lenIn, f->numInputs*sizeof(size_t));
+            memcpy(slot->lens + f->numInputs + f->numOutputs, isFlushing,
+                    f->numInputs*sizeof(bool));
+        }
+        if(f->numOutputs)
+            memcpy(slot->lens + f->numInputs, lenOut,
+                    f->numOutputs*sizeof(size_t));
+        atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    } else
+        AddToOverflow(q, lenIn, lenOut, isFlushing);
+
+    if(!atomic_exchange(&q->scheduled, true))
+        _qsControllerQueueEvent(q->queue, &q->event);
+}
+
+
+void FreeInputCallbacks(struct QsFilter *f) {
+
+    if(f->preInput) {
+        free(f->preInput);
+        f->preInput = 0;
+    }
+    if(f->postInput) {
+        free(f->postInput);
+        f->postInput = 0;
+    }
+    f->numPreInput = 0;
+    f->numPostInput = 0;
+}
@@ -231,6 +231,13 @@ struct QsApp {
     struct QsController *first; // first loaded
     struct QsController *last; // last loaded
 
+    // Threads that controllers share, from qsControllerRunInThread(), or
+    // 0 until a controller asks for it.
+    struct QsControllerPool *controllerPool;
+    // The number of threads in controllerPool, set with
+    // qsAppSetControllerPoolThreads().
+    uint32_t numControllerPoolThreads;
+
 
     // We could have more than one stream.  We can't delete or edit one
     // while it is running.  You could do something weird like configure
@@ -338,6 +345,11 @@ struct QsController {
         uint32_t numInputs, uint32_t numOutputs);
     int (*postStop)(struct QsStream *stream, struct QsFilter *f,
         uint32_t numInputs, uint32_t numOutputs);
+
+    // From qsControllerRunInThread(), or 0 if the controller functions
+    // are called by whatever thread triggers them.  See
+    // controllerThread.h.
+    struct QsEventQueue *queue;
 };
 
 
@@ -445,10 +457,26 @@ struct QsStream {
     struct QsJob *jobFirst; // next job in the streams job queue
     struct QsJob *jobLast; // last job in the streams job queue
     //
+    // numFdWaiting is the number of filters that called qsWaitFd() and
+    // are waiting for the fd thread to see their file descriptor be
+    // ready.  The worker threads do not all exit while it's not zero.
+    uint32_t numFdWaiting;
+    //
     //
     ///////////////////////////////////////////////////////////////////////
 
 
+    // The fd thread waits on file descriptors from qsWaitFd() calls in
+    // filter input() with epoll.  It is started the first time a filter
+    // calls qsWaitFd() in a stream run, and joined in qsStreamWait().  See
+    // fdWait.c.
+    bool haveFdThread; // set and read with the stream mutex lock
+    pthread_t fdThread;
+    int epollFd;
+    // Writing to fdPipe[1] tells the fd thread to return.
+    int fdPipe[2];
+
+
     // The array list of sources is created at start:
     uint32_t numSources;       // length of sources
     //
@@ -527,9 +555,41 @@ struct QsFilter {
     // List of controller's qsAddPostFilterInput() callbacks
     struct QsDictionary *postInputCallbacks;
 
+    // The callbacks from the two dictionaries above, made into arrays in
+    // qsStreamReady() and freed in qsStreamStop().  The arrays do not
+    // change at flow time, so more than one thread may use them.  A
+    // callback that returns non-zero is marked in its cb->returnValue and
+    // skipped after that.  See flow.c and prePostInputCallbacks.c.
+    struct QsInputCallback {
+        union {
+            int (*pre)(struct QsFilter *filter,
+                    const size_t lenIn[],
+                    const bool isFlushing[],
+                    uint32_t numInputs, uint32_t numOutputs,
+                    void *userData);
+            int (*post)(struct QsFilter *filter,
+                    const size_t lenIn[],
+                    const size_t lenOut[],
+                    const bool isFlushing[],
+                    uint32_t numInputs, uint32_t numOutputs,
+                    void *userData);
+        };
+        void *userData;
+        // So qsStreamStop() can see that the callback returned non-zero.
+        struct ControllerCallback *cb;
+        // The queue of the controller, if the controller runs in a
+        // thread, and then the post input callback is queued as an event.
+        struct QsEventQueue *queue;
+    } *preInput, *postInput;
+    uint32_t numPreInput, numPostInput;
+
 
     void *dlhandle; // from dlopen()
 
+    // If this filter is compiled into the program this is set and
+    // dlhandle is 0.
+    struct QsBuiltin *builtin;
+
     struct QsApp *app;       // This does not change
     struct QsStream *stream; // This stream can be changed
 
@@ -549,6 +609,17 @@ struct QsFilter {
             const bool isFlushing[],
             uint32_t numInputs, uint32_t numOutputs);
 
+    // For filter modules that use the instance API (see
+    // QS_FILTER_INSTANCE_API in filter.h) these are used in place of
+    // start, stop, and input above, which are then 0.  instance is what
+    // the module construct() returned, and it is passed to all of them.
+    void *instance;
+    int (* iStart)(void *instance, uint32_t numInputs, uint32_t numOutputs);
+    int (* iStop)(void *instance, uint32_t numInputs, uint32_t numOutputs);
+    int (* iInput)(void *instance, void *buffer[], const size_t len[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs);
+
 
     struct QsFilter *next; // next loaded filter in the stream filter list
 
@@ -599,6 +670,19 @@ struct QsFilter {
         // outputLens from qsOuput() and qsGetOutputBuffer() calls from in
         // filter input().   Length of this array is filter numOutputs.
         size_t *outputLens; // amount output was advanced in input() call.
+        //
+        // Set from qsWaitFd() and qsInputAgain() in the filter input()
+        // call.  waitEvents is 0, EPOLLIN, or EPOLLOUT.
+        int waitFd;
+        uint32_t waitEvents;
+        bool inputAgain;
+        //
+        // Scheduled parameter changes from qsParameterSetAt() that are
+        // applied just before the next input() call, and if the input
+        // lengths where cut short to stop at the next scheduled change.
+        // See ScheduleInput() in flow.c.
+        struct QsScheduledSet *dueSets;
+        bool scheduleClamped;
 
         // This will be the pthread_getspecific() data for each flow
         // thread.  Each thread just calls the filter (QsFilter) input()
@@ -688,6 +772,11 @@ struct QsFilter {
         // The input port number that this filter being written to sees in
         // it's input(,,portNum,) call.
         uint32_t inputPortNum;
+
+        // The total number of bytes that the reading filter advanced this
+        // input in this flow cycle.  qsParameterSetAt() offsets are
+        // counted in this.  Requires a stream mutex lock.
+        uint64_t readCount;
     }
     // array of pointers to readers array that is in feed filters
     // and not all the feed filters are the same filter.
@@ -759,8 +848,39 @@ struct QsFilter {
     struct QsJob *workingFirst; // First in thread working queue
     struct QsJob *workingLast;  // Last in thread working queue
     //
+    // If waitEvents is not 0 the filter called qsWaitFd() and input() is
+    // not called until the fd thread sees waitFd be ready.
+    int waitFd;
+    uint32_t waitEvents;
+    //
+    // The filter called qsInputAgain() in its last input() call.
+    bool inputAgain;
+    //
+    // The last input() call was cut short for a scheduled parameter
+    // change and did not advance any input, so the change is applied
+    // late, before the next input() call.
+    bool scheduleStalled;
+    //
     //
     /////////////////////////////////////////////////////////////////////
+
+
+    // Parameter changes from qsParameterSetAt() that are waiting for the
+    // input to get to them; a list in input offset order.  Any thread may
+    // add to it, so we have a mutex for it, but the thread that calls
+    // input() only takes the mutex lock when numScheduled is not 0.
+    pthread_mutex_t scheduleMutex;
+    struct QsScheduledSet {
+        struct QsScheduledSet *next;
+        uint64_t offset; // input byte offset
+        uint32_t inputPort;
+        // The parameter is looked up when the change is applied, so that
+        // a parameter that is destroyed in the mean time is not a problem.
+        char *pName;
+        // The copied value
+        char value[];
+    } *scheduled;
+    atomic_uint numScheduled;
  
 
     // We define source as a filter with no input.  We will feed is zeros
@@ -1038,6 +1158,51 @@ extern
 struct QsDictionary *GetStreamDictionary(const struct QsStream *s);
 
 
+// These are in prePostInputCallbacks.c
+
+// Make the filter's preInput and postInput arrays from the callbacks in
+// its preInputCallbacks and postInputCallbacks dictionaries, so that the
+// flow does not iterate through dictionaries.  Called at the end of
+// qsStreamReady().
+extern
+void CompileInputCallbacks(struct QsFilter *f);
+
+// Free the filter's preInput and postInput arrays.
+extern
+void FreeInputCallbacks(struct QsFilter *f);
+
+// Queue a call to the post input callback cb for the controller thread,
+// with copies of the lengths, or add the lengths to the last call if the
+// callback has too many calls waiting.  Called by the thread that called
+// the filter input().
+extern
+void QueuePostInput(struct QsFilter *f, const struct QsInputCallback *cb,
+        const size_t lenIn[], const size_t lenOut[],
+        const bool isFlushing[]);
+
+
+// Queue a job for filter f, if it can have one, and get a worker thread
+// for it.  The stream mutex must be locked.  From flow.c.
+extern
+void QueueFilterJob(struct QsStream *s, struct QsFilter *f);
+
+
+// Functions from fdWait.c
+
+// Have the fd thread wait for fd to be ready for events and then queue a
+// job for f.  Called with the stream mutex locked.  Returns false if fd
+// cannot be waited on.
+extern
+bool FdWaitAdd(struct QsStream *s, struct QsFilter *f, int fd,
+        uint32_t events);
+
+// Stop and join the fd thread, if there is one.  Called from the main
+// thread with the stream mutex unlocked after the worker threads have
+// returned.
+extern
+void FdWaitJoin(struct QsStream *s);
+
+
 // Just Frees the malloc allocated memory that is pointed to from the
 // Parameter Dictionary.  The Parameter Dictionary is not destroyed with
 // this.
@@ -1061,6 +1226,27 @@ char *GetPluginPath(const char *prefix, const char *category,
         const char *name, const char *suffix);
 
 
+// An entry in the table of filters that are compiled into the program.
+// See qsBuiltinFiltersAdd() and lib/builtinFilter.c.
+struct QsBuiltin {
+
+    // From the user's qsBuiltinFiltersAdd() call.
+    const struct QsBuiltinFilter *filter;
+
+    // The number of loaded filters that use this.  A filter that does not
+    // use the instance API can only be loaded once at a time.
+    uint32_t useCount;
+
+    struct QsBuiltin *next;
+};
+
+
+// Returns the built-in filter named fileName, with or without a ".so"
+// suffix, or 0 if there is none.
+extern
+struct QsBuiltin *FindBuiltinFilter(const char *fileName);
+
+
 // To get the controller C object when we are calling one of the
 // controller module standard controller functions: construct(),
 // destroy(), preStart(), postStart(), preStop(), and postStop().
@@ -1069,10 +1255,12 @@ char *GetPluginPath(const char *prefix, const char *category,
 //
 static inline struct QsController *GetController(void) {
 
-    DASSERT(_qsMainThread == pthread_self(), "Not main thread");
     struct QsController *c = (struct QsController *)
         pthread_getspecific(_qsControllerKey);
     DASSERT(c);
+    // Or the controller thread from qsControllerRunInThread().
+    DASSERT(_qsMainThread == pthread_self() || c->queue,
+            "Not main thread");
     DASSERT(c->mark == _QS_IN_CCONSTRUCT ||
             c->mark == _QS_IN_CDESTROY ||
             c->mark == _QS_IN_PRESTART ||
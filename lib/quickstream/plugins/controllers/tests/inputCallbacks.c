@@ -0,0 +1,142 @@
+// This controller module is part of a test in
+// tests/393_controller_inputCallbacks
+//
+// It adds pre and post filter input callbacks to all filters and checks
+// that they are called in pairs around each filter input() call.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../../../../include/quickstream/app.h"
+#include "../../../../../include/quickstream/controller.h"
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../lib/debug.h"
+
+
+
+void help(FILE *f) {
+    fprintf(f,
+"   Usage: tests/inputCallbacks [ --remove-after N ]\n"
+"\n"
+" A test controller module that adds pre and post filter input callbacks\n"
+" to all filters, and checks that they are called in pairs.  The post\n"
+" input callback of source filters returns 1 after N calls, so it is\n"
+" removed.  The default N is 10.\n"
+"\n"
+"\n");
+}
+
+
+#define MAX_FILTERS  (16)
+
+static struct Count {
+    struct QsFilter *filter;
+    uint64_t pre, post;
+    size_t lenIn; // input length from the last pre input callback
+    bool inInput;
+} counts[MAX_FILTERS];
+
+static uint32_t numFilters = 0;
+
+static uint64_t removeAfter;
+
+
+static struct Count *GetCount(struct QsFilter *f) {
+
+    for(uint32_t i=0; i<numFilters; ++i)
+        if(counts[i].filter == f)
+            return counts + i;
+
+    ASSERT(numFilters < MAX_FILTERS);
+    struct Count *c = counts + numFilters++;
+    c->filter = f;
+    return c;
+}
+
+
+static
+int PreInputCB(struct QsFilter *filter,
+            const size_t lenIn[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData) {
+
+    struct Count *c = userData;
+    ASSERT(c->filter == filter);
+
+    if(c->post == c->pre)
+        ASSERT(!c->inInput, "filter \"%s\" pre input callback called"
+                " twice", qsFilterName(filter));
+    c->inInput = true;
+    c->lenIn = numInputs?lenIn[0]:0;
+    ++c->pre;
+
+    return 0;
+}
+
+
+static
+int PostInputCB(struct QsFilter *filter,
+            const size_t lenIn[],
+            const size_t lenOut[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData) {
+
+    struct Count *c = userData;
+    ASSERT(c->filter == filter);
+
+    ASSERT(c->inInput, "filter \"%s\" post input callback without pre",
+            qsFilterName(filter));
+    c->inInput = false;
+    if(numInputs)
+        // The filter cannot advance more input than it was given.
+        ASSERT(lenIn[0] <= c->lenIn);
+    ++c->post;
+
+    if(numInputs == 0 && c->post == removeAfter)
+        return 1; // Remove this callback.
+
+    return 0;
+}
+
+
+int construct(int argc, const char **argv) {
+
+    removeAfter = qsOptsGetSizeT(argc, argv, "remove-after", 10);
+    return 0; // success
+}
+
+
+int preStart(struct QsStream *stream, struct QsFilter *f,
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    struct Count *c = GetCount(f);
+    c->pre = 0;
+    c->post = 0;
+    c->inInput = false;
+
+    ASSERT(qsAddPreFilterInput(f, PreInputCB, c) == 0);
+    ASSERT(qsAddPostFilterInput(f, PostInputCB, c) == 0);
+
+    return 0;
+}
+
+
+int postStop(struct QsStream *stream, struct QsFilter *f,
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    struct Count *c = GetCount(f);
+
+    fprintf(stderr, "filter \"%s\" had %" PRIu64 " pre and %" PRIu64
+            " post input callbacks\n", qsFilterName(f), c->pre, c->post);
+
+    ASSERT(c->pre);
+
+    if(numInputs == 0 && c->pre >= removeAfter)
+        ASSERT(c->post == removeAfter);
+    else
+        ASSERT(c->post == c->pre);
+
+    return 0;
+}
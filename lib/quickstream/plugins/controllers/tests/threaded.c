@@ -0,0 +1,263 @@
+// This controller module is part of a test in
+// tests/394_controller_thread
+//
+// It runs in a controller thread and checks that its functions and
+// callbacks are called by a controller thread, one at a time, and that
+// all the queued post input callbacks and parameter values are delivered
+// before the stream stops.
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../../../../include/quickstream/app.h"
+#include "../../../../../include/quickstream/controller.h"
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../include/quickstream/parameter.h"
+#include "../../../../../lib/debug.h"
+
+
+
+void help(FILE *f) {
+    fprintf(f,
+"   Usage: tests/threaded [ --shared ] [ --length BYTES ]\n"
+"                         [ --remove-after N ] [ --max-rate HZ ]\n"
+"                         [ --sleep USEC ]\n"
+"\n"
+" A test controller module that runs in its own thread, or in the shared\n"
+" controller threads with --shared.  It adds post filter input callbacks\n"
+" to all filters, and gets the bytesOutTotal parameter of source filters\n"
+" from the bytesCounter controller, which must be loaded before this.\n"
+" It checks that each filter got BYTES bytes of input, and that the\n"
+" source filters wrote BYTES bytes.  The post input callback of source\n"
+" filters returns 1 after N calls, so it is removed.  The default N is\n"
+" 10.  With --max-rate it also gets bytesOutTotal with\n"
+" qsParameterGetAsync() at HZ and checks that it is called by the\n"
+" controller thread no faster than HZ.  With --sleep the post input\n"
+" callback of filters with inputs sleeps USEC micro-seconds, so that the\n"
+" calls back up, and the input lengths must still add up to BYTES.\n"
+"\n"
+"\n");
+}
+
+
+#define MAX_FILTERS  (16)
+
+static struct Count {
+    struct QsFilter *filter;
+    uint64_t posts;
+    uint64_t lenIn; // total input advanced
+    uint64_t bytesOut; // from the bytesOutTotal parameter
+    uint64_t asyncBytesOut; // from qsParameterGetAsync()
+    uint64_t asyncGets;
+    double asyncTime; // of the last async get callback
+} counts[MAX_FILTERS];
+
+static uint32_t numFilters = 0;
+
+static bool shared;
+static uint64_t length, removeAfter;
+static double maxRate;
+static useconds_t sleepUsec;
+
+static pthread_t mainThread, thread;
+static bool haveThread = false;
+static atomic_bool inEvent = false;
+
+
+static struct Count *GetCount(struct QsFilter *f) {
+
+    for(uint32_t i=0; i<numFilters; ++i)
+        if(counts[i].filter == f)
+            return counts + i;
+
+    ASSERT(numFilters < MAX_FILTERS);
+    struct Count *c = counts + numFilters++;
+    c->filter = f;
+    return c;
+}
+
+
+// Check that we are in a controller thread, and that no other thread is
+// calling us now.
+static void Enter(void) {
+
+    ASSERT(!pthread_equal(pthread_self(), mainThread));
+
+    if(!shared) {
+        // We have our own thread, so it's always the same one.
+        if(!haveThread) {
+            thread = pthread_self();
+            haveThread = true;
+        }
+        ASSERT(pthread_equal(pthread_self(), thread));
+    }
+
+    ASSERT(!atomic_exchange(&inEvent, true),
+            "controller called by two threads at once");
+}
+
+
+static void Leave(void) {
+    atomic_store(&inEvent, false);
+}
+
+
+static
+int PostInputCB(struct QsFilter *filter,
+            const size_t lenIn[],
+            const size_t lenOut[],
+            const bool isFlushing[],
+            uint32_t numInputs, uint32_t numOutputs,
+            void *userData) {
+
+    Enter();
+
+    struct Count *c = userData;
+    ASSERT(c->filter == filter);
+
+    if(numInputs)
+        c->lenIn += lenIn[0];
+    ++c->posts;
+
+    Leave();
+
+    if(numInputs && sleepUsec)
+        usleep(sleepUsec);
+
+    if(numInputs == 0 && c->posts == removeAfter)
+        return 1; // Remove this callback.
+
+    return 0;
+}
+
+
+static
+int GetCB(const void *value, void *stream,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *userData) {
+
+    Enter();
+
+    struct Count *c = userData;
+    uint64_t bytesOut = *(const uint64_t *) value;
+    ASSERT(bytesOut >= c->bytesOut);
+    c->bytesOut = bytesOut;
+
+    Leave();
+
+    return 0;
+}
+
+
+static inline
+double GetTime(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+
+static
+int AsyncGetCB(const void *value, void *stream,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *userData) {
+
+    Enter();
+
+    struct Count *c = userData;
+    uint64_t bytesOut = *(const uint64_t *) value;
+    ASSERT(bytesOut >= c->asyncBytesOut);
+    c->asyncBytesOut = bytesOut;
+
+    double t = GetTime();
+    // A little slack for the rounding in the delivery thread timeouts.
+    ASSERT(!c->asyncGets || t - c->asyncTime > 0.99/maxRate,
+            "called %lg seconds after the last call",
+            t - c->asyncTime);
+    c->asyncTime = t;
+    ++c->asyncGets;
+
+    Leave();
+
+    return 0;
+}
+
+
+int construct(int argc, const char **argv) {
+
+    mainThread = pthread_self();
+
+    shared = qsOptsGetBool(argc, argv, "shared");
+    length = qsOptsGetSizeT(argc, argv, "length", 0);
+    removeAfter = qsOptsGetSizeT(argc, argv, "remove-after", 10);
+    maxRate = qsOptsGetDouble(argc, argv, "max-rate", 0);
+    sleepUsec = qsOptsGetUint32(argc, argv, "sleep", 0);
+
+    ASSERT(qsControllerRunInThread(shared?QS_CONTROLLER_SHARED:0) == 0);
+    ASSERT(qsControllerRunInThread(0) == 1);
+
+    return 0; // success
+}
+
+
+int preStart(struct QsStream *stream, struct QsFilter *f,
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    Enter();
+
+    struct Count *c = GetCount(f);
+    c->posts = 0;
+    c->lenIn = 0;
+    c->bytesOut = 0;
+    c->asyncBytesOut = 0;
+    c->asyncGets = 0;
+
+    ASSERT(qsAddPostFilterInput(f, PostInputCB, c) == 0);
+
+    if(numInputs == 0)
+        ASSERT(qsParameterGet(stream, qsFilterName(f), "bytesOutTotal",
+                    QsUint64, GetCB, 0, c, QS_LATEST_ONLY) == 1);
+
+    if(numInputs == 0 && maxRate > 0)
+        // Not QS_LATEST_ONLY, so the values wait in a queue and are
+        // called one at a time at maxRate.
+        ASSERT(qsParameterGetAsync(stream, qsFilterName(f),
+                    "bytesOutTotal", QsUint64, AsyncGetCB, 0, c, 0,
+                    maxRate) == 1);
+
+    Leave();
+
+    return 0;
+}
+
+
+int postStop(struct QsStream *stream, struct QsFilter *f,
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    Enter();
+
+    struct Count *c = GetCount(f);
+
+    fprintf(stderr, "filter \"%s\" had %" PRIu64 " post input callbacks,"
+            " %" PRIu64 " bytes in and %" PRIu64 " bytes out\n",
+            qsFilterName(f), c->posts, c->lenIn, c->bytesOut);
+    if(maxRate > 0 && numInputs == 0)
+        fprintf(stderr, "filter \"%s\" had %" PRIu64 " async get "
+                "callbacks\n", qsFilterName(f), c->asyncGets);
+
+    if(numInputs == 0) {
+        if(length)
+            ASSERT(c->bytesOut == length);
+        ASSERT(c->posts == removeAfter);
+    } else if(length)
+        ASSERT(c->lenIn == length);
+
+    Leave();
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+// AM (amplitude modulation) demodulator.  An envelope detector.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Envelope_detector
+//
+// The output is the magnitude of the I/Q input, optionally with the DC
+// (the carrier) removed with a one pole high-pass filter.  The high-pass
+// filter state is kept between input() calls.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "vmath.h"
+
+
+static size_t maxWrite;
+static float gain = 1.0F;
+// The DC removal constant, or 0 for no DC removal.
+static float alpha = 0.0F;
+// The running average of the envelope.
+static float dc;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: amDemod [ --gain G --dcBlock A --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It assumes that the input is a series of 2 floats (I/Q).  The output\n"
+"  is a series of floats, one for each I/Q sample, that is the magnitude\n"
+"  of the I/Q sample times G.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --dcBlock A     Remove the DC from the output, by subtracting a running\n"
+"                  average of the envelope.  A is the weight of each new\n"
+"                  sample in the running average, 0 < A < 1.  Something\n"
+"                  like 0.001 is good.  By default the DC is not removed.\n"
+"\n"
+"\n"
+"  --gain G        G is the output gain.  The default G is 1.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of sizeof(float).\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    gain = qsOptsGetFloat(argc, argv, "gain", 1.0F);
+    alpha = qsOptsGetFloat(argc, argv, "dcBlock", 0.0F);
+
+    if(alpha < 0.0F || alpha >= 1.0F) {
+        ERROR("Bad --dcBlock %g, it must be in (0, 1)", alpha);
+        return -1; // fail
+    }
+
+    maxWrite -= maxWrite % sizeof(float);
+    if(maxWrite == 0)
+        maxWrite = sizeof(float);
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    dc = 0.0F;
+
+    // We can read as little as one I/Q sample.
+    qsSetInputReadPromise(0, 2*sizeof(float));
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of I/Q samples.
+    size_t n = lens[0]/(2*sizeof(float));
+    if(n > maxWrite/sizeof(float))
+        n = maxWrite/sizeof(float);
+    if(n == 0)
+        return 0;
+
+    const float *x = buffers[0];
+    float *out = qsGetOutputBuffer(0, maxWrite, 0);
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4) {
+        VmV4 re, im;
+        VmLoadComplex(x + 2*i, &re, &im);
+        VmV4 p = re * re + im * im;
+        // There is no vector square root in the GCC vector extensions,
+        // but the compiler knows sqrtf().
+        for(int j=0; j<4; ++j)
+            out[i+j] = gain * sqrtf(p[j]);
+    }
+
+    for(; i < n; ++i)
+        out[i] = gain * sqrtf(x[2*i] * x[2*i] + x[2*i+1] * x[2*i+1]);
+
+    if(alpha != 0.0F)
+        // This is a recursion, so it's not vectorized.
+        for(i=0; i<n; ++i) {
+            dc += alpha * (out[i] - dc);
+            out[i] -= dc;
+        }
+
+    qsAdvanceInput(0/*port*/, n * 2*sizeof(float));
+    qsOutput(0/*port*/, n * sizeof(float));
+
+    return 0; // continue.
+}
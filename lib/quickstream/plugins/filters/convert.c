@@ -0,0 +1,364 @@
+// Sample type conversion.  This converts between int8, uint8, int16, and
+// float samples, real or complex (I/Q), in either direction, with scaling
+// and saturation.
+//
+// By default integer samples are taken to be fixed point numbers in the
+// range [-1, 1), which is how SDR hardware delivers them; so uint8 128 is
+// 0.0, int8 -128 is -1.0, and int16 16384 is 0.5.  With --raw the numbers
+// are converted as they are; so uint8 200 is 200.0.  Either way, the
+// conversion is
+//
+//    out = a * in + b
+//
+// with a and b set up in construct() from the two types and the --scale
+// option, and then rounded and saturated to the range of the output type.
+//
+// We convert 16 samples at a time with the GCC vector extensions.  On
+// x86_64 the conversion functions are compiled for AVX2 and for the
+// default instruction set, and the run-time linker picks one for the CPU
+// that we run on (GCC target_clones function multi-versioning).
+//
+// If the input and output sample sizes are the same we convert in place
+// using a pass-through buffer.  We do not use a pass-through buffer when
+// the output sample is smaller than the input sample, because then the
+// output write pointer would fall further and further behind the input
+// read pointer in the shared ring buffer.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#  define CONVERT_TARGETS  __attribute__((target_clones("avx2","default")))
+#else
+#  define CONVERT_TARGETS
+#endif
+
+
+enum Type { INT8 = 0, UINT8, INT16, FLOAT, NUM_TYPES };
+
+static const char *typeNames[NUM_TYPES] = {
+    "int8", "uint8", "int16", "float"
+};
+
+static const size_t typeSizes[NUM_TYPES] = {
+    sizeof(int8_t), sizeof(uint8_t), sizeof(int16_t), sizeof(float)
+};
+
+// The fixed point zero and the value of 1.0 for each type.
+static const float typeOffsets[NUM_TYPES] = { 0.0F, 128.0F, 0.0F, 0.0F };
+static const float typeOnes[NUM_TYPES] = { 128.0F, 128.0F, 32768.0F, 1.0F };
+
+// Saturation limits.  The float output is not saturated.
+static const float typeMins[NUM_TYPES] = {
+    INT8_MIN, 0.0F, INT16_MIN, -INFINITY
+};
+static const float typeMaxs[NUM_TYPES] = {
+    INT8_MAX, UINT8_MAX, INT16_MAX, INFINITY
+};
+
+
+// 16 samples of each type, with the alignment of the type so we can load
+// and store them anywhere in the ring buffers.
+typedef int8_t V16i8 __attribute__((vector_size(16), aligned(1)));
+typedef uint8_t V16u8 __attribute__((vector_size(16), aligned(1)));
+typedef int16_t V16i16 __attribute__((vector_size(32), aligned(2)));
+typedef float V16f __attribute__((vector_size(64), aligned(4)));
+typedef int32_t V16i32 __attribute__((vector_size(64)));
+
+
+static enum Type from, to;
+// Values per sample, 2 for complex.
+static size_t numValues = 1;
+static float a, b;
+static size_t inSize, outSize;
+static size_t maxWrite;
+static bool passThrough;
+
+// The conversion function for the from and to types.
+static void (*convert)(const void *in, void *out, size_t n);
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: convert --from TYPE --to TYPE [ --scale S --raw\n"
+"                                           --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It converts the input samples of one type to output samples of\n"
+"  another type.  TYPE may be int8, uint8, int16, or float, or the same\n"
+"  with a \"c\" in front for complex (I/Q) samples, like for example\n"
+"  cuint8 for the 2 byte I/Q samples from a RTL-SDR.  If one type is\n"
+"  complex both must be.\n"
+"\n"
+"  Integer samples are taken to be fixed point values in the range -1 to\n"
+"  1, unless the --raw option is given.  Outputs that do not fit in the\n"
+"  output type are saturated.\n"
+"\n"
+"  If the input and output types are the same size the conversion is\n"
+"  done in place with a pass-through buffer.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --from TYPE     TYPE is the type of the input samples.  This option is\n"
+"                  required.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of the output sample size.\n"
+"\n"
+"\n"
+"  --raw           Do not treat integers as fixed point values, so for\n"
+"                  example --from uint8 --to float --raw converts 255\n"
+"                  to 255.0, like the uint8ToFloat filter does.\n"
+"\n"
+"\n"
+"  --scale S       Multiply the values by S.  The default S is 1.\n"
+"\n"
+"\n"
+"  --to TYPE       TYPE is the type of the output samples.  This option\n"
+"                  is required.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE);
+}
+
+
+// Load and store macros for each type.  The Store macros round and
+// saturate.  These are macros and not functions because passing 64 byte
+// vectors to functions changes the ABI with the instruction set, and
+// GCC warns about that.
+
+#define LoadInt8(p)    __builtin_convertvector(*(const V16i8 *) (p), V16f)
+#define LoadUint8(p)   __builtin_convertvector(*(const V16u8 *) (p), V16f)
+#define LoadInt16(p)   __builtin_convertvector(*(const V16i16 *) (p), V16f)
+#define LoadFloat(p)   (*(const V16f *) (p))
+
+// Returns x where mask is set, else y.
+#define SELECT(mask, x, y) \
+    ((V16f) (((V16i32) (x) & (mask)) | ((V16i32) (y) & ~(mask))))
+
+#define ROUND_AND_CLIP(x, min, max)                                    \
+    ({                                                                 \
+        const V16f zero = { 0.0F };                                    \
+        V16f v = (x);                                                  \
+        v = SELECT(v < (min), zero + (min), v);                        \
+        v = SELECT(v > (max), zero + (max), v);                        \
+        /* Round half away from zero. */                               \
+        v += SELECT(v < 0.0F, zero - 0.5F, zero + 0.5F);               \
+        __builtin_convertvector(v, V16i32);                            \
+    })
+
+#define StoreInt8(p, x)  (*(V16i8 *) (p) = __builtin_convertvector(    \
+            ROUND_AND_CLIP((x), INT8_MIN, INT8_MAX), V16i8))
+#define StoreUint8(p, x) (*(V16u8 *) (p) = __builtin_convertvector(    \
+            ROUND_AND_CLIP((x), 0.0F, UINT8_MAX), V16u8))
+#define StoreInt16(p, x) (*(V16i16 *) (p) = __builtin_convertvector(   \
+            ROUND_AND_CLIP((x), INT16_MIN, INT16_MAX), V16i16))
+#define StoreFloat(p, x) (*(V16f *) (p) = (x))
+
+
+// The one at a time versions for the last few values.
+
+static inline float Load1(const void *p, size_t i) {
+    switch(from) {
+        case INT8: return ((const int8_t *) p)[i];
+        case UINT8: return ((const uint8_t *) p)[i];
+        case INT16: return ((const int16_t *) p)[i];
+        default: return ((const float *) p)[i];
+    }
+}
+
+static inline void Store1(void *p, size_t i, float x) {
+    if(to == FLOAT) {
+        ((float *) p)[i] = x;
+        return;
+    }
+    if(x < typeMins[to]) x = typeMins[to];
+    else if(x > typeMaxs[to]) x = typeMaxs[to];
+    x = roundf(x);
+    switch(to) {
+        case INT8: ((int8_t *) p)[i] = x; break;
+        case UINT8: ((uint8_t *) p)[i] = x; break;
+        default: ((int16_t *) p)[i] = x; break;
+    }
+}
+
+
+// Converts n values.  The input and output may be the same memory if the
+// output type is not larger than the input type; we load 16 input values
+// before we store the 16 output values.
+#define CONVERT(IN, OUT)                                               \
+    CONVERT_TARGETS                                                    \
+    static void Convert##IN##To##OUT(const void *in, void *out,        \
+            size_t n) {                                                \
+        const uint8_t *i = in;                                         \
+        uint8_t *o = out;                                              \
+        size_t k = 0;                                                  \
+        for(; k + 16 <= n; k += 16) {                                  \
+            Store##OUT(o, a * Load##IN(i) + b);                        \
+            i += 16 * inSize;                                          \
+            o += 16 * outSize;                                         \
+        }                                                              \
+        for(; k < n; ++k)                                              \
+            Store1(out, k, a * Load1(in, k) + b);                      \
+    }
+
+CONVERT(Int8, Int8)
+CONVERT(Int8, Uint8)
+CONVERT(Int8, Int16)
+CONVERT(Int8, Float)
+CONVERT(Uint8, Int8)
+CONVERT(Uint8, Uint8)
+CONVERT(Uint8, Int16)
+CONVERT(Uint8, Float)
+CONVERT(Int16, Int8)
+CONVERT(Int16, Uint8)
+CONVERT(Int16, Int16)
+CONVERT(Int16, Float)
+CONVERT(Float, Int8)
+CONVERT(Float, Uint8)
+CONVERT(Float, Int16)
+CONVERT(Float, Float)
+
+
+static void (* const converters[NUM_TYPES][NUM_TYPES])
+        (const void *in, void *out, size_t n) = {
+    { ConvertInt8ToInt8, ConvertInt8ToUint8,
+        ConvertInt8ToInt16, ConvertInt8ToFloat },
+    { ConvertUint8ToInt8, ConvertUint8ToUint8,
+        ConvertUint8ToInt16, ConvertUint8ToFloat },
+    { ConvertInt16ToInt8, ConvertInt16ToUint8,
+        ConvertInt16ToInt16, ConvertInt16ToFloat },
+    { ConvertFloatToInt8, ConvertFloatToUint8,
+        ConvertFloatToInt16, ConvertFloatToFloat }
+};
+
+
+// Returns 0 on success.
+static int GetType(int argc, const char **argv, const char *optName,
+        enum Type *type, bool *isComplex) {
+
+    const char *name = qsOptsGetString(argc, argv, optName, 0);
+    if(!name) {
+        ERROR("The --%s option is required", optName);
+        return -1;
+    }
+
+    *isComplex = (name[0] == 'c');
+    const char *n = (*isComplex)?(name + 1):name;
+
+    for(int i=0; i<NUM_TYPES; ++i)
+        if(strcmp(n, typeNames[i]) == 0) {
+            *type = i;
+            return 0;
+        }
+
+    ERROR("Unknown --%s type \"%s\"", optName, name);
+    return -1;
+}
+
+
+int construct(int argc, const char **argv) {
+
+    bool fromComplex, toComplex;
+
+    if(GetType(argc, argv, "from", &from, &fromComplex) ||
+            GetType(argc, argv, "to", &to, &toComplex))
+        return -1; // fail
+
+    if(fromComplex != toComplex) {
+        ERROR("Both --from and --to types must be complex, or neither");
+        return -1; // fail
+    }
+
+    numValues = fromComplex?2:1;
+    inSize = typeSizes[from];
+    outSize = typeSizes[to];
+
+    float scale = qsOptsGetFloat(argc, argv, "scale", 1.0F);
+    float inOffset = 0.0F, inOne = 1.0F, outOffset = 0.0F, outOne = 1.0F;
+
+    if(!qsOptsGetBool(argc, argv, "raw")) {
+        inOffset = typeOffsets[from];
+        inOne = typeOnes[from];
+        outOffset = typeOffsets[to];
+        outOne = typeOnes[to];
+    }
+
+    // out = ((in - inOffset)/inOne * scale) * outOne + outOffset
+    a = scale * outOne/inOne;
+    b = outOffset - inOffset * a;
+
+    convert = converters[from][to];
+
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    maxWrite -= maxWrite % (numValues * outSize);
+    if(maxWrite == 0)
+        maxWrite = numValues * outSize;
+
+    passThrough = (inSize == outSize);
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    // We can read as little as one sample.
+    qsSetInputReadPromise(0, numValues * inSize);
+
+    if(passThrough) {
+        if(qsCreatePassThroughBuffer(0, 0, maxWrite))
+            // Some other filter has a pass-through buffer from our input
+            // feed, so we'll just make our own buffer.
+            passThrough = false;
+        else
+            return 0; // success
+    }
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of values, not samples.
+    size_t n = lens[0]/inSize;
+    if(n > maxWrite/outSize)
+        n = maxWrite/outSize;
+    n -= n % numValues;
+    if(n == 0)
+        return 0;
+
+    void *out;
+    if(passThrough) {
+        out = qsGetOutputBuffer(0, n * outSize, n * outSize);
+        DASSERT(out == buffers[0]);
+    } else
+        out = qsGetOutputBuffer(0, maxWrite, 0);
+
+    convert(buffers[0], out, n);
+
+    qsAdvanceInput(0/*port*/, n * inSize);
+    qsOutput(0/*port*/, n * outSize);
+
+    return 0; // continue.
+}
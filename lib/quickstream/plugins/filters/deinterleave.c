@@ -0,0 +1,127 @@
+// Deinterleave channels.  The input is frames of N values, one value from
+// each of N channels, and each output port gets one channel.  So for
+// example stereo audio can be split into left and right, or I/Q into I
+// and Q.
+//
+// See interleave.h for the kernels.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "interleave.h"
+
+
+#define DEFAULT_SIZE  ((size_t) sizeof(float))
+
+
+static size_t size = DEFAULT_SIZE;
+static size_t maxWrite;
+// Length numOutputs array of output buffer pointers.
+static void **out;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: deinterleave [ --size BYTES --maxWrite LEN ]\n"
+"\n"
+"  This has one input and N outputs.\n"
+"\n"
+"  The input is a series of frames of N values, each value being BYTES\n"
+"  bytes, and each output port gets one of the N values from each frame.\n"
+"  Output port 0 gets the first value in each frame, output port 1 gets\n"
+"  the second value in each frame, and so on.  N is the number of output\n"
+"  ports that are connected.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise for each output to LEN\n"
+"                  bytes.  The default value for LEN is %zu.  LEN will get\n"
+"                  rounded down to a multiple of BYTES.\n"
+"\n"
+"\n"
+"  --size BYTES    BYTES is the size of each value in bytes.  The default\n"
+"                  BYTES is %zu, the size of a float.  For I/Q float values\n"
+"                  use 8.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE, DEFAULT_SIZE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    size = qsOptsGetSizeT(argc, argv, "size", DEFAULT_SIZE);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+
+    if(size < 1 || size > 1024) {
+        ERROR("Bad --size %zu", size);
+        return -1; // fail
+    }
+
+    maxWrite -= maxWrite % size;
+    if(maxWrite == 0)
+        maxWrite = size;
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts >= 1);
+
+    out = calloc(numOutPorts, sizeof(*out));
+    ASSERT(out, "calloc(%" PRIu32 ",%zu) failed",
+            numOutPorts, sizeof(*out));
+
+    // We can read as little as one frame.
+    qsSetInputReadPromise(0, numOutPorts * size);
+
+    for(uint32_t i=0; i<numOutPorts; ++i)
+        qsCreateOutputBuffer(i, maxWrite);
+
+    return 0; // success
+}
+
+
+int stop(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    if(out) {
+        free(out);
+        out = 0;
+    }
+    return 0;
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of frames.
+    size_t n = lens[0]/(numOutputs * size);
+    if(n > maxWrite/size)
+        n = maxWrite/size;
+    if(n == 0)
+        return 0;
+
+    for(uint32_t i=0; i<numOutputs; ++i)
+        out[i] = qsGetOutputBuffer(i, maxWrite, 0);
+
+    Deinterleave(out, buffers[0], numOutputs, size, n);
+
+    qsAdvanceInput(0/*port*/, n * numOutputs * size);
+    for(uint32_t i=0; i<numOutputs; ++i)
+        qsOutput(i, n * size);
+
+    return 0; // continue.
+}
@@ -0,0 +1,246 @@
+// A polyphase filter bank channelizer.  It splits the I/Q input into N
+// channels, each decimated by N, and writes each channel to its own output
+// port.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Polyphase_quadrature_filter
+// http://fftw.org/fftw3_doc/Complex-DFTs.html
+//
+// Channel k is what we would get if we mixed the input down by k*rate/N,
+// low-pass filtered it with the prototype filter h, and kept every N-th
+// sample.  With the filter taps reversed, hr[j] = h[NP - 1 - j], and the
+// window of NP input samples starting at sample mN:
+//
+//   y_k[m] = sum_j hr[j] x[mN + j] exp(-i 2 pi k (mN + j)/N)
+//
+// With j = q + lN the exponential only depends on q, so we first sum the
+// P rows of N in the window
+//
+//   v_q[m] = sum_l hr[q + lN] x[mN + q + lN]
+//
+// and then y_k[m] is the DFT of v_q[m] over q.  So for each N input
+// samples we do about P*N multiplies, where P is the number of taps in a
+// branch, and one FFT of size N, for all the N channels; in place of
+// about 2*P*N multiplies for each channel with a mixer and a decimating
+// FIR filter.
+//
+// Like in polyphaseFIR we read the filter window directly from the input
+// ring buffer.
+
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <fftw3.h>
+
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "fir.h"
+
+
+#define DEFAULT_TAPS  ((uint32_t) 8)
+
+
+// The number of taps in each polyphase branch.
+static uint32_t tapsPerBranch = DEFAULT_TAPS;
+// The number of channels, if set with --channels, else 0.
+static uint32_t optChannels = 0;
+static double cutoff = 1.0;
+static size_t maxWrite;
+
+// The number of channels and the FFT size.
+static uint32_t channels;
+static fftwf_plan plan;
+
+// The prototype filter taps reversed, channels*tapsPerBranch of them,
+// with each tap twice, once for I and once for Q, like the taps for
+// complex input in fir.h.
+static float *taps;
+// Length channels arrays.
+static float complex *branch, *fftOut;
+// Length numOutputs array of output buffer pointers.
+static float complex **out;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: fftwChannelizer [ --channels N --taps P --cutoff F\n"
+"                             --maxWrite LEN ]\n"
+"\n"
+"  This has one input and up to N outputs.\n"
+"\n"
+"  It assumes that the input is a series 2 floats (I/Q).  It splits the\n"
+"  input into N channels, using a polyphase filter bank and an FFT.  Each\n"
+"  channel is written to an output port as a series of 2 floats (I/Q),\n"
+"  at 1/N of the input sample rate.  Output port k gets the channel that\n"
+"  is centered at k*rate/N, where rate is the input sample rate, and\n"
+"  channels with k greater than N/2 are at negative frequencies.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --channels N    N is the number of channels.  N must not be less than\n"
+"                  the number of output ports, and if N is greater only\n"
+"                  the first channels are written.  The default N is the\n"
+"                  number of output ports.\n"
+"\n"
+"\n"
+"  --cutoff F      F is the cut-off frequency of the prototype low-pass\n"
+"                  filter as a fraction of half the channel spacing.  The\n"
+"                  default F is 1.0, which makes adjacent channels meet\n"
+"                  at their -6 dB points.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise for each output to LEN\n"
+"                  bytes.  The default value for LEN is %zu.  LEN will get\n"
+"                  rounded down to a multiple of 2*sizeof(float).\n"
+"\n"
+"\n"
+"  --taps P        P is the number of taps in each polyphase branch\n"
+"                  filter, so the prototype low-pass filter has N*P taps.\n"
+"                  The default P is %" PRIu32 ".\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE, DEFAULT_TAPS);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    tapsPerBranch = qsOptsGetUint32(argc, argv, "taps", DEFAULT_TAPS);
+    optChannels = qsOptsGetUint32(argc, argv, "channels", 0);
+    cutoff = qsOptsGetDouble(argc, argv, "cutoff", 1.0);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+
+    if(tapsPerBranch < 1 || tapsPerBranch > 1024) {
+        ERROR("Bad --taps %" PRIu32, tapsPerBranch);
+        return -1; // fail
+    }
+    if(cutoff <= 0.0 || cutoff > 2.0) {
+        ERROR("Bad --cutoff %lg, it must be in (0, 2]", cutoff);
+        return -1; // fail
+    }
+
+    maxWrite -= maxWrite % sizeof(float complex);
+    if(maxWrite == 0)
+        maxWrite = sizeof(float complex);
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts >= 1);
+
+    channels = optChannels?optChannels:numOutPorts;
+
+    if(channels < numOutPorts || channels > 64*1024) {
+        ERROR("--channels %" PRIu32 " with %" PRIu32 " outputs",
+                channels, numOutPorts);
+        return 1; // fail
+    }
+
+    // The prototype filter is a low-pass with a cut-off at half the
+    // channel spacing.
+    struct FirTaps t;
+    size_t numTaps = ((size_t) channels) * tapsPerBranch;
+    double fc = cutoff * 0.5/channels;
+    if(fc >= 0.5) fc = 0.499;
+    FirTapsLowPass(&t, numTaps, fc, 1.0);
+
+    taps = fftwf_malloc(2 * numTaps * sizeof(*taps));
+    ASSERT(taps, "fftwf_malloc() failed");
+    for(size_t i=0; i<numTaps; ++i) {
+        taps[2*i] = t.re[numTaps - 1 - i];
+        taps[2*i+1] = t.re[numTaps - 1 - i];
+    }
+    FirTapsFree(&t);
+
+    branch = fftwf_malloc(channels * sizeof(*branch));
+    ASSERT(branch, "fftwf_malloc() failed");
+    fftOut = fftwf_malloc(channels * sizeof(*fftOut));
+    ASSERT(fftOut, "fftwf_malloc() failed");
+    out = calloc(numOutPorts, sizeof(*out));
+    ASSERT(out, "calloc(%" PRIu32 ",%zu) failed",
+            numOutPorts, sizeof(*out));
+
+    plan = fftwf_plan_dft_1d(channels, branch, fftOut,
+            FFTW_FORWARD, FFTW_ESTIMATE);
+    ASSERT(plan, "fftwf_plan_dft_1d() failed");
+
+    // We need the window of all the taps to compute one output.
+    qsSetInputReadPromise(0, numTaps * sizeof(float complex));
+
+    for(uint32_t i=0; i<numOutPorts; ++i)
+        qsCreateOutputBuffer(i, maxWrite);
+
+    return 0; // success
+}
+
+
+int stop(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    if(!taps) return 0;
+
+    fftwf_destroy_plan(plan);
+    fftwf_free(taps);
+    fftwf_free(branch);
+    fftwf_free(fftOut);
+    free(out);
+    taps = 0;
+    out = 0;
+
+    return 0;
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    size_t numTaps = ((size_t) channels) * tapsPerBranch;
+    // Number of input samples.
+    size_t n = lens[0]/sizeof(float complex);
+    if(n < numTaps)
+        // We do not have enough data to act.
+        return 0;
+
+    // The number of output samples that we can write to each output.
+    size_t frames = (n - numTaps)/channels + 1;
+    if(frames > maxWrite/sizeof(float complex))
+        frames = maxWrite/sizeof(float complex);
+
+    for(uint32_t i=0; i<numOutputs; ++i)
+        out[i] = qsGetOutputBuffer(i, maxWrite, 0);
+
+    const float complex *x = buffers[0];
+
+    for(size_t m=0; m<frames; ++m) {
+
+        // The input window is the N*P samples starting at x.  We add
+        // up its P rows of N samples times the taps, with the vector
+        // kernels from fir.h.  A row is 2N floats.
+        FirMult((float *) branch, (const float *) x, taps, 2*channels);
+        for(uint32_t l=1; l<tapsPerBranch; ++l)
+            FirMultAdd((float *) branch, (const float *) (x + l * channels),
+                    taps + 2 * l * channels, 2*channels);
+
+        fftwf_execute(plan);
+
+        for(uint32_t i=0; i<numOutputs; ++i)
+            out[i][m] = fftOut[i];
+
+        x += channels;
+    }
+
+    qsAdvanceInput(0/*port*/, frames * channels * sizeof(float complex));
+    for(uint32_t i=0; i<numOutputs; ++i)
+        qsOutput(i, frames * sizeof(float complex));
+
+    return 0; // continue.
+}
@@ -0,0 +1,331 @@
+// Welch's method of power spectrum estimation.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Welch%27s_method
+// http://fftw.org/fftw3_doc/Complex-DFTs.html
+//
+// We window each frame of bins I/Q samples, FFT it, compute the magnitude
+// squared of each bin, and then average NUM of these frames before we
+// write out one spectrum.  So the output data rate is NUM times less than
+// that of the fftwComplexFloat1D filter, and the down-stream filters do
+// not need to square and average the FFT output themselves.
+//
+// Frames may overlap.  With an overlap the input is advanced by
+// (bins - overlap) I/Q samples after each frame, and not by a full frame.
+
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <fftw3.h>
+
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "vmath.h"
+
+
+#define DEFAULT_BINS      ((int) 512)
+#define DEFAULT_AVERAGE   ((size_t) 16)
+#define DEFAULT_OVERLAP   ((int) 256)
+#define DEFAULT_WINDOW    "hann"
+
+
+static int bins = DEFAULT_BINS;
+static size_t average = DEFAULT_AVERAGE;
+static int overlap = DEFAULT_OVERLAP;
+static size_t bufMult = 2;
+static const char *windowName = DEFAULT_WINDOW;
+
+static fftwf_plan plan;
+
+// We define batchSize as the length, in bytes, of an input frame that
+// is needed to do one FFT.
+static size_t batchSize;
+// The length in bytes that we advance the input after each frame.
+static size_t hopSize;
+// The length in bytes of one output spectrum.
+static size_t spectrumSize;
+static size_t maxWrite;
+
+// fftwf_malloc() allocated arrays of length bins.
+static float *window;
+static float complex *frame;
+static float complex *spectrum;
+// The running sum of the magnitude squared for each bin.
+static float *sum;
+// The number of frames that are summed in sum[] so far.
+static size_t count;
+// 1/(average * sum of window squared)
+static float scale;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: fftwPowerSpectrum [ --bins NUM --average N --overlap NUM\n"
+"                               --window NAME --bufMult M ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It assumes that the input is a series 2 floats (I/Q).  The output is\n"
+"  a series of arrays of NUM floats, each array being the average power\n"
+"  spectrum of N windowed FFT frames, as in Welch's method.  The output\n"
+"  data rate is about N times less than the input data rate.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --average N    N is the number of FFT frames that are averaged to\n"
+"                 get one output spectrum.  The default N is %zu.\n"
+"\n"
+"\n"
+"  --bins NUM     NUM is the number of I/Q pairs used to compute\n"
+"                 each FFT.  The default NUM is %d.\n"
+"\n"
+"\n"
+"  --bufMult M    M is the maximum number of spectrums that can be\n"
+"                 written in one input call.  The default is %zu.\n"
+"\n"
+"\n"
+"  --overlap NUM  NUM is the number of I/Q pairs that adjacent frames\n"
+"                 share.  NUM must be less than bins.  The default NUM\n"
+"                 is %d.\n"
+"\n"
+"\n"
+"  --window NAME  NAME is the window function that is applied to each\n"
+"                 frame before the FFT.  NAME may be: rectangular,\n"
+"                 hann, hamming, or blackman.  The default NAME\n"
+"                 is %s.\n"
+"\n"
+"\n",
+    DEFAULT_AVERAGE, DEFAULT_BINS, bufMult, DEFAULT_OVERLAP,
+    DEFAULT_WINDOW);
+}
+
+
+// Returns 0 on success.
+static int MakeWindow(const char *name) {
+
+    double a0, a1, a2;
+
+    if(strcmp(name, "rectangular") == 0) {
+        a0 = 1.0; a1 = 0.0; a2 = 0.0;
+    } else if(strcmp(name, "hann") == 0) {
+        a0 = 0.5; a1 = 0.5; a2 = 0.0;
+    } else if(strcmp(name, "hamming") == 0) {
+        a0 = 0.54; a1 = 0.46; a2 = 0.0;
+    } else if(strcmp(name, "blackman") == 0) {
+        a0 = 0.42; a1 = 0.5; a2 = 0.08;
+    } else {
+        ERROR("Unknown window function \"%s\"", name);
+        return -1; // error
+    }
+
+    // The generalized cosine window:
+    //   w[n] = a0 - a1 cos(2 pi n/N) + a2 cos(4 pi n/N)
+    double sumSq = 0.0;
+    for(int i=0; i<bins; ++i) {
+        double x = 2.0 * M_PI * i / bins;
+        window[i] = a0 - a1 * cos(x) + a2 * cos(2.0 * x);
+        sumSq += window[i] * window[i];
+    }
+
+    scale = 1.0/(average * sumSq);
+
+    return 0; // success
+}
+
+
+int construct(int argc, const char **argv) {
+
+    bins = qsOptsGetInt(argc, argv, "bins", bins);
+    average = qsOptsGetSizeT(argc, argv, "average", average);
+    overlap = qsOptsGetInt(argc, argv, "overlap", overlap);
+    bufMult = qsOptsGetSizeT(argc, argv, "bufMult", bufMult);
+    windowName = qsOptsGetString(argc, argv, "window", windowName);
+
+    // Ya, whatever.
+    ASSERT(bins >= 2);
+    ASSERT(bins < 10*1024);
+    ASSERT(average >= 1);
+    ASSERT(bufMult >= 1);
+    ASSERT(bufMult < 1000);
+
+    if(overlap < 0 || overlap >= bins) {
+        ERROR("--overlap %d must be 0 to less than bins=%d",
+                overlap, bins);
+        return -1; // fail
+    }
+
+    window = fftwf_malloc(bins * sizeof(*window));
+    ASSERT(window, "fftwf_malloc() failed");
+
+    if(MakeWindow(windowName)) {
+        fftwf_free(window);
+        window = 0;
+        return -1; // fail
+    }
+
+    frame = fftwf_malloc(bins * sizeof(*frame));
+    ASSERT(frame, "fftwf_malloc() failed");
+    spectrum = fftwf_malloc(bins * sizeof(*spectrum));
+    ASSERT(spectrum, "fftwf_malloc() failed");
+    sum = fftwf_malloc(bins * sizeof(*sum));
+    ASSERT(sum, "fftwf_malloc() failed");
+
+    return 0; // success
+}
+
+
+int destroy(void) {
+
+    if(window) {
+        fftwf_free(window);
+        fftwf_free(frame);
+        fftwf_free(spectrum);
+        fftwf_free(sum);
+        window = 0;
+    }
+    return 0;
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    batchSize = bins * sizeof(float complex);
+    hopSize = (bins - overlap) * sizeof(float complex);
+    spectrumSize = bins * sizeof(float);
+    maxWrite = bufMult * spectrumSize;
+
+    // Unlike in fftwComplexFloat1D we always transform the same arrays,
+    // so we can use the "regular" fftw API.
+    plan = fftwf_plan_dft_1d(bins, frame, spectrum,
+            FFTW_FORWARD, FFTW_ESTIMATE);
+    ASSERT(plan, "fftwf_plan_dft_1d() failed");
+
+    memset(sum, 0, spectrumSize);
+    count = 0;
+
+    // We need at least a frame of input to be able to act on the input.
+    qsSetInputReadPromise(0, batchSize);
+
+    // We promise not to write more than maxWrite of output.
+    qsCreateOutputBuffer(0/*out port 0*/, maxWrite);
+
+    return 0; // success
+}
+
+
+int stop(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    fftwf_destroy_plan(plan);
+    return 0;
+}
+
+
+// The kernels below work on 4 bins at a time with the GCC vector
+// extensions in vmath.h, so they are vectorized without -O options.
+// frame, spectrum, sum and window are from fftwf_malloc(), so they are
+// aligned for vectors, but the input and output ring buffers are not.
+
+static inline void
+Window(float complex *out, const float complex *in, const float *w,
+        int n) {
+
+    float *o = (float *) out;
+    const float *x = (const float *) in;
+    int i = 0;
+
+    for(; i + 4 <= n; i += 4) {
+        VmV4 wi = *(const VmV4 *) (w + i);
+        // The window value for each of the I/Q floats.
+        *(VmV4 *) (o + 2*i) = *(const VmV4u *) (x + 2*i) *
+            VM_SHUFFLE2(wi, wi, 0, 0, 1, 1);
+        *(VmV4 *) (o + 2*i + 4) = *(const VmV4u *) (x + 2*i + 4) *
+            VM_SHUFFLE2(wi, wi, 2, 2, 3, 3);
+    }
+
+    for(; i<n; ++i) {
+        o[2*i] = x[2*i] * w[i];
+        o[2*i+1] = x[2*i+1] * w[i];
+    }
+}
+
+
+static inline void
+AddPower(float *acc, const float complex *in, int n) {
+
+    const float *x = (const float *) in;
+    int i = 0;
+
+    for(; i + 4 <= n; i += 4) {
+        VmV4 re, im;
+        VmLoadComplex(x + 2*i, &re, &im);
+        *(VmV4 *) (acc + i) += re * re + im * im;
+    }
+
+    for(; i<n; ++i)
+        acc[i] += x[2*i] * x[2*i] + x[2*i+1] * x[2*i+1];
+}
+
+
+static inline void
+Scale(float *out, float *acc, float s, int n) {
+
+    const VmV4 vs = VmSplat(s);
+    int i = 0;
+
+    for(; i + 4 <= n; i += 4) {
+        *(VmV4u *) (out + i) = *(const VmV4 *) (acc + i) * vs;
+        *(VmV4 *) (acc + i) = VmSplat(0.0F);
+    }
+
+    for(; i<n; ++i) {
+        out[i] = acc[i] * s;
+        acc[i] = 0.0F;
+    }
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    size_t len = lens[0];
+    if(len < batchSize)
+        // We do not have enough data to act.
+        return 0;
+
+    const uint8_t *in = buffers[0];
+    float *out = 0;
+    size_t outLen = 0;
+    size_t inLen = 0;
+
+    while(len - inLen >= batchSize && outLen < maxWrite) {
+
+        Window(frame, (const float complex *) (in + inLen), window, bins);
+        fftwf_execute(plan);
+        AddPower(sum, spectrum, bins);
+        inLen += hopSize;
+
+        if(++count == average) {
+            if(!out)
+                out = qsGetOutputBuffer(0, maxWrite, 0);
+            Scale((float *) (((uint8_t *) out) + outLen),
+                    sum, scale, bins);
+            outLen += spectrumSize;
+            count = 0;
+        }
+    }
+
+    qsAdvanceInput(0/*port*/, inLen);
+    if(outLen)
+        qsOutput(0/*port*/, outLen);
+
+    return 0; // continue.
+}
@@ -0,0 +1,513 @@
+// Polyphase FIR (finite impulse response) filter bank code that is shared
+// by the FIR filter modules in this directory.
+//
+// This is not a filter module.  It's just static functions that we
+// include in more than one filter module.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Polyphase_quadrature_filter
+// https://en.wikipedia.org/wiki/Sinc_filter
+//
+//
+// Prototype filter taps h[t] with t = 0, 1, ..., N-1 are split into L
+// phases (sub-filters) with K0 = ceil(N/L) taps each:
+//
+//     h_p[k] = h[p + k*L]    p = 0, 1, ..., L-1  and  k = 0, 1, ..., K0-1
+//
+// We store the phase taps in reverse order so that the dot product is
+// with a forward looking window of the input, x[w], x[w+1], ...  That way
+// we can compute the dot product straight out of the input ring buffer
+// with no copying; the ring buffer keeps the filter history for us.
+//
+// Each phase is zero padded to a multiple of the SIMD vector length.  So a
+// phase reads len (padded) input samples from the window start.
+//
+// We use the GCC (and clang) vector extensions and not the x86 intrinsics
+// so that this builds on any architecture that GCC builds on.  The
+// compiler turns these into SSE/AVX/NEON instructions as it can.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+
+// 4 floats.
+typedef float FirV4 __attribute__((vector_size(16)));
+// The same but with the alignment of a float, so we can load it from
+// any float in the input ring buffer.
+typedef float FirV4u __attribute__((vector_size(16), aligned(4)));
+typedef int FirV4i __attribute__((vector_size(16)));
+
+#ifdef __clang__
+#  define FIR_SWAP_PAIRS(v)  __builtin_shufflevector((v), (v), 1, 0, 3, 2)
+#else
+#  define FIR_SWAP_PAIRS(v)  __builtin_shuffle((v), (FirV4i) {1, 0, 3, 2})
+#endif
+
+
+// Prototype filter taps.
+struct FirTaps {
+
+    float *re; // malloc()ed array of length num
+    float *im; // 0 if the taps are real, else array of length num
+    size_t num;
+};
+
+
+struct FirBank {
+
+    // The number of phases, which is the interpolation factor L.
+    uint32_t numPhases;
+
+    // Number of input samples in each phase, after padding.
+    size_t len;
+
+    // Number of floats for each phase in the arrays a and b.
+    size_t stride;
+
+    bool complexIn, complexTaps;
+
+    // aligned memory holding numPhases * stride floats.  The layout
+    // depends on the kind of input and taps:
+    //
+    //  real in,    real taps:     a = h
+    //  complex in, real taps:     a = h h       (each tap twice)
+    //  complex in, complex taps:  a = hr hr  b = -hi hi
+    //  real in,    complex taps:  a = hr     b = hi
+    //
+    float *a;
+    float *b; // 0 for real taps
+};
+
+
+static inline void FirTapsFree(struct FirTaps *t) {
+
+    if(t->re) free(t->re);
+    if(t->im) free(t->im);
+    memset(t, 0, sizeof(*t));
+}
+
+
+// Parse a list of numbers separated by white space, commas, or
+// semicolons.  A '#' starts a comment that runs to the end of the line.
+// For complex taps the numbers are real and imaginary pairs.
+//
+// Returns 0 on success.
+static inline int
+FirTapsParse(struct FirTaps *t, const char *str, bool isComplex) {
+
+    size_t num = 0, alloc = 0;
+    float *v = 0;
+    const char *s = str;
+
+    while(*s) {
+        if(*s == '#') {
+            while(*s && *s != '\n') ++s;
+            continue;
+        }
+        if(*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' ||
+                *s == ',' || *s == ';') {
+            ++s;
+            continue;
+        }
+        char *end = 0;
+        float val = strtof(s, &end);
+        if(end == s) {
+            ERROR("Bad FIR tap value at: \"%.12s\"", s);
+            if(v) free(v);
+            return -1;
+        }
+        s = end;
+        if(num == alloc) {
+            alloc += 64;
+            v = realloc(v, alloc * sizeof(*v));
+            ASSERT(v, "realloc(,%zu) failed", alloc * sizeof(*v));
+        }
+        v[num++] = val;
+    }
+
+    if(num == 0 || (isComplex && num % 2)) {
+        ERROR("Got %zu FIR tap values%s", num,
+                isComplex?", need real and imaginary pairs":"");
+        if(v) free(v);
+        return -1;
+    }
+
+    if(!isComplex) {
+        t->re = v;
+        t->im = 0;
+        t->num = num;
+        return 0;
+    }
+
+    t->num = num/2;
+    t->re = malloc(t->num * sizeof(*t->re));
+    ASSERT(t->re, "malloc(%zu) failed", t->num * sizeof(*t->re));
+    t->im = malloc(t->num * sizeof(*t->im));
+    ASSERT(t->im, "malloc(%zu) failed", t->num * sizeof(*t->im));
+    for(size_t i=0; i<t->num; ++i) {
+        t->re[i] = v[2*i];
+        t->im[i] = v[2*i+1];
+    }
+    free(v);
+    return 0;
+}
+
+
+// Returns 0 on success.
+static inline int
+FirTapsLoadFile(struct FirTaps *t, const char *path, bool isComplex) {
+
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        ERROR("fopen(\"%s\", \"r\") failed", path);
+        return -1;
+    }
+
+    size_t len = 0, alloc = 1024;
+    char *str = malloc(alloc);
+    ASSERT(str, "malloc(%zu) failed", alloc);
+    size_t rd;
+    while((rd = fread(str + len, 1, alloc - len - 1, file)) > 0) {
+        len += rd;
+        if(len == alloc - 1) {
+            alloc *= 2;
+            str = realloc(str, alloc);
+            ASSERT(str, "realloc(,%zu) failed", alloc);
+        }
+    }
+    str[len] = '\0';
+    fclose(file);
+
+    int ret = FirTapsParse(t, str, isComplex);
+    free(str);
+    return ret;
+}
+
+
+// Design a windowed sinc low-pass filter with a Blackman window.
+//
+// cutoff is the cut-off frequency in cycles per sample, 0 < cutoff < 0.5,
+// and the DC gain of the filter is gain.
+static inline void
+FirTapsLowPass(struct FirTaps *t, size_t num, double cutoff, double gain) {
+
+    DASSERT(num);
+    DASSERT(cutoff > 0.0 && cutoff < 0.5);
+
+    t->num = num;
+    t->im = 0;
+    t->re = malloc(num * sizeof(*t->re));
+    ASSERT(t->re, "malloc(%zu) failed", num * sizeof(*t->re));
+
+    double sum = 0.0;
+    double mid = (num - 1)/2.0;
+
+    for(size_t i=0; i<num; ++i) {
+        double x = i - mid;
+        double sinc = (x == 0.0)? 2.0 * cutoff :
+            sin(2.0 * M_PI * cutoff * x)/(M_PI * x);
+        double w = (num == 1)? 1.0 :
+            0.42 - 0.5 * cos(2.0 * M_PI * i/(num - 1)) +
+            0.08 * cos(4.0 * M_PI * i/(num - 1));
+        t->re[i] = sinc * w;
+        sum += t->re[i];
+    }
+
+    for(size_t i=0; i<num; ++i)
+        t->re[i] *= gain/sum;
+}
+
+
+// Get the prototype filter taps from the filter module options:
+//
+//   --taps LIST  --tapsFile FILE  --complexTaps  --numTaps N  --cutoff F
+//
+// If no taps are given we design a low-pass filter with numTaps taps that
+// has a cut-off at F times rate/2, where rate is the lower of the input
+// and output sample rates.  R is the max of the interpolation and
+// decimation factors and L is the interpolation factor.
+//
+// Returns 0 on success.
+static inline int
+FirTapsGet(struct FirTaps *t, int argc, const char **argv,
+        uint32_t R, uint32_t L) {
+
+    bool isComplex = qsOptsGetBool(argc, argv, "complexTaps");
+    const char *str = qsOptsGetString(argc, argv, "taps", 0);
+    const char *path = qsOptsGetString(argc, argv, "tapsFile", 0);
+
+    if(str && path) {
+        ERROR("Use just one of --taps and --tapsFile");
+        return -1;
+    }
+    if(str)
+        return FirTapsParse(t, str, isComplex);
+    if(path)
+        return FirTapsLoadFile(t, path, isComplex);
+
+    size_t num = qsOptsGetSizeT(argc, argv, "numTaps", 16*R + 1);
+    double cutoff = qsOptsGetDouble(argc, argv, "cutoff", 0.9);
+
+    if(num < 1 || num > 64*1024) {
+        ERROR("Bad --numTaps %zu", num);
+        return -1;
+    }
+    if(cutoff <= 0.0 || cutoff > 1.0) {
+        ERROR("Bad --cutoff %lg, it must be in (0, 1]", cutoff);
+        return -1;
+    }
+    // We keep it just a little less than Nyquist.
+    cutoff *= 0.5/R;
+    if(cutoff >= 0.5) cutoff = 0.499;
+
+    // Interpolation by L has a DC gain of 1/L that we make up for in the
+    // taps.
+    FirTapsLowPass(t, num, cutoff, L);
+    return 0;
+}
+
+
+static inline float *FirAlloc(size_t numFloats) {
+
+    void *ptr = 0;
+    ASSERT(posix_memalign(&ptr, 32, numFloats * sizeof(float)) == 0,
+            "posix_memalign(,32,%zu) failed", numFloats * sizeof(float));
+    memset(ptr, 0, numFloats * sizeof(float));
+    return ptr;
+}
+
+
+// Split the prototype taps into numPhases reversed and padded phases
+// with the layout that the kernel for the kind of input needs.
+static inline void
+FirBankCreate(struct FirBank *b, const struct FirTaps *t,
+        uint32_t numPhases, bool complexIn) {
+
+    DASSERT(numPhases);
+    DASSERT(t->num);
+
+    memset(b, 0, sizeof(*b));
+
+    b->numPhases = numPhases;
+    b->complexIn = complexIn;
+    b->complexTaps = (t->im)?true:false;
+
+    size_t k0 = (t->num + numPhases - 1)/numPhases;
+    // We pad to 4 floats of input.
+    size_t pad = complexIn?2:4;
+    b->len = ((k0 + pad - 1)/pad)*pad;
+    b->stride = complexIn?(2 * b->len):b->len;
+
+    b->a = FirAlloc(numPhases * b->stride);
+    if(b->complexTaps)
+        b->b = FirAlloc(numPhases * b->stride);
+
+    for(uint32_t p=0; p<numPhases; ++p) {
+        float *a = b->a + p * b->stride;
+        float *bb = (b->b)?(b->b + p * b->stride):0;
+        for(size_t j=0; j<k0; ++j) {
+            // Reverse order.
+            size_t t_i = p + (k0 - 1 - j) * numPhases;
+            if(t_i >= t->num) continue; // leave it zero.
+            float re = t->re[t_i];
+            float im = (t->im)?t->im[t_i]:0.0F;
+
+            if(!complexIn && !t->im)
+                a[j] = re;
+            else if(!complexIn) {
+                a[j] = re;
+                bb[j] = im;
+            } else if(!t->im) {
+                a[2*j] = re;
+                a[2*j+1] = re;
+            } else {
+                a[2*j] = re;
+                a[2*j+1] = re;
+                bb[2*j] = -im;
+                bb[2*j+1] = im;
+            }
+        }
+    }
+}
+
+
+static inline void FirBankDestroy(struct FirBank *b) {
+
+    if(b->a) free(b->a);
+    if(b->b) free(b->b);
+    memset(b, 0, sizeof(*b));
+}
+
+
+// The size in bytes of an input sample.
+static inline size_t FirBankInSize(const struct FirBank *b) {
+    return b->complexIn?(2*sizeof(float)):sizeof(float);
+}
+
+
+// The size in bytes of an output sample.
+static inline size_t FirBankOutSize(const struct FirBank *b) {
+    return (b->complexIn || b->complexTaps)?
+        (2*sizeof(float)):sizeof(float);
+}
+
+
+// The kernels.  n is the number of floats to run through, which is a
+// multiple of 4.  x does not need to be aligned, but a and b are.
+
+
+static inline float
+FirDotRR(const float *x, const float *a, size_t n) {
+
+    FirV4 acc = { 0.0F, 0.0F, 0.0F, 0.0F };
+    for(size_t i=0; i<n; i += 4)
+        acc += *(const FirV4u *) (x + i) * *(const FirV4 *) (a + i);
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+
+static inline void
+FirDotCR(float *out, const float *x, const float *a, size_t n) {
+
+    FirV4 acc = { 0.0F, 0.0F, 0.0F, 0.0F };
+    for(size_t i=0; i<n; i += 4)
+        acc += *(const FirV4u *) (x + i) * *(const FirV4 *) (a + i);
+    // Even lanes are I and odd lanes are Q.
+    out[0] = acc[0] + acc[2];
+    out[1] = acc[1] + acc[3];
+}
+
+
+static inline void
+FirDotCC(float *out, const float *x, const float *a, const float *b,
+        size_t n) {
+
+    FirV4 acc = { 0.0F, 0.0F, 0.0F, 0.0F };
+    for(size_t i=0; i<n; i += 4) {
+        FirV4 v = *(const FirV4u *) (x + i);
+        // (xr + i xi)(hr + i hi) = xr hr - xi hi + i(xi hr + xr hi)
+        acc += v * *(const FirV4 *) (a + i) +
+            FIR_SWAP_PAIRS(v) * *(const FirV4 *) (b + i);
+    }
+    out[0] = acc[0] + acc[2];
+    out[1] = acc[1] + acc[3];
+}
+
+
+static inline void
+FirDotRC(float *out, const float *x, const float *a, const float *b,
+        size_t n) {
+
+    FirV4 accR = { 0.0F, 0.0F, 0.0F, 0.0F };
+    FirV4 accI = { 0.0F, 0.0F, 0.0F, 0.0F };
+    for(size_t i=0; i<n; i += 4) {
+        FirV4 v = *(const FirV4u *) (x + i);
+        accR += v * *(const FirV4 *) (a + i);
+        accI += v * *(const FirV4 *) (b + i);
+    }
+    out[0] = (accR[0] + accR[1]) + (accR[2] + accR[3]);
+    out[1] = (accI[0] + accI[1]) + (accI[2] + accI[3]);
+}
+
+
+// Set acc[i] = x[i] a[i] for the n floats.  This, and FirMultAdd(), are
+// for when we sum the products of many windows, like in the
+// fftwChannelizer, and not one window.  n does not need to be a multiple
+// of 4, acc is aligned, and x and a do not need to be aligned.
+static inline void
+FirMult(float *acc, const float *x, const float *a, size_t n) {
+
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        *(FirV4 *) (acc + i) =
+            *(const FirV4u *) (x + i) * *(const FirV4u *) (a + i);
+    for(; i < n; ++i)
+        acc[i] = x[i] * a[i];
+}
+
+
+// Add acc[i] += x[i] a[i] for the n floats.
+static inline void
+FirMultAdd(float *acc, const float *x, const float *a, size_t n) {
+
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        *(FirV4 *) (acc + i) +=
+            *(const FirV4u *) (x + i) * *(const FirV4u *) (a + i);
+    for(; i < n; ++i)
+        acc[i] += x[i] * a[i];
+}
+
+
+// Write one output sample to out from phase p with the input window
+// starting at x.
+static inline void
+FirBankDot(const struct FirBank *b, uint32_t p, float *out,
+        const float *x) {
+
+    DASSERT(p < b->numPhases);
+
+    const float *a = b->a + p * b->stride;
+
+    if(b->complexIn) {
+        if(b->complexTaps)
+            FirDotCC(out, x, a, b->b + p * b->stride, b->stride);
+        else
+            FirDotCR(out, x, a, b->stride);
+    } else {
+        if(b->complexTaps)
+            FirDotRC(out, x, a, b->b + p * b->stride, b->stride);
+        else
+            *out = FirDotRR(x, a, b->stride);
+    }
+}
+
+
+// The phase table for resampling by the rational factor L/M, with L and
+// M having no common factor.
+//
+// Output sample m is at i = m*M in the input that is up-sampled by L, so
+// it comes from phase i%L with the window ending at input sample i/L.
+// This repeats every L outputs, so we tabulate the phase and how many
+// input samples to advance after each of the L outputs in a cycle.
+struct FirPhaseTable {
+
+    uint32_t len; // L
+    uint32_t *phase;
+    uint32_t *advance;
+    // The largest value in advance[].
+    uint32_t maxAdvance;
+};
+
+
+static inline void
+FirPhaseTableCreate(struct FirPhaseTable *t, uint32_t L, uint32_t M) {
+
+    DASSERT(L);
+    DASSERT(M);
+
+    t->len = L;
+    t->phase = malloc(L * sizeof(*t->phase));
+    ASSERT(t->phase, "malloc(%zu) failed", L * sizeof(*t->phase));
+    t->advance = malloc(L * sizeof(*t->advance));
+    ASSERT(t->advance, "malloc(%zu) failed", L * sizeof(*t->advance));
+    t->maxAdvance = 0;
+
+    for(uint64_t m=0; m<L; ++m) {
+        t->phase[m] = (m * M) % L;
+        t->advance[m] = ((m + 1) * M)/L - (m * M)/L;
+        if(t->advance[m] > t->maxAdvance)
+            t->maxAdvance = t->advance[m];
+    }
+}
+
+
+static inline void FirPhaseTableDestroy(struct FirPhaseTable *t) {
+
+    if(t->phase) free(t->phase);
+    if(t->advance) free(t->advance);
+    memset(t, 0, sizeof(*t));
+}
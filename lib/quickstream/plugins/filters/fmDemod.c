@@ -0,0 +1,165 @@
+// FM (frequency modulation) demodulator.  A quadrature discriminator.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Detector_(radio)#Frequency_and_phase_modulation_detectors
+//
+// The output is the phase difference between adjacent I/Q samples:
+//
+//    y[n] = gain * arg(x[n] * conj(x[n-1]))
+//
+// which is the instantaneous frequency of the input in radians per
+// sample.  We keep the last sample from the last input() call so there is
+// no glitch between calls.
+//
+// The arg() is the vectorized polynomial atan2 from vmath.h, 4 samples at
+// a time.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "vmath.h"
+
+
+static size_t maxWrite;
+static float gain;
+
+// The last I/Q sample from the last input() call.
+static float last[2];
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: fmDemod [ --gain G | --deviation D --rate R ]\n"
+"                   [ --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It assumes that the input is a series of 2 floats (I/Q).  The output\n"
+"  is a series of floats, one for each I/Q sample, that is the FM\n"
+"  demodulated signal.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --deviation D   D is the maximum frequency deviation of the FM signal\n"
+"                  in Hz.  With --rate R the output gain is set so that\n"
+"                  a deviation of D gives an output of 1.0.  For broadcast\n"
+"                  FM D is 75000.\n"
+"\n"
+"\n"
+"  --gain G        The output is G times the phase change in radians per\n"
+"                  sample.  The default G is 1/pi, so that the output is\n"
+"                  in the range -1 to 1.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of sizeof(float).\n"
+"\n"
+"\n"
+"  --rate R        R is the sample rate of the input in Hz.  Use with\n"
+"                  --deviation.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    gain = qsOptsGetFloat(argc, argv, "gain", 1.0/M_PI);
+    double deviation = qsOptsGetDouble(argc, argv, "deviation", 0.0);
+    double rate = qsOptsGetDouble(argc, argv, "rate", 0.0);
+
+    if(deviation != 0.0 || rate != 0.0) {
+        if(deviation <= 0.0 || rate <= 0.0) {
+            ERROR("Bad --deviation %lg and --rate %lg", deviation, rate);
+            return -1; // fail
+        }
+        // A deviation of D Hz is 2 pi D/R radians per sample.
+        gain = rate/(2.0 * M_PI * deviation);
+    }
+
+    maxWrite -= maxWrite % sizeof(float);
+    if(maxWrite == 0)
+        maxWrite = sizeof(float);
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    last[0] = 0.0F;
+    last[1] = 0.0F;
+
+    // We can read as little as one I/Q sample.
+    qsSetInputReadPromise(0, 2*sizeof(float));
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+// y = gain * arg(x * conj(p))
+static inline float
+Discriminate(const float *x, const float *p) {
+
+    float re = x[0] * p[0] + x[1] * p[1];
+    float im = x[1] * p[0] - x[0] * p[1];
+    return gain * atan2f(im, re);
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of I/Q samples.
+    size_t n = lens[0]/(2*sizeof(float));
+    if(n > maxWrite/sizeof(float))
+        n = maxWrite/sizeof(float);
+    if(n == 0)
+        return 0;
+
+    const float *x = buffers[0];
+    float *out = qsGetOutputBuffer(0, maxWrite, 0);
+
+    out[0] = Discriminate(x, last);
+
+    const VmV4 g = VmSplat(gain);
+    size_t i = 1;
+
+    for(; i + 4 <= n; i += 4) {
+        VmV4 xr, xi, pr, pi;
+        VmLoadComplex(x + 2*i, &xr, &xi);
+        VmLoadComplex(x + 2*(i-1), &pr, &pi);
+        // x * conj(p)
+        VmV4 re = xr * pr + xi * pi;
+        VmV4 im = xi * pr - xr * pi;
+        *(VmV4u *) (out + i) = g * VmAtan2(im, re);
+    }
+
+    for(; i < n; ++i)
+        out[i] = Discriminate(x + 2*i, x + 2*(i-1));
+
+    last[0] = x[2*(n-1)];
+    last[1] = x[2*(n-1)+1];
+
+    qsAdvanceInput(0/*port*/, n * 2*sizeof(float));
+    qsOutput(0/*port*/, n * sizeof(float));
+
+    return 0; // continue.
+}
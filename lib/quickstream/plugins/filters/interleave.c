@@ -0,0 +1,110 @@
+// Interleave channels.  This is the inverse of the deinterleave filter.
+// Each input port is one channel, and the output is frames of N values,
+// one value from each of the N input channels.
+//
+// See interleave.h for the kernels.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "interleave.h"
+
+
+#define DEFAULT_SIZE  ((size_t) sizeof(float))
+
+
+static size_t size = DEFAULT_SIZE;
+static size_t maxWrite;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: interleave [ --size BYTES --maxWrite LEN ]\n"
+"\n"
+"  This has N inputs and one output.\n"
+"\n"
+"  Each input is a series of values, each value being BYTES bytes.  The\n"
+"  output is a series of frames of N values, the first value in each\n"
+"  frame from input port 0, the second from input port 1, and so on.\n"
+"  N is the number of input ports that are connected.\n"
+"\n"
+"  We can only write a frame when there is a value on all N inputs, so\n"
+"  the inputs need to flow at the same rate, like for example from the\n"
+"  outputs of a deinterleave filter.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  up to a multiple of N*BYTES.\n"
+"\n"
+"\n"
+"  --size BYTES    BYTES is the size of each value in bytes.  The default\n"
+"                  BYTES is %zu, the size of a float.  For I/Q float values\n"
+"                  use 8.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE, DEFAULT_SIZE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    size = qsOptsGetSizeT(argc, argv, "size", DEFAULT_SIZE);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+
+    if(size < 1 || size > 1024) {
+        ERROR("Bad --size %zu", size);
+        return -1; // fail
+    }
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts >= 1);
+    ASSERT(numOutPorts == 1);
+
+    size_t frame = numInPorts * size;
+
+    // We do not know N until now.
+    if(maxWrite % frame)
+        maxWrite += frame - maxWrite % frame;
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of frames.
+    size_t n = maxWrite/(numInputs * size);
+    for(uint32_t i=0; i<numInputs; ++i)
+        if(lens[i]/size < n)
+            n = lens[i]/size;
+    if(n == 0)
+        return 0;
+
+    Interleave(qsGetOutputBuffer(0, maxWrite, 0), buffers,
+            numInputs, size, n);
+
+    for(uint32_t i=0; i<numInputs; ++i)
+        qsAdvanceInput(i, n * size);
+    qsOutput(0/*port*/, n * numInputs * size);
+
+    return 0; // continue.
+}
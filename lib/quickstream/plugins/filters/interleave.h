@@ -0,0 +1,132 @@
+// Interleave and deinterleave kernels that are shared by the interleave
+// and deinterleave filter modules.
+//
+// This is not a filter module.  It's just static functions that we
+// include in more than one filter module.
+//
+// An interleaved frame is N channel values of size bytes each, one after
+// the other.  For the common case of 2 channels of 2, 4, or 8 byte values
+// (stereo int16 or float audio, or I/Q float) we use vector shuffles from
+// the GCC (and clang) vector extensions, 16 bytes at a time.  For other
+// cases we just copy one value at a time.
+
+#include <stdint.h>
+#include <string.h>
+
+
+// 16 bytes as 8 int16, 4 int32, or 2 int64, with byte alignment, so we
+// can load and store them anywhere in the ring buffers.
+typedef int16_t IlV8s __attribute__((vector_size(16), aligned(1)));
+typedef int32_t IlV4s __attribute__((vector_size(16), aligned(1)));
+typedef int64_t IlV2s __attribute__((vector_size(16), aligned(1)));
+
+
+// So we can pass a list of shuffle indexes as one macro argument.
+#define IL_ARGS(...) __VA_ARGS__
+
+#ifdef __clang__
+#  define IL_SHUFFLE2(a, b, ...) __builtin_shufflevector((a), (b), __VA_ARGS__)
+#  define IL_SHUFFLE_MASK(T, ...) __VA_ARGS__
+#else
+#  define IL_SHUFFLE2(a, b, ...) __builtin_shuffle((a), (b), __VA_ARGS__)
+#  define IL_SHUFFLE_MASK(T, ...) ((T) { __VA_ARGS__ })
+#endif
+
+
+// The vector shuffle versions of 2 channel deinterleave and interleave
+// for value type T with vector type V that has L values and mask type M.
+// n is the number of frames, and we do 2 vectors, L frames, at a time.
+#define IL_TWO(T, V, M, L, EVEN, ODD, LO, HI)                          \
+    static inline size_t                                               \
+    Deinterleave2_##T(T *o0, T *o1, const T *in, size_t n) {           \
+        size_t i = 0;                                                  \
+        for(; i + L <= n; i += L) {                                    \
+            V a = *(const V *) (in + 2*i);                             \
+            V b = *(const V *) (in + 2*i + L);                         \
+            *(V *) (o0 + i) = IL_SHUFFLE2(a, b, IL_SHUFFLE_MASK(M, EVEN));\
+            *(V *) (o1 + i) = IL_SHUFFLE2(a, b, IL_SHUFFLE_MASK(M, ODD));\
+        }                                                              \
+        return i;                                                      \
+    }                                                                  \
+    static inline size_t                                               \
+    Interleave2_##T(T *out, const T *i0, const T *i1, size_t n) {      \
+        size_t i = 0;                                                  \
+        for(; i + L <= n; i += L) {                                    \
+            V a = *(const V *) (i0 + i);                               \
+            V b = *(const V *) (i1 + i);                               \
+            *(V *) (out + 2*i) = IL_SHUFFLE2(a, b, IL_SHUFFLE_MASK(M, LO));\
+            *(V *) (out + 2*i + L) =                                   \
+                IL_SHUFFLE2(a, b, IL_SHUFFLE_MASK(M, HI));             \
+        }                                                              \
+        return i;                                                      \
+    }
+
+IL_TWO(int16_t, IlV8s, IlV8s, 8,
+        IL_ARGS(0, 2, 4, 6, 8, 10, 12, 14),
+        IL_ARGS(1, 3, 5, 7, 9, 11, 13, 15),
+        IL_ARGS(0, 8, 1, 9, 2, 10, 3, 11),
+        IL_ARGS(4, 12, 5, 13, 6, 14, 7, 15))
+IL_TWO(int32_t, IlV4s, IlV4s, 4,
+        IL_ARGS(0, 2, 4, 6),
+        IL_ARGS(1, 3, 5, 7),
+        IL_ARGS(0, 4, 1, 5),
+        IL_ARGS(2, 6, 3, 7))
+IL_TWO(int64_t, IlV2s, IlV2s, 2,
+        IL_ARGS(0, 2),
+        IL_ARGS(1, 3),
+        IL_ARGS(0, 2),
+        IL_ARGS(1, 3))
+
+
+// Copy n frames of N channels of size bytes each from in to the N
+// outputs in out[].
+static inline void
+Deinterleave(void *out[], const void *in, uint32_t N, size_t size,
+        size_t n) {
+
+    size_t i = 0;
+
+    if(N == 2) {
+        // The vector versions do all but the last few frames.
+        if(size == 2)
+            i = Deinterleave2_int16_t(out[0], out[1], in, n);
+        else if(size == 4)
+            i = Deinterleave2_int32_t(out[0], out[1], in, n);
+        else if(size == 8)
+            i = Deinterleave2_int64_t(out[0], out[1], in, n);
+    }
+
+    const uint8_t *x = ((const uint8_t *) in) + i * N * size;
+
+    for(; i < n; ++i)
+        for(uint32_t k=0; k<N; ++k) {
+            memcpy(((uint8_t *) out[k]) + i * size, x, size);
+            x += size;
+        }
+}
+
+
+// Copy n frames of N channels of size bytes each from the N inputs in
+// in[] to out.
+static inline void
+Interleave(void *out, void *in[], uint32_t N, size_t size, size_t n) {
+
+    size_t i = 0;
+
+    if(N == 2) {
+        if(size == 2)
+            i = Interleave2_int16_t(out, in[0], in[1], n);
+        else if(size == 4)
+            i = Interleave2_int32_t(out, in[0], in[1], n);
+        else if(size == 8)
+            i = Interleave2_int64_t(out, in[0], in[1], n);
+    }
+
+    uint8_t *x = ((uint8_t *) out) + i * N * size;
+
+    for(; i < n; ++i)
+        for(uint32_t k=0; k<N; ++k) {
+            memcpy(x, ((const uint8_t *) in[k]) + i * size, size);
+            x += size;
+        }
+}
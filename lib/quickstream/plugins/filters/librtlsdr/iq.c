@@ -1,4 +1,12 @@
 #include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <rtl-sdr.h>
 
 #include "../../../../../include/quickstream/filter.h"
@@ -28,6 +36,12 @@
 
 #define DEFAULT_MAXWRITE ((size_t) 8*1024)
 
+// For --async mode.  0.65 seconds at 3.2 MS/s.
+#define DEFAULT_FIFO ((size_t) 4*1024*1024)
+// The librtlsdr default USB transfer length, and number of transfers.
+#define ASYNC_BUF_LEN ((uint32_t) 16*32*512)
+#define ASYNC_BUF_NUM ((uint32_t) 15)
+
 //example:
 //Time to read a buffer of this size = 8*1024/3200000 = 0.00256 sec
 
@@ -52,12 +66,29 @@ void help(FILE *f) {
 "\n"
 "  Adjusting --maxWrite can change CPU usage considerably.\n"
 "\n"
+"  With --async the USB transfers are read with rtlsdr_read_async() in a\n"
+"  thread that we make for librtlsdr, and not with rtlsdr_read_sync()\n"
+"  in input().  The librtlsdr thread puts the data in a lock-free FIFO\n"
+"  and input() takes it from there, so a slow stream does not hold up\n"
+"  the USB reading until the FIFO is full.  When the FIFO is full data\n"
+"  is dropped and we count it.  When the FIFO is empty input() does\n"
+"  not block, so the stream worker thread is free to run other filters\n"
+"  until there is data.\n"
+"\n"
 "  Reference: https://www.rtl-sdr.com/about-rtl-sdr/\n"
 "\n"
 "\n"
 "\n"
 "                     OPTIONS\n"
 "\n"
+"    --async    read with rtlsdr_read_async() in another thread.  See\n"
+"               NOTES above.\n"
+"\n"
+"\n"
+"    --fifo BYTES  the size of the FIFO for --async.  The default is\n"
+"                  %zu.  BYTES will get rounded up to a power of 2.\n"
+"\n"
+"\n"
 "    --freq HZ  set the dongle center frequency to HZ Hz.  The default\n"
 "               center frequency is %" PRIu32 " Hz.\n"
 "\n"
@@ -88,7 +119,7 @@ void help(FILE *f) {
 "               Sample loss is to be expected for rates > 2400000.\n"
 "\n"
 "\n",
-    DEFAULT_FREQ, DEFAULT_GAIN,
+    DEFAULT_FIFO, DEFAULT_FREQ, DEFAULT_GAIN,
     DEFAULT_MAXWRITE,
     DEFAULT_RATE
         );
@@ -118,6 +149,30 @@ static
 size_t maxWrite; // bytes.  Max we'll output per input() call.
 
 
+// For --async mode.
+//
+// The librtlsdr callback (in thread) is the only writer of the FIFO and
+// input() is the only reader, so with the head and tail atomic we need
+// no lock to move data.  When the FIFO is empty input() sets waiting and
+// calls qsWaitFd() on an eventfd, and returns; the callback writes to the
+// eventfd when it sees waiting set, and the stream calls input() again.
+//
+// The callback stores head and then loads waiting, and input() stores
+// waiting and then loads head.  Those are seq_cst so that at least one of
+// them sees the other's store, or else the wakeup could be lost.
+//
+static bool async;
+static pthread_t thread;
+static uint8_t *fifo;
+static size_t fifoLen; // a power of 2
+static atomic_size_t head; // total bytes written by the callback
+static atomic_size_t tail; // total bytes read by input()
+static atomic_size_t dropped; // total bytes the callback could not write
+static atomic_bool waiting;
+static atomic_bool running;
+static int efd = -1; // eventfd that input() waits on
+
+
 // TODO: add a mutex for remote parameter setting and getting.
 
 // TODO: We may need to use rtlsdr_set_freq_correction()
@@ -211,6 +266,8 @@ int construct(int argc, const char **argv) {
     freq = qsOptsGetUint32(argc, argv, "freq", DEFAULT_FREQ);
     num = qsOptsGetSizeT(argc, argv, "num", DEFAULT_NUM);
     maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", DEFAULT_MAXWRITE);
+    async = qsOptsGetBool(argc, argv, "async");
+    size_t len = qsOptsGetSizeT(argc, argv, "fifo", DEFAULT_FIFO);
 
     if(maxWrite < 1024) {
         ERROR("maxWrite (%zu) is too small", maxWrite);
@@ -220,10 +277,92 @@ int construct(int argc, const char **argv) {
     if(num && num % maxWrite)
         num +=  maxWrite - (num % maxWrite);
 
+    for(fifoLen = 1; fifoLen < len; fifoLen <<= 1);
+    if(async && (fifoLen < 2*maxWrite || fifoLen < 2*ASYNC_BUF_LEN)) {
+        ERROR("--fifo (%zu) is too small", len);
+        return -1;
+    }
+
     return 0; // success
 }
 
 
+// Make the fd that input() waits on ready.
+static inline void Wake(void) {
+
+    uint64_t one = 1;
+    ASSERT(write(efd, &one, sizeof(one)) == sizeof(one));
+}
+
+
+// This is called by rtlsdr_read_async() in the thread.
+static void
+Callback(unsigned char *buf, uint32_t len, void *ctx) {
+
+    size_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&tail, memory_order_acquire);
+
+    if(fifoLen - (h - t) < len) {
+        // The stream is not keeping up.
+        atomic_fetch_add_explicit(&dropped, len, memory_order_relaxed);
+        return;
+    }
+
+    size_t i = h & (fifoLen - 1);
+    size_t l = fifoLen - i;
+    if(l > len) l = len;
+    memcpy(fifo + i, buf, l);
+    memcpy(fifo, buf + l, len - l);
+
+    // seq_cst, see the comment by waiting.
+    atomic_store(&head, h + len);
+
+    if(atomic_exchange(&waiting, false))
+        Wake();
+}
+
+
+static void *Thread(void *ptr) {
+
+    // This blocks until rtlsdr_cancel_async() is called.
+    int r = rtlsdr_read_async(dev, Callback, 0,
+            ASYNC_BUF_NUM, ASYNC_BUF_LEN);
+    if(r)
+        ERROR("rtlsdr_read_async() failed");
+
+    atomic_store(&running, false);
+    // So input() sees that we quit.
+    Wake();
+
+    return 0;
+}
+
+
+// Returns the number of bytes in the FIFO.  If there are none we set
+// waiting, and the callback will wake us when there are.
+static size_t GetData(void) {
+
+    size_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    size_t n = atomic_load_explicit(&head, memory_order_acquire) - t;
+    if(n)
+        return n;
+
+    // Eat stale wakeups, so that we do not get called again for nothing.
+    uint64_t count;
+    if(read(efd, &count, sizeof(count)) < 0)
+        ASSERT(errno == EAGAIN);
+
+    // seq_cst, see the comment by waiting.
+    atomic_store(&waiting, true);
+    n = atomic_load(&head) - t;
+    if(n)
+        // The callback wrote after all.  It may or may not wake us.
+        atomic_store(&waiting, false);
+
+    return n;
+}
+
+
 int start(uint32_t numInPorts, uint32_t numOutPorts) {
 
     ASSERT(numInPorts == 0);
@@ -253,6 +392,19 @@ int start(uint32_t numInPorts, uint32_t numOutPorts) {
 
     qsCreateOutputBuffer(0/*output port*/, maxWrite/*maxWriteLen*/);
 
+    if(async) {
+        efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        ASSERT(efd >= 0, "eventfd() failed");
+        fifo = malloc(fifoLen);
+        ASSERT(fifo, "malloc(%zu) failed", fifoLen);
+        atomic_store(&head, 0);
+        atomic_store(&tail, 0);
+        atomic_store(&dropped, 0);
+        atomic_store(&waiting, false);
+        atomic_store(&running, true);
+        ASSERT(pthread_create(&thread, 0, Thread, 0) == 0);
+    }
+
     INFO("Settings: rate=%" PRIu32 " freq=%" PRIu32,
             getRate(), getFreq());
 
@@ -261,6 +413,25 @@ int start(uint32_t numInPorts, uint32_t numOutPorts) {
 
 int stop(uint32_t numInPorts, uint32_t numOutPorts) {
 
+    if(fifo) {
+        DASSERT(dev);
+        // The thread may not be in rtlsdr_read_async() yet, and then
+        // rtlsdr_cancel_async() does nothing, so we keep trying until
+        // rtlsdr_read_async() returns.
+        while(atomic_load(&running)) {
+            rtlsdr_cancel_async(dev);
+            const struct timespec ts = { 0, 1000000 }; // 1 ms
+            nanosleep(&ts, 0);
+        }
+        ASSERT(pthread_join(thread, 0) == 0);
+        free(fifo);
+        fifo = 0;
+        ASSERT(close(efd) == 0);
+        efd = -1;
+        if(atomic_load(&dropped))
+            WARN("dropped %zu bytes", atomic_load(&dropped));
+    }
+
     if(dev) {
         rtlsdr_close(dev);
         dev = 0;
@@ -270,6 +441,49 @@ int stop(uint32_t numInPorts, uint32_t numOutPorts) {
 }
 
 
+static int AsyncInput(size_t lenRequest) {
+
+    size_t n = GetData();
+
+    if(n == 0) {
+        if(!atomic_load(&running)) {
+            // The librtlsdr thread quit.
+            ERROR("rtlsdr_read_async() stopped");
+            return -1; // fail/bail
+        }
+        // Free this worker thread until the callback wakes us.
+        qsWaitFd(efd, false);
+        return 0; // continue.
+    }
+
+    if(n > lenRequest)
+        n = lenRequest;
+
+    uint8_t *outBuf = qsGetOutputBuffer(0, n, 0/*min*/);
+
+    size_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    size_t i = t & (fifoLen - 1);
+    size_t l = fifoLen - i;
+    if(l > n) l = n;
+    memcpy(outBuf, fifo + i, l);
+    memcpy(outBuf + l, fifo, n - l);
+
+    atomic_store_explicit(&tail, t + n, memory_order_release);
+
+    qsOutput(0/*port*/, n);
+
+    total += n;
+
+    DASSERT(num == 0 || total <= num);
+
+    if(total == num)
+        // finished running.
+        return 1;
+
+    return 0; // continue.
+}
+
+
 int input(void *buffers[], const size_t lens[],
         const bool isFlushing[],
         uint32_t numInputs, uint32_t numOutputs) {
@@ -281,6 +495,9 @@ int input(void *buffers[], const size_t lens[],
     if(num && lenRequest + total > num)
         lenRequest = num - total;
 
+    if(async)
+        return AsyncInput(lenRequest);
+
     // TODO: If we always do read lenRequest we can set min to lenRequest.
     // But that only helps if we could make this filter multi-threaded,
     // and it's not likely the librtlsdr code could do that.
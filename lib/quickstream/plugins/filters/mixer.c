@@ -0,0 +1,210 @@
+// A complex mixer that shifts the frequency of the I/Q input by mixing it
+// with a NCO (numerically controlled oscillator).
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Numerically-controlled_oscillator
+//
+// With this and a decimating filter, like polyphaseFIR, we can tune to a
+// channel in the captured band without retuning the hardware, and we can
+// tune to more than one channel from one capture.
+//
+// The NCO is a recursion: we rotate a phasor by multiplying it by
+// exp(i 2 pi freq/rate) for each sample.  We do 2 samples at a time in 4
+// float vectors, so the phasors for 2 adjacent samples are rotated by 2
+// steps each time.  The float phasors drift in magnitude and phase, so
+// every CHUNK samples we recompute the phasors from the phase that we keep
+// in a double.
+//
+// This uses a pass-through buffer, so it mixes the data in place.
+
+#include <string.h>
+#include <math.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../include/quickstream/parameter.h"
+#include "../../../../lib/debug.h"
+
+
+// 4 floats; 2 complex values.
+typedef float v4sf __attribute__((vector_size(16)));
+// The same but with the alignment of a float, so we can use it with any
+// complex value in the ring buffer.
+typedef float v4sfu __attribute__((vector_size(16), aligned(4)));
+typedef int v4si __attribute__((vector_size(16)));
+
+#ifdef __clang__
+#  define SHUFFLE(v, a, b, c, d)  __builtin_shufflevector((v), (v), a, b, c, d)
+#else
+#  define SHUFFLE(v, a, b, c, d)  __builtin_shuffle((v), (v4si) {a, b, c, d})
+#endif
+
+
+// The number of I/Q samples between recomputing the NCO phasors.
+#define CHUNK  ((size_t) 512)
+
+#define DEFAULT_RATE  (1.0)
+
+
+static size_t maxWrite;
+static double rate = DEFAULT_RATE;
+
+// The frequency used in input().
+static double freq = 0.0;
+// The NCO phase in cycles, 0 <= phase < 1.
+static double phase = 0.0;
+
+// qsParameterSet() may be called by any thread, so the "freq" parameter
+// has a mailbox that we read in input(), and no setCallback().
+static struct QsParameter *freqParameter;
+static uint32_t freqSeen = 0;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: mixer [ --freq F --rate R --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It assumes that the input is a series of 2 floats (I/Q).  It shifts\n"
+"  the frequency of the input by F by multiplying it by exp(i 2 pi F t).\n"
+"  The output is the same type as the input, and uses the same memory as\n"
+"  the input via a pass-through buffer.\n"
+"\n"
+"  This filter has the parameter \"freq\" that can be set while the stream\n"
+"  is flowing.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --freq F        F is the frequency shift in Hz.  To tune to a signal\n"
+"                  at +100 kHz set F to -100000.  The default F is 0,\n"
+"                  and with F at 0 the data is not changed.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of 2*sizeof(float).\n"
+"\n"
+"\n"
+"  --rate R        R is the sample rate of the input in Hz.  The default\n"
+"                  R is %lg, which makes F in cycles per sample.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE, DEFAULT_RATE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    rate = qsOptsGetDouble(argc, argv, "rate", DEFAULT_RATE);
+    freq = qsOptsGetDouble(argc, argv, "freq", 0.0);
+
+    if(rate <= 0.0) {
+        ERROR("--rate %lg must be greater than 0", rate);
+        return -1; // fail
+    }
+
+    maxWrite -= maxWrite % (2*sizeof(float));
+    if(maxWrite == 0)
+        maxWrite = 2*sizeof(float);
+
+    freqParameter = qsParameterCreate("freq", QsDouble, 0, 0, 0);
+    ASSERT(freqParameter);
+    ASSERT(qsParameterAddMailbox(freqParameter, 0, &freq) == 0);
+    // We already have the first value.
+    ASSERT(qsParameterMailboxRead(freqParameter, &freq, &freqSeen));
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    phase = 0.0;
+
+    // We can read as little as one I/Q sample.
+    qsSetInputReadPromise(0, 2*sizeof(float));
+
+    if(qsCreatePassThroughBuffer(0, 0, maxWrite))
+        return 1; // fail
+
+    return 0; // success
+}
+
+
+// Multiply n complex values at x by the NCO, in place, starting at phase
+// ph cycles with a step of dph cycles per sample.
+static inline void
+Mix(float *x, size_t n, double ph, double dph) {
+
+    // The first 2 phasors.
+    v4sf p = {
+        cos(2.0 * M_PI * ph), sin(2.0 * M_PI * ph),
+        cos(2.0 * M_PI * (ph + dph)), sin(2.0 * M_PI * (ph + dph))
+    };
+    // Rotation by 2 steps.
+    float sr = cos(4.0 * M_PI * dph), si = sin(4.0 * M_PI * dph);
+    const v4sf stepRe = { sr, sr, sr, sr };
+    const v4sf stepIm = { -si, si, -si, si };
+    const v4sf sign = { -1.0F, 1.0F, -1.0F, 1.0F };
+
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2) {
+        v4sf v = *(v4sfu *) (x + 2*i);
+        // (a + ib)(c + id) = ac - bd + i(ad + bc)
+        v4sf re = SHUFFLE(p, 0, 0, 2, 2);
+        v4sf im = SHUFFLE(p, 1, 1, 3, 3) * sign;
+        *(v4sfu *) (x + 2*i) = v * re + SHUFFLE(v, 1, 0, 3, 2) * im;
+        p = p * stepRe + SHUFFLE(p, 1, 0, 3, 2) * stepIm;
+    }
+
+    if(i < n) {
+        // The odd last one.
+        float a = x[2*i], b = x[2*i+1];
+        x[2*i]   = a * p[0] - b * p[1];
+        x[2*i+1] = a * p[1] + b * p[0];
+    }
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    size_t len = lens[0];
+    if(len > maxWrite)
+        len = maxWrite;
+    len -= len % (2*sizeof(float));
+    if(len == 0)
+        return 0;
+
+    if(qsParameterMailboxRead(freqParameter, &freq, &freqSeen))
+        DSPEW("\"freq\" set to %lg Hz", freq);
+
+    float *x = qsGetOutputBuffer(0, len, len);
+    DASSERT(x == buffers[0]);
+
+    if(freq != 0.0) {
+        // Cycles per sample.
+        double dph = freq/rate;
+        size_t n = len/(2*sizeof(float));
+
+        for(size_t i=0; i<n; i += CHUNK) {
+            size_t m = (n - i < CHUNK)?(n - i):CHUNK;
+            Mix(x + 2*i, m, phase, dph);
+            phase += m * dph;
+            phase -= floor(phase);
+        }
+    }
+
+    qsAdvanceInput(0/*port*/, len);
+    qsOutput(0/*port*/, len);
+
+    return 0; // continue.
+}
@@ -0,0 +1,211 @@
+// A polyphase FIR (finite impulse response) filter that can decimate or
+// interpolate by an integer factor.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Polyphase_quadrature_filter
+//
+// For decimation by M we only compute every M-th output of the filter.
+// For interpolation by L we never multiply by the zeros that would be
+// stuffed between input samples; each input sample position gives L
+// outputs, one from each of the L phases of the filter bank.
+//
+// We read the filter windows directly from the input ring buffer, which
+// is contiguous in memory, so there is no copying of input and no
+// filter history to keep.  We just do not advance the input past the
+// samples that we still need.
+//
+// See fir.h for the filter bank and the vectorized dot product kernels.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "fir.h"
+
+
+static uint32_t decimate = 1, interpolate = 1;
+static size_t maxWrite;
+
+static struct FirBank bank;
+
+// Sizes in bytes.
+static size_t inSize, outSize;
+// The number of input samples we need to have to act.
+static size_t need;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: polyphaseFIR [ --decimate M | --interpolate L ]\n"
+"                        [ --taps LIST | --tapsFile FILE ]\n"
+"                        [ --complexTaps --real --numTaps N\n"
+"                          --cutoff F --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It filters the input with a FIR filter and decimates by M or\n"
+"  interpolates by L.  Only one of M and L may be greater than 1.  To\n"
+"  do both use the resampler filter.\n"
+"\n"
+"  The input is a series of 2 floats (I/Q) unless the --real option is\n"
+"  given.  The output is a series of 2 floats (I/Q) unless the input is\n"
+"  real and the taps are real, in which case the output is real floats.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --complexTaps    The taps are complex.  The values in LIST or FILE\n"
+"                   are read as real and imaginary pairs.\n"
+"\n"
+"\n"
+"  --cutoff F       F is the cut-off frequency of the default low-pass\n"
+"                   filter as a fraction of the lower of the input and\n"
+"                   output Nyquist frequencies.  The default F is 0.9.\n"
+"                   Not used if the taps are given.\n"
+"\n"
+"\n"
+"  --decimate M     Decimate by M.  The default M is 1.\n"
+"\n"
+"\n"
+"  --interpolate L  Interpolate by L.  The default L is 1.\n"
+"\n"
+"\n"
+"  --maxWrite LEN   Set the maximum write promise to LEN bytes.  The\n"
+"                   default value for LEN is %zu.  LEN will get rounded\n"
+"                   down to a multiple of L output samples.\n"
+"\n"
+"\n"
+"  --numTaps N      N is the number of taps in the default windowed\n"
+"                   sinc low-pass filter.  The default N is 16 times\n"
+"                   the larger of M and L, plus one.  Not used if the\n"
+"                   taps are given.\n"
+"\n"
+"\n"
+"  --real           The input is real floats and not I/Q pairs.\n"
+"\n"
+"\n"
+"  --taps LIST      LIST is the filter taps separated by commas or\n"
+"                   spaces, like for example --taps \"0.25,0.5,0.25\".\n"
+"\n"
+"\n"
+"  --tapsFile FILE  Read the filter taps from the text file FILE.  The\n"
+"                   taps are separated by white space or commas and a\n"
+"                   '#' starts a comment that runs to the end of the\n"
+"                   line.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    decimate = qsOptsGetUint32(argc, argv, "decimate", 1);
+    interpolate = qsOptsGetUint32(argc, argv, "interpolate", 1);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    bool complexIn = !qsOptsGetBool(argc, argv, "real");
+
+    if(decimate < 1 || interpolate < 1 ||
+            decimate > 1024 || interpolate > 1024) {
+        ERROR("--decimate %" PRIu32 " and --interpolate %" PRIu32
+                " must be 1 to 1024", decimate, interpolate);
+        return -1; // fail
+    }
+    if(decimate > 1 && interpolate > 1) {
+        ERROR("Only one of --decimate %" PRIu32 " and --interpolate %"
+                PRIu32 " may be greater than 1",
+                decimate, interpolate);
+        return -1; // fail
+    }
+
+    struct FirTaps taps;
+    memset(&taps, 0, sizeof(taps));
+    uint32_t r = (decimate > interpolate)?decimate:interpolate;
+    if(FirTapsGet(&taps, argc, argv, r, interpolate))
+        return -1; // fail
+
+    FirBankCreate(&bank, &taps, interpolate, complexIn);
+    FirTapsFree(&taps);
+
+    inSize = FirBankInSize(&bank);
+    outSize = FirBankOutSize(&bank);
+
+    // We write interpolate output samples at a time.
+    size_t chunk = interpolate * outSize;
+    maxWrite -= maxWrite % chunk;
+    if(maxWrite < chunk)
+        maxWrite = chunk;
+
+    // To write one output we need the window of bank.len samples, and
+    // after we need to be able to advance the input by decimate samples.
+    need = (bank.len > decimate)?bank.len:decimate;
+
+    return 0; // success
+}
+
+
+int destroy(void) {
+
+    FirBankDestroy(&bank);
+    return 0;
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    // With this much input we will always be able to read some of it.
+    qsSetInputReadPromise(0, need * inSize);
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of input samples.
+    size_t n = lens[0]/inSize;
+    if(n < need)
+        // We do not have enough data to act.
+        return 0;
+
+    const float *in = buffers[0];
+    uint8_t *out = qsGetOutputBuffer(0, maxWrite, 0);
+    size_t outLen = 0;
+    // The input window start, in samples.
+    size_t w = 0;
+    size_t floatsPerSample = inSize/sizeof(float);
+
+    if(interpolate == 1) {
+        while(w + need <= n && outLen < maxWrite) {
+            FirBankDot(&bank, 0, (float *) (out + outLen),
+                    in + w * floatsPerSample);
+            outLen += outSize;
+            w += decimate;
+        }
+    } else {
+        while(w + need <= n && outLen < maxWrite) {
+            const float *x = in + w * floatsPerSample;
+            for(uint32_t p=0; p<interpolate; ++p) {
+                FirBankDot(&bank, p, (float *) (out + outLen), x);
+                outLen += outSize;
+            }
+            ++w;
+        }
+    }
+
+    qsAdvanceInput(0/*port*/, w * inSize);
+    qsOutput(0/*port*/, outLen);
+
+    return 0; // continue.
+}
@@ -0,0 +1,269 @@
+// A polyphase rational resampler.  It changes the sample rate by the
+// factor L/M, where L and M are any positive integers, like for example
+// from a 2.4 MHz RTL-SDR sample rate to a 48 kHz audio rate.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Sample-rate_conversion
+//
+// The number of output samples for each input() call varies, and is not
+// a fixed multiple of the input; we just write what we can from the input
+// that we have.  quickstream does not need a fixed ratio of input to
+// output.
+//
+// Like in polyphaseFIR we read the filter windows directly from the
+// input ring buffer.  The phase to use and the input to advance after
+// each output sample come from a precomputed table of L entries (see
+// struct FirPhaseTable in fir.h), and we keep our place in that table
+// between input() calls.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "fir.h"
+
+
+// The resample factor is interpolate/decimate, after we remove common
+// factors.
+static uint32_t decimate = 1, interpolate = 1;
+static size_t maxWrite;
+
+static struct FirBank bank;
+static struct FirPhaseTable table;
+
+// Sizes in bytes.
+static size_t inSize, outSize;
+// The number of input samples we need to have to act.
+static size_t need;
+
+// Where we are in the phase table.
+static uint32_t tableIndex;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: resampler [ --interpolate L --decimate M |\n"
+"                       --inRate IN --outRate OUT ]\n"
+"                     [ --taps LIST | --tapsFile FILE ]\n"
+"                     [ --complexTaps --real --numTaps N\n"
+"                       --cutoff F --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.\n"
+"\n"
+"  It filters the input with a polyphase FIR filter and changes the\n"
+"  sample rate by the factor L/M, or OUT/IN.  The number of output\n"
+"  samples written for each input() call varies.\n"
+"\n"
+"  The input is a series of 2 floats (I/Q) unless the --real option is\n"
+"  given.  The output is a series of 2 floats (I/Q) unless the input is\n"
+"  real and the taps are real, in which case the output is real floats.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --complexTaps    The taps are complex.  The values in LIST or FILE\n"
+"                   are read as real and imaginary pairs.\n"
+"\n"
+"\n"
+"  --cutoff F       F is the cut-off frequency of the default low-pass\n"
+"                   filter as a fraction of the lower of the input and\n"
+"                   output Nyquist frequencies.  The default F is 0.9.\n"
+"                   Not used if the taps are given.\n"
+"\n"
+"\n"
+"  --decimate M     Decimate by M.  The default M is 1.\n"
+"\n"
+"\n"
+"  --inRate IN      IN is the input sample rate.  Use with --outRate\n"
+"                   in place of --interpolate and --decimate.  Only\n"
+"                   the ratio of OUT to IN matters.\n"
+"\n"
+"\n"
+"  --interpolate L  Interpolate by L.  The default L is 1.\n"
+"\n"
+"\n"
+"  --maxWrite LEN   Set the maximum write promise to LEN bytes.  The\n"
+"                   default value for LEN is %zu.  LEN will get rounded\n"
+"                   down to a multiple of the output sample size, and\n"
+"                   raised to at least L output samples.\n"
+"\n"
+"\n"
+"  --numTaps N      N is the number of taps in the default windowed\n"
+"                   sinc low-pass filter.  The default N is 16 times\n"
+"                   the larger of M and L, plus one.  Not used if the\n"
+"                   taps are given.\n"
+"\n"
+"\n"
+"  --outRate OUT    OUT is the output sample rate.  Use with --inRate.\n"
+"\n"
+"\n"
+"  --real           The input is real floats and not I/Q pairs.\n"
+"\n"
+"\n"
+"  --taps LIST      LIST is the filter taps separated by commas or\n"
+"                   spaces, like for example --taps \"0.25,0.5,0.25\".\n"
+"                   The taps are for the input up-sampled by L.\n"
+"\n"
+"\n"
+"  --tapsFile FILE  Read the filter taps from the text file FILE.  The\n"
+"                   taps are separated by white space or commas and a\n"
+"                   '#' starts a comment that runs to the end of the\n"
+"                   line.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE);
+}
+
+
+static size_t Gcd(size_t a, size_t b) {
+
+    while(b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+int construct(int argc, const char **argv) {
+
+    size_t inRate = qsOptsGetSizeT(argc, argv, "inRate", 0);
+    size_t outRate = qsOptsGetSizeT(argc, argv, "outRate", 0);
+
+    if(inRate || outRate) {
+        if(!inRate || !outRate) {
+            ERROR("Use both --inRate and --outRate");
+            return -1; // fail
+        }
+        size_t a = Gcd(inRate, outRate);
+        if(inRate/a > 0xFFFFFFFF || outRate/a > 0xFFFFFFFF) {
+            ERROR("--inRate %zu and --outRate %zu have too few common"
+                    " factors", inRate, outRate);
+            return -1; // fail
+        }
+        decimate = inRate/a;
+        interpolate = outRate/a;
+    } else {
+        decimate = qsOptsGetUint32(argc, argv, "decimate", 1);
+        interpolate = qsOptsGetUint32(argc, argv, "interpolate", 1);
+        if(decimate < 1 || interpolate < 1) {
+            ERROR("--decimate %" PRIu32 " and --interpolate %" PRIu32
+                    " must be at least 1", decimate, interpolate);
+            return -1; // fail
+        }
+        size_t gcd = Gcd(decimate, interpolate);
+        decimate /= gcd;
+        interpolate /= gcd;
+    }
+
+    // The filter bank has interpolate phases.
+    if(interpolate > 4096 || decimate > 64*1024) {
+        ERROR("The resample factor %" PRIu32 "/%" PRIu32
+                " is too complex", interpolate, decimate);
+        return -1; // fail
+    }
+
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+    bool complexIn = !qsOptsGetBool(argc, argv, "real");
+
+    struct FirTaps taps;
+    memset(&taps, 0, sizeof(taps));
+    uint32_t r = (decimate > interpolate)?decimate:interpolate;
+    if(FirTapsGet(&taps, argc, argv, r, interpolate))
+        return -1; // fail
+
+    FirBankCreate(&bank, &taps, interpolate, complexIn);
+    FirTapsFree(&taps);
+    FirPhaseTableCreate(&table, interpolate, decimate);
+
+    inSize = FirBankInSize(&bank);
+    outSize = FirBankOutSize(&bank);
+
+    maxWrite -= maxWrite % outSize;
+    // Each input() call must advance the input to keep the read promise
+    // that we make in start().  When we interpolate by more than we
+    // decimate many outputs in a row may not advance the input, but the L
+    // outputs of a whole phase table cycle advance it by M, so we must be
+    // able to write at least that many.
+    if(maxWrite < table.len * outSize) {
+        NOTICE("Raising --maxWrite from %zu to %zu bytes to fit %"
+                PRIu32 " output samples", maxWrite,
+                table.len * outSize, table.len);
+        maxWrite = table.len * outSize;
+    }
+
+    // To write one output we need the window of bank.len samples, and
+    // after we need to be able to advance the input.
+    need = (bank.len > table.maxAdvance)?bank.len:table.maxAdvance;
+
+    DSPEW("Resampling by %" PRIu32 "/%" PRIu32 " with %zu taps per phase",
+            interpolate, decimate, bank.len);
+
+    return 0; // success
+}
+
+
+int destroy(void) {
+
+    FirPhaseTableDestroy(&table);
+    FirBankDestroy(&bank);
+    return 0;
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    tableIndex = 0;
+
+    // With this much input we will always be able to read some of it,
+    // and write at least one output sample.
+    qsSetInputReadPromise(0, need * inSize);
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    // Number of input samples.
+    size_t n = lens[0]/inSize;
+    if(n < need)
+        // We do not have enough data to act.
+        return 0;
+
+    const float *in = buffers[0];
+    uint8_t *out = qsGetOutputBuffer(0, maxWrite, 0);
+    size_t outLen = 0;
+    // The input window start, in samples.
+    size_t w = 0;
+    size_t floatsPerSample = inSize/sizeof(float);
+    uint32_t k = tableIndex;
+
+    while(w + need <= n && outLen < maxWrite) {
+        FirBankDot(&bank, table.phase[k], (float *) (out + outLen),
+                in + w * floatsPerSample);
+        outLen += outSize;
+        w += table.advance[k];
+        if(++k == table.len)
+            k = 0;
+    }
+
+    tableIndex = k;
+
+    qsAdvanceInput(0/*port*/, w * inSize);
+    qsOutput(0/*port*/, outLen);
+
+    return 0; // continue.
+}
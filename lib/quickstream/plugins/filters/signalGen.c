@@ -0,0 +1,497 @@
+// A signal generator source.  It writes a tone, a chirp, Gaussian noise,
+// or a replayed file, as complex (I/Q) or real floats, at a given sample
+// rate or as fast as the down-stream filters can take it.
+//
+// With this we can run and benchmark streams without any hardware.
+//
+// The tone is a phasor recursion, 2 samples at a time in 4 float vectors,
+// like in the mixer filter.  The chirp is the same, but the phasor steps
+// are rotated too.  The noise comes from 4 xorshift random number
+// generators that run in a vector, and the Box-Muller transform with the
+// vector log, square root, sine and cosine from vmath.h.
+//
+// When throttled we sleep until the absolute time that the samples that
+// we wrote so far are due, so that the sleep errors do not add up.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "vmath.h"
+#include "throttle.h"
+
+
+#define DEFAULT_RATE   ((double) 1000000.0)
+#define DEFAULT_FREQ   ((double) 1000.0)
+
+// The number of samples between recomputing the tone and chirp phasors
+// from the phase that we keep in a double.
+#define CHUNK  ((size_t) 512)
+
+
+enum Signal { TONE, CHIRP, NOISE, REPLAY };
+
+static enum Signal signal = TONE;
+static bool isReal = false;
+static bool throttle = true;
+static double rate = DEFAULT_RATE;
+static double freq = DEFAULT_FREQ, freq2, period = 1.0;
+static float amplitude = 1.0F;
+static uint32_t seed = 1;
+// The total number of samples to write, or 0 to write forever.
+static size_t length = 0;
+static size_t maxWrite;
+// The size of an output sample in bytes.
+static size_t sampleSize;
+
+// Samples written since start().
+static size_t count;
+static struct timespec t0;
+
+// The tone phase, or the chirp phase, in cycles.
+static double phase;
+// The sample index in the chirp sweep.
+static size_t chirpIndex;
+static size_t chirpLength;
+
+// 4 xorshift32 random number generators.
+typedef uint32_t V4u32 __attribute__((vector_size(16)));
+static V4u32 rng;
+
+// The file data for replay.
+static uint8_t *replay;
+static size_t replayLen, replayIndex;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: signalGen [ --signal NAME --rate R --unthrottled --real\n"
+"                       --length N --amplitude A --freq F --freq2 F2\n"
+"                       --period T --seed S --file FILE --maxWrite LEN ]\n"
+"\n"
+"  This filter is a source.  It writes a generated signal to one output.\n"
+"\n"
+"  The output is a series of 2 floats (I/Q), unless the --real option\n"
+"  is given.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --amplitude A   A is the amplitude of the tone or chirp, or the RMS\n"
+"                  value of the noise.  The default A is 1.\n"
+"\n"
+"\n"
+"  --file FILE     Replay the data in FILE, over and over.  The data is\n"
+"                  written as it is in the file.  Use with --signal\n"
+"                  replay.\n"
+"\n"
+"\n"
+"  --freq F        F is the tone frequency, or the chirp start frequency,\n"
+"                  in Hz.  The default F is %lg.\n"
+"\n"
+"\n"
+"  --freq2 F2      F2 is the chirp end frequency in Hz.  The default F2\n"
+"                  is R/4.\n"
+"\n"
+"\n"
+"  --length N      Write N samples and then finish.  By default this\n"
+"                  writes forever.\n"
+"\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of the sample size.\n"
+"\n"
+"\n"
+"  --period T      T is the time in seconds that a chirp takes to sweep\n"
+"                  from F to F2.  The default T is 1.\n"
+"\n"
+"\n"
+"  --rate R        R is the sample rate in Hz.  The default R is %lg.\n"
+"\n"
+"\n"
+"  --real          Write real floats and not I/Q pairs.\n"
+"\n"
+"\n"
+"  --seed S        S is the noise random number generator seed.  The\n"
+"                  default S is 1.\n"
+"\n"
+"\n"
+"  --signal NAME   NAME is the kind of signal to write.  NAME may be:\n"
+"                  tone, chirp, noise, or replay.  The default NAME is\n"
+"                  tone.\n"
+"\n"
+"\n"
+"  --unthrottled   Write the samples as fast as the stream will take\n"
+"                  them, and not at the rate R.  This is for measuring\n"
+"                  the throughput of a stream.\n"
+"\n"
+"\n",
+    DEFAULT_FREQ, QS_DEFAULTMAXWRITE, DEFAULT_RATE);
+}
+
+
+// Returns 0 on success.
+static int LoadFile(const char *path) {
+
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        ERROR("fopen(\"%s\", \"r\") failed", path);
+        return -1;
+    }
+
+    size_t alloc = 4096;
+    replay = malloc(alloc);
+    ASSERT(replay, "malloc(%zu) failed", alloc);
+    replayLen = 0;
+    size_t rd;
+    while((rd = fread(replay + replayLen, 1, alloc - replayLen, file))) {
+        replayLen += rd;
+        if(replayLen == alloc) {
+            alloc *= 2;
+            replay = realloc(replay, alloc);
+            ASSERT(replay, "realloc(,%zu) failed", alloc);
+        }
+    }
+    fclose(file);
+
+    if(replayLen == 0) {
+        ERROR("File \"%s\" has no data", path);
+        free(replay);
+        replay = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int construct(int argc, const char **argv) {
+
+    const char *name = qsOptsGetString(argc, argv, "signal", "tone");
+
+    if(strcmp(name, "tone") == 0)
+        signal = TONE;
+    else if(strcmp(name, "chirp") == 0)
+        signal = CHIRP;
+    else if(strcmp(name, "noise") == 0)
+        signal = NOISE;
+    else if(strcmp(name, "replay") == 0)
+        signal = REPLAY;
+    else {
+        ERROR("Unknown --signal \"%s\"", name);
+        return -1; // fail
+    }
+
+    isReal = qsOptsGetBool(argc, argv, "real");
+    throttle = !qsOptsGetBool(argc, argv, "unthrottled");
+    rate = qsOptsGetDouble(argc, argv, "rate", DEFAULT_RATE);
+    freq = qsOptsGetDouble(argc, argv, "freq", DEFAULT_FREQ);
+    freq2 = qsOptsGetDouble(argc, argv, "freq2", rate/4);
+    period = qsOptsGetDouble(argc, argv, "period", 1.0);
+    amplitude = qsOptsGetFloat(argc, argv, "amplitude", 1.0F);
+    seed = qsOptsGetUint32(argc, argv, "seed", 1);
+    length = qsOptsGetSizeT(argc, argv, "length", 0);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+
+    if(rate <= 0.0) {
+        ERROR("Bad --rate %lg", rate);
+        return -1; // fail
+    }
+
+    chirpLength = period * rate;
+    if(signal == CHIRP && chirpLength < 1) {
+        ERROR("Bad --period %lg", period);
+        return -1; // fail
+    }
+
+    if(signal == REPLAY) {
+        const char *path = qsOptsGetString(argc, argv, "file", 0);
+        if(!path) {
+            ERROR("--signal replay needs the --file option");
+            return -1; // fail
+        }
+        if(LoadFile(path))
+            return -1; // fail
+    }
+
+    sampleSize = isReal?sizeof(float):(2*sizeof(float));
+    maxWrite -= maxWrite % sampleSize;
+    if(maxWrite == 0)
+        maxWrite = sampleSize;
+
+    return 0; // success
+}
+
+
+int destroy(void) {
+
+    if(replay) {
+        free(replay);
+        replay = 0;
+    }
+    return 0;
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 0);
+    ASSERT(numOutPorts == 1);
+
+    count = 0;
+    phase = 0.0;
+    chirpIndex = 0;
+    replayIndex = 0;
+    // xorshift needs non-zero state.
+    rng = (V4u32) { seed, seed ^ 0x9E3779B9, seed ^ 0x85EBCA6B,
+        seed ^ 0xC2B2AE35 };
+    for(int i=0; i<4; ++i)
+        if(rng[i] == 0) rng[i] = 0x6C078965;
+
+    qsCreateOutputBuffer(0, maxWrite);
+
+    ASSERT(clock_gettime(CLOCK_MONOTONIC, &t0) == 0);
+
+    return 0; // success
+}
+
+
+// Write n samples of the phasor that starts at phase ph and steps by
+// dph cycles per sample.
+static inline void
+Tone(float *out, size_t n, double ph, double dph) {
+
+    VmV4 p = {
+        amplitude * cos(2.0 * M_PI * ph),
+        amplitude * sin(2.0 * M_PI * ph),
+        amplitude * cos(2.0 * M_PI * (ph + dph)),
+        amplitude * sin(2.0 * M_PI * (ph + dph))
+    };
+    // Rotation by 2 steps.
+    float sr = cos(4.0 * M_PI * dph), si = sin(4.0 * M_PI * dph);
+    const VmV4 stepRe = VmSplat(sr);
+    const VmV4 stepIm = { -si, si, -si, si };
+
+    size_t i = 0;
+
+    if(isReal)
+        for(; i + 2 <= n; i += 2) {
+            out[i] = p[0];
+            out[i+1] = p[2];
+            p = p * stepRe + VM_SHUFFLE2(p, p, 1, 0, 3, 2) * stepIm;
+        }
+    else
+        for(; i + 2 <= n; i += 2) {
+            *(VmV4u *) (out + 2*i) = p;
+            p = p * stepRe + VM_SHUFFLE2(p, p, 1, 0, 3, 2) * stepIm;
+        }
+
+    if(i < n) {
+        if(isReal)
+            out[i] = p[0];
+        else {
+            out[2*i] = p[0];
+            out[2*i+1] = p[1];
+        }
+    }
+}
+
+
+static inline void WriteTone(float *out, size_t n) {
+
+    double dph = freq/rate;
+
+    for(size_t i=0; i<n; i += CHUNK) {
+        size_t m = (n - i < CHUNK)?(n - i):CHUNK;
+        Tone(out + (isReal?i:(2*i)), m, phase, dph);
+        phase += m * dph;
+        phase -= floor(phase);
+    }
+}
+
+
+// Write n samples of the chirp that starts at phase ph cycles, with a
+// frequency of f cycles per sample that changes by df cycles per sample
+// each sample.  Like in Tone() we do 2 samples at a time.  The phase
+// changes from sample j to sample j+2 by 2f + (2j+1)df, so the step
+// phasors for the 2 samples are rotated by 4df each time.
+static inline void
+Chirp(float *out, size_t n, double ph, double f, double df) {
+
+    VmV4 p = {
+        amplitude * cos(2.0 * M_PI * ph),
+        amplitude * sin(2.0 * M_PI * ph),
+        amplitude * cos(2.0 * M_PI * (ph + f)),
+        amplitude * sin(2.0 * M_PI * (ph + f))
+    };
+    VmV4 step = {
+        cos(2.0 * M_PI * (2.0 * f + df)),
+        sin(2.0 * M_PI * (2.0 * f + df)),
+        cos(2.0 * M_PI * (2.0 * f + 3.0 * df)),
+        sin(2.0 * M_PI * (2.0 * f + 3.0 * df))
+    };
+    float sr = cos(8.0 * M_PI * df), si = sin(8.0 * M_PI * df);
+    const VmV4 stepStep = { sr, si, sr, si };
+
+    size_t i = 0;
+
+    if(isReal)
+        for(; i + 2 <= n; i += 2) {
+            out[i] = p[0];
+            out[i+1] = p[2];
+            p = VmCMul2(p, step);
+            step = VmCMul2(step, stepStep);
+        }
+    else
+        for(; i + 2 <= n; i += 2) {
+            *(VmV4u *) (out + 2*i) = p;
+            p = VmCMul2(p, step);
+            step = VmCMul2(step, stepStep);
+        }
+
+    if(i < n) {
+        if(isReal)
+            out[i] = p[0];
+        else {
+            out[2*i] = p[0];
+            out[2*i+1] = p[1];
+        }
+    }
+}
+
+
+static inline void WriteChirp(float *out, size_t n) {
+
+    // The frequency changes by k Hz per sample.
+    double k = (freq2 - freq)/chirpLength;
+
+    for(size_t i=0; i<n;) {
+
+        size_t m = n - i;
+        if(m > CHUNK) m = CHUNK;
+        if(m > chirpLength - chirpIndex) m = chirpLength - chirpIndex;
+
+        // The instantaneous frequency in cycles per sample.
+        double f = (freq + k * chirpIndex)/rate;
+        Chirp(out + (isReal?i:(2*i)), m, phase, f, k/rate);
+
+        // phase += sum of f over the m samples
+        phase += m * f + k/rate * m * (m - 1)/2;
+        phase -= floor(phase);
+        i += m;
+        chirpIndex += m;
+        if(chirpIndex == chirpLength) {
+            chirpIndex = 0;
+            phase = 0.0;
+        }
+    }
+}
+
+
+// Returns 4 uniform random values in (0, 1].
+static inline VmV4 Uniform(void) {
+
+    // xorshift32 in all 4 lanes
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+
+    return __builtin_convertvector((rng >> 8) + 1, VmV4) *
+            VmSplat(1.0F/16777216.0F);
+}
+
+
+// Write n floats of Gaussian noise with standard deviation sigma.
+static inline void WriteNoise(float *out, size_t n, float sigma) {
+
+    size_t i = 0;
+
+    while(i < n) {
+
+        // Box-Muller gives 2 Gaussian values for each 2 uniform values,
+        // so we get 8 values from 2 vectors of uniform values.
+        VmV4 r = VmSplat(sigma) *
+            VmSqrt(VmSplat(-2.0F) * VmLog(Uniform()));
+        VmV4 s, c;
+        VmSinCos(VmSplat(2.0F * (float) M_PI) * Uniform() -
+                VmSplat((float) M_PI), &s, &c);
+        VmV4 x[2] = { r * c, r * s };
+
+        if(i + 8 <= n) {
+            *(VmV4u *) (out + i) = x[0];
+            *(VmV4u *) (out + i + 4) = x[1];
+            i += 8;
+        } else {
+            memcpy(out + i, x, (n - i) * sizeof(float));
+            i = n;
+        }
+    }
+}
+
+
+static inline void WriteReplay(uint8_t *out, size_t len) {
+
+    while(len) {
+        size_t l = replayLen - replayIndex;
+        if(l > len) l = len;
+        memcpy(out, replay + replayIndex, l);
+        out += l;
+        len -= l;
+        replayIndex += l;
+        if(replayIndex == replayLen)
+            replayIndex = 0;
+    }
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    int ret = 0;
+    size_t n = maxWrite/sampleSize;
+
+    if(length) {
+        if(count + n >= length) {
+            n = length - count;
+            ret = 1; // Last time calling input().
+        }
+        if(n == 0) return 1; // We're done.
+    }
+
+    if(throttle)
+        ThrottleUntil(&t0, count/rate);
+
+    void *out = qsGetOutputBuffer(0, n * sampleSize, n * sampleSize);
+
+    switch(signal) {
+        case TONE:
+            WriteTone(out, n);
+            break;
+        case CHIRP:
+            WriteChirp(out, n);
+            break;
+        case NOISE:
+            WriteNoise(out, isReal?n:(2*n),
+                    isReal?amplitude:(amplitude/(float) M_SQRT2));
+            break;
+        case REPLAY:
+            WriteReplay(out, n * sampleSize);
+            break;
+    }
+
+    count += n;
+    qsOutput(0, n * sampleSize);
+
+    return ret;
+}
@@ -0,0 +1,67 @@
+// A test filter module that uses the C++ coroutine filter API in
+// coFilter.hpp.  It copies its input to its output a frame at a time.
+
+#include <string.h>
+#include <stdexcept>
+
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../include/quickstream/coFilter.hpp"
+
+
+class CoFrame: public qs::CoFilter<CoFrame, qs::Inputs<uint8_t>,
+        qs::Outputs<uint8_t>> {
+
+    public:
+
+    CoFrame(int argc, const char **argv) {
+
+        frame = qsOptsGetSizeT(argc, argv, "frame", 100);
+        maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", maxWrite);
+
+        if(frame < 1 || frame > maxWrite)
+            throw std::invalid_argument("bad --frame");
+
+        in<0>().maxRead = frame;
+    };
+
+
+    qs::Task run(void) {
+
+        for(;;) {
+
+            co_await in<0>().read(frame);
+
+            if(in<0>().size() < frame)
+                // It's flushing and this is less than a frame, so we drop
+                // it.
+                co_return;
+
+            co_await out<0>().space(frame);
+
+            memcpy(out<0>().get(frame), in<0>().data(), frame);
+            in<0>().advance(frame);
+            out<0>().write(frame);
+        }
+    };
+
+
+    static void help(FILE *file) {
+
+        fprintf(file,
+"  Usage: tests/coFrameCPP [ --frame N --maxWrite M ]\n"
+"\n"
+"  Copies 1 input to 1 output N bytes at a time.  The default N is 100.\n"
+"\n"
+"  M is the most bytes written at a time.  The default M is %zu.\n"
+"\n", QS_DEFAULTMAXWRITE);
+    };
+
+
+    private:
+
+    size_t frame;
+};
+
+
+// We do not want a semicolon after this CPP macro
+QS_TYPED_FILTER_MODULE(CoFrame)
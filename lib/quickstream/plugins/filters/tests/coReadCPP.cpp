@@ -0,0 +1,68 @@
+// A test filter module that uses the C++ coroutine filter API in
+// coFilter.hpp.  It's like the stdin filter, but it does not block a
+// worker thread waiting for stdin.
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdexcept>
+
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../include/quickstream/coFilter.hpp"
+
+
+class CoRead: public qs::CoFilter<CoRead, qs::Inputs<>,
+        qs::Outputs<uint8_t>> {
+
+    public:
+
+    CoRead(int argc, const char **argv) {
+
+        maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", maxWrite);
+
+        if(maxWrite < 1)
+            throw std::invalid_argument("bad --maxWrite");
+    };
+
+
+    qs::Task run(void) {
+
+        for(;;) {
+
+            co_await qs::readable(STDIN_FILENO);
+            co_await out<0>().space(1);
+
+            size_t n = out<0>().available();
+            ssize_t rd = read(STDIN_FILENO, out<0>().get(n), n);
+
+            if(rd == 0)
+                // End of file.
+                co_return;
+
+            if(rd < 0) {
+                if(errno == EINTR || errno == EAGAIN)
+                    continue;
+                throw std::runtime_error("read(2) failed");
+            }
+
+            out<0>().write(rd);
+        }
+    };
+
+
+    static void help(FILE *file) {
+
+        fprintf(file,
+"  Usage: tests/coReadCPP [ --maxWrite N ]\n"
+"\n"
+"  Reads stdin and writes it to 1 output.  A worker thread does not wait\n"
+"  for stdin to be readable.\n"
+"\n"
+"  N is the most bytes written at a time.  The default N is %zu.\n"
+"\n", QS_DEFAULTMAXWRITE);
+    };
+};
+
+
+// We do not want a semicolon after this CPP macro
+QS_TYPED_FILTER_MODULE(CoRead)
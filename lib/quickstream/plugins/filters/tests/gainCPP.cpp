@@ -0,0 +1,68 @@
+// A test filter module that uses the typed C++ filter API in
+// typedFilter.hpp.
+
+#include <complex>
+#include <stdexcept>
+
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../include/quickstream/typedFilter.hpp"
+
+
+typedef std::complex<float> Complex;
+
+
+class Gain: public qs::Filter<Gain, qs::Inputs<Complex>,
+        qs::Outputs<Complex>> {
+
+    public:
+
+    Gain(int argc, const char **argv) {
+
+        gain = qsOptsGetFloat(argc, argv, "gain", 1.0F);
+        maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", maxWrite);
+
+        if(maxWrite < 1)
+            throw std::invalid_argument("bad --maxWrite");
+    };
+
+
+    int input(qs::In<Complex> in, qs::Out<Complex> out) {
+
+        size_t n = in.size();
+        if(n > out.max())
+            n = out.max();
+        if(n == 0)
+            return 0;
+
+        Complex *o = out.get(n);
+        for(size_t i=0; i<n; ++i)
+            o[i] = in[i] * gain;
+
+        in.advance(n);
+        out.write(n);
+
+        return 0; // success continue
+    };
+
+
+    static void help(FILE *file) {
+
+        fprintf(file,
+"  Usage: tests/gainCPP [ --gain G --maxWrite N ]\n"
+"\n"
+"  Reads 1 input of complex float values, multiplies them by G, and\n"
+"  writes them to 1 output.  The default G is 1.\n"
+"\n"
+"  N is the most values written at a time.  The default N is %zu.\n"
+"\n", QS_DEFAULTMAXWRITE);
+    };
+
+
+    private:
+
+    float gain;
+};
+
+
+// We do not want a semicolon after this CPP macro
+QS_TYPED_FILTER_MODULE(Gain)
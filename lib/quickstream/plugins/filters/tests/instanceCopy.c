@@ -0,0 +1,112 @@
+// A test filter module that uses the filter instance API.  All the
+// filters loaded from this module share one loaded DSO, and each one
+// keeps its state in its own struct Instance.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define QS_FILTER_INSTANCE_API
+#include "../../../../../include/quickstream/filter.h"
+#include "../../../../../lib/debug.h"
+
+
+QS_FILTER_INSTANCE_MODULE
+
+
+
+void help(FILE *f) {
+    fprintf(f,
+"  Usage: tests/instanceCopy { --maxWrite BYTES }\n"
+"\n"
+"A test filter module that copies each input to the output with the same\n"
+"port number.  It uses the filter instance API, so loading it more than\n"
+"once does not load more than one copy of the DSO.\n"
+"\n"
+"                       OPTIONS\n"
+"\n"
+"      --maxWrite BYTES   default value %zu\n"
+"\n"
+"\n",
+        QS_DEFAULTMAXWRITE);
+}
+
+
+struct Instance {
+
+    size_t maxWrite;
+    // Bytes copied in this flow cycle.
+    size_t count;
+};
+
+
+void *construct(int argc, const char **argv) {
+
+    struct Instance *i = calloc(1, sizeof(*i));
+    ASSERT(i, "calloc(1,%zu) failed", sizeof(*i));
+
+    i->maxWrite = qsOptsGetSizeT(argc, argv,
+            "maxWrite", QS_DEFAULTMAXWRITE);
+
+    DSPEW("Filter \"%s\" instance=%p maxWrite=%zu",
+            qsGetFilterName(), i, i->maxWrite);
+
+    return i; // success
+}
+
+
+int destroy(void *instance) {
+
+    if(instance)
+        free(instance);
+    return 0;
+}
+
+
+int start(void *instance, uint32_t numInPorts, uint32_t numOutPorts) {
+
+    struct Instance *i = instance;
+
+    ASSERT(numInPorts);
+    ASSERT(numInPorts == numOutPorts);
+
+    i->count = 0;
+
+    for(uint32_t j=0; j<numOutPorts; ++j)
+        qsCreateOutputBuffer(j, i->maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *instance, void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInPorts, uint32_t numOutPorts) {
+
+    struct Instance *i = instance;
+
+    for(uint32_t j=0; j<numInPorts; ++j) {
+        size_t len = lens[j];
+        if(len > i->maxWrite)
+            len = i->maxWrite;
+        else if(len == 0)
+            continue;
+
+        memcpy(qsGetOutputBuffer(j, len, len), buffers[j], len);
+        qsAdvanceInput(j, len);
+        qsOutput(j, len);
+        i->count += len;
+    }
+
+    return 0;
+}
+
+
+int stop(void *instance, uint32_t numInPorts, uint32_t numOutPorts) {
+
+    struct Instance *i = instance;
+
+    DSPEW("Filter \"%s\" copied %zu bytes", qsGetFilterName(), i->count);
+
+    return 0;
+}
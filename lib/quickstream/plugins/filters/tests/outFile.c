@@ -67,6 +67,23 @@ int start(uint32_t numInPorts, uint32_t numOutPorts) {
 }
 
 
+// So that the file has all the data when the stream is stopped.
+int stop(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    fflush(file);
+    return 0; // success
+}
+
+
+int destroy(void) {
+
+    if(file && file != stdout)
+        fclose(file);
+    file = 0;
+    return 0; // success
+}
+
+
 int input(void *buffers[], const size_t lens[],
         const bool isFlushing[],
         uint32_t numInPorts, uint32_t numOutPorts) {
@@ -1,6 +1,5 @@
 #include <unistd.h>
 #include <time.h>
-#include <pthread.h>
 
 #include "../../../../../include/quickstream/filter.h"
 #include "../../../../../include/quickstream/parameter.h"
@@ -33,41 +32,12 @@ static size_t maxWrite;
 static struct timespec t = { 0, 0 };
 const char *filterName = 0;
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-double _sleepT = 0;
-
 double sleepT = 0;
 
-
-
-// This may be called by any thread hence we use a mutex to protect
-// _sleepT.
-//
-int setSleepCallback(struct QsParameter *p,
-        void *value, const char *pName, void *userData) {
-
-    DSPEW("\"%s\" time set to %lg seconds", pName, *(double *) value);
-
-    double val = -1.0;
-
-    ASSERT(pthread_mutex_lock(&mutex) == 0);
-    if(_sleepT != (*(double *) value)) {
-        _sleepT = *(double *) value;
-        val = _sleepT;
-    }
-    // We need a save local stack variable to use to hold
-    // the value so we can qsParameterPush() with it in a
-    // thread safe way.
-    ASSERT(pthread_mutex_unlock(&mutex) == 0);
-
-    if(val > 0)
-        // Now we can't access _sleepT but we can access local stack
-        // variable val.  We could not call this while holding a mutex
-        // lock.
-        qsParameterPush("sleep", &val);
-
-    return 0;
-}
+// qsParameterSet() may be called by any thread, so the "sleep" parameter
+// has a mailbox that we read in input(), and no setCallback().
+static struct QsParameter *sleepParameter;
+static uint32_t sleepSeen = 0;
 
 
 
@@ -82,7 +52,7 @@ int construct(int argc, const char **argv) {
 
     ASSERT(maxWrite);
 
-    _sleepT = sleepT = qsOptsGetDouble(argc, argv,
+    sleepT = qsOptsGetDouble(argc, argv,
             "sleep", 0);
 
     if(sleepT) {
@@ -95,7 +65,11 @@ int construct(int argc, const char **argv) {
                 filterName, sleepT);
     }
 
-    qsParameterCreate("sleep", QsDouble, setSleepCallback, 0, 0);
+    sleepParameter = qsParameterCreate("sleep", QsDouble, 0, 0, 0);
+    ASSERT(sleepParameter);
+    ASSERT(qsParameterAddMailbox(sleepParameter, 0, &sleepT) == 0);
+    // We already have the first value.
+    ASSERT(qsParameterMailboxRead(sleepParameter, &sleepT, &sleepSeen));
 
     return 0; // success
 }
@@ -124,14 +98,10 @@ int input(void *buffers[], const size_t lens[],
     //DSPEW("lens[0]=%zu", lens[0]);
 
 
-    if(sleepT != _sleepT) {
-
-        ASSERT(pthread_mutex_lock(&mutex) == 0);
-        sleepT = _sleepT;
+    if(qsParameterMailboxRead(sleepParameter, &sleepT, &sleepSeen)) {
+        DSPEW("\"%s\" sleep time set to %lg seconds", filterName, sleepT);
         t.tv_sec = sleepT;
         t.tv_nsec = (sleepT - t.tv_sec) * 1000000000;
-        ASSERT(pthread_mutex_unlock(&mutex) == 0);
-        //qsParameterPush("sleep", &sleepT);
     }
 
     if(sleepT)
@@ -0,0 +1,148 @@
+// A pass-through filter that paces the data flowing through it to a
+// given sample rate.  With it we can replay captured data, like from the
+// stdin filter, at the rate that it was recorded, and so see how the
+// stream behaves in real-time.
+//
+// We sleep until the absolute time that the data being written is due,
+// so that errors in the sleep times do not add up.  If we get behind,
+// like when the stream stalls, we write the late data as soon as we can,
+// so that the average rate stays the same.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#include "../../../../include/quickstream/filter.h"
+#include "../../../../lib/debug.h"
+
+#include "throttle.h"
+
+
+#define DEFAULT_RATE   ((double) 1000000.0)
+#define DEFAULT_SIZE   ((size_t) (2*sizeof(float)))
+
+
+static double rate = DEFAULT_RATE;
+static size_t size = DEFAULT_SIZE;
+static size_t maxWrite;
+// Is the output a pass-through buffer?
+static bool passThrough;
+
+// Bytes written since the first input() call.
+static size_t count;
+static struct timespec t0;
+
+
+void help(FILE *f) {
+
+    fprintf(f,
+
+"    Usage: throttle [ --rate R --size BYTES --maxWrite LEN ]\n"
+"\n"
+"  This has one input and one output.  It writes the input to the output\n"
+"  without changing it, at R samples per second.  The time starts at the\n"
+"  first input.\n"
+"\n"
+"  Data is written in chunks of up to LEN bytes, at the time that the\n"
+"  last sample in the chunk is due, so a smaller LEN gives less jitter.\n"
+"\n"
+"  If the stream gets behind, the late data is written as soon as it can\n"
+"  be, so that the average rate stays at R.\n"
+"\n"
+"\n"
+"                    OPTIONS\n"
+"\n"
+"  --maxWrite LEN  Set the maximum write promise to LEN bytes.  The\n"
+"                  default value for LEN is %zu.  LEN will get rounded\n"
+"                  down to a multiple of BYTES.\n"
+"\n"
+"\n"
+"  --rate R        R is the rate in samples per second.  The default R is\n"
+"                  %lg.\n"
+"\n"
+"\n"
+"  --size BYTES    BYTES is the size of a sample in bytes.  The default\n"
+"                  BYTES is %zu, the size of an I/Q float sample.\n"
+"\n"
+"\n",
+    QS_DEFAULTMAXWRITE, DEFAULT_RATE, DEFAULT_SIZE);
+}
+
+
+int construct(int argc, const char **argv) {
+
+    rate = qsOptsGetDouble(argc, argv, "rate", DEFAULT_RATE);
+    size = qsOptsGetSizeT(argc, argv, "size", DEFAULT_SIZE);
+    maxWrite = qsOptsGetSizeT(argc, argv, "maxWrite", QS_DEFAULTMAXWRITE);
+
+    if(rate <= 0.0) {
+        ERROR("Bad --rate %lg", rate);
+        return -1; // fail
+    }
+
+    if(size < 1) {
+        ERROR("Bad --size %zu", size);
+        return -1; // fail
+    }
+
+    maxWrite -= maxWrite % size;
+    if(maxWrite == 0)
+        maxWrite = size;
+
+    return 0; // success
+}
+
+
+int start(uint32_t numInPorts, uint32_t numOutPorts) {
+
+    ASSERT(numInPorts == 1);
+    ASSERT(numOutPorts == 1);
+
+    count = 0;
+
+    // We can read as little as one sample.
+    qsSetInputReadPromise(0, size);
+
+    // If the feed is already a pass-through buffer for another filter we
+    // have to copy.
+    passThrough = !qsCreatePassThroughBuffer(0, 0, maxWrite);
+    if(!passThrough)
+        qsCreateOutputBuffer(0, maxWrite);
+
+    return 0; // success
+}
+
+
+int input(void *buffers[], const size_t lens[],
+        const bool isFlushing[],
+        uint32_t numInputs, uint32_t numOutputs) {
+
+    size_t len = lens[0];
+    if(len > maxWrite)
+        len = maxWrite;
+    if(!isFlushing[0])
+        len -= len % size;
+    if(len == 0)
+        return 0;
+
+    if(count == 0)
+        ASSERT(clock_gettime(CLOCK_MONOTONIC, &t0) == 0);
+
+    count += len;
+    ThrottleUntil(&t0, count/(rate * size));
+
+    void *out = qsGetOutputBuffer(0, len, len);
+    if(passThrough)
+        DASSERT(out == buffers[0]);
+    else
+        memcpy(out, buffers[0], len);
+
+    qsAdvanceInput(0/*port*/, len);
+    qsOutput(0/*port*/, len);
+
+    return 0; // continue.
+}
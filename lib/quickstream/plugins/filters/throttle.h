@@ -0,0 +1,31 @@
+// Pacing that is shared by the signalGen and throttle filter modules.
+//
+// This is not a filter module.  It's just static functions that we
+// include in more than one filter module.
+//
+// We sleep until an absolute time on the CLOCK_MONOTONIC timeline, so
+// that the time spent writing the data does not add up and the average
+// rate stays correct.
+
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+
+
+// Sleep until t seconds after the time t0.  If that time has passed
+// already this returns right away.
+static inline void ThrottleUntil(const struct timespec *t0, double t) {
+
+    struct timespec t1 = *t0;
+    t1.tv_sec += (time_t) t;
+    t1.tv_nsec += (long) ((t - floor(t)) * 1.0e9);
+    if(t1.tv_nsec >= 1000000000) {
+        t1.tv_nsec -= 1000000000;
+        ++t1.tv_sec;
+    }
+
+    int ret;
+    while((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                    &t1, 0)) == EINTR);
+    ASSERT(ret == 0, "clock_nanosleep() failed");
+}
@@ -0,0 +1,198 @@
+// Vectorized math functions that are shared by the filter modules in
+// this directory.
+//
+// This is not a filter module.  It's just static functions that we
+// include in more than one filter module.
+//
+// Like in fir.h we use the GCC (and clang) vector extensions so that this
+// builds on any architecture that GCC builds on.  We work with 4 floats at
+// a time.
+
+#include <stdint.h>
+#include <math.h>
+
+
+// 4 floats.
+typedef float VmV4 __attribute__((vector_size(16)));
+// The same but with the alignment of a float, so we can load it from
+// any float in a ring buffer.
+typedef float VmV4u __attribute__((vector_size(16), aligned(4)));
+typedef int32_t VmV4i __attribute__((vector_size(16)));
+
+
+#ifdef __clang__
+// Pick 4 of the 8 floats in a and b.
+#  define VM_SHUFFLE2(a, b, i, j, k, l) \
+    __builtin_shufflevector((a), (b), i, j, k, l)
+#else
+#  define VM_SHUFFLE2(a, b, i, j, k, l) \
+    __builtin_shuffle((a), (b), (VmV4i) {i, j, k, l})
+#endif
+
+
+static inline VmV4 VmSplat(float x) {
+    return (VmV4) { x, x, x, x };
+}
+
+
+static inline VmV4i VmSplatI(int32_t x) {
+    return (VmV4i) { x, x, x, x };
+}
+
+
+// Returns a where the mask m is set, else b.  m is from a vector compare.
+static inline VmV4 VmSelect(VmV4i m, VmV4 a, VmV4 b) {
+    return (VmV4) (((VmV4i) a & m) | ((VmV4i) b & ~m));
+}
+
+
+static inline VmV4 VmAbs(VmV4 x) {
+    return (VmV4) ((VmV4i) x & VmSplatI(INT32_MAX));
+}
+
+
+// Load 4 complex values, 8 floats, as 4 real parts and 4 imaginary
+// parts.
+static inline void
+VmLoadComplex(const float *x, VmV4 *re, VmV4 *im) {
+
+    VmV4 a = *(const VmV4u *) x;
+    VmV4 b = *(const VmV4u *) (x + 4);
+    *re = VM_SHUFFLE2(a, b, 0, 2, 4, 6);
+    *im = VM_SHUFFLE2(a, b, 1, 3, 5, 7);
+}
+
+
+// An approximation of atan2(y, x) with a maximum error of about 1.0e-5
+// radians.
+//
+// Reference:
+// https://mazzo.li/posts/vectorized-atan2.html
+// Abramowitz and Stegun, Handbook of Mathematical Functions, 4.4.49
+//
+// With a = min(|x|,|y|)/max(|x|,|y|) we have 0 <= a <= 1 and we use an
+// odd polynomial for atan(a) that is good in [0, 1], and then fix the
+// octant and quadrant.  atan2(0, 0) is 0.
+static inline VmV4 VmAtan2(VmV4 y, VmV4 x) {
+
+    VmV4 ax = VmAbs(x), ay = VmAbs(y);
+    VmV4i swap = ay > ax;
+    VmV4 num = VmSelect(swap, ax, ay);
+    VmV4 den = VmSelect(swap, ay, ax);
+    // So we do not divide by zero.
+    VmV4 a = num/(den + VmSplat(1.0e-30F));
+    VmV4 s = a * a;
+
+    VmV4 r = VmSplat(-0.0117212F);
+    r = r * s + VmSplat(0.05265332F);
+    r = r * s + VmSplat(-0.11643287F);
+    r = r * s + VmSplat(0.19354346F);
+    r = r * s + VmSplat(-0.33262347F);
+    r = r * s + VmSplat(0.99997723F);
+    r = r * a;
+
+    r = VmSelect(swap, VmSplat((float) M_PI_2) - r, r);
+    r = VmSelect(x < VmSplat(0.0F), VmSplat((float) M_PI) - r, r);
+    // Copy the sign of y.
+    r = (VmV4) ((VmV4i) r | ((VmV4i) y & VmSplatI(INT32_MIN)));
+    return r;
+}
+
+
+// Multiply the 2 complex values in a by the 2 complex values in b.
+static inline VmV4 VmCMul2(VmV4 a, VmV4 b) {
+
+    const VmV4 sign = { -1.0F, 1.0F, -1.0F, 1.0F };
+    // (a + ib)(c + id) = ac - bd + i(ad + bc)
+    return a * VM_SHUFFLE2(b, b, 0, 0, 2, 2) +
+        VM_SHUFFLE2(a, a, 1, 0, 3, 2) * VM_SHUFFLE2(b, b, 1, 1, 3, 3) * sign;
+}
+
+
+// An approximation of sqrt(x) for x >= 0 with a relative error of about
+// 2.0e-7.  We start with the well known bit trick guess of 1/sqrt(x) and
+// do 3 Newton's method iterations.  sqrt(0) is 0.
+//
+// Reference:
+// https://en.wikipedia.org/wiki/Fast_inverse_square_root
+static inline VmV4 VmSqrt(VmV4 x) {
+
+    VmV4 y = (VmV4) (VmSplatI(0x5f3759df) - ((VmV4i) x >> 1));
+    for(int i=0; i<3; ++i)
+        y = y * (VmSplat(1.5F) - VmSplat(0.5F) * x * y * y);
+    return x * y;
+}
+
+
+// An approximation of the natural log of x, for normal floats x > 0,
+// with a relative error of about 1.0e-7.
+//
+// Reference:
+// Cephes Math Library, logf.c, http://www.netlib.org/cephes/
+//
+// With x = m 2^e, and m moved into [sqrt(1/2), sqrt(2)), log(x) is
+// e log(2) + log(m), and log(1 + f), with f = m - 1, is a polynomial.
+static inline VmV4 VmLog(VmV4 x) {
+
+    VmV4i i = (VmV4i) x;
+    VmV4i e = ((i >> 23) & VmSplatI(0xff)) - VmSplatI(127);
+    // The mantissa in [1, 2).
+    VmV4 m = (VmV4) ((i & VmSplatI(0x007fffff)) | VmSplatI(0x3f800000));
+    VmV4i big = m > VmSplat((float) M_SQRT2);
+    m = VmSelect(big, m * VmSplat(0.5F), m);
+    // big is -1 where it's set.
+    e -= big;
+
+    VmV4 fe = __builtin_convertvector(e, VmV4);
+    VmV4 f = m - VmSplat(1.0F);
+    VmV4 z = f * f;
+
+    VmV4 y = VmSplat(7.0376836292E-2F);
+    y = y * f + VmSplat(-1.1514610310E-1F);
+    y = y * f + VmSplat(1.1676998740E-1F);
+    y = y * f + VmSplat(-1.2420140846E-1F);
+    y = y * f + VmSplat(1.4249322787E-1F);
+    y = y * f + VmSplat(-1.6668057665E-1F);
+    y = y * f + VmSplat(2.0000714765E-1F);
+    y = y * f + VmSplat(-2.4999993993E-1F);
+    y = y * f + VmSplat(3.3333331174E-1F);
+    y = y * f * z;
+
+    // log(2) is split in 2 parts so fe log(2) keeps more bits.
+    y += fe * VmSplat(-2.12194440E-4F);
+    y -= VmSplat(0.5F) * z;
+    return f + y + fe * VmSplat(0.693359375F);
+}
+
+
+// Approximations of sin(x) and cos(x) for x in [-pi, pi], with errors of
+// about 2.0e-7.  We reflect x into [-pi/2, pi/2], where the Taylor series
+// to the x^11 and x^12 terms are good to float precision.
+static inline void VmSinCos(VmV4 x, VmV4 *s, VmV4 *c) {
+
+    // pi with the sign of x.
+    VmV4 pi = (VmV4) ((VmV4i) VmSplat((float) M_PI) |
+            ((VmV4i) x & VmSplatI(INT32_MIN)));
+    // sin(pi - x) = sin(x) and cos(pi - x) = -cos(x)
+    VmV4i far = VmAbs(x) > VmSplat((float) M_PI_2);
+    x = VmSelect(far, pi - x, x);
+
+    VmV4 z = x * x;
+
+    VmV4 y = VmSplat(-1.0F/39916800.0F);
+    y = y * z + VmSplat(1.0F/362880.0F);
+    y = y * z + VmSplat(-1.0F/5040.0F);
+    y = y * z + VmSplat(1.0F/120.0F);
+    y = y * z + VmSplat(-1.0F/6.0F);
+    y = y * z + VmSplat(1.0F);
+    *s = y * x;
+
+    y = VmSplat(1.0F/479001600.0F);
+    y = y * z + VmSplat(-1.0F/3628800.0F);
+    y = y * z + VmSplat(1.0F/40320.0F);
+    y = y * z + VmSplat(-1.0F/720.0F);
+    y = y * z + VmSplat(1.0F/24.0F);
+    y = y * z + VmSplat(-0.5F);
+    y = y * z + VmSplat(1.0F);
+    *c = VmSelect(far, -y, y);
+}
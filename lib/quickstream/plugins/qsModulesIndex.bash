@@ -0,0 +1,82 @@
+#!/bin/bash
+
+# Usage: qsModulesIndex.bash DIR [DIR ...]
+#
+# Make the module index file DIR/qsModules.index for the quickstream
+# plugin modules (filters, controllers, and run) in and below each DIR.
+# With this file libquickstream can find a module in DIR without looking
+# through the file system.  See lib/GetPluginPath.c.
+#
+# Each line in the index file is the path to a module relative to DIR,
+# and then a tab and the quickstream module symbols that it exports.
+#
+# libquickstream looks for an index file in the installed plugins
+# directory, and in each directory in QS_MODULE_PATH, QS_FILTER_PATH,
+# QS_CONTROLLER_PATH, and QS_RUN_PATH, so each of them needs its own.
+# When quickstream is installed with quickbuild this is run for the
+# installed plugins directory and its filters, controllers, and run
+# directories.  Run it again if you add modules by hand, because a module
+# that is not in the index file is not looked for in DIR.  A module that
+# is in the index file but was removed is not found in DIR either.
+
+set -eo pipefail
+
+if [ -z "$1" ] ; then
+    echo "Usage: $0 DIR [DIR ...]"
+    exit 1
+fi
+
+for dir in "$@" ; do
+    if [ ! -d "$dir" ] ; then
+        echo "Usage: $0 DIR [DIR ...]"
+        echo "$dir is not a directory"
+        exit 1
+    fi
+done
+
+symbols='^(input|construct|destroy|start|stop|help|preStart|postStart|preStop|postStop|qsFilterInstanceAPI)$'
+
+haveNm=
+if which nm > /dev/null ; then
+    haveNm=yes
+fi
+
+
+# Make the index file in the current directory.
+function MakeIndex() {
+
+    local tmpfile=qsModules.index.tmp
+    local path syms
+
+    exec 3> $tmpfile
+
+    cat >&3 << EOF2
+# This file was generated by $(basename $0)
+#
+# PATH	SYMBOLS
+#
+EOF2
+
+    while read -r path ; do
+        path="${path#./}"
+        syms=
+        if [ -n "$haveNm" ] ; then
+            syms="$(nm -D --defined-only "$path" 2> /dev/null |\
+                awk '{print $3}' | grep -E "$symbols" | sort |\
+                tr '\n' ' ')" || true
+        fi
+        printf "%s\t%s\n" "$path" "${syms% }" >&3
+    done < <(find . \( -name '*.so' -o -name '*.py' \)\
+        \( -type f -o -type l \) | sort)
+
+    exec 3>&-
+
+    mv $tmpfile qsModules.index
+
+    echo "Made $PWD/qsModules.index"
+}
+
+
+for dir in "$@" ; do
+    (cd "$dir" && MakeIndex)
+done
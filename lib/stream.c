@@ -12,6 +12,7 @@
 #include "./debug.h"
 #include "Dictionary.h"
 #include "./qs.h"
+#include "parameter.h"
 #include "filterList.h"
 #include "stream.h"
 
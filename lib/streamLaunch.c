@@ -113,6 +113,10 @@ uint32_t nThreadFlow(struct QsStream *s) {
         //
         RunningWorkerThread(p);
 
+        // The stream run is done, so we stop the fd thread now, if there
+        // is one.
+        FdWaitJoin(s);
+
         // Just in case this state needs to be known.
         s->maxThreads = 0; // We lied.  maxThread really is 0.
         s->numThreads = 0;
@@ -234,6 +238,10 @@ void JoinThreads(struct QsStream *s) {
             CHECK(pthread_join(t->thread, 0));
             t->hasLaunched = false;
         }
+
+    // The worker threads are done, so no filters can be waiting on file
+    // descriptors now.
+    FdWaitJoin(s);
 }
 
 
@@ -13,9 +13,10 @@
 #include "debug.h"
 #include "Dictionary.h"
 #include "qs.h"
+#include "parameter.h"
 #include "filterList.h"
 #include "stream.h"
-#include "parameter.h"
+#include "controllerThread.h"
 
 
 
@@ -378,6 +379,46 @@ SetupInputPorts(struct QsStream *s, struct QsFilter *f, bool ret) {
 //
 //    <= -1  bail the program error, stop calling and etc.
 //
+
+struct pSt_args {
+
+    struct QsController *c;
+    struct QsStream *s;
+    uint32_t type;
+    int (*func)(struct QsStream *, struct QsFilter *,
+            uint32_t, uint32_t);
+    int ret;
+};
+
+
+// Call the controller callback for each filter in the stream.  This is
+// called by the main thread, or by the controller thread if the
+// controller runs in a thread, and then the controller thread specific
+// data is set already.
+static void
+pSt_forEachFilter(struct pSt_args *a) {
+
+    struct QsController *c = a->c;
+    void *oldController = pthread_getspecific(_qsControllerKey);
+
+    DASSERT(c->mark == 0);
+    DASSERT(oldController == 0 || oldController == c);
+    c->mark = a->type;
+    CHECK(pthread_setspecific(_qsControllerKey, c));
+
+    a->ret = 0;
+
+    for(struct QsFilter *f=a->s->filters; f; f = f->next) {
+        a->ret = a->func(a->s, f, f->numInputs, f->numOutputs);
+        if(a->ret)
+            break;
+    }
+
+    CHECK(pthread_setspecific(_qsControllerKey, oldController));
+    c->mark = 0;
+}
+
+
 // Returns false to keep going.
 // Returns true to bail on the running program.
 //
@@ -391,21 +432,11 @@ bool pSt_callback(struct QsController *c, struct QsStream *s,
 
     if(!func) return false; // no callback to call.
 
-    DASSERT(c->mark == 0);
     DASSERT(pthread_getspecific(_qsControllerKey) == 0);
-    c->mark = type;
-    CHECK(pthread_setspecific(_qsControllerKey, c));
-
-    int ret = 0;
-
-    for(struct QsFilter *f=s->filters; f; f = f->next) {
-        ret = func(s, f, f->numInputs, f->numOutputs);
-        if(ret)
-            break;
-    }
 
-    CHECK(pthread_setspecific(_qsControllerKey, 0));
-    c->mark = 0;
+    struct pSt_args args = { c, s, type, func, 0 };
+    _qsControllerRun(c, (void (*)(void *)) pSt_forEachFilter, &args);
+    int ret = args.ret;
 
     if(ret < 0) {
         ERROR("Controller \"%s\"::%s() returned (%d) error",
@@ -461,7 +492,7 @@ struct ControllerCallbackRemover {
 };
 
 
-static void
+static int
 MarkInputCallback(const char *key, struct  ControllerCallback *cb,
         struct ControllerCallbackRemover *r) {
 
@@ -477,6 +508,32 @@ MarkInputCallback(const char *key, struct  ControllerCallback *cb,
 
         cb->key = key;
     }
+
+    return 0; // keep going
+}
+
+
+static void
+RemoveMarkedInputCallbacks(struct QsFilter *f, struct QsDictionary *dict,
+        const char *what) {
+
+    if(dict == 0)
+        return;
+
+    struct ControllerCallbackRemover r;
+    r.start = 0;
+    r.end = 0;
+
+    qsDictionaryForEach(dict,
+        (int (*) (const char *key, void *value,
+            void *userData)) MarkInputCallback, &r);
+
+    struct ControllerCallback *next;
+    for(struct ControllerCallback *cb=r.start; cb; cb = next) {
+        next = cb->next;
+        DSPEW("Removing %s:%s %s callback", f->name, cb->key, what);
+        qsDictionaryRemove(dict, cb->key);
+    }
 }
 
 
@@ -501,6 +558,20 @@ int qsStreamStop(struct QsStream *s) {
         return -1; // failure
     }
 
+    // The stream is not flowing, so the controllers may change the input
+    // callbacks in their dictionaries again.
+    for(struct QsFilter *f = s->filters; f; f = f->next)
+        FreeInputCallbacks(f);
+
+
+    /**********************************************************************
+     *      Stage: wait for the controller threads to call the events
+     *             that the flow queued for them
+     *********************************************************************/
+
+    for(struct QsController *c=s->app->first; c; c=c->next)
+        _qsControllerQueueWait(c);
+
 
     /**********************************************************************
      *      Stage: call all the app's controller preStop()s if present
@@ -512,29 +583,14 @@ int qsStreamStop(struct QsStream *s) {
 
 
     /**********************************************************************
-     *      Stage: remove all PostInputCallbacks that are marked as
-     *             finished.
+     *      Stage: remove all PreInputCallbacks and PostInputCallbacks
+     *             that are marked as finished.
      *********************************************************************/
 
     for(struct QsFilter *f = s->filters; f; f = f->next) {
 
-        if(f->postInputCallbacks == 0)
-            continue;
-
-        struct ControllerCallbackRemover r;
-        r.start = 0;
-        r.end = 0;
-
-        qsDictionaryForEach(f->postInputCallbacks,
-            (int (*) (const char *key, void *value,
-                void *userData)) MarkInputCallback, &r);
-
-        struct ControllerCallback *next;
-        for(struct ControllerCallback *cb=r.start; cb; cb = next) {
-            next = cb->next;
-            DSPEW("Removing %s:%s PostInput callback", f->name, cb->key);
-            qsDictionaryRemove(f->postInputCallbacks, cb->key);
-        }
+        RemoveMarkedInputCallbacks(f, f->preInputCallbacks, "PreInput");
+        RemoveMarkedInputCallbacks(f, f->postInputCallbacks, "PostInput");
     }
 
 
@@ -542,16 +598,24 @@ int qsStreamStop(struct QsStream *s) {
      *     Stage: call all stream's filter stop() if present
      *********************************************************************/
 
-    for(struct QsFilter *f = s->filters; f; f = f->next)
-        if(f->stream == s && f->stop) {
+    for(struct QsFilter *f = s->filters; f; f = f->next) {
+        if(f->stream != s)
+            continue;
+        if(f->stop || f->iStop) {
             CHECK(pthread_setspecific(_qsKey, f));
             f->mark = _QS_IN_STOP;
             s->flags |= _QS_STREAM_STOP;
-            f->stop(f->numInputs, f->numOutputs);
+            if(f->iStop)
+                f->iStop(f->instance, f->numInputs, f->numOutputs);
+            else
+                f->stop(f->numInputs, f->numOutputs);
             s->flags &= ~_QS_STREAM_STOP;
-            f->mark = 0;
             CHECK(pthread_setspecific(_qsKey, 0));
         }
+        // The flow marks finished filters, and filters without a stop()
+        // need to be unmarked too, or else destroy() will see the mark.
+        f->mark = 0;
+    }
 
 
     /**********************************************************************
@@ -564,11 +628,15 @@ int qsStreamStop(struct QsStream *s) {
 
 
     /**********************************************************************
-     *     Stage: remove all the parameter get callbacks that we can.
+     *     Stage: remove all the parameter get callbacks that we can,
+     *            and the scheduled parameter changes.
      *********************************************************************/
 
-    for(struct QsFilter *f = s->filters; f; f = f->next)
+    for(struct QsFilter *f = s->filters; f; f = f->next) {
         _qsParameterRemoveCallbacksForRestart(f);
+        // The input offsets start over in the next flow cycle.
+        _qsParameterFreeScheduled(f);
+    }
 
 
     /**********************************************************************
@@ -733,7 +801,7 @@ int qsStreamReady(struct QsStream *s) {
     //
     for(struct QsFilter *f = s->filters; f; f = f->next) {
         if(f->stream == s) {
-            if(f->start) {
+            if(f->start || f->iStart) {
                 // We mark which filter we are calling the start() for so
                 // that if the filter start() calls any filter API
                 // function to get resources we know what filter these
@@ -742,7 +810,12 @@ int qsStreamReady(struct QsStream *s) {
                 f->mark = _QS_IN_START;
                 s->flags |= _QS_STREAM_START;
                 // Call a filter start() function:
-                int ret = f->start(f->numInputs, f->numOutputs);
+                int ret;
+                if(f->iStart)
+                    ret = f->iStart(f->instance,
+                            f->numInputs, f->numOutputs);
+                else
+                    ret = f->start(f->numInputs, f->numOutputs);
                 s->flags &= ~_QS_STREAM_START;
                 f->mark = 0;
                 CHECK(pthread_setspecific(_qsKey, 0));
@@ -796,5 +869,33 @@ int qsStreamReady(struct QsStream *s) {
         postStart_callback(c, s);
 
 
+    /**********************************************************************
+     *      Stage: freeze the dictionaries that are used at flow time
+     *********************************************************************/
+
+    // qsFilterFromName(), qsParameterSet(), qsParameterPush() and like
+    // functions can be called at high rates while the stream flows, and
+    // they find things in these dictionaries, which do not change while
+    // the stream flows.  If one of them does change it unfreezes, and
+    // it's just slower.
+    qsDictionaryFreeze(s->dict);
+    for(struct QsFilter *f = s->filters; f; f = f->next)
+        qsDictionaryFreeze(f->parameters);
+    qsDictionaryFreeze(s->app->controllers);
+    for(struct QsController *c=s->app->first; c; c=c->next)
+        qsDictionaryFreeze(c->parameters);
+
+
+    /**********************************************************************
+     *      Stage: make arrays of controller pre and post input callbacks
+     *********************************************************************/
+
+    // The controllers have added all the callbacks they will for this
+    // stream run.  The flow calls these arrays, in place of iterating
+    // through the dictionaries after every filter input() call.
+    for(struct QsFilter *f = s->filters; f; f = f->next)
+        CompileInputCallbacks(f);
+
+
     return 0; // success
 }
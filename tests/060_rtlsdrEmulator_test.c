@@ -0,0 +1,153 @@
+// Tests the emulated librtlsdr in ../dev_tests/rtlsdrEmulator.c, that a
+// reader that keeps up gets all the samples, and that a reader that falls
+// behind more than the USB buffers loses samples, like with the dongle.
+//
+// The emulator replays a file in which sample i is the 16 bit count i, I
+// is the low byte and Q is the high byte, so we can see where samples are
+// lost.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "../lib/debug.h"
+
+
+// From rtl-sdr.h, which we do not need to have.
+typedef struct rtlsdr_dev rtlsdr_dev_t;
+typedef void (*rtlsdr_read_async_cb_t)(unsigned char *buf, uint32_t len,
+        void *ctx);
+extern int rtlsdr_open(rtlsdr_dev_t **dev, uint32_t index);
+extern int rtlsdr_close(rtlsdr_dev_t *dev);
+extern int rtlsdr_set_sample_rate(rtlsdr_dev_t *dev, uint32_t rate);
+extern int rtlsdr_reset_buffer(rtlsdr_dev_t *dev);
+extern int rtlsdr_read_sync(rtlsdr_dev_t *dev, void *buf, int len,
+        int *n_read);
+extern int rtlsdr_read_async(rtlsdr_dev_t *dev, rtlsdr_read_async_cb_t cb,
+        void *ctx, uint32_t buf_num, uint32_t buf_len);
+extern int rtlsdr_cancel_async(rtlsdr_dev_t *dev);
+
+
+#define FILENAME  "060_rtlsdrEmulator.tmp"
+#define RATE      ((uint32_t) 250000)
+#define BUF_NUM   ((uint32_t) 2)
+#define BUF_LEN   ((uint32_t) 4096)
+// The async reader sleeps this long, in seconds, in one callback.
+#define NAP       (0.1)
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+static rtlsdr_dev_t *dev;
+
+// The next 16 bit count that we expect.
+static uint16_t next;
+static bool haveNext = false;
+
+// Samples that were not there, found by the gaps in the count.
+static uint64_t gap = 0;
+static uint32_t numGaps = 0;
+
+static uint32_t numCallbacks = 0;
+
+
+// Check that the count in buf goes up by one, and add up the gaps.
+static void Check(const uint8_t *buf, size_t len) {
+
+    for(size_t i=0; i<len; i += 2) {
+        uint16_t c = buf[i] | (((uint16_t) buf[i+1]) << 8);
+        if(haveNext && c != next) {
+            gap += (uint16_t) (c - next);
+            ++numGaps;
+        }
+        next = c + 1;
+        haveNext = true;
+    }
+}
+
+
+static void callback(unsigned char *buf, uint32_t len, void *ctx) {
+
+    ASSERT(ctx == &dev);
+    ASSERT(len == BUF_LEN);
+
+    Check(buf, len);
+
+    ++numCallbacks;
+
+    if(numCallbacks == 5)
+        // Fall behind.
+        usleep(NAP * 1000000);
+    else if(numCallbacks == 20)
+        ASSERT(rtlsdr_cancel_async(dev) == 0);
+}
+
+
+int main(void) {
+
+    ASSERT(signal(SIGSEGV, catcher) != SIG_ERR);
+    ASSERT(signal(SIGABRT, catcher) != SIG_ERR);
+
+    FILE *f = fopen(FILENAME, "w");
+    ASSERT(f);
+    for(uint32_t i=0; i < (1 << 16); ++i) {
+        uint8_t iq[2] = { i & 0xFF, i >> 8 };
+        ASSERT(fwrite(iq, 2, 1, f) == 1);
+    }
+    fclose(f);
+
+    ASSERT(setenv("RTLSDR_EMU_FILE", FILENAME, 1) == 0);
+    ASSERT(setenv("RTLSDR_EMU_RATE", "real", 1) == 0);
+    ASSERT(unsetenv("RTLSDR_EMU_STALL") == 0);
+
+    ASSERT(rtlsdr_open(&dev, 0) == 0);
+    ASSERT(rtlsdr_set_sample_rate(dev, RATE) == 0);
+    ASSERT(rtlsdr_reset_buffer(dev) == 0);
+
+    // A sync reader that keeps up gets all the samples.
+    uint8_t buf[BUF_LEN];
+    for(int i=0; i<10; ++i) {
+        int n = 0;
+        ASSERT(rtlsdr_read_sync(dev, buf, sizeof(buf), &n) == 0);
+        ASSERT(n == sizeof(buf));
+        Check(buf, n);
+    }
+    ASSERT(numGaps == 0, "%" PRIu32 " gaps", numGaps);
+
+    // An async reader that falls NAP seconds behind, and so more than the
+    // BUF_NUM*BUF_LEN bytes of buffers, loses the samples that did not fit
+    // in the buffers.
+    ASSERT(rtlsdr_reset_buffer(dev) == 0);
+    haveNext = false;
+    ASSERT(rtlsdr_read_async(dev, callback, &dev, BUF_NUM, BUF_LEN) == 0);
+    ASSERT(numCallbacks == 20);
+    ASSERT(numGaps == 1, "%" PRIu32 " gaps", numGaps);
+    // The gap is mod 2^16 so this fails if the nap is over about 0.28
+    // seconds late.
+    const uint64_t min = NAP * RATE - (BUF_NUM * BUF_LEN)/2;
+    ASSERT(gap >= min, "lost %" PRIu64 " < %" PRIu64 " samples",
+            gap, min);
+
+    ASSERT(rtlsdr_close(dev) == 0);
+
+    fprintf(stderr, "%s lost %" PRIu64 " samples\nSUCCESS\n",
+            __BASE_FILE__, gap);
+
+    return 0;
+}
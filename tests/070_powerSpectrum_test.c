@@ -0,0 +1,105 @@
+// Tests the fftwPowerSpectrum filter.  A tone from signalGen at the
+// center of a bin must make the biggest value in the spectrums in that
+// bin, and the spectrums must add up to the power of the tone.
+
+#include "dspTest.h"
+
+
+#define FILENAME  "070_powerSpectrum.tmp"
+
+
+// Run n samples of a tone at bin k, where k may be negative, through
+// fftwPowerSpectrum with the options bins, average, overlap, and window.
+static void Spectrum(int k, size_t n, int bins, size_t average,
+        int overlap, const char *window, size_t bufMult,
+        uint32_t maxThreads) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    const double rate = 1024000.0;
+    const double amplitude = 0.5;
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu --rate %lg"
+            " --freq %lg --amplitude %lg --maxWrite 3000",
+            n, rate, k * rate/bins, amplitude);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--bins %d --average %zu --overlap %d"
+            " --window %s --bufMult %zu", bins, average, overlap, window,
+            bufMult);
+    struct QsFilter *ps = Load(s, "fftwPowerSpectrum", args);
+    Connect(gen, ps);
+    Connect(ps, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    size_t num;
+    float *x = ReadFloats(FILENAME, &num);
+
+    size_t hop = bins - overlap;
+    size_t frames = (n - bins)/hop + 1;
+    size_t spectrums = frames/average;
+
+    fprintf(stderr, "bins=%d average=%zu overlap=%d window=%s:"
+            " %zu spectrums\n", bins, average, overlap, window,
+            num/bins);
+    ASSERT(num == spectrums * bins, "got %zu floats not %zu",
+            num, spectrums * bins);
+
+    size_t bin = (k < 0)?(bins + k):k;
+
+    for(size_t i=0; i<spectrums; ++i) {
+        const float *p = x + i * bins;
+        double sum = 0.0;
+        size_t max = 0;
+        for(size_t j=0; j<bins; ++j) {
+            sum += p[j];
+            if(p[j] > p[max])
+                max = j;
+        }
+        ASSERT(max == bin, "spectrum %zu peak at bin %zu not %zu",
+                i, max, bin);
+        // By Parseval's theorem, and how the spectrum is scaled, the
+        // sum is bins times the power of the tone, for any window.
+        double power = bins * amplitude * amplitude;
+        ASSERT(fabs(sum - power) < 1.0e-3 * power,
+                "spectrum %zu adds up to %lg not %lg", i, sum, power);
+        if(strcmp(window, "rectangular") == 0)
+            // All the power is in the one bin.
+            ASSERT(fabs(p[bin] - power) < 1.0e-3 * power,
+                    "spectrum %zu bin %zu is %g not %lg",
+                    i, bin, p[bin], power);
+    }
+
+    free(x);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    if(!HaveFilter("fftwPowerSpectrum")) {
+        fprintf(stderr, "\n  The fftwPowerSpectrum filter was not built,"
+                " so this test passes by default.\n\nSUCCESS\n");
+        return 0;
+    }
+
+    Spectrum(100, 40000, 512, 16, 256, "hann", 2, 0);
+    Spectrum(-37, 30011, 256, 4, 64, "blackman", 3, 2);
+    // An odd number of bins so the vector kernels have a remainder.
+    Spectrum(9, 20000, 125, 3, 0, "rectangular", 1, 0);
+    Spectrum(-1, 9000, 64, 1, 63, "hamming", 5, 2);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
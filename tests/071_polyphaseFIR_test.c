@@ -0,0 +1,148 @@
+// Tests the polyphaseFIR filter.  A tone from signalGen is decimated or
+// interpolated, and must keep its frequency in Hz, or be filtered out if
+// it is above the output Nyquist frequency.  And a ramp through a small
+// real filter must give the exact values.
+
+#include "dspTest.h"
+
+
+#define FILENAME  "071_polyphaseFIR.tmp"
+#define RAMPFILE  "071_polyphaseFIR_ramp.tmp"
+
+
+// Filter the n samples of a tone of freq Hz at rate, and decimate by M or
+// interpolate by L.  If pass the tone must come out with magnitude 1,
+// else it must be filtered out.
+static void Tone(double rate, double freq, size_t n, uint32_t M,
+        uint32_t L, bool pass, const char *opts, uint32_t maxThreads) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu --rate %lg"
+            " --freq %lg", n, rate, freq);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--decimate %" PRIu32 " --interpolate %"
+            PRIu32 " %s", M, L, opts?opts:"");
+    struct QsFilter *fir = Load(s, "polyphaseFIR", args);
+    Connect(gen, fir);
+    Connect(fir, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    size_t num;
+    float *x = ReadFloats(FILENAME, &num);
+    // Complex output samples.
+    num /= 2;
+
+    // The default filter has 16*max(L,M) + 1 taps, and the last input
+    // samples that are less than a filter window make no output.
+    uint32_t r = (M > L)?M:L;
+    size_t window = (16*r + 1)/L + M + 1;
+    size_t max = n * L/M;
+    size_t min = (n - window) * L/M;
+    double outRate = rate * L/M;
+    fprintf(stderr, "decimate %" PRIu32 " interpolate %" PRIu32
+            " %s: %zu samples in, %zu out\n", M, L, opts?opts:"", n, num);
+    ASSERT(min <= num && num <= max, "%zu output samples not in [%zu,%zu]",
+            num, min, max);
+
+    // Skip the filter start transient.
+    const float *y = x + 2*(num/4);
+    size_t m = num/2;
+    double min_, max_;
+    MagRange(y, m, &min_, &max_);
+
+    if(pass) {
+        double f = ToneFreq(y, m) * outRate;
+        ASSERT(fabs(f - freq) < 1.0e-3 * fabs(freq),
+                "tone at %lg Hz not %lg Hz", f, freq);
+        ASSERT(min_ > 0.9 && max_ < 1.1, "tone magnitude from %lg to %lg",
+                min_, max_);
+    } else
+        ASSERT(max_ < 0.05, "tone at %lg Hz not filtered out, magnitude"
+                " %lg", freq, max_);
+
+    free(x);
+}
+
+
+// A ramp x[i] = i of n real floats through the taps 0.25, 0.5, 0.25 and
+// decimated by M gives y[j] = M j + 1.
+static void Ramp(size_t n, uint32_t M, const char *opts,
+        uint32_t maxThreads) {
+
+    float *ramp = malloc(n * sizeof(*ramp));
+    ASSERT(ramp);
+    for(size_t i=0; i<n; ++i)
+        ramp[i] = i;
+    WriteFile(RAMPFILE, ramp, n * sizeof(*ramp));
+    free(ramp);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --real --length %zu"
+            " --signal replay --file " RAMPFILE, n);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--real --taps 0.25,0.5,0.25"
+            " --decimate %" PRIu32 " %s", M, opts?opts:"");
+    struct QsFilter *fir = Load(s, "polyphaseFIR", args);
+    Connect(gen, fir);
+    Connect(fir, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    size_t num;
+    float *y = ReadFloats(FILENAME, &num);
+
+    // One output for each window that starts at a multiple of M.  fir.h
+    // pads the 3 taps with a zero to 4 floats, so a window is 4 inputs.
+    size_t expect = (n - 4)/M + 1;
+    fprintf(stderr, "ramp of %zu decimated by %" PRIu32 " %s: %zu out\n",
+            n, M, opts?opts:"", num);
+    ASSERT(num == expect, "%zu output samples not %zu", num, expect);
+
+    for(size_t j=0; j<num; ++j)
+        ASSERT(y[j] == M * j + 1.0F, "y[%zu] = %g not %zu",
+                j, y[j], M * j + 1);
+
+    free(y);
+    unlink(RAMPFILE);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    Tone(48000, 2000, 40000, 4, 1, true, 0, 0);
+    // 20 kHz is above the 6 kHz output Nyquist frequency.
+    Tone(48000, 20000, 40000, 4, 1, false, 0, 2);
+    Tone(48000, -1500, 30000, 7, 1, true, "--maxWrite 24", 3);
+    Tone(8000, 1000, 5000, 1, 5, true, 0, 0);
+    // --maxWrite is rounded down to 80, 2 phase cycles.
+    Tone(8000, -700, 5000, 1, 5, true, "--maxWrite 100", 2);
+    Tone(8000, 1000, 3000, 1, 33, true, "--numTaps 200 --cutoff 0.8", 0);
+
+    Ramp(1000, 1, 0, 0);
+    Ramp(1001, 2, 0, 2);
+    Ramp(9999, 3, "--maxWrite 20", 0);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
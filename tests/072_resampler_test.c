@@ -0,0 +1,106 @@
+// Tests the resampler filter.  A tone from signalGen is resampled, and
+// the output must have the right length and the tone at the same
+// frequency in Hz, for decimating and for large interpolating factors,
+// where one input() call may not advance the input for many outputs.
+
+#include "dspTest.h"
+
+
+#define FILENAME  "072_resampler.tmp"
+
+
+static size_t Gcd(size_t a, size_t b) {
+
+    while(b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+// Resample a tone of freq Hz at inRate from the n input samples to
+// outRate, and check the output.
+static void Resample(double inRate, double outRate, double freq,
+        size_t n, const char *opts, uint32_t maxThreads) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu --rate %lg"
+            " --freq %lg", n, inRate, freq);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--inRate %.0lf --outRate %.0lf %s",
+            inRate, outRate, opts?opts:"");
+    struct QsFilter *resampler = Load(s, "resampler", args);
+    Connect(gen, resampler);
+    Connect(resampler, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    size_t num;
+    float *x = ReadFloats(FILENAME, &num);
+    // Complex output samples.
+    num /= 2;
+
+    // The default filter has 16*max(L,M) + 1 taps, which is about
+    // 16*max(L,M)/L input samples, and the last input samples that are
+    // less than a filter window make no output.
+    double ratio = outRate/inRate;
+    size_t gcd = Gcd(inRate, outRate);
+    size_t L = outRate/gcd, M = inRate/gcd;
+    size_t window = 16 * ((L > M)?L:M)/L + 4;
+    size_t max = ceil(n * ratio);
+    size_t min = (n - window) * ratio;
+    fprintf(stderr, "%lg -> %lg Hz: %zu samples in, %zu out\n",
+            inRate, outRate, n, num);
+    ASSERT(min <= num && num <= max, "%zu output samples not in [%zu,%zu]",
+            num, min, max);
+
+    // Skip the filter start transient, which is the number of filter taps
+    // long, and is less than a quarter of the output.
+    const float *y = x + 2*(num/4);
+    size_t m = num/2;
+
+    double f = ToneFreq(y, m) * outRate;
+    ASSERT(fabs(f - freq) < 1.0e-3 * freq, "tone at %lg Hz not %lg Hz",
+            f, freq);
+
+    double min_, max_;
+    MagRange(y, m, &min_, &max_);
+    ASSERT(min_ > 0.9 && max_ < 1.1, "tone magnitude from %lg to %lg",
+            min_, max_);
+
+    free(x);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    // Decimate by 6, with a small --maxWrite.
+    Resample(48000, 8000, 1000, 60000, "--maxWrite 24", 2);
+    // 3/2
+    Resample(32000, 48000, 2000, 20000, 0, 0);
+    // Interpolate by 129, which is more than the 1024/8 output samples
+    // that fit in the default --maxWrite, and with a --maxWrite that is
+    // smaller than that.
+    Resample(8000, 1032000, 500, 4000, 0, 2);
+    Resample(8000, 1032000, 500, 4000, "--maxWrite 64", 0);
+    // Interpolate by 300.
+    Resample(8000, 2400000, 500, 2000, 0, 3);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Tests the mixer filter.  A tone from signalGen must come out shifted by
+// the mixer frequency, with the same length and magnitude, and the
+// "freq" parameter must change the shift while the stream is flowing.
+
+#include "dspTest.h"
+
+#include "../include/quickstream/parameter.h"
+
+
+#define FILENAME  "073_mixer.tmp"
+
+
+// Mix the n samples of a tone of freq Hz at rate by shift Hz.  If
+// newShift is not 0 we set the "freq" parameter to it after 1/4 of the
+// samples, and signalGen is throttled so that we know when that is.
+static void Mix(double rate, double freq, size_t n, double shift,
+        const double *newShift, const char *opts, uint32_t maxThreads) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "%s --length %zu --rate %lg"
+            " --freq %lg", newShift?"":"--unthrottled", n, rate, freq);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--rate %lg --freq %lg %s",
+            rate, shift, opts?opts:"");
+    struct QsFilter *mixer = Load(s, "mixer", args);
+    Connect(gen, mixer);
+    Connect(mixer, Sink(s, FILENAME));
+
+    if(newShift) {
+        ASSERT(maxThreads);
+        ASSERT(qsStreamReady(s) == 0);
+        ASSERT(qsStreamLaunch(s, maxThreads) == 0);
+        usleep(1000000 * n/(4 * rate));
+        double val = *newShift;
+        ASSERT(qsParameterSet(s, "mixer", "freq", QsDouble, &val) == 0);
+        qsStreamWait(s);
+        ASSERT(qsStreamStop(s) == 0);
+    } else
+        Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    size_t num;
+    float *x = ReadFloats(FILENAME, &num);
+    // Complex samples.
+    num /= 2;
+
+    fprintf(stderr, "tone at %lg Hz shifted by %lg Hz %s: %zu samples\n",
+            freq, shift, opts?opts:"", num);
+    ASSERT(num == n, "%zu output samples not %zu", num, n);
+
+    double min, max;
+    MagRange(x, num, &min, &max);
+    ASSERT(min > 0.999 && max < 1.001, "tone magnitude from %lg to %lg",
+            min, max);
+
+    // Before the parameter is set, or all of it.
+    size_t m = newShift?(n/20):n;
+    double f = ToneFreq(x, m) * rate;
+    ASSERT(fabs(f - (freq + shift)) < 1.0e-3 * rate,
+            "tone at %lg Hz not %lg Hz", f, freq + shift);
+
+    if(newShift) {
+        // The last half is after the parameter is set.
+        f = ToneFreq(x + 2*(n/2), n - n/2) * rate;
+        ASSERT(fabs(f - (freq + *newShift)) < 1.0e-3 * rate,
+                "tone at %lg Hz not %lg Hz after setting \"freq\"",
+                f, freq + *newShift);
+    }
+
+    free(x);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    Mix(48000, 1000, 100000, -3000, 0, 0, 0);
+    // --maxWrite is rounded down to 40 bytes.
+    Mix(48000, -7000, 30001, 9000, 0, "--maxWrite 44", 2);
+    // 0 leaves the data as it is.
+    Mix(1, 0.1, 2000, 0, 0, "--maxWrite 1000", 0);
+
+    const double newShift = 2000;
+    Mix(100000, 1000, 100000, -5000, &newShift, 0, 2);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Tests the fftwChannelizer filter.  A tone from signalGen a little above
+// the center of channel k, k*rate/N, must come out of output port k at
+// the offset frequency, and must be filtered out of the other ports.
+
+#include "dspTest.h"
+
+
+#define MAX_PORTS  8
+
+
+static void Filename(char *name, size_t size, uint32_t port) {
+    snprintf(name, size, "074_channelizer_%" PRIu32 ".tmp", port);
+}
+
+
+// Run n samples of a tone in channel k, where k may be negative, through
+// the channelizer with numPorts outputs, and N channels.  opts are more
+// channelizer options, and may be 0.
+static void Channelize(uint32_t N, uint32_t numPorts, int k, size_t n,
+        uint32_t tapsPerBranch, const char *opts, uint32_t maxThreads) {
+
+    ASSERT(numPorts <= MAX_PORTS);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    const double rate = 1600000.0;
+    const double spacing = rate/N;
+    // The tone is a tenth of the channel spacing above the channel center,
+    // so it is well in the pass band.
+    const double offset = 0.1 * spacing;
+    const double amplitude = 0.5;
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu --rate %lg"
+            " --freq %lg --amplitude %lg",
+            n, rate, k * spacing + offset, amplitude);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--channels %" PRIu32 " --taps %" PRIu32
+            " %s", N, tapsPerBranch, opts?opts:"");
+    struct QsFilter *ch = Load(s, "fftwChannelizer", args);
+    Connect(gen, ch);
+    for(uint32_t i=0; i<numPorts; ++i) {
+        char name[64];
+        Filename(name, sizeof(name), i);
+        // We give the output port numbers, because QS_NEXTPORT can't
+        // number more than two output ports.
+        qsFiltersConnect(ch, Sink(s, name), i, 0);
+    }
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    uint32_t port = (k < 0)?(N + k):k;
+    // Every output gets one sample for each N input samples after the
+    // first window of all the taps.
+    size_t numOut = (n - N * tapsPerBranch)/N + 1;
+
+    fprintf(stderr, "%" PRIu32 " channels, %" PRIu32 " taps, tone in"
+            " channel %d: %zu samples in, %zu out of each of %" PRIu32
+            " ports\n", N, tapsPerBranch, k, n, numOut, numPorts);
+
+    for(uint32_t i=0; i<numPorts; ++i) {
+        char name[64];
+        Filename(name, sizeof(name), i);
+        size_t num;
+        float *x = ReadFloats(name, &num);
+        // Complex samples.
+        num /= 2;
+        ASSERT(num == numOut, "port %" PRIu32 " has %zu samples not %zu",
+                i, num, numOut);
+
+        // Skip the start, where the first windows are not yet all tone.
+        const float *y = x + 2*(num/4);
+        size_t m = num - num/4;
+        double min, max;
+        MagRange(y, m, &min, &max);
+
+        if(i == port) {
+            double f = ToneFreq(y, m) * spacing;
+            ASSERT(fabs(f - offset) < 1.0e-3 * offset,
+                    "port %" PRIu32 " tone at %lg Hz not %lg Hz",
+                    i, f, offset);
+            ASSERT(min > 0.9 * amplitude && max < 1.1 * amplitude,
+                    "port %" PRIu32 " tone magnitude from %lg to %lg",
+                    i, min, max);
+        } else
+            ASSERT(max < 0.1 * amplitude,
+                    "port %" PRIu32 " has magnitude %lg from channel %d",
+                    i, max, k);
+
+        free(x);
+        unlink(name);
+    }
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    if(!HaveFilter("fftwChannelizer")) {
+        fprintf(stderr, "\n  The fftwChannelizer filter was not built,"
+                " so this test passes by default.\n\nSUCCESS\n");
+        return 0;
+    }
+
+    // All the channels have a port.
+    Channelize(4, 4, 1, 40000, 8, 0, 0);
+    // An odd number of channels, so the vector kernels have a remainder,
+    // a negative frequency channel, and a small --maxWrite.
+    Channelize(5, 5, -1, 30001, 4, "--maxWrite 40", 2);
+    // More channels than ports.
+    Channelize(16, 3, 2, 100000, 12, "--maxWrite 1001", 0);
+    Channelize(8, 8, 0, 50000, 16, "--cutoff 0.8", 3);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
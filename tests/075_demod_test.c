@@ -0,0 +1,142 @@
+// Tests the fmDemod and amDemod filters.  The FM demodulation of a tone
+// from signalGen is the constant tone frequency times the gain, and the
+// AM demodulation of an amplitude modulated carrier is the envelope.
+
+#include "dspTest.h"
+
+
+#define FILENAME  "075_demod.tmp"
+#define AMFILE    "075_demod_am.tmp"
+
+
+// Returns the output of the demodulator filter name, with the options
+// opts, of the n samples from signalGen with the options genOpts.  Sets
+// *num to the number of output floats.
+static float *Demod(const char *name, const char *opts,
+        const char *genOpts, size_t n, uint32_t maxThreads,
+        size_t *num) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu %s",
+            n, genOpts);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    struct QsFilter *demod = Load(s, name, opts);
+    Connect(gen, demod);
+    Connect(demod, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    float *y = ReadFloats(FILENAME, num);
+    fprintf(stderr, "%s { %s } from signalGen { %s }: %zu samples\n",
+            name, opts?opts:"", genOpts, *num);
+    ASSERT(*num == n, "%zu output samples not %zu", *num, n);
+    return y;
+}
+
+
+// FM demodulate a tone of freq Hz at rate, and check that the output is
+// expect.
+static void FM(double rate, double freq, size_t n, double expect,
+        const char *opts, uint32_t maxThreads) {
+
+    char genOpts[128];
+    snprintf(genOpts, sizeof(genOpts), "--rate %lg --freq %lg --amplitude"
+            " 0.3", rate, freq);
+    size_t num;
+    float *y = Demod("fmDemod", opts, genOpts, n, maxThreads, &num);
+
+    // y[0] is from the sample before the first, which is 0.
+    for(size_t i=1; i<num; ++i)
+        ASSERT(fabs(y[i] - expect) < 1.0e-4 * (1.0 + fabs(expect)),
+                "y[%zu] = %g not %lg", i, y[i], expect);
+
+    free(y);
+}
+
+
+// AM demodulate a carrier with the amplitude 1 + m cos(2 pi i/period),
+// and check that the output is gain times that.
+static void AM(double m, size_t period, size_t n, float gain,
+        uint32_t maxThreads) {
+
+    float *x = malloc(2 * period * sizeof(*x));
+    ASSERT(x);
+    for(size_t i=0; i<period; ++i) {
+        double a = 1.0 + m * cos(2.0 * M_PI * i/period);
+        // The carrier phase does not matter.
+        x[2*i] = a * cos(0.1 * i);
+        x[2*i+1] = a * sin(0.1 * i);
+    }
+    WriteFile(AMFILE, x, 2 * period * sizeof(*x));
+    free(x);
+
+    char opts[64];
+    snprintf(opts, sizeof(opts), "--gain %g --maxWrite %zu",
+            gain, 4 * period + 4);
+    size_t num;
+    float *y = Demod("amDemod", opts, "--signal replay --file " AMFILE,
+            n, maxThreads, &num);
+
+    for(size_t i=0; i<num; ++i) {
+        double expect = gain * (1.0 + m * cos(2.0 * M_PI * (i % period)/
+                    period));
+        ASSERT(fabs(y[i] - expect) < 1.0e-5 * (1.0 + fabs(expect)),
+                "y[%zu] = %g not %lg", i, y[i], expect);
+    }
+
+    free(y);
+    unlink(AMFILE);
+}
+
+
+// With --dcBlock A the DC of a constant carrier of amplitude B is
+// removed, and the output is B (1 - A)^(i+1).
+static void DCBlock(float A, float B, size_t n) {
+
+    char opts[64], genOpts[64];
+    snprintf(opts, sizeof(opts), "--dcBlock %g", A);
+    snprintf(genOpts, sizeof(genOpts), "--amplitude %g --freq 0", B);
+    size_t num;
+    float *y = Demod("amDemod", opts, genOpts, n, 0, &num);
+
+    for(size_t i=0; i<num; ++i) {
+        double expect = B * pow(1.0 - A, i + 1);
+        ASSERT(fabs(y[i] - expect) < 1.0e-4 * B,
+                "y[%zu] = %g not %lg", i, y[i], expect);
+    }
+
+    free(y);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    // The default gain is 1/pi, so the output is 2 freq/rate.
+    FM(100000, 10000, 20000, 0.2, 0, 0);
+    // A deviation of D gives 1, so the output is freq/D.  --maxWrite is
+    // 11 floats, so the vector loop has a remainder.
+    FM(250000, -30000, 30001, -0.4,
+            "--deviation 75000 --rate 250000 --maxWrite 44", 2);
+    FM(1, 0.01, 5000, 2.0 * 2.0 * M_PI * 0.01, "--gain 2", 3);
+
+    AM(0.5, 100, 10000, 1.0F, 0);
+    AM(0.9, 37, 5001, 3.0F, 2);
+
+    DCBlock(0.01F, 0.7F, 3000);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
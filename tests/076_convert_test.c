@@ -0,0 +1,221 @@
+// Tests the convert filter.  signalGen replays files of samples of each
+// type through one or two convert filters, and the output must be the
+// exact rounded and saturated values, or the same as the input for a
+// round-trip.
+
+#include "dspTest.h"
+
+
+#define FILENAME   "076_convert.tmp"
+#define INFILE     "076_convert_in.tmp"
+
+#define NUM_FLOATS  8000
+
+
+// Run the len bytes in data through the convert filters with the
+// options in opts[], which is 0 terminated, and return the output.  Sets
+// *outLen to the output length in bytes.  len must be a multiple of 4.
+static void *Convert(const void *data, size_t len, const char **opts,
+        uint32_t maxThreads, size_t *outLen) {
+
+    ASSERT(len % 4 == 0);
+    WriteFile(INFILE, data, len);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    // With --real signalGen writes 4 byte samples, whatever the type of
+    // the data in the file is.
+    snprintf(args, sizeof(args), "--unthrottled --real --length %zu"
+            " --signal replay --file " INFILE " --maxWrite 1004", len/4);
+    struct QsFilter *prev = Load(s, "signalGen", args);
+    for(; *opts; ++opts) {
+        struct QsFilter *convert = Load(s, "convert", *opts);
+        Connect(prev, convert);
+        prev = convert;
+    }
+    Connect(prev, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    void *out = ReadFile(FILENAME, outLen);
+    unlink(INFILE);
+    return out;
+}
+
+
+// All the int16 values must go to float and back unchanged, and the
+// floats must be the fixed point values.
+static void Int16RoundTrip(uint32_t maxThreads) {
+
+    const size_t n = 1 << 16;
+    int16_t *x = malloc(n * sizeof(*x));
+    ASSERT(x);
+    for(size_t i=0; i<n; ++i)
+        x[i] = INT16_MIN + i;
+
+    const char *opts[] = {
+        "--from int16 --to float --maxWrite 100",
+        "--from float --to int16",
+        0
+    };
+    size_t len;
+    int16_t *y = Convert(x, n * sizeof(*x), opts, maxThreads, &len);
+    ASSERT(len == n * sizeof(*x), "got %zu bytes not %zu",
+            len, n * sizeof(*x));
+    ASSERT(memcmp(x, y, len) == 0, "int16 -> float -> int16 changed"
+            " the values");
+    free(y);
+
+    opts[1] = 0;
+    float *f = Convert(x, n * sizeof(*x), opts, maxThreads, &len);
+    ASSERT(len == n * sizeof(*f), "got %zu bytes not %zu",
+            len, n * sizeof(*f));
+    for(size_t i=0; i<n; ++i)
+        ASSERT(f[i] == x[i]/32768.0F, "int16 %" PRIi16 " -> %g",
+                x[i], f[i]);
+    free(f);
+
+    fprintf(stderr, "int16 -> float -> int16 round-trip passed\n");
+    free(x);
+}
+
+
+// All the int8 values go to uint8 in place, with a pass-through buffer,
+// and back again; and all the cuint8 values go to cfloat.
+static void Int8RoundTrip(uint32_t maxThreads) {
+
+    int8_t x[256];
+    for(int i=0; i<256; ++i)
+        x[i] = INT8_MIN + i;
+
+    const char *opts[] = { "--from int8 --to uint8", 0, 0 };
+    size_t len;
+    uint8_t *u = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == sizeof(x));
+    for(int i=0; i<256; ++i)
+        ASSERT(u[i] == x[i] + 128, "int8 %" PRIi8 " -> uint8 %" PRIu8,
+                x[i], u[i]);
+
+    opts[1] = "--from uint8 --to int8 --maxWrite 33";
+    int8_t *y = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == sizeof(x));
+    ASSERT(memcmp(x, y, len) == 0, "int8 -> uint8 -> int8 changed"
+            " the values");
+    free(y);
+
+    const char *copts[] = { "--from cuint8 --to cfloat", 0 };
+    float *f = Convert(u, sizeof(x), copts, maxThreads, &len);
+    ASSERT(len == sizeof(x) * sizeof(*f));
+    for(int i=0; i<256; ++i)
+        ASSERT(f[i] == (u[i] - 128)/128.0F, "uint8 %" PRIu8 " -> %g",
+                u[i], f[i]);
+    free(f);
+    free(u);
+
+    fprintf(stderr, "int8 -> uint8 -> int8 round-trip passed\n");
+}
+
+
+// Returns x scaled by a, plus b, rounded half away from zero, and
+// saturated to [min, max].
+static float Expect(float x, float a, float b, float min, float max) {
+
+    float v = a * x + b;
+    if(v < min) v = min;
+    else if(v > max) v = max;
+    return roundf(v);
+}
+
+
+// Floats from -2 to 2 go to the integer types, with values that round
+// half way and values that saturate.
+static void Saturate(uint32_t maxThreads) {
+
+    float x[NUM_FLOATS];
+    for(int i=0; i<NUM_FLOATS; ++i)
+        // Steps of 1/2048, so there are values half way between the int8
+        // values, and a little off from that.
+        x[i] = (i - NUM_FLOATS/2)/2048.0F + ((i % 3 == 2)?1.0e-6F:0.0F);
+
+    size_t len;
+    const char *opts[] = { "--from float --to int8 --maxWrite 17", 0 };
+    int8_t *i8 = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == NUM_FLOATS);
+    for(int i=0; i<NUM_FLOATS; ++i)
+        ASSERT(i8[i] == Expect(x[i], 128.0F, 0.0F, INT8_MIN, INT8_MAX),
+                "float %g -> int8 %" PRIi8, x[i], i8[i]);
+    free(i8);
+
+    opts[0] = "--from float --to uint8";
+    uint8_t *u8 = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == NUM_FLOATS);
+    for(int i=0; i<NUM_FLOATS; ++i)
+        ASSERT(u8[i] == Expect(x[i], 128.0F, 128.0F, 0, UINT8_MAX),
+                "float %g -> uint8 %" PRIu8, x[i], u8[i]);
+    free(u8);
+
+    opts[0] = "--from float --to int16 --scale 0.75";
+    int16_t *i16 = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == NUM_FLOATS * sizeof(*i16));
+    for(int i=0; i<NUM_FLOATS; ++i)
+        ASSERT(i16[i] == Expect(x[i], 0.75F * 32768.0F, 0.0F,
+                    INT16_MIN, INT16_MAX),
+                "float %g -> int16 %" PRIi16, x[i], i16[i]);
+    free(i16);
+
+    fprintf(stderr, "float saturation passed\n");
+}
+
+
+// With --raw the values are not fixed point.
+static void Raw(uint32_t maxThreads) {
+
+    uint8_t x[1000];
+    for(int i=0; i<1000; ++i)
+        x[i] = i;
+
+    size_t len;
+    const char *opts[] = { "--from uint8 --to float --raw --scale 0.5", 0 };
+    float *f = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == sizeof(x) * sizeof(*f));
+    for(int i=0; i<1000; ++i)
+        ASSERT(f[i] == 0.5F * x[i], "uint8 %" PRIu8 " -> %g", x[i], f[i]);
+    free(f);
+
+    opts[0] = "--from uint8 --to int8 --raw";
+    int8_t *y = Convert(x, sizeof(x), opts, maxThreads, &len);
+    ASSERT(len == sizeof(x));
+    for(int i=0; i<1000; ++i)
+        ASSERT(y[i] == ((x[i] > INT8_MAX)?INT8_MAX:x[i]),
+                "uint8 %" PRIu8 " -> int8 %" PRIi8, x[i], y[i]);
+    free(y);
+
+    fprintf(stderr, "--raw passed\n");
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    Int16RoundTrip(0);
+    Int16RoundTrip(2);
+    Int8RoundTrip(0);
+    Int8RoundTrip(3);
+    Saturate(0);
+    Saturate(2);
+    Raw(0);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
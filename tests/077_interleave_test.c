@@ -0,0 +1,115 @@
+// Tests the deinterleave and interleave filters.  signalGen replays
+// frames of N channels into deinterleave, each deinterleave output must
+// be one channel, and interleave of the deinterleave outputs must be the
+// same as the input.
+
+#include "dspTest.h"
+
+
+#define INFILE    "077_interleave_in.tmp"
+#define OUTFILE   "077_interleave_out.tmp"
+
+#define MAX_CHANNELS  8
+
+
+static void ChannelFile(char *name, size_t size, uint32_t channel) {
+    snprintf(name, size, "077_interleave_%" PRIu32 ".tmp", channel);
+}
+
+
+// Run the frames of N channels of values of size bytes, through
+// deinterleave and interleave.  opts are more options for both filters,
+// and may be 0.
+static void Interleave(uint32_t N, size_t size, size_t frames,
+        const char *opts, uint32_t maxThreads) {
+
+    ASSERT(N <= MAX_CHANNELS);
+
+    size_t len = frames * N * size;
+    // signalGen --real writes 4 byte samples.
+    ASSERT(len % 4 == 0);
+    uint8_t *x = malloc(len);
+    ASSERT(x);
+    // Values that will not repeat in a way that can hide a mistake.
+    uint32_t r = 1;
+    for(size_t i=0; i<len; ++i) {
+        r = r * 1664525 + 1013904223;
+        x[i] = r >> 24;
+    }
+    WriteFile(INFILE, x, len);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --real --length %zu"
+            " --signal replay --file " INFILE " --maxWrite 1000", len/4);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    snprintf(args, sizeof(args), "--size %zu %s", size, opts?opts:"");
+    struct QsFilter *de = Load(s, "deinterleave", args);
+    struct QsFilter *in = Load(s, "interleave", args);
+    Connect(gen, de);
+    // We give the port numbers, because QS_NEXTPORT can't number more
+    // than two ports.
+    for(uint32_t i=0; i<N; ++i) {
+        char name[64];
+        ChannelFile(name, sizeof(name), i);
+        qsFiltersConnect(de, Sink(s, name), i, 0);
+        qsFiltersConnect(de, in, i, i);
+    }
+    Connect(in, Sink(s, OUTFILE));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "%" PRIu32 " channels of %zu byte values %s:"
+            " %zu frames\n", N, size, opts?opts:"", frames);
+
+    for(uint32_t i=0; i<N; ++i) {
+        char name[64];
+        ChannelFile(name, sizeof(name), i);
+        size_t l;
+        uint8_t *y = ReadFile(name, &l);
+        ASSERT(l == frames * size, "channel %" PRIu32 " has %zu bytes"
+                " not %zu", i, l, frames * size);
+        for(size_t j=0; j<frames; ++j)
+            ASSERT(memcmp(y + j * size, x + (j * N + i) * size, size) == 0,
+                    "channel %" PRIu32 " value %zu is wrong", i, j);
+        free(y);
+        unlink(name);
+    }
+
+    size_t l;
+    uint8_t *y = ReadFile(OUTFILE, &l);
+    ASSERT(l == len, "interleave wrote %zu bytes not %zu", l, len);
+    ASSERT(memcmp(x, y, len) == 0, "interleave of deinterleave is not"
+            " the input");
+
+    free(y);
+    free(x);
+    unlink(OUTFILE);
+    unlink(INFILE);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    // I/Q into I and Q.
+    Interleave(2, 4, 10000, 0, 0);
+    Interleave(3, 2, 20002, "--maxWrite 10", 2);
+    Interleave(5, 8, 3001, 0, 3);
+    Interleave(8, 1, 40001, "--maxWrite 7", 2);
+    Interleave(1, 12, 1000, "--maxWrite 100", 0);
+    // Sizes that are not 1, 2, 4 or 8.
+    Interleave(4, 3, 9999, 0, 0);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
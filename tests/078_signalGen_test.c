@@ -0,0 +1,180 @@
+// Tests the signalGen filter.  The tone and chirp must be the phasors
+// that we compute here in double precision, and the noise must have the
+// mean, RMS and spread of Gaussian noise.
+
+#include "dspTest.h"
+
+
+#define FILENAME  "078_signalGen.tmp"
+
+
+// Returns the n samples that signalGen writes with the options opts, and
+// sets *num to the number of floats.
+static float *Generate(const char *opts, size_t n, uint32_t maxThreads,
+        size_t *num) {
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --length %zu %s",
+            n, opts);
+    struct QsFilter *gen = Load(s, "signalGen", args);
+    Connect(gen, Sink(s, FILENAME));
+
+    Run(s, maxThreads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    float *x = ReadFloats(FILENAME, num);
+    fprintf(stderr, "signalGen { %s }: %zu floats\n", args, *num);
+    return x;
+}
+
+
+// The tone or chirp from the phase of each sample, in cycles.
+static void CheckPhases(const float *x, size_t n, bool isReal,
+        double amplitude, double (*Phase)(size_t i, const void *arg),
+        const void *arg) {
+
+    for(size_t i=0; i<n; ++i) {
+        double ph = 2.0 * M_PI * Phase(i, arg);
+        double re = amplitude * cos(ph), im = amplitude * sin(ph);
+        if(isReal)
+            ASSERT(fabs(x[i] - re) < 1.0e-3 * amplitude,
+                    "x[%zu] = %g not %lg", i, x[i], re);
+        else
+            ASSERT(hypot(x[2*i] - re, x[2*i+1] - im) < 1.0e-3 * amplitude,
+                    "x[%zu] = %g%+gi not %lg%+lgi", i, x[2*i], x[2*i+1],
+                    re, im);
+    }
+}
+
+
+struct Signal {
+    double rate, freq, freq2;
+    size_t chirpLength;
+};
+
+
+static double TonePhase(size_t i, const void *arg) {
+
+    const struct Signal *t = arg;
+    return t->freq * i/t->rate;
+}
+
+
+static double ChirpPhase(size_t i, const void *arg) {
+
+    const struct Signal *c = arg;
+    // The phase starts over at 0 each period.
+    i %= c->chirpLength;
+    // Hz per sample
+    double k = (c->freq2 - c->freq)/c->chirpLength;
+    return (c->freq * i + k * i * (i - 1)/2.0)/c->rate;
+}
+
+
+static void Tone(double rate, double freq, double amplitude, size_t n,
+        bool isReal, const char *opts, uint32_t maxThreads) {
+
+    char args[256];
+    snprintf(args, sizeof(args), "--rate %lg --freq %lg --amplitude %lg"
+            " %s %s", rate, freq, amplitude, isReal?"--real":"",
+            opts?opts:"");
+    size_t num;
+    float *x = Generate(args, n, maxThreads, &num);
+    ASSERT(num == (isReal?n:(2*n)), "%zu floats", num);
+
+    struct Signal t = { rate, freq, 0, 0 };
+    CheckPhases(x, n, isReal, amplitude, TonePhase, &t);
+    free(x);
+}
+
+
+static void Chirp(double rate, double freq, double freq2, double period,
+        double amplitude, size_t n, bool isReal, const char *opts,
+        uint32_t maxThreads) {
+
+    char args[256];
+    snprintf(args, sizeof(args), "--signal chirp --rate %lg --freq %lg"
+            " --freq2 %lg --period %lg --amplitude %lg %s %s",
+            rate, freq, freq2, period, amplitude, isReal?"--real":"",
+            opts?opts:"");
+    size_t num;
+    float *x = Generate(args, n, maxThreads, &num);
+    ASSERT(num == (isReal?n:(2*n)), "%zu floats", num);
+
+    struct Signal c = { rate, freq, freq2, period * rate };
+    CheckPhases(x, n, isReal, amplitude, ChirpPhase, &c);
+    free(x);
+}
+
+
+static void Noise(double amplitude, size_t n, bool isReal,
+        const char *opts, uint32_t maxThreads) {
+
+    char args[256];
+    snprintf(args, sizeof(args), "--signal noise --amplitude %lg %s %s",
+            amplitude, isReal?"--real":"", opts?opts:"");
+    size_t num;
+    float *x = Generate(args, n, maxThreads, &num);
+    ASSERT(num == (isReal?n:(2*n)), "%zu floats", num);
+
+    // Each float has the standard deviation sigma, and for complex the
+    // I/Q sample has the RMS amplitude.
+    double sigma = isReal?amplitude:(amplitude/M_SQRT2);
+    double sum = 0.0, sum2 = 0.0;
+    size_t in1 = 0;
+    for(size_t i=0; i<num; ++i) {
+        ASSERT(isfinite(x[i]), "x[%zu] = %g", i, x[i]);
+        sum += x[i];
+        sum2 += x[i] * x[i];
+        if(fabs(x[i]) < sigma)
+            ++in1;
+    }
+    double mean = sum/num;
+    double rms = sqrt(sum2/num);
+    // The fraction of Gaussian values that are within one standard
+    // deviation of the mean.
+    double frac = ((double) in1)/num;
+
+    fprintf(stderr, "  mean=%lg rms=%lg fraction in 1 sigma=%lg\n",
+            mean, rms, frac);
+    ASSERT(fabs(mean) < 5.0 * sigma/sqrt(num), "mean is %lg", mean);
+    ASSERT(fabs(rms - sigma) < 0.01 * sigma, "RMS is %lg not %lg",
+            rms, sigma);
+    ASSERT(fabs(frac - 0.682689) < 0.005, "%lg of the values are in one"
+            " standard deviation", frac);
+    free(x);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    Tone(1000000, 1000, 1.0, 100000, false, 0, 0);
+    // An odd --maxWrite, so the vector loop has a remainder, and a
+    // negative frequency.
+    Tone(48000, -7123, 0.3, 30001, false, "--maxWrite 28", 2);
+    Tone(48000, 440, 2.0, 30001, true, "--maxWrite 20", 0);
+
+    // 2.5 periods.
+    Chirp(100000, 1000, 20000, 0.1, 1.0, 25000, false, 0, 0);
+    Chirp(100000, -5000, 5000, 0.013, 0.5, 9999, false,
+            "--maxWrite 36", 2);
+    Chirp(48000, 100, 10000, 0.05, 1.0, 7001, true, "--maxWrite 28", 0);
+
+    Noise(1.0, 1000000, false, 0, 0);
+    Noise(0.25, 1000001, true, "--maxWrite 44 --seed 7", 2);
+
+    unlink(FILENAME);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
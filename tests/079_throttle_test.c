@@ -0,0 +1,98 @@
+// Tests the throttle filter.  An unthrottled signalGen replays a file
+// through throttle filters, and the stream must take as long as the
+// slowest throttle rate says, and pass the data through unchanged.
+
+#include <time.h>
+
+#include "dspTest.h"
+
+
+#define INFILE   "079_throttle_in.tmp"
+#define OUTFILE  "079_throttle_out.tmp"
+
+
+// Run n samples of size bytes through the throttle filters with the
+// options in opts[], which is 0 terminated, and check that it takes
+// seconds.
+static void Throttle(size_t n, size_t size, const char **opts,
+        double seconds, uint32_t maxThreads) {
+
+    size_t len = n * size;
+    // signalGen --real writes 4 byte samples.
+    ASSERT(len % 4 == 0);
+    uint8_t *x = malloc(len);
+    ASSERT(x);
+    uint32_t r = 7;
+    for(size_t i=0; i<len; ++i) {
+        r = r * 1664525 + 1013904223;
+        x[i] = r >> 24;
+    }
+    WriteFile(INFILE, x, len);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    char args[256];
+    snprintf(args, sizeof(args), "--unthrottled --real --length %zu"
+            " --signal replay --file " INFILE, len/4);
+    struct QsFilter *prev = Load(s, "signalGen", args);
+    for(const char **o = opts; *o; ++o) {
+        struct QsFilter *throttle = Load(s, "throttle", *o);
+        Connect(prev, throttle);
+        prev = throttle;
+    }
+    Connect(prev, Sink(s, OUTFILE));
+
+    struct timespec t0, t1;
+    ASSERT(clock_gettime(CLOCK_MONOTONIC, &t0) == 0);
+    Run(s, maxThreads);
+    ASSERT(clock_gettime(CLOCK_MONOTONIC, &t1) == 0);
+    double t = (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "%zu samples through throttle { %s }%s took %lg"
+            " seconds, expected %lg\n", n, opts[0], opts[1]?" and more":"",
+            t, seconds);
+    // The sleeps may be late, but never early.
+    ASSERT(t > 0.95 * seconds && t < seconds + 0.5,
+            "it took %lg seconds not %lg", t, seconds);
+
+    size_t l;
+    uint8_t *y = ReadFile(OUTFILE, &l);
+    ASSERT(l == len, "got %zu bytes not %zu", l, len);
+    ASSERT(memcmp(x, y, len) == 0, "throttle changed the data");
+
+    free(y);
+    free(x);
+    unlink(OUTFILE);
+    unlink(INFILE);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+    signal(SIGABRT, catcher);
+
+    // I/Q samples, which is the default --size.
+    const char *opts1[] = { "--rate 100000", 0 };
+    Throttle(50000, 8, opts1, 0.5, 0);
+
+    const char *opts2[] = { "--rate 200000 --size 4 --maxWrite 4000", 0 };
+    Throttle(100000, 4, opts2, 0.5, 2);
+
+    // The slower one sets the pace.
+    const char *opts3[] = {
+        "--rate 1000000 --size 2 --maxWrite 1002",
+        "--rate 250000 --size 2",
+        0
+    };
+    Throttle(100000, 2, opts3, 0.4, 3);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
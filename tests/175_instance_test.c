@@ -0,0 +1,87 @@
+// Tests the filter instance API.  tests/instanceCopy uses it, so all the
+// instanceCopy filters must share one loaded DSO, while each keeps its
+// own state.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/app.h"
+#include "../lib/qs.h"
+
+
+#define NUM_COPIES  5
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    const char *genArgv[] = { "--length", "109332", 0 };
+    struct QsFilter *gen = qsStreamFilterLoad(s, "tests/sequenceGen",
+            0, 2, genArgv);
+    ASSERT(gen);
+
+    // Each copy writes different amounts, so they need their own state.
+    const char *maxWrite[NUM_COPIES] = { "1000", "300", 0, "31", "4000" };
+    struct QsFilter *copy[NUM_COPIES];
+    struct QsFilter *prev = gen;
+
+    for(int i=0; i<NUM_COPIES; ++i) {
+        const char *copyArgv[] = { "--maxWrite", maxWrite[i], 0 };
+        copy[i] = qsStreamFilterLoad(s, "tests/instanceCopy", 0,
+                maxWrite[i]?2:0, copyArgv);
+        ASSERT(copy[i]);
+        ASSERT(copy[i] != QS_UNLOADED);
+        ASSERT(copy[i]->dlhandle);
+        ASSERT(copy[i]->dlhandle == copy[0]->dlhandle,
+                "filter \"%s\" has its own DSO", copy[i]->name);
+        qsFiltersConnect(prev, copy[i], QS_NEXTPORT, QS_NEXTPORT);
+        prev = copy[i];
+    }
+
+    const char *checkArgv[] = { "--maxWrite", "10", 0 };
+    struct QsFilter *check = qsStreamFilterLoad(s, "tests/sequenceCheck",
+            0, 2, checkArgv);
+    ASSERT(check);
+    qsFiltersConnect(prev, check, QS_NEXTPORT, QS_NEXTPORT);
+
+    // Run it with the main thread only, and with worker threads.
+    for(uint32_t maxThreads = 0; maxThreads < 4; maxThreads += 3) {
+        ASSERT(qsStreamReady(s) == 0);
+        ASSERT(qsStreamLaunch(s, maxThreads) == 0);
+        if(maxThreads)
+            qsStreamWait(s);
+        ASSERT(qsStreamStop(s) == 0);
+    }
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Tests loading filters that are compiled into the program, from the
+// qsBuiltin*.c files that ../lib/builtinFilters.bash makes.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/app.h"
+#include "../lib/qs.h"
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+static struct QsFilter *Load(struct QsStream *s, const char *fileName,
+        bool isBuiltin) {
+
+    struct QsFilter *f = qsStreamFilterLoad(s, fileName, 0, 0, 0);
+    ASSERT(f);
+    ASSERT(f != QS_UNLOADED);
+
+    if(isBuiltin)
+        ASSERT(f->builtin && !f->dlhandle,
+                "filter \"%s\" is not built-in", f->name);
+    else
+        ASSERT(!f->builtin && f->dlhandle,
+                "filter \"%s\" is built-in", f->name);
+
+    return f;
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    ASSERT(qsFilterPrintHelp("tests/sequenceGen", stderr) == 0);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    struct QsFilter *gen0 = Load(s, "tests/sequenceGen", true);
+    // instanceCopy uses the instance API so we can load it more than
+    // once, and it is built-in each time.
+    struct QsFilter *copy0 = Load(s, "tests/instanceCopy", true);
+    struct QsFilter *copy1 = Load(s, "tests/instanceCopy.so", true);
+    struct QsFilter *check0 = Load(s, "tests/sequenceCheck", true);
+    // These are in use, so we get the plugin DSO files.
+    struct QsFilter *gen1 = Load(s, "tests/sequenceGen", false);
+    struct QsFilter *check1 = Load(s, "tests/sequenceCheck", false);
+
+    struct QsBuiltin *genBuiltin = gen0->builtin;
+    struct QsBuiltin *copyBuiltin = copy0->builtin;
+    ASSERT(genBuiltin->useCount == 1);
+    ASSERT(copyBuiltin->useCount == 2);
+
+    qsFiltersConnect(gen0, copy0, QS_NEXTPORT, QS_NEXTPORT);
+    qsFiltersConnect(copy0, copy1, QS_NEXTPORT, QS_NEXTPORT);
+    qsFiltersConnect(copy1, check0, QS_NEXTPORT, QS_NEXTPORT);
+    qsFiltersConnect(gen1, check1, QS_NEXTPORT, QS_NEXTPORT);
+
+    ASSERT(qsStreamReady(s) == 0);
+    ASSERT(qsStreamLaunch(s, 2) == 0);
+    qsStreamWait(s);
+    ASSERT(qsStreamStop(s) == 0);
+
+    // Now the built-in sequenceGen is not in use.
+    ASSERT(qsFilterUnload(gen0) == 0);
+    ASSERT(genBuiltin->useCount == 0);
+    // The built-in sequenceGen keeps its file scope variables, but it sets
+    // them all in construct() and start(), so it does not matter.
+    gen0 = Load(s, "tests/sequenceGen", true);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    ASSERT(genBuiltin->useCount == 0);
+    ASSERT(copyBuiltin->useCount == 0);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
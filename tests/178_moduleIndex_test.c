@@ -0,0 +1,139 @@
+// Tests finding filter modules in QS_FILTER_PATH directories that have a
+// qsModules.index file, from ../lib/quickstream/plugins/qsModulesIndex.bash.
+//
+// A module that is in the index of the first directory but was removed
+// from it must be found in the next directory, and not be masked by the
+// stale index entry.  A module that is not in the index of its directory
+// is not looked for there.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/app.h"
+#include "../lib/qs.h"
+
+
+#define DIR_A  "178_moduleIndex_a"
+#define DIR_B  "178_moduleIndex_b"
+
+// Any filter module will do.
+#define MODULE  "../lib/quickstream/plugins/filters/tests/sequenceGen.so"
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+static void WriteString(const char *path, const char *str) {
+
+    FILE *f = fopen(path, "w");
+    ASSERT(f, "fopen(\"%s\", \"w\") failed", path);
+    ASSERT(fputs(str, f) >= 0);
+    fclose(f);
+}
+
+
+static void Copy(const char *from, const char *to) {
+
+    FILE *in = fopen(from, "r");
+    ASSERT(in, "fopen(\"%s\", \"r\") failed", from);
+    FILE *out = fopen(to, "w");
+    ASSERT(out, "fopen(\"%s\", \"w\") failed", to);
+    char buf[4096];
+    size_t rd;
+    while((rd = fread(buf, 1, sizeof(buf), in)))
+        ASSERT(fwrite(buf, 1, rd, out) == rd);
+    fclose(out);
+    fclose(in);
+}
+
+
+static void CleanUp(void) {
+
+    unlink(DIR_A "/qsModules.index");
+    unlink(DIR_B "/qsModules.index");
+    unlink(DIR_B "/stale.so");
+    unlink(DIR_B "/unlisted.so");
+    rmdir(DIR_A);
+    rmdir(DIR_B);
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    CleanUp();
+    ASSERT(mkdir(DIR_A, 0755) == 0);
+    ASSERT(mkdir(DIR_B, 0755) == 0);
+
+    // "stale" was removed from DIR_A, but not from its index.
+    WriteString(DIR_A "/qsModules.index", "# PATH\tSYMBOLS\nstale.so\n");
+    // "unlisted" was added to DIR_B after its index was made.
+    WriteString(DIR_B "/qsModules.index", "stale.so\tconstruct input\n");
+    Copy(MODULE, DIR_B "/stale.so");
+    Copy(MODULE, DIR_B "/unlisted.so");
+
+    char *cwd = getcwd(0, 0);
+    ASSERT(cwd);
+    size_t len = 2*strlen(cwd) + strlen(DIR_A) + strlen(DIR_B) + 4;
+    char *path = malloc(len);
+    ASSERT(path);
+    snprintf(path, len, "%s/" DIR_A ":%s/" DIR_B, cwd, cwd);
+    ASSERT(setenv("QS_FILTER_PATH", path, 1) == 0);
+    ASSERT(unsetenv("QS_MODULE_PATH") == 0);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    // Load it twice, so the second time is from the cache.
+    for(int i=0; i<2; ++i) {
+        struct QsFilter *f = qsStreamFilterLoad(s, "stale", 0, 0, 0);
+        ASSERT(f, "filter \"stale\" was not found in " DIR_B);
+        ASSERT(f != QS_UNLOADED);
+        ASSERT(f->dlhandle);
+        Dl_info info;
+        void *input = dlsym(f->dlhandle, "input");
+        ASSERT(input);
+        ASSERT(dladdr(input, &info));
+        DSPEW("Loaded \"%s\" from %s", f->name, info.dli_fname);
+        if(i == 0)
+            // The second time it's a copy in a temporary file.
+            ASSERT(strstr(info.dli_fname, DIR_B "/stale.so"),
+                    "\"stale\" was loaded from %s", info.dli_fname);
+    }
+
+    ASSERT(qsStreamFilterLoad(s, "unlisted", 0, 0, 0) == 0,
+            "\"unlisted\" is not in the index, so it should not be found");
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    free(path);
+    free(cwd);
+    CleanUp();
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../lib/Dictionary.h"
+#include "../lib/debug.h"
+
+// Tests qsDictionaryFreeze()
+
+static
+void catchSegv(int sig) {
+    fprintf(stderr, "\nCaught signal %d\n"
+            "\nsleeping:  gdb -pid %u\n",
+            sig, getpid());
+    while(true) usleep(100000);
+}
+
+
+#define NUM_KEYS  (1000)
+
+static char keys[NUM_KEYS][32];
+
+
+static size_t numFreed = 0;
+
+static void FreeValue(void *value) {
+    ++numFreed;
+}
+
+
+static void CheckAll(struct QsDictionary *d, size_t skip) {
+
+    for(size_t i=0; i<NUM_KEYS; ++i) {
+        if(i == skip) {
+            ASSERT(qsDictionaryFind(d, keys[i]) == 0);
+            continue;
+        }
+        void *value = 0;
+        ASSERT(qsDictionaryFind(d, keys[i]) == keys[i],
+                "key=\"%s\" not found", keys[i]);
+        ASSERT(qsDictionaryFindDict(d, keys[i], &value));
+        ASSERT(value == keys[i]);
+    }
+}
+
+
+int main(int argc, const char **argv) {
+
+    signal(SIGSEGV, catchSegv);
+
+    struct QsDictionary *d = qsDictionaryCreate();
+
+    // An empty dictionary can be frozen.
+    qsDictionaryFreeze(d);
+    ASSERT(qsDictionaryFind(d, "foo") == 0);
+
+    // Keys that share prefixes like parameter names do.
+    for(size_t i=0; i<NUM_KEYS; ++i) {
+        snprintf(keys[i], sizeof(keys[i]), (i%2)?"filter%zu:freq":
+                "f%zu", i);
+        struct QsDictionary *entry = 0;
+        ASSERT(qsDictionaryInsert(d, keys[i], keys[i], &entry) == 0);
+        qsDictionarySetFreeValueOnDestroy(entry, FreeValue);
+    }
+
+    CheckAll(d, -1);
+
+    qsDictionaryFreeze(d);
+
+    CheckAll(d, -1);
+
+    // Keys that are not there, including a prefix of keys that are.
+    ASSERT(qsDictionaryFind(d, "filter") == 0);
+    ASSERT(qsDictionaryFind(d, "filter1:") == 0);
+    ASSERT(qsDictionaryFind(d, "filter1:freqs") == 0);
+    ASSERT(qsDictionaryFind(d, "f1000") == 0);
+
+    // Setting a value does not need a new freeze.
+    struct QsDictionary *entry = qsDictionaryFindDict(d, "f0", 0);
+    ASSERT(entry);
+    qsDictionarySetValue(entry, "new");
+    ASSERT(strcmp(qsDictionaryFind(d, "f0"), "new") == 0);
+    qsDictionarySetValue(entry, keys[0]);
+
+    // Insert unfreezes.
+    ASSERT(qsDictionaryInsert(d, "filter1:freq:", "x", 0) == 0);
+    ASSERT(strcmp(qsDictionaryFind(d, "filter1:freq:"), "x") == 0);
+    CheckAll(d, -1);
+    // A key inserted with a sub-dictionary is found with the whole key
+    // after the freeze.
+    ASSERT(qsDictionaryInsert(entry, ":gain", "y", 0) == 0);
+    qsDictionaryFreeze(d);
+    ASSERT(strcmp(qsDictionaryFind(d, "filter1:freq:"), "x") == 0);
+    ASSERT(strcmp(qsDictionaryFind(d, "f0:gain"), "y") == 0);
+    ASSERT(qsDictionaryFind(d, ":gain") == 0);
+    CheckAll(d, -1);
+
+    // Inserting or removing with a sub-dictionary of a frozen dictionary
+    // fails, and does not change it.
+    ASSERT(qsDictionaryInsert(entry, ":freq", "z", 0) == -1);
+    ASSERT(qsDictionaryFind(d, "f0:freq") == 0);
+    ASSERT(qsDictionaryRemove(entry, ":gain") == -1);
+    ASSERT(strcmp(qsDictionaryFind(d, "f0:gain"), "y") == 0);
+    ASSERT(numFreed == 0);
+    CheckAll(d, -1);
+
+    // Remove unfreezes.
+    ASSERT(qsDictionaryRemove(d, keys[7]) == 0);
+    ASSERT(numFreed == 1);
+    qsDictionaryFreeze(d);
+    CheckAll(d, 7);
+
+    qsDictionaryDestroy(d);
+
+    ASSERT(numFreed == NUM_KEYS);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
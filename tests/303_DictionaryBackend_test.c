@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../lib/Dictionary.h"
+#include "../lib/debug.h"
+
+// Tests qsDictionaryCreateBackend() with all the backends.
+
+static
+void catchSegv(int sig) {
+    fprintf(stderr, "\nCaught signal %d\n"
+            "\nsleeping:  gdb -pid %u\n",
+            sig, getpid());
+    while(true) usleep(100000);
+}
+
+
+#define NUM_KEYS  (1000)
+
+static char keys[NUM_KEYS][32];
+
+
+static size_t numFreed = 0;
+
+static void FreeValue(void *value) {
+    ++numFreed;
+}
+
+
+// If skip is not 0, every skip key is not there.
+static void CheckAll(struct QsDictionary *d, size_t skip) {
+
+    for(size_t i=0; i<NUM_KEYS; ++i) {
+        if(skip && i%skip == 0) {
+            ASSERT(qsDictionaryFind(d, keys[i]) == 0);
+            continue;
+        }
+        void *value = 0;
+        ASSERT(qsDictionaryFind(d, keys[i]) == keys[i],
+                "key=\"%s\" not found", keys[i]);
+        struct QsDictionary *entry = qsDictionaryFindDict(d, keys[i],
+                &value);
+        ASSERT(entry);
+        ASSERT(value == keys[i]);
+        ASSERT(qsDictionaryGetValue(entry) == keys[i]);
+    }
+}
+
+
+static const char *lastKey;
+static bool sorted;
+
+static int CheckCallback(const char *key, void *value, void *userData) {
+
+    ASSERT(value == qsDictionaryFind(userData, key));
+    if(sorted && lastKey)
+        ASSERT(strcmp(lastKey, key) < 0);
+    lastKey = key;
+    return 0;
+}
+
+
+// Removes every third key, from in the callback.
+static int RemoveCallback(const char *key, void *value, void *userData) {
+
+    if(((char (*)[32]) value - keys) % 3 == 0)
+        ASSERT(qsDictionaryRemove(userData, key) == 0);
+    return 0;
+}
+
+
+static void Run(enum QsDictionaryBackend backend) {
+
+    numFreed = 0;
+
+    struct QsDictionary *d = qsDictionaryCreateBackend(backend);
+    ASSERT(d);
+
+    ASSERT(qsDictionaryFind(d, "foo") == 0);
+    ASSERT(qsDictionaryRemove(d, "foo") == 1);
+    ASSERT(qsDictionaryInsert(d, "bad\001key", "x", 0) == -1);
+
+    for(size_t i=0; i<NUM_KEYS; ++i) {
+        struct QsDictionary *entry = 0;
+        ASSERT(qsDictionaryInsert(d, keys[i], keys[i], &entry) == 0);
+        qsDictionarySetFreeValueOnDestroy(entry, FreeValue);
+    }
+
+    // Inserting a key that is there does not change it.
+    struct QsDictionary *entry = 0;
+    ASSERT(qsDictionaryInsert(d, keys[5], "x", &entry) == 1);
+    ASSERT(qsDictionaryGetValue(entry) == keys[5]);
+
+    CheckAll(d, 0);
+
+    ASSERT(qsDictionaryFind(d, "filter") == 0);
+    ASSERT(qsDictionaryFind(d, "filter1:freqs") == 0);
+
+    qsDictionarySetValue(entry, "new");
+    ASSERT(strcmp(qsDictionaryFind(d, keys[5]), "new") == 0);
+    qsDictionarySetValue(entry, keys[5]);
+
+    lastKey = 0;
+    // The hash table is the only one that is not in key order.
+    sorted = (backend != QsDictionaryHash);
+    ASSERT(qsDictionaryForEach(d, CheckCallback, d) == NUM_KEYS);
+
+    ASSERT(qsDictionaryForEach(d, RemoveCallback, d) == NUM_KEYS);
+    ASSERT(numFreed == (NUM_KEYS + 2)/3);
+    CheckAll(d, 3);
+
+    // Add them back, so the hash table reuses the removed slots.
+    for(size_t i=0; i<NUM_KEYS; i += 3) {
+        ASSERT(qsDictionaryInsert(d, keys[i], keys[i], &entry) == 0);
+        qsDictionarySetFreeValueOnDestroy(entry, FreeValue);
+    }
+    CheckAll(d, 0);
+
+    qsDictionaryFreeze(d);
+    CheckAll(d, 0);
+
+    qsDictionaryDestroy(d);
+
+    ASSERT(numFreed == NUM_KEYS + (NUM_KEYS + 2)/3);
+}
+
+
+int main(int argc, const char **argv) {
+
+    signal(SIGSEGV, catchSegv);
+
+    for(size_t i=0; i<NUM_KEYS; ++i)
+        snprintf(keys[i], sizeof(keys[i]), (i%2)?"filter%zu:freq":
+                "f%zu", i);
+
+    Run(QsDictionaryTrie);
+    Run(QsDictionaryHash);
+    Run(QsDictionarySorted);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../lib/Dictionary.h"
+#include "../lib/debug.h"
+
+// Tests that the trie entries do not move when the tree changes around
+// them, and that removing and inserting over and over works.
+
+static
+void catchSegv(int sig) {
+    fprintf(stderr, "\nCaught signal %d\n"
+            "\nsleeping:  gdb -pid %u\n",
+            sig, getpid());
+    while(true) usleep(100000);
+}
+
+
+#define NUM_KEYS  (2000)
+
+static char keys[NUM_KEYS][32];
+
+
+int main(int argc, const char **argv) {
+
+    signal(SIGSEGV, catchSegv);
+
+    struct QsDictionary *d = qsDictionaryCreate();
+
+    struct QsDictionary *e1, *e2, *e;
+
+    ASSERT(qsDictionaryInsert(d, "filter0:freq", "1", &e1) == 0);
+    ASSERT(qsDictionaryInsert(d, "filter0:freq:max", "2", &e2) == 0);
+
+    // These split the nodes above and at e1 and e2.
+    ASSERT(qsDictionaryInsert(d, "filter0:f", "3", 0) == 0);
+    ASSERT(qsDictionaryInsert(d, "filter", "4", 0) == 0);
+    ASSERT(qsDictionaryInsert(d, "filter0:freq:m", "5", 0) == 0);
+    ASSERT(qsDictionaryInsert(d, "filter0:freq:mix", "6", 0) == 0);
+
+    ASSERT(qsDictionaryFindDict(d, "filter0:freq", 0) == e1);
+    ASSERT(qsDictionaryFindDict(d, "filter0:freq:max", 0) == e2);
+    ASSERT(strcmp(qsDictionaryGetValue(e1), "1") == 0);
+    ASSERT(strcmp(qsDictionaryGetValue(e2), "2") == 0);
+
+    // Sub-dictionary finds from e1.
+    ASSERT(qsDictionaryFindDict(e1, ":max", 0) == e2);
+    ASSERT(strcmp(qsDictionaryFind(e1, ":m"), "5") == 0);
+    ASSERT(strcmp(qsDictionaryFind(e1, ":mix"), "6") == 0);
+    ASSERT(qsDictionaryFind(e1, ":mi") == 0);
+    ASSERT(qsDictionaryFind(e1, "freq") == 0);
+
+    // Inserting into the sub-dictionary.
+    ASSERT(qsDictionaryInsert(e1, ":min", "7", &e) == 0);
+    ASSERT(qsDictionaryFindDict(d, "filter0:freq:min", 0) == e);
+    ASSERT(qsDictionaryInsert(e1, ":max", "x", &e) == 1);
+    ASSERT(e == e2);
+
+    // Removing the keys around e2 does not move it.
+    ASSERT(qsDictionaryRemove(d, "filter0:freq:m") == 0);
+    ASSERT(qsDictionaryRemove(d, "filter0:freq:mix") == 0);
+    ASSERT(qsDictionaryRemove(d, "filter0:freq:min") == 0);
+    ASSERT(qsDictionaryFindDict(d, "filter0:freq:max", 0) == e2);
+    ASSERT(qsDictionaryFind(d, "filter0:freq:m") == 0);
+    ASSERT(qsDictionaryRemove(d, "filter0:freq:m") == 1);
+
+    const char *names[] = { "rate", "freq", "gain", "bytes" };
+
+    for(size_t i=0; i<NUM_KEYS; ++i)
+        snprintf(keys[i], sizeof(keys[i]), "filter%zu:%s", i/4 + 1,
+                names[i%4]);
+
+    // Insert and remove, over and over, so the memory that is freed is
+    // used again.
+    for(int loop = 0; loop < 10; ++loop) {
+
+        for(size_t i=0; i<NUM_KEYS; ++i)
+            qsDictionaryInsert(d, keys[i], keys[i], 0);
+
+        for(size_t i=0; i<NUM_KEYS; ++i)
+            ASSERT(qsDictionaryFind(d, keys[i]) == keys[i],
+                    "key=\"%s\"", keys[i]);
+
+        for(size_t i=loop%2; i<NUM_KEYS; i += 1 + loop%2)
+            qsDictionaryRemove(d, keys[i]);
+
+        for(size_t i=loop%2; i<NUM_KEYS; i += 1 + loop%2)
+            ASSERT(qsDictionaryFind(d, keys[i]) == 0);
+    }
+
+    ASSERT(strcmp(qsDictionaryFind(d, "filter"), "4") == 0);
+    ASSERT(strcmp(qsDictionaryFind(d, "filter0:f"), "3") == 0);
+    ASSERT(qsDictionaryFindDict(d, "filter0:freq", 0) == e1);
+    ASSERT(qsDictionaryFindDict(e1, ":max", 0) == e2);
+
+    qsDictionaryDestroy(d);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
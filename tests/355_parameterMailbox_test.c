@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/filter.h"
+#include "../include/quickstream/parameter.h"
+#include "../include/quickstream/app.h"
+
+// Tests qsParameterAddMailbox() and qsParameterMailboxRead() with
+// threads calling qsParameterSet() while this thread reads.
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+// The size is not a multiple of 8 bytes, and all the numbers in it are
+// the same when it's read whole.
+struct Value {
+    uint32_t n[5];
+};
+
+#define NUM_WRITERS  (3)
+#define NUM_SETS     (100000)
+
+static struct QsStream *s;
+static atomic_uint numDone;
+
+
+static void *Writer(void *arg) {
+
+    uint32_t id = (uintptr_t) arg;
+
+    for(uint32_t i=1; i<=NUM_SETS; ++i) {
+        struct Value v;
+        for(int j=0; j<5; ++j)
+            v.n[j] = (id << 24) | i;
+        ASSERT(qsParameterSet(s, "pt", "value", QsNew, &v) == 0);
+    }
+    atomic_fetch_add(&numDone, 1);
+    return 0;
+}
+
+
+static double sleepGot = -1.0;
+
+static
+int getCallback(
+        const void *value, void *stream,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *userData) {
+
+    sleepGot = *(double *) value;
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    struct QsFilter *f = qsStreamFilterLoad(s, "tests/passThrough",
+            "pt", 0, 0);
+    ASSERT(f);
+
+    // tests/passThrough has a "sleep" parameter with a mailbox and no
+    // setCallback(), so qsParameterSet() pushes the value for it.
+    ASSERT(qsParameterGet(s, "pt", "sleep",
+                QsDouble, getCallback, 0, 0, 0) == 1);
+    double sleepT = 0.0;
+    ASSERT(qsParameterSet(s, "pt", "sleep", QsDouble, &sleepT) == 0);
+    ASSERT(sleepGot == 0.0);
+
+    struct QsParameter *p = qsParameterCreateForFilter(f, "value",
+            QsNew, 0, 0, 0);
+    ASSERT(p);
+    uint32_t seen = 0;
+    struct Value v;
+
+    // We need the size for a QsNew type.
+    ASSERT(qsParameterAddMailbox(p, 0, 0) != 0);
+    ASSERT(qsParameterAddMailbox(p, sizeof(v), 0) == 0);
+    ASSERT(qsParameterAddMailbox(p, sizeof(v), 0) != 0);
+
+    // Nothing has been set yet.
+    ASSERT(qsParameterMailboxRead(p, &v, &seen) == false);
+
+    pthread_t threads[NUM_WRITERS];
+    for(uintptr_t i=0; i<NUM_WRITERS; ++i)
+        ASSERT(pthread_create(threads + i, 0, Writer, (void *) i) == 0);
+
+    uint32_t last[NUM_WRITERS] = { 0 };
+    size_t numReads = 0;
+
+    while(atomic_load(&numDone) != NUM_WRITERS) {
+
+        if(!qsParameterMailboxRead(p, &v, &seen))
+            continue;
+        ++numReads;
+        for(int j=1; j<5; ++j)
+            ASSERT(v.n[j] == v.n[0], "torn read %" PRIu32 " != %" PRIu32,
+                    v.n[j], v.n[0]);
+        uint32_t id = v.n[0] >> 24;
+        uint32_t i = v.n[0] & 0xFFFFFF;
+        ASSERT(id < NUM_WRITERS);
+        // Each writer sets its values in order.
+        ASSERT(i >= last[id]);
+        last[id] = i;
+    }
+
+    for(int i=0; i<NUM_WRITERS; ++i)
+        ASSERT(pthread_join(threads[i], 0) == 0);
+
+    // We may not have read the last value yet.  After that there's no new
+    // value, and without seen we get the last value again.
+    qsParameterMailboxRead(p, &v, &seen);
+    ASSERT(qsParameterMailboxRead(p, &v, &seen) == false);
+    ASSERT(qsParameterMailboxRead(p, &v, 0) == true);
+    // The last value set is the last value of one of the writers.
+    ASSERT((v.n[0] & 0xFFFFFF) == NUM_SETS);
+    ASSERT(numReads);
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "%zu reads with new values\n", numReads);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Tests qsParameterSetAt(), that the setting lands just before the
+// input() call that starts at the input offset.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/app.h"
+#include "../include/quickstream/parameter.h"
+#include "../lib/qs.h"
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+static const uint64_t offsets[] = { 1000, 1000, 5001, 123457, 400000 };
+#define NUM_OFFSETS  (sizeof(offsets)/sizeof(offsets[0]))
+
+static struct QsFilter *pt;
+static uint32_t numSet = 0;
+
+
+// This is called by the thread that calls the passThrough filter input(),
+// just before the input() call.
+static
+int setCallback(struct QsParameter *p,
+        void *value, const char *pName, void *userData) {
+
+    uint64_t offset = *(uint64_t *) value;
+
+    ASSERT(numSet < NUM_OFFSETS);
+    ASSERT(offset == offsets[numSet], "%" PRIu64 " != %" PRIu64,
+            offset, offsets[numSet]);
+    // The input is at the offset, to the byte.
+    ASSERT(pt->readers[0]->readCount == offset,
+            "readCount=%" PRIu64 " offset=%" PRIu64,
+            pt->readers[0]->readCount, offset);
+    ++numSet;
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    const char *genArgv[] = { "--length", "800000", 0 };
+    struct QsFilter *gen = qsStreamFilterLoad(s, "tests/sequenceGen",
+            0, 2, genArgv);
+    pt = qsStreamFilterLoad(s, "tests/passThrough", "pt", 0, 0);
+    struct QsFilter *check = qsStreamFilterLoad(s, "tests/sequenceCheck",
+            0, 0, 0);
+    ASSERT(gen && pt && check);
+
+    qsFiltersConnect(gen, pt, QS_NEXTPORT, QS_NEXTPORT);
+    qsFiltersConnect(pt, check, QS_NEXTPORT, QS_NEXTPORT);
+
+    ASSERT(qsParameterCreateForFilter(pt, "offset", QsUint64,
+                setCallback, 0, 0));
+
+    // We need to know how big a QsNew value is.
+    ASSERT(qsParameterCreateForFilter(pt, "new", QsNew,
+                setCallback, 0, 0));
+    uint64_t x = 0;
+    ASSERT(qsParameterSetAt(s, "pt", "new", QsNew, &x, 0, 10) != 0);
+
+    // pt has just input port 0, and the source has no input ports.
+    ASSERT(qsParameterSetAt(s, "pt", "offset", QsUint64, &x, 1, 10) != 0);
+    ASSERT(qsParameterCreateForFilter(gen, "offset", QsUint64,
+                setCallback, 0, 0));
+    ASSERT(qsParameterSetAt(s, gen->name, "offset", QsUint64,
+                &x, 0, 10) != 0);
+
+    // Run it with the main thread only, and with worker threads.
+    for(uint32_t maxThreads = 0; maxThreads < 4; maxThreads += 3) {
+
+        numSet = 0;
+
+        ASSERT(qsStreamReady(s) == 0);
+
+        // Set them out of order.  They come in offset order.
+        for(uint32_t i=NUM_OFFSETS-1; i!=-1; --i) {
+            uint64_t offset = offsets[i];
+            ASSERT(qsParameterSetAt(s, "pt", "offset", QsUint64,
+                        &offset, 0, offset) == 0);
+        }
+        // This one is past the end of the input, so it is not reached.
+        x = 900000;
+        ASSERT(qsParameterSetAt(s, "pt", "offset", QsUint64,
+                    &x, 0, x) == 0);
+
+        ASSERT(qsStreamLaunch(s, maxThreads) == 0);
+        if(maxThreads)
+            qsStreamWait(s);
+        ASSERT(qsStreamStop(s) == 0);
+
+        ASSERT(numSet == NUM_OFFSETS, "numSet=%" PRIu32, numSet);
+    }
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
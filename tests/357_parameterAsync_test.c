@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/filter.h"
+#include "../include/quickstream/parameter.h"
+#include "../include/quickstream/app.h"
+
+// Tests qsParameterGetAsync() with a thread pushing values like a filter
+// input() would.
+
+
+static
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+#define NUM_PUSHES  (1000)
+
+static struct QsParameter *p;
+static pthread_t pusher;
+
+
+static void *Pusher(void *arg) {
+
+    for(uint64_t i=1; i<=NUM_PUSHES; ++i) {
+        if(i == NUM_PUSHES)
+            // Let the queue drain so the last value is not dropped.
+            usleep(10000);
+        ASSERT(qsParameterPushByPointer(p, &i) == 0);
+        usleep(100);
+    }
+    return 0;
+}
+
+
+static pthread_t syncThread;
+
+static
+int syncCallback(
+        const void *value, void *stream,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *userData) {
+
+    syncThread = pthread_self();
+    return 0;
+}
+
+
+struct Got {
+    bool queued;
+    atomic_uint_fast64_t last;
+    atomic_uint count;
+};
+
+
+static
+int asyncCallback(
+        const void *value, void *stream,
+        const char *filterName, const char *pName,
+        enum QsParameterType type, void *userData) {
+
+    struct Got *got = userData;
+    uint64_t v = *(const uint64_t *) value;
+
+    ASSERT(!pthread_equal(pthread_self(), pusher));
+    ASSERT(type == QsUint64);
+    ASSERT(strcmp(pName, "count") == 0);
+    // Values are delivered in the order they are pushed.
+    ASSERT(v > atomic_load(&got->last), "%" PRIu64 " <= %" PRIu64,
+            v, (uint64_t) atomic_load(&got->last));
+    if(!got->queued)
+        // Slow enough that the pusher gets ahead of us.
+        usleep(1000);
+    atomic_store(&got->last, v);
+    atomic_fetch_add(&got->count, 1);
+    return 0;
+}
+
+
+static void WaitFor(struct Got *got) {
+
+    for(int i=0; i<5000 && atomic_load(&got->last) != NUM_PUSHES; ++i)
+        usleep(1000);
+    ASSERT(atomic_load(&got->last) == NUM_PUSHES, "got %" PRIu64,
+            (uint64_t) atomic_load(&got->last));
+}
+
+
+int main(int argc, char **argv) {
+
+    signal(SIGSEGV, catcher);
+
+    struct QsApp *app = qsAppCreate();
+    ASSERT(app);
+    struct QsStream *s = qsAppStreamCreate(app);
+    ASSERT(s);
+
+    struct QsFilter *f = qsStreamFilterLoad(s, "tests/passThrough",
+            "pt", 0, 0);
+    ASSERT(f);
+
+    p = qsParameterCreateForFilter(f, "count", QsUint64, 0, 0, 0);
+    ASSERT(p);
+
+    // We can't know the size of a QsNew value without a mailbox.
+    ASSERT(qsParameterCreateForFilter(f, "new", QsNew, 0, 0, 0));
+    ASSERT(qsParameterGetAsync(s, "pt", "new", QsNew, asyncCallback,
+                0, 0, 0, 0) < 0);
+
+    struct Got queued = { .queued = true }, latest = { .queued = false };
+
+    ASSERT(qsParameterGet(s, "pt", "count", QsUint64, syncCallback,
+                0, 0, 0) == 1);
+    ASSERT(qsParameterGetAsync(s, "pt", "count", QsUint64, asyncCallback,
+                0, &queued, 0, 0) == 1);
+    ASSERT(qsParameterGetAsync(s, "pt", "count", QsUint64, asyncCallback,
+                0, &latest, QS_LATEST_ONLY, 100.0) == 1);
+
+    ASSERT(pthread_create(&pusher, 0, Pusher, 0) == 0);
+    ASSERT(pthread_join(pusher, 0) == 0);
+
+    // The get callback from qsParameterGet() is called by the pusher.
+    ASSERT(pthread_equal(syncThread, pusher));
+
+    WaitFor(&queued);
+    WaitFor(&latest);
+
+    // At 100 per second for about 0.1 seconds or more, most of the values
+    // were skipped.
+    ASSERT(atomic_load(&latest.count) < NUM_PUSHES/4, "count=%u",
+            atomic_load(&latest.count));
+
+    fprintf(stderr, "queued got %u values, latest only got %u values\n",
+            atomic_load(&queued.count), atomic_load(&latest.count));
+
+    ASSERT(qsAppDestroy(app) == 0);
+
+    fprintf(stderr, "SUCCESS\n");
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Code that is shared by the tests of the signal processing filters in
+// ../lib/quickstream/plugins/filters/, the 07*_test.c files.
+//
+// Each test makes streams that start with a signalGen filter and end in
+// tests/outFile filters that write the output to files, runs them, and
+// then checks what is in the files.
+//
+// This is not a test.  It's just static inline functions that we include
+// in more than one test.  They are inline so that a test does not need to
+// use all of them.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+#include <complex.h>
+
+#include "../lib/debug.h"
+#include "../include/quickstream/app.h"
+
+
+static inline
+void catcher(int sig) {
+    fprintf(stderr, "Caught signal %u\n"
+            "\n"
+            "  Try:  gdb -pid %u\n\n"
+            "Will now sleep ...\n",
+            sig, getpid());
+    while(1) {
+        usleep(10000);
+    }
+}
+
+
+// Load the filter module name with the options in args, like
+// "--freq 1000 --real", or args may be 0.  The filter construct() may keep
+// pointers to the option strings, so we do not free them.
+static inline
+struct QsFilter *Load(struct QsStream *s, const char *name,
+        const char *args) {
+
+    const char *argv[64];
+    int argc = 0;
+
+    if(args) {
+        char *str = strdup(args);
+        ASSERT(str, "strdup() failed");
+        for(char *tok = strtok(str, " "); tok; tok = strtok(0, " ")) {
+            ASSERT(argc < 63);
+            argv[argc++] = tok;
+        }
+    }
+    argv[argc] = 0;
+
+    struct QsFilter *f = qsStreamFilterLoad(s, name, 0, argc, argv);
+    ASSERT(f, "Failed to load filter \"%s\" { %s }", name,
+            args?args:"");
+    ASSERT(f != QS_UNLOADED);
+    return f;
+}
+
+
+// Returns true if the filter module plugin was built.  Some filters, like
+// the fftw ones, are only built if the libraries they need are found.
+static inline
+bool HaveFilter(const char *name) {
+
+    char path[256];
+    snprintf(path, sizeof(path),
+            "../lib/quickstream/plugins/filters/%s.so", name);
+    if(access(path, R_OK) == 0)
+        return true;
+    // With GNU autotools.
+    snprintf(path, sizeof(path),
+            "../lib/quickstream/plugins/filters/.libs/%s.so", name);
+    return access(path, R_OK) == 0;
+}
+
+
+// Load a tests/outFile filter that writes its input to the file.
+static inline
+struct QsFilter *Sink(struct QsStream *s, const char *filename) {
+
+    char args[256];
+    snprintf(args, sizeof(args), "--file %s", filename);
+    return Load(s, "tests/outFile", args);
+}
+
+
+static inline
+void Connect(struct QsFilter *from, struct QsFilter *to) {
+    qsFiltersConnect(from, to, QS_NEXTPORT, QS_NEXTPORT);
+}
+
+
+// Run the stream until the source finishes.
+static inline
+void Run(struct QsStream *s, uint32_t maxThreads) {
+
+    ASSERT(qsStreamReady(s) == 0);
+    ASSERT(qsStreamLaunch(s, maxThreads) == 0);
+    if(maxThreads)
+        qsStreamWait(s);
+    ASSERT(qsStreamStop(s) == 0);
+}
+
+
+// Returns a malloc() allocated copy of what is in the file, and sets *len
+// to the length in bytes.
+static inline
+void *ReadFile(const char *filename, size_t *len) {
+
+    FILE *f = fopen(filename, "r");
+    ASSERT(f, "fopen(\"%s\", \"r\") failed", filename);
+    ASSERT(fseek(f, 0, SEEK_END) == 0);
+    long size = ftell(f);
+    ASSERT(size >= 0);
+    rewind(f);
+    // So we do not malloc(0).
+    uint8_t *buf = malloc(size + 1);
+    ASSERT(buf, "malloc(%ld) failed", size + 1);
+    ASSERT(fread(buf, 1, size, f) == (size_t) size);
+    fclose(f);
+    *len = size;
+    return buf;
+}
+
+
+// Write the len bytes in data to the file, for signalGen --signal replay.
+static inline
+void WriteFile(const char *filename, const void *data, size_t len) {
+
+    FILE *f = fopen(filename, "w");
+    ASSERT(f, "fopen(\"%s\", \"w\") failed", filename);
+    ASSERT(fwrite(data, 1, len, f) == len);
+    fclose(f);
+}
+
+
+// Returns the floats in the file and sets *n to the number of them.
+static inline
+float *ReadFloats(const char *filename, size_t *n) {
+
+    size_t len;
+    float *x = ReadFile(filename, &len);
+    ASSERT(len % sizeof(float) == 0, "file \"%s\" has %zu bytes",
+            filename, len);
+    *n = len/sizeof(float);
+    return x;
+}
+
+
+// Returns the frequency, in cycles per sample, of the tone in the n
+// complex (I/Q) samples in x, from the average phase change from one
+// sample to the next.
+static inline
+double ToneFreq(const float *x, size_t n) {
+
+    ASSERT(n >= 2);
+    double complex sum = 0.0;
+    for(size_t i=1; i<n; ++i)
+        sum += CMPLX(x[2*i], x[2*i+1]) * CMPLX(x[2*i-2], -x[2*i-1]);
+    return carg(sum)/(2.0 * M_PI);
+}
+
+
+// Returns the largest and smallest magnitudes of the n complex samples
+// in x.
+static inline
+void MagRange(const float *x, size_t n, double *min, double *max) {
+
+    *min = INFINITY;
+    *max = 0.0;
+    for(size_t i=0; i<n; ++i) {
+        double m = hypot(x[2*i], x[2*i+1]);
+        if(m < *min) *min = m;
+        if(m > *max) *max = m;
+    }
+}